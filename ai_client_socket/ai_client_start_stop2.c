@@ -36,6 +36,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <errno.h>
+#include <stdatomic.h>
 #include "rk_defines.h"
 #include "rk_debug.h"
 #include "rk_mpi_ai.h"
@@ -43,8 +44,18 @@
 #include "rk_mpi_amix.h"
 #include "rk_mpi_sys.h"
 #include "rk_mpi_mb.h"
+#include "rk_mpi_adec.h"
 #include <getopt.h>
 #include "test_comm_argparse.h"
+#include "socket_io_loop.h"
+#include "audio_codec.h"
+#include "audio_ring.h"
+#include "audio_jitter.h"
+#include "audio_mp3.h"
+#include "audio_preroll.h"
+#include "audio_vad.h"
+#include "audio_kws.h"
+#include "audio_resample.h"
 
 //视频采集配置参数
 #define VIDEO_DEVICE "/dev/video7"
@@ -61,9 +72,37 @@
 
 // Socket协议相关定义
 #define SOCKET_BUFFER_SIZE (8192)
-#define AUDIO_PLAY_BUFFER_SIZE (655360)  // 增大到64KB，支持大的音频数据包
+#define PLAYBACK_RING_SIZE          (128 * 1024)  // 播放环大小（必须为2的幂）
+#define PLAYBACK_PREBUFFER_MIN_MS   (AUDIO_JITTER_MIN_MS)  // 低水位（预缓冲时长）下限，按到达抖动自适应
+#define PLAYBACK_PREBUFFER_MAX_MS   (AUDIO_JITTER_MAX_MS)  // 低水位（预缓冲时长）上限
+#define PLAYBACK_CHUNK_BYTES        (4096)    // 每次送给AO的最大字节数
+#define PLAYBACK_POOL_BLOCKS        (10)      // AO帧内存池块数（AO缓冲帧数+2）
+#define PLAYBACK_SEND_TIMEOUT_MS    (20)      // AO队列满时单次等待时长，超时后重新检查中断/清空（限制抢话延迟）
+#define PLAYBACK_MAX_SEND_FAILS     (40)      // 连续发送失败次数上限，超过则丢弃该块
+#define PLAYBACK_POLL_US            (2000)    // 播放线程/背压等待的轮询间隔
+#define PLAYBACK_STALL_TIMEOUT_MS   (3000)    // 播放环长时间无法写入时放弃该包
+#define AO_IDLE_TIMEOUT_MS          (30000)   // 播放设备空闲多久后关闭（0=每次响应结束立即关闭）
+#define AI_IDLE_POLL_MS             (10)      // 采集线程每次取帧的最长等待
+#define CAPTURE_MSG_FRAME           (0)       // 采集队列：录音开始后采集到的一帧
+#define CAPTURE_MSG_PREROLL         (1)       // 采集队列：开始录音时补在开头的预录内容
+#define AI_PREROLL_MS               (300)     // 预录环默认时长（开始录音时补在上传数据前面，0=关闭）
+#define AI_VAD_HANGOVER_MS          (800)     // VAD：语音后静音多久判为一句话结束
+#define AI_KWS_CPU_BUDGET_PCT       (10)      // 关键词检测的CPU预算（单核百分比）
+#define AI_KWS_STATS_INTERVAL_MS    (60000)   // 关键词检测统计的打印间隔（按音频时长）
+#define MP3_ADEC_CHN                (0)       // 下行MP3解码通道
+#define MP3_ADEC_BUF_COUNT          (4)
+#define MP3_ADEC_BUF_SIZE           (1152 * 2 * 2)  // 一帧MP3解码输出（1152采样，双声道16位）
+#define MP3_SEGMENT_DRAIN_MS        (20)      // 句子结束时等待解码器输出剩余数据的时间
+#define MP3_END_DRAIN_MS            (200)     // 响应结束时等待解码器输出剩余数据的时间
 #define SOCKET_REQUEST_BUFFER_SIZE (16384)
 #define SOCKET_RESPONSE_BUFFER_SIZE (655360)  // 增大到64KB，支持更大的音频数据包
+#define SOCKET_CONTROL_TIMEOUT_MS   (30000)   // 等待开始/结束录音控制消息超时
+#define SOCKET_RESPONSE_TIMEOUT_MS  (80000)   // 等待AI响应消息超时
+#define SOCKET_RESPONSE_POLL_MS     (100)     // 等待响应时检查抢话中断的间隔
+#define CLIENT_HEARTBEAT_MS         (20000)   // 心跳间隔（连接空闲时发送）
+#define VOICE_ENCODE_CHUNK_SAMPLES  (1024)    // 每次编码的最大采样数（限制编码输出大小）
+#define VOICE_ENCODE_BUFFER_SIZE    (8192)    // 编码输出缓冲区（按上面的采样数足够Opus/ADPCM使用）
+#define VOICE_FILE_TX_WAIT_MS       (3000)    // 文件上传时等待发送队列腾出空间的最长时间
 
 // Socket协议消息类型定义（与Python SocketClient保持一致）
 #define MSG_VOICE_START     0x01    // 开始语音传输
@@ -82,11 +121,12 @@
 #define MSG_AI_NEWCHAT      0x0E    // 新对话开始
 #define MSG_CLIENT_HEART    0x10    // 客户端心跳
 #define MSG_IMAGE_DATA      0x11    // 图片数据
+#define MSG_CANCEL          0x12    // 客户端取消指定轮次（抢话），负载为轮次号
+#define AUDIO_TURN_ID_SIZE  4       // 轮次号长度（VOICE_START负载；服务器音频帧前缀，大端）
+#define AUDIO_FORMAT_INFO_SIZE 5    // AUDIO_START负载中的PCM格式（轮次号之后）：采样率4字节大端 + 声道数1字节
 // 音频包分段结束标记（与Python SocketClient保持一致）
 static const unsigned char AUDIO_END_MARKER[8] = {0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF};
 
-static RK_BOOL sendingvoice = RK_FALSE ;    //是否在发送语音
-static RK_BOOL grecvservRespon = RK_FALSE; //是否在接收服务器响应
 static RK_BOOL gRecorderExit = RK_FALSE;
 static RK_BOOL gGpioRecording = RK_FALSE;  // GPIO录音状态标志
 static RK_BOOL gGpioPressed = RK_FALSE;    // GPIO按钮按下状态
@@ -99,6 +139,172 @@ static pthread_mutex_t gAudioStateMutex = PTHREAD_MUTEX_INITIALIZER;  // 音频
 static volatile RK_BOOL gInterruptAIResponse = RK_FALSE;
 static volatile RK_BOOL gAIResponseActive = RK_FALSE; // 新增：AI响应进行中标志
 
+// 服务器连接由I/O线程独占，其他线程只通过队列收发帧
+static SOCKET_IO_LOOP_S g_stIoLoop;
+static SOCKET_MSG_QUEUE_S g_stCtrlQueue;    // 开始/结束录音控制消息（GPIO线程消费）
+static SOCKET_MSG_QUEUE_S g_stRespQueue;    // AI响应消息（录音线程消费）
+
+// 播放环：响应线程只追加数据，播放线程独占AO发送
+static AUDIO_RING_S g_stPlaybackRing;
+static pthread_t g_playbackThread;
+static volatile RK_BOOL g_playbackThreadRunning = RK_FALSE;
+static pthread_mutex_t g_playbackDevMutex = PTHREAD_MUTEX_INITIALIZER;  // AO设备开关与送帧互斥
+// 预缓冲自适应：只在响应线程中更新，目标变化时写入播放环低水位
+static AUDIO_JITTER_S g_stPlaybackJitter;
+static int g_s32PrebufferMs = PLAYBACK_PREBUFFER_MIN_MS;  // 当前生效的预缓冲时长
+
+// 播放设备生命周期管理：设备在多轮响应之间保持打开，格式变化时才重新配置，空闲超时后关闭
+typedef struct _AoManagerStats {
+    RK_U32 u32ColdSetups;       // 冷启动次数（设备未打开）
+    RK_U32 u32Reconfigs;        // 播放格式变化导致的重新配置次数
+    RK_U32 u32Reuses;           // 直接复用已打开设备的次数
+    RK_U32 u32IdleCloses;       // 空闲超时关闭次数
+    long   lLastSetupMs;        // 最近一次打开设备耗时
+    long   lMaxSetupMs;
+    long   lTotalSetupMs;
+} AO_MANAGER_STATS_S;
+
+static AO_MANAGER_STATS_S g_stAoStats;
+static RK_S32 g_s32AoIdleTimeoutMs = AO_IDLE_TIMEOUT_MS;
+static volatile long long g_llAoIdleSinceMs = 0;       // 设备空闲开始时间，0表示正在使用
+
+// 录音设备生命周期管理：混音器只在首次打开时配置，两次录音之间按空闲策略保持运行或暂停，
+// 按下按键时设备已经就绪
+typedef enum _AiIdleMode {
+    AI_IDLE_KEEP = 0,           // 通道保持运行，空闲时取帧丢弃，开始录音无需任何设备操作
+    AI_IDLE_PAUSE,              // 录音结束后只关闭通道（设备和混音器保持），响应结束后重新开启
+    AI_IDLE_CLOSE,              // 录音结束后完全关闭设备，响应结束后重新打开（原有行为，混音器不再重复配置）
+} AI_IDLE_MODE_E;
+
+typedef enum _AiDevState {
+    AI_DEV_CLOSED = 0,
+    AI_DEV_PAUSED,              // 设备已打开，通道已关闭
+    AI_DEV_RUNNING,
+} AI_DEV_STATE_E;
+
+typedef struct _AiManagerStats {
+    RK_U32        u32ColdSetups;    // 打开设备次数
+    RK_U32        u32Resumes;       // 重新开启通道次数
+    RK_U32        u32Reuses;        // 开始录音时设备已在运行的次数
+    RK_U32        u32MixerApplies;  // 混音器配置次数
+    unsigned long ulFlushedFrames;  // 响应结束后丢弃的积压帧
+    long          lLastRearmMs;     // 最近一次重新就绪耗时（设备/通道操作）
+    long          lMaxRearmMs;
+    long          lLastFirstFrameMs;// 最近一次开始录音到取得第一帧的耗时
+    long          lMaxFirstFrameMs;
+} AI_MANAGER_STATS_S;
+
+static AI_IDLE_MODE_E g_enAiIdleMode = AI_IDLE_KEEP;
+static AI_DEV_STATE_E g_enAiState = AI_DEV_CLOSED;
+static RK_BOOL g_bAiMixerApplied = RK_FALSE;
+static AI_MANAGER_STATS_S g_stAiStats;
+static long long g_llAiArmRequestMs = 0;               // 本次录音开始时间，取得第一帧后清零
+
+// 采集线程（GPIO触发模式）：录音设备运行时一直取帧，包括等待响应和播放期间。
+// 不在录音时写入预录环并送入关键词检测，录音时放入g_stCaptureQueue交给录音线程。
+// g_aiDevMutex只保护设备状态切换和取帧（取帧、拷贝、释放）；数据去向、预录环和关键词检测状态由
+// g_captureRouteMutex保护。采集线程在释放g_aiDevMutex之前取得g_captureRouteMutex，两把锁总按这个顺序获取
+static pthread_t g_captureThread;
+static volatile RK_BOOL g_captureThreadRunning = RK_FALSE;
+static pthread_mutex_t g_aiDevMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_captureRouteMutex = PTHREAD_MUTEX_INITIALIZER;
+static RK_BOOL g_bCaptureToRecorder = RK_FALSE;
+static SOCKET_MSG_QUEUE_S g_stCaptureQueue;          // 消息类型为CAPTURE_MSG_FRAME或CAPTURE_MSG_PREROLL
+static unsigned char *g_pCaptureBuf = NULL;            // 采集线程从设备帧拷出的PCM
+static RK_U32 g_u32CaptureBufSize = 0;
+
+// 预录环：等待开始录音期间采集到的最近一段声音（采集线程写入，录音线程在g_captureRouteMutex下取出）
+static AUDIO_PREROLL_S g_stPreroll;
+static RK_S32 g_s32PrerollMs = AI_PREROLL_MS;
+
+// 设备端VAD：off=不处理，trim=裁剪静音后上传，auto=裁剪静音并在检测到一句话结束时自动结束录音
+typedef enum _AiVadMode {
+    AI_VAD_OFF = 0,
+    AI_VAD_TRIM,
+    AI_VAD_AUTO,
+} AI_VAD_MODE_E;
+
+// 录音数据的去向（VAD输出回调使用），只在录音线程中使用
+typedef struct _CaptureOutput {
+    FILE    *fp;
+    RK_BOOL  bLive;
+    RK_BOOL  bFailed;       // 实时上传失败，之后的数据丢弃
+} CAPTURE_OUTPUT_S;
+
+static AI_VAD_MODE_E g_enVadMode = AI_VAD_TRIM;
+static RK_S32 g_s32VadHangoverMs = AI_VAD_HANGOVER_MS;
+static RK_BOOL g_bVadReady = RK_FALSE;
+static AUDIO_VAD_S g_stVad;
+static CAPTURE_OUTPUT_S g_stCapture;
+
+// 本地关键词检测：空闲时处理录音数据，检测到关键词后在本地触发开始录音（不等服务器的开始录音消息）
+static const char *g_pKwsTemplates = NULL;             // 关键词模板录音，逗号分隔
+static RK_S32 g_s32KwsThreshold = 0;                   // 0=自动
+static RK_BOOL g_bKwsReady = RK_FALSE;
+static volatile RK_BOOL g_bKwsRecording = RK_FALSE;    // 本次录音由关键词触发，由VAD判断结束
+static unsigned long long g_ullKwsLastLogMs = 0;
+static AUDIO_KWS_S g_stKws;
+
+// 采样率/声道转换：录音设备格式与上传格式不同时取帧后立即转换（录音线程）；
+// 服务器音频格式与播放设备格式不同时写入播放环前转换（响应线程）。转换缓冲区按需增长
+typedef struct _AudioConvert {
+    AUDIO_RESAMPLE_S stResample;
+    RK_BOOL          bEnabled;
+    unsigned char   *pBuf;
+    unsigned int     u32Size;
+} AUDIO_CONVERT_S;
+
+static AUDIO_CONVERT_S g_stCaptureConv;
+static AUDIO_CONVERT_S g_stPlaybackConv;
+static RK_BOOL g_bPlaybackFormatFixed = RK_FALSE;      // 播放设备格式由命令行指定，MP3下行也转换到该格式
+
+// 对话轮次：每次VOICE_START分配新的轮次号，服务器在AUDIO_START/AUDIO_DATA/AUDIO_END前加上轮次号，
+// I/O线程据此直接丢弃过期轮次的音频，不再拷贝进响应队列。
+// g_u32ActiveTurnId由I/O线程、录音线程和抢话触发线程（GPIO/采集）写入，I/O线程读取，只用原子操作访问
+static RK_U32 g_u32NextTurnId = 0;
+static _Atomic RK_U32 g_u32ActiveTurnId = 0;        // 正在接收音频的轮次，0表示丢弃所有带轮次号的音频
+static RK_BOOL g_bAudioTurnTagged = RK_FALSE;       // 服务器已确认音频帧带轮次号（连接建立时协商，只在I/O线程中访问）
+
+// 抢话统计：从I/O线程收到开始录音到AO缓冲清空的耗时，以及被丢弃的过期音频
+typedef struct _BargeInStats {
+    RK_U32        u32Count;
+    long          lLastMs;
+    long          lMaxMs;
+    long          lTotalMs;
+    RK_U32        u32StaleFrames;
+    unsigned long ulStaleBytes;
+    RK_U32        u32CancelSent;    // 发送MSG_CANCEL次数
+    RK_U32        u32CancelAcked;   // 收到服务器确认次数
+    long          lLastAckMs;       // 最近一次取消到确认的耗时
+} BARGE_IN_STATS_S;
+
+static BARGE_IN_STATS_S g_stBargeInStats;
+static volatile long long g_llStartRequestMs = 0;      // 最近一次开始录音控制消息到达时间（I/O线程写入）
+static volatile long long g_llBargeInRequestMs = 0;    // 本次抢话的触发时间，播放停止后统计延迟
+static volatile RK_U32 g_u32CancelTurnId = 0;          // 最近一次请求服务器取消的轮次
+static volatile long long g_llCancelSentMs = 0;
+
+// 下行MP3解码（rockit ADEC，只在响应线程中使用）：服务器直接转发TTS的MP3，解码后写入播放环
+typedef struct _Mp3DecodeCtx {
+    RK_BOOL       bEnabled;         // 本次运行使用MP3下行（启动时确认ADEC可用）
+    RK_BOOL       bOpened;          // ADEC通道已创建
+    RK_BOOL       bFormatKnown;     // 本次响应已从帧头得到采样率/声道数
+    RK_U32        u32Seq;
+    unsigned long ulInBytes;        // 收到的MP3字节数
+    unsigned long ulOutBytes;       // 解码输出的PCM字节数
+} MP3_DECODE_CTX_S;
+
+static MP3_DECODE_CTX_S g_stMp3Dec = {RK_FALSE, RK_FALSE, RK_FALSE, 0, 0, 0};
+
+// 上行语音编码器（只在录音线程中使用）
+static AUDIO_ENCODER_S g_stVoiceEncoder;
+static unsigned char g_voiceEncodeBuf[VOICE_ENCODE_BUFFER_SIZE];
+
+// 上行编码协商：连接建立后向服务器提议g_enVoiceCodecWanted，服务器确认前一直用PCM上传。
+// g_enVoiceCodecAgreed由I/O线程写入，录音线程在每轮的CONFIG之前切换编码器
+static AUDIO_CODEC_TYPE_E g_enVoiceCodecWanted = AUDIO_CODEC_PCM;
+static volatile AUDIO_CODEC_TYPE_E g_enVoiceCodecAgreed = AUDIO_CODEC_PCM;
+
 typedef struct _MyRecorderCtx {
     const char *outputFilePath;
     RK_S32      s32RecordSeconds;
@@ -116,6 +322,9 @@ typedef struct _MyRecorderCtx {
     RK_S32      s32VqeEnable;
     RK_S32      s32SetVolume;
     RK_S32      s32EnableUpload;     // 是否启用Socket上传
+    RK_S32      s32LiveUpload;       // 边录边传：采集到的帧直接发送，不写临时文件
+    const char *voiceCodec;          // 上行语音编码 (pcm/ima_adpcm/opus)
+    const char *audioFormat;         // 下行TTS音频格式 (mp3/pcm)
     const char *serverHost;          // 服务器地址
     RK_S32      serverPort;          // 服务器端口
     const char *responseFormat;      // 响应格式 (json/stream)
@@ -135,11 +344,6 @@ typedef struct _MyRecorderCtx {
     const char *gpioDebugPath;        // GPIO调试文件路径
     RK_S32      s32GpioNumber;        // 要监控的GPIO编号
     RK_S32      s32GpioPollInterval;  // GPIO状态检查间隔(ms)
-    
-    // Socket通信相关
-    int         sockfd;              // Socket文件描述符
-    char        audio_buffer[AUDIO_PLAY_BUFFER_SIZE]; // 音频缓冲区
-    size_t      audio_buffer_size;   // 音频缓冲区大小
 } MY_RECORDER_CTX_S;
 
 // 新增：时间统计相关定义
@@ -160,6 +364,7 @@ typedef struct _TimingStats {
     long total_voice_bytes;                    // 发送的语音数据总字节数
     long total_audio_bytes;                    // 接收的音频数据总字节数
     int voice_data_packets;                    // 语音数据包数量
+    int voice_data_dropped;                    // 发送队列已满而丢弃的语音帧数（实时上传）
     int audio_data_packets;                    // 音频数据包数量
     int audio_segments_played;                 // 已播放的音频段数
     
@@ -176,9 +381,7 @@ static TIMING_STATS_S g_timing_stats;
 static RK_S32 setup_audio_playback(MY_RECORDER_CTX_S *ctx);
 static RK_S32 cleanup_audio_playback(void);
 static void query_playback_status(void);
-static RK_S32 play_audio_buffer(MY_RECORDER_CTX_S *ctx, const void *audio_data, size_t data_len);
-static RK_S32 socket_send_message(int sockfd, unsigned char msg_type, const void *data, unsigned int data_len);
-static RK_S32 socket_receive_message(int sockfd, unsigned char *msg_type, void *data, unsigned int *data_len, unsigned int max_len);
+static RK_S32 socket_send_message(unsigned char msg_type, const void *data, unsigned int data_len);
 static RK_S32 process_received_message(MY_RECORDER_CTX_S *ctx, unsigned char msg_type, const void *data, unsigned int data_len);
 static void socket_log_with_time(const char *message);
 static AUDIO_SOUND_MODE_E find_sound_mode(RK_S32 ch);
@@ -203,6 +406,43 @@ static RK_BOOL get_audio_playing_state(void);
 static RK_BOOL is_audio_interrupted(void);
 static RK_S32 interrupt_audio_playback(void);
 
+// 播放线程相关函数声明
+static RK_S32 playback_start(MY_RECORDER_CTX_S *ctx);
+static void playback_ring_configure(void);
+static void playback_ring_update_prebuffer(void);
+static void playback_ring_append(const void *data, unsigned int len);
+static void playback_ring_drain(void);
+static void playback_ring_report(void);
+
+// 播放设备管理函数声明
+static RK_S32 ao_manager_acquire(MY_RECORDER_CTX_S *ctx);
+static void ao_manager_release(void);
+static void ao_manager_idle_check(void);
+static RK_S32 ai_manager_open(MY_RECORDER_CTX_S *ctx);
+static RK_S32 ai_manager_arm(MY_RECORDER_CTX_S *ctx, RK_BOOL bPress);
+static void ai_manager_park(MY_RECORDER_CTX_S *ctx);
+static void ai_manager_first_frame(void);
+static void ai_manager_close(MY_RECORDER_CTX_S *ctx);
+static RK_S32 kws_open(MY_RECORDER_CTX_S *ctx);
+static RK_BOOL kws_process(const void *data, RK_U32 len);
+static void raise_start_event(long long llRequestMs);
+static void preroll_prepend(MY_RECORDER_CTX_S *ctx);
+static void capture_begin(FILE *fp, RK_BOOL bLive);
+static RK_S32 capture_write(const void *data, RK_U32 len);
+static RK_BOOL capture_end(void);
+static RK_S32 audio_convert_run(AUDIO_CONVERT_S *conv, const void **data, unsigned int *len);
+static RK_S32 capture_convert(const void **data, RK_U32 *len);
+static void audio_convert_close(AUDIO_CONVERT_S *conv);
+static void playback_convert_setup(MY_RECORDER_CTX_S *ctx, RK_S32 s32SampleRate, RK_S32 s32Channels);
+static long long get_monotonic_ms(void);
+
+// 下行MP3解码函数声明
+static RK_S32 mp3_decoder_open(RK_S32 s32SampleRate, RK_S32 s32Channels);
+static void mp3_decoder_close(void);
+static RK_S32 mp3_decoder_probe(void);
+static unsigned int mp3_decoder_feed(const void *data, unsigned int len);
+static unsigned int mp3_decoder_drain(RK_S32 s32TimeoutMs, RK_BOOL bEndOfStream);
+
 static void sigterm_handler(int sig) {
     printf("INFO: Recording interrupted by user (Ctrl+C)");
     gRecorderExit = RK_TRUE;
@@ -257,557 +497,352 @@ static void socket_log_with_time(const char *message) {
 }
 
 // Socket协议：打包消息
-static RK_S32 socket_send_message(int sockfd, unsigned char msg_type, const void *data, unsigned int data_len) {
-    unsigned char header[5];
-    ssize_t sent_bytes;
-    
-    // 构建消息头：消息类型(1字节) + 数据长度(4字节，网络字节序)
-    header[0] = msg_type;
-    header[1] = (data_len >> 24) & 0xFF;
-    header[2] = (data_len >> 16) & 0xFF;
-    header[3] = (data_len >> 8) & 0xFF;
-    header[4] = data_len & 0xFF;
-    
+// 只把帧放入I/O线程的发送队列，由I/O线程合并发送
+static RK_S32 socket_send_message(unsigned char msg_type, const void *data, unsigned int data_len) {
     printf("📤 发送消息: 类型=0x%02X, 数据长度=%u\n", msg_type, data_len);
     fflush(stdout);
-    
-    // 发送消息头
-    sent_bytes = send(sockfd, header, 5, 0);
-    if (sent_bytes != 5) {
-        printf("❌ 发送消息头失败\n");
+
+    if (socket_io_send(&g_stIoLoop, msg_type, data, data_len) != 0) {
+        printf("❌ 发送消息失败: 未连接到服务器\n");
         fflush(stdout);
         return RK_FAILURE;
     }
-    
-    // 发送数据（如果有的话）
-    if (data_len > 0 && data != NULL) {
-        sent_bytes = send(sockfd, data, data_len, 0);
-        if (sent_bytes != (ssize_t)data_len) {
-            printf("❌ 发送消息数据失败\n");
-            fflush(stdout);
-            return RK_FAILURE;
+    return RK_SUCCESS;
+}
+
+// 发送配置消息
+static RK_S32 send_images_message(void) {
+    char config_json[256];
+    unsigned char *raw_buffer = (unsigned char *)(malloc(BUFFER_SIZE));
+    printf("INFO: Sending images message to server...\n");
+    fflush(stdout);
+    int res = capture_thread_func(NULL);
+    if(!res)
+    {
+        FILE* raw_file = fopen(RAW_FILE_PATH, "rb");
+        if (!raw_file) {
+            printf("[ERROR] 无法打开raw文件: %s\n", strerror(errno));
+        } else {
+            size_t bytes_read = fread(raw_buffer, 1, BUFFER_SIZE, raw_file);
+            printf("imagedata->bytes_read:%d \n",bytes_read);
+            fclose(raw_file);
+            raw_file = NULL;
         }
     }
+    // 构建配置JSON
+    //snprintf(config_json, sizeof(config_json), "{\"response_format\": \"%s\"}", response_format);
+    int imagelen = BUFFER_SIZE;
+
+    RK_S32 result = socket_send_message(MSG_IMAGE_DATA, raw_buffer, BUFFER_SIZE);
+    free(raw_buffer);   // 发送队列已拷贝数据
     
-    printf("✅ 消息发送成功\n");
-    fflush(stdout);
-    return RK_SUCCESS;
+    // 记录配置发送完成时间
+    if (result == RK_SUCCESS) {
+        record_timestamp(&g_timing_stats.config_sent_time, "图像消息发送完成");
+    }
+
+
+    return result;
 }
 
 
-static RK_S32 socket_receive_message_msg_press(int sockfd, unsigned char *msg_type, void *data, unsigned int *data_len, unsigned int max_len)
-{
-    unsigned char header[5];
-    ssize_t received_bytes;
-    unsigned int payload_len;
-    
-    // === 添加接收开始时间记录 ===
-    struct timeval recv_start, recv_end, select_start, select_end;
-    gettimeofday(&recv_start, NULL);
-    
-    // 设置接收超时
-    struct timeval timeout;
-    timeout.tv_sec = 30;  // 30秒超时
-    timeout.tv_usec = 0;
-    
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(sockfd, &readfds);
-    
-    // === 监控select等待时间 ===
-    gettimeofday(&select_start, NULL);
 
+// 连接建立后提议下行音频带轮次号和上行编码（在I/O线程中调用），服务器以带audio_turn_id_accepted/
+// voice_codec_accepted的MSG_CONFIG回复。确认前按旧服务器处理：音频帧不带轮次号，上行用PCM
+static void client_config_offer(MY_RECORDER_CTX_S *ctx) {
+    char offer_json[160];
 
-    printf("📡 [DEBUG-SELECT  ___press] 开始等待socket开始录音数据.. grecvservRespon:%d. \n",grecvservRespon);
-    
-    // 检查socket是否有数据可读
-    int select_result = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
+    g_enVoiceCodecAgreed = AUDIO_CODEC_PCM;
+    g_bAudioTurnTagged = RK_FALSE;
+    if (g_enVoiceCodecWanted == AUDIO_CODEC_PCM) {
+        snprintf(offer_json, sizeof(offer_json), "{\"audio_turn_id_offer\": true}");
+    } else {
+        snprintf(offer_json, sizeof(offer_json),
+                 "{\"audio_turn_id_offer\": true, \"voice_codec_offer\": \"%s\", "
+                 "\"voice_sample_rate\": %d, \"voice_channels\": %d}",
+                 audio_codec_name(g_enVoiceCodecWanted), ctx->s32SampleRate, ctx->s32Channel);
+    }
+    socket_io_send(&g_stIoLoop, MSG_CONFIG, offer_json, strlen(offer_json));
+}
 
-    long select_time = (select_end.tv_sec - select_start.tv_sec) * 1000 + 
-                       (select_end.tv_usec - select_start.tv_usec) / 1000;
-    
-    if (select_result <= 0) {
-        if (select_result == 0) {
-            printf("WARNING: [DEBUG-TIMEOUT] Socket receive timeout (30s), select耗时:%ldms\n", select_time);
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-SELECTERR] Socket select failed, select耗时:%ldms\n", select_time);
-            fflush(stdout);
-        }
-        return RK_FAILURE;
+// 在服务器回复中查找"key": true
+static RK_BOOL config_reply_true(const char *reply, const char *key) {
+    const char *p = strstr(reply, key);
+
+    if (!p) {
+        return RK_FALSE;
     }
+    p = strchr(p + strlen(key), ':');
+    while (p && (*p == ':' || *p == ' ')) {
+        p++;
+    }
+    return (p && strncmp(p, "true", 4) == 0) ? RK_TRUE : RK_FALSE;
+}
 
-     // 接收消息头（5字节）
-    received_bytes = recv(sockfd, header, 5, MSG_WAITALL);
+// 服务器对提议的回复（在I/O线程中调用）
+static void client_config_ack(const unsigned char *data, unsigned int len) {
+    char reply[256];
 
-    if (received_bytes != 5) {
-        if (received_bytes == 0) {
-            printf("INFO: [DEBUG-CLOSED] Server closed connection gracefully, header接收耗时:%ldms\n");
-            fflush(stdout);
-        } else if (received_bytes < 0) {
-            printf("ERROR: [DEBUG-RECVERR] Socket receive error, header接收耗时:%ldms\n");
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-PARTIAL] Partial header received: %zd/5 bytes, header接收耗时:%ldms\n");
-            fflush(stdout);
-        }
-        return RK_FAILURE;
+    if (len >= sizeof(reply)) {
+        len = sizeof(reply) - 1;
+    }
+    memcpy(reply, data, len);
+    reply[len] = '\0';
+    if (config_reply_true(reply, "\"audio_turn_id_accepted\"")) {
+        g_bAudioTurnTagged = RK_TRUE;
+        printf("INFO: 服务器确认音频帧带轮次号\n");
+        fflush(stdout);
+    }
+    if (!strstr(reply, "\"voice_codec_accepted\"") || !strstr(reply, audio_codec_name(g_enVoiceCodecWanted))) {
+        return;
+    }
+    if (config_reply_true(reply, "\"voice_codec_accepted\"")) {
+        g_enVoiceCodecAgreed = g_enVoiceCodecWanted;
+        printf("INFO: [CODEC] 服务器支持 %s，下一轮开始按此编码上传\n", audio_codec_name(g_enVoiceCodecWanted));
+    } else {
+        printf("WARNING: [CODEC] 服务器不支持 %s，继续使用PCM上传\n", audio_codec_name(g_enVoiceCodecWanted));
     }
-    // 解析消息头
-    *msg_type = header[0];
-    payload_len = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4];
-    printf("INFO: [DEBUG-MSG] Received message: type=0x%02X, data_length=%u\n", *msg_type, payload_len);
     fflush(stdout);
-    
-    // 检查数据长度是否合理
-    if (payload_len > max_len) {
-        printf("ERROR: [DEBUG-TOOLARGE] Data length too large: %u > %u\n", payload_len, max_len);
-        fflush(stdout);
-        return RK_FAILURE;
+}
+
+// 切换到服务器已确认的上行编码（随后的CONFIG声明它，服务器在VOICE_START时按此创建解码器）
+static void voice_codec_apply(MY_RECORDER_CTX_S *ctx) {
+    AUDIO_CODEC_TYPE_E agreed = g_enVoiceCodecAgreed;
+
+    if (g_stVoiceEncoder.type == agreed) {
+        return;
     }
-    *data_len = payload_len;
-    // === 监控payload接收时间 ===
-    struct timeval payload_start, payload_end;
-    
-    // 接收数据（如果有的话）
-    if (payload_len > 0) {
-        gettimeofday(&payload_start, NULL);
-        printf("📡 [DEBUG-PAYLOAD] 开始接收payload: %u字节\n", payload_len);
-        
-        received_bytes = recv(sockfd, data, payload_len, MSG_WAITALL);
-        
-        gettimeofday(&payload_end, NULL);
-        long payload_time = (payload_end.tv_sec - payload_start.tv_sec) * 1000 + 
-                           (payload_end.tv_usec - payload_start.tv_usec) / 1000;
-        
-        if (received_bytes != (ssize_t)payload_len) {
-            printf("ERROR: [DEBUG-PAYLOADFAIL] Failed to receive message data: %zd/%u bytes, payload接收耗时:%ldms\n", 
-                   received_bytes, payload_len, payload_time);
-            fflush(stdout);
-            return RK_FAILURE;
-        }     
+    audio_encoder_deinit(&g_stVoiceEncoder);
+    if (audio_encoder_init(&g_stVoiceEncoder, agreed, ctx->s32SampleRate, ctx->s32Channel) != 0) {
+        audio_encoder_init(&g_stVoiceEncoder, AUDIO_CODEC_PCM, ctx->s32SampleRate, ctx->s32Channel);
     }
-    return RK_SUCCESS;
+    printf("INFO: [CODEC] 上行编码: %s\n", audio_codec_name(g_stVoiceEncoder.type));
+    fflush(stdout);
 }
 
-static RK_S32 socket_receive_message_msg_release(int sockfd, unsigned char *msg_type, void *data, unsigned int *data_len, unsigned int max_len)
-{
-    unsigned char header[5];
-    ssize_t received_bytes;
-    unsigned int payload_len;
-    
-    // === 添加接收开始时间记录 ===
-    struct timeval recv_start, recv_end, select_start, select_end;
-    gettimeofday(&recv_start, NULL);
+// 发送配置消息
+static RK_S32 send_config_message(MY_RECORDER_CTX_S *ctx) {
+    char config_json[320];
+    int n;
     
-    // 设置接收超时
-    struct timeval timeout;
-    timeout.tv_sec = 30;  // 30秒超时
-    timeout.tv_usec = 0;
+    printf("INFO: Sending configuration message to server...\n");
+    fflush(stdout);
+    voice_codec_apply(ctx);
     
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(sockfd, &readfds);
+    // 构建配置JSON（同时声明上行语音的编码方式，PCM下行按原始采样率发送并在AUDIO_START中声明格式；
+    // 音频帧是否带轮次号在连接建立时已经协商）
+    n = snprintf(config_json, sizeof(config_json),
+                 "{\"response_format\": \"%s\", \"voice_codec\": \"%s\", \"voice_sample_rate\": %d, \"voice_channels\": %d, "
+                 "\"audio_start_format\": true",
+                 ctx->responseFormat, audio_codec_name(g_stVoiceEncoder.type), ctx->s32SampleRate, ctx->s32Channel);
+    // MP3下行：服务器直接转发TTS输出，不再逐包转码为PCM（PCM模式保持服务器默认配置）
+    if (g_stMp3Dec.bEnabled) {
+        n += snprintf(config_json + n, sizeof(config_json) - n, ", \"audio_format\": \"mp3\"");
+    }
+    snprintf(config_json + n, sizeof(config_json) - n, "}");
     
-    // === 监控select等待时间 ===
-    gettimeofday(&select_start, NULL);
-    printf("📡 [DEBUG-SELECT] ___release 开始等待socket结束录音数据...\n");
+    RK_S32 result = socket_send_message(MSG_CONFIG, config_json, strlen(config_json));
     
-    // 检查socket是否有数据可读
-    int select_result = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
+    // 记录配置发送完成时间
+    if (result == RK_SUCCESS) {
+        record_timestamp(&g_timing_stats.config_sent_time, "配置消息发送完成");
+    }
 
-    long select_time = (select_end.tv_sec - select_start.tv_sec) * 1000 + 
-                       (select_end.tv_usec - select_start.tv_usec) / 1000;
-    
-    if (select_result <= 0) {
-        if (select_result == 0) {
-            printf("WARNING: [DEBUG-TIMEOUT] Socket receive timeout (30s), select耗时:%ldms\n", select_time);
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-SELECTERR] Socket select failed, select耗时:%ldms\n", select_time);
-            fflush(stdout);
-        }
+    return result;
+}
+
+// 开始新的一轮：分配轮次号并随VOICE_START发送，之后只接收该轮次的音频
+static RK_S32 send_voice_start(void) {
+    unsigned char payload[AUDIO_TURN_ID_SIZE];
+    RK_U32 turn = ++g_u32NextTurnId;
+
+    if (turn == 0) {
+        turn = ++g_u32NextTurnId;
+    }
+    payload[0] = (unsigned char)(turn >> 24);
+    payload[1] = (unsigned char)(turn >> 16);
+    payload[2] = (unsigned char)(turn >> 8);
+    payload[3] = (unsigned char)turn;
+    atomic_store(&g_u32ActiveTurnId, turn);
+    return socket_send_message(MSG_VOICE_START, payload, sizeof(payload));
+}
+
+// 抢话时通知服务器停止生成该轮次的回复（服务器以带轮次号的MSG_AI_CANCELLED确认）
+static RK_S32 send_cancel_message(RK_U32 turn) {
+    unsigned char payload[AUDIO_TURN_ID_SIZE];
+
+    if (turn == 0) {
         return RK_FAILURE;
     }
+    payload[0] = (unsigned char)(turn >> 24);
+    payload[1] = (unsigned char)(turn >> 16);
+    payload[2] = (unsigned char)(turn >> 8);
+    payload[3] = (unsigned char)turn;
+    g_u32CancelTurnId = turn;
+    g_llCancelSentMs = get_monotonic_ms();
+    if (socket_io_send(&g_stIoLoop, MSG_CANCEL, payload, sizeof(payload)) != 0) {
+        return RK_FAILURE;
+    }
+    g_stBargeInStats.u32CancelSent++;
+    printf("🛑 [DEBUG-CANCEL] 请求服务器取消轮次 %u\n", turn);
+    fflush(stdout);
+    return RK_SUCCESS;
+}
 
-     // 接收消息头（5字节）
-    received_bytes = recv(sockfd, header, 5, MSG_WAITALL);
+// 发送一帧VOICE_DATA：实时上传在发送队列积压过多时丢弃该帧（IMA-ADPCM块和Opus包都可独立解码），
+// 文件上传则等待I/O线程腾出空间
+static RK_S32 send_voice_frame(const void *data, unsigned int len, RK_BOOL bLive) {
+    int ret;
 
-    if (received_bytes != 5) {
-        if (received_bytes == 0) {
-            printf("INFO: [DEBUG-CLOSED] Server closed connection gracefully, header接收耗时:%ldms\n");
-            fflush(stdout);
-        } else if (received_bytes < 0) {
-            printf("ERROR: [DEBUG-RECVERR] Socket receive error, header接收耗时:%ldms\n");
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-PARTIAL] Partial header received: %zd/5 bytes, header接收耗时:%ldms\n");
-            fflush(stdout);
+    if (bLive) {
+        ret = socket_io_send_droppable(&g_stIoLoop, MSG_VOICE_DATA, data, len);
+        if (ret == SOCKET_IO_ERR_FULL) {
+            if (g_timing_stats.voice_data_dropped++ == 0) {
+                printf("WARNING: [LIVE] 发送队列积压，开始丢弃语音帧\n");
+                fflush(stdout);
+            }
+            return RK_SUCCESS;
         }
-        return RK_FAILURE;
+        return ret == 0 ? RK_SUCCESS : RK_FAILURE;
     }
-    // 解析消息头
-    *msg_type = header[0];
-    payload_len = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4];
-    printf("INFO: [DEBUG-MSG] Received message: type=0x%02X, data_length=%u\n", *msg_type, payload_len);
-    fflush(stdout);
-    
-    // 检查数据长度是否合理
-    if (payload_len > max_len) {
-        printf("ERROR: [DEBUG-TOOLARGE] Data length too large: %u > %u\n", payload_len, max_len);
+
+    if (!socket_io_wait_tx_space(&g_stIoLoop, SOCKET_FRAME_HEADER_SIZE + len, VOICE_FILE_TX_WAIT_MS)) {
+        printf("ERROR: 发送队列长时间没有空间\n");
         fflush(stdout);
         return RK_FAILURE;
     }
-    *data_len = payload_len;
-    // === 监控payload接收时间 ===
-    struct timeval payload_start, payload_end;
-    
-    // 接收数据（如果有的话）
-    if (payload_len > 0) {
-        gettimeofday(&payload_start, NULL);
-        printf("📡 [DEBUG-PAYLOAD] 开始接收payload: %u字节\n", payload_len);
-        
-        received_bytes = recv(sockfd, data, payload_len, MSG_WAITALL);
-        
-        gettimeofday(&payload_end, NULL);
-        long payload_time = (payload_end.tv_sec - payload_start.tv_sec) * 1000 + 
-                           (payload_end.tv_usec - payload_start.tv_usec) / 1000;
-        
-        if (received_bytes != (ssize_t)payload_len) {
-            printf("ERROR: [DEBUG-PAYLOADFAIL] Failed to receive message data: %zd/%u bytes, payload接收耗时:%ldms\n", 
-                   received_bytes, payload_len, payload_time);
-            fflush(stdout);
+    return socket_io_send(&g_stIoLoop, MSG_VOICE_DATA, data, len) == 0 ? RK_SUCCESS : RK_FAILURE;
+}
+
+// 编码并发送一段语音PCM，PCM模式直接发送原始数据
+static RK_S32 send_voice_chunk(const void *pcm, unsigned int len, RK_BOOL bLive) {
+    const short *samples = (const short *)pcm;
+    int total = len / sizeof(short) / g_stVoiceEncoder.channels;
+
+    if (g_stVoiceEncoder.type == AUDIO_CODEC_PCM) {
+        return send_voice_frame(pcm, len, bLive);
+    }
+
+    while (total > 0) {
+        int count = total > VOICE_ENCODE_CHUNK_SAMPLES ? VOICE_ENCODE_CHUNK_SAMPLES : total;
+        int n = audio_encoder_encode(&g_stVoiceEncoder, samples, count, g_voiceEncodeBuf, sizeof(g_voiceEncodeBuf));
+
+        if (n < 0) {
+            printf("ERROR: [CODEC] 语音编码失败\n");
+            return RK_FAILURE;
+        }
+        if (n > 0 && send_voice_frame(g_voiceEncodeBuf, n, bLive) != RK_SUCCESS) {
             return RK_FAILURE;
-        }     
+        }
+        samples += count * g_stVoiceEncoder.channels;
+        total -= count;
     }
     return RK_SUCCESS;
 }
 
+// 发送编码器中剩余的数据（VOICE_END之前调用）
+static RK_S32 send_voice_flush(void) {
+    int n = audio_encoder_flush(&g_stVoiceEncoder, g_voiceEncodeBuf, sizeof(g_voiceEncodeBuf));
 
-// Socket协议：解包消息
-static RK_S32 socket_receive_message(int sockfd, unsigned char *msg_type, void *data, unsigned int *data_len, unsigned int max_len) {
-    unsigned char header[5];
-    ssize_t received_bytes;
-    unsigned int payload_len;
-    
-    // === 添加接收开始时间记录 ===
-    struct timeval recv_start, recv_end, select_start, select_end;
-    gettimeofday(&recv_start, NULL);
-    
-    // 设置接收超时
-    struct timeval timeout;
-    timeout.tv_sec = 80;  // 30秒超时
-    timeout.tv_usec = 0;
-    
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(sockfd, &readfds);
-    
-    // === 监控select等待时间 ===
-    gettimeofday(&select_start, NULL);
-    printf("📡 [DEBUG-SELECT] 开始等待socket数据  nomal...\n");
-    
-    // 检查socket是否有数据可读
-    int select_result = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
-    
-    gettimeofday(&select_end, NULL);
-    long select_time = (select_end.tv_sec - select_start.tv_sec) * 1000 + 
-                       (select_end.tv_usec - select_start.tv_usec) / 1000;
-    
-    if (select_result <= 0) {
-        if (select_result == 0) {
-            printf("WARNING: [DEBUG-TIMEOUT] Socket receive timeout (30s), select耗时:%ldms\n", select_time);
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-SELECTERR] Socket select failed, select耗时:%ldms\n", select_time);
-            fflush(stdout);
-        }
+    if (n < 0) {
         return RK_FAILURE;
     }
-    
-    printf("📡 [DEBUG-SELECTOK] Socket数据就绪, select耗时:%ldms\n", select_time);
-    
-    // === 监控header接收时间 ===
-    struct timeval header_start, header_end;
-    gettimeofday(&header_start, NULL);
-    
-    // 接收消息头（5字节）
-    received_bytes = recv(sockfd, header, 5, MSG_WAITALL);
-    
-    gettimeofday(&header_end, NULL);
-    long header_time = (header_end.tv_sec - header_start.tv_sec) * 1000 + 
-                       (header_end.tv_usec - header_start.tv_usec) / 1000;
-    
-    if (received_bytes != 5) {
-        if (received_bytes == 0) {
-            printf("INFO: [DEBUG-CLOSED] Server closed connection gracefully, header接收耗时:%ldms\n", header_time);
-            fflush(stdout);
-        } else if (received_bytes < 0) {
-            printf("ERROR: [DEBUG-RECVERR] Socket receive error, header接收耗时:%ldms\n", header_time);
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-PARTIAL] Partial header received: %zd/5 bytes, header接收耗时:%ldms\n", 
-                   received_bytes, header_time);
-            fflush(stdout);
-        }
+    if (n > 0 && socket_io_send(&g_stIoLoop, MSG_VOICE_DATA, g_voiceEncodeBuf, n) != 0) {
         return RK_FAILURE;
     }
-    
-    if (header_time > 1) {
-        printf("📡 [DEBUG-HEADERTIME] Header接收耗时: %ldms\n", header_time);
+    if (g_stVoiceEncoder.type != AUDIO_CODEC_PCM && g_stVoiceEncoder.out_bytes > 0) {
+        printf("INFO: [CODEC] %s: PCM %lu 字节 -> 上行 %lu 字节 (%.1f:1)\n", audio_codec_name(g_stVoiceEncoder.type),
+               g_stVoiceEncoder.in_bytes, g_stVoiceEncoder.out_bytes,
+               (double)g_stVoiceEncoder.in_bytes / g_stVoiceEncoder.out_bytes);
+        fflush(stdout);
     }
+    return RK_SUCCESS;
+}
+
+// 发送语音文件到Socket服务器
+static RK_S32 send_voice_file_to_socket_server(MY_RECORDER_CTX_S *ctx) {
+    FILE *file;
+    char file_buffer[1024];
+    size_t bytes_read;
+    long total_sent = 0;
+    long file_size;
     
-    // 解析消息头
-    *msg_type = header[0];
-    payload_len = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4];
+    if (!ctx->s32EnableUpload || !ctx->outputFilePath) {
+        return RK_SUCCESS;
+    }
     
-    printf("INFO: [DEBUG-MSG] Received message: type=0x%02X, data_length=%u\n", *msg_type, payload_len);
+    printf("INFO: Starting to send audio file via socket\n");
     fflush(stdout);
     
-    // 检查数据长度是否合理
-    if (payload_len > max_len) {
-        printf("ERROR: [DEBUG-TOOLARGE] Data length too large: %u > %u\n", payload_len, max_len);
+    file = fopen(ctx->outputFilePath, "rb");
+    if (!file) {
+        printf("ERROR: Cannot open file: %s\n", ctx->outputFilePath);
         fflush(stdout);
         return RK_FAILURE;
     }
     
-    *data_len = payload_len;
+    // 获取文件大小
+    fseek(file, 0, SEEK_END);
+    file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    printf("INFO: File size: %ld bytes\n", file_size);
+    fflush(stdout);
+    
     
-    // === 监控payload接收时间 ===
-    struct timeval payload_start, payload_end;
+    // 发送语音开始信号
+    record_timestamp(&g_timing_stats.voice_start_time, "语音开始发送");
+    audio_encoder_reset(&g_stVoiceEncoder);
+    if (send_voice_start() != RK_SUCCESS) {
+        fclose(file);
+        return RK_FAILURE;
+    }
     
-    // 接收数据（如果有的话）
-    if (payload_len > 0) {
-        gettimeofday(&payload_start, NULL);
-        printf("📡 [bayes_DEBUG-PAYLOAD] 开始接收payload: %u字节\n", payload_len);
+    // 分块发送文件数据
+    while ((bytes_read = fread(file_buffer, 1, sizeof(file_buffer), file)) > 0) {
+        // 记录第一个语音数据包发送时间
+        if (g_timing_stats.voice_data_packets == 0) {
+            record_timestamp(&g_timing_stats.voice_data_first_time, "第一个语音数据包发送");
+        }
         
-        received_bytes = recv(sockfd, data, payload_len, MSG_WAITALL);
+        if (send_voice_chunk(file_buffer, bytes_read, RK_FALSE) != RK_SUCCESS) {
+            printf("ERROR: Failed to send voice data\n");
+            fflush(stdout);
+            fclose(file);
+            return RK_FAILURE;
+        }
+        
+        // 更新统计数据
+        g_timing_stats.voice_data_packets++;
+        g_timing_stats.total_voice_bytes += bytes_read;
+        total_sent += bytes_read;
         
-        gettimeofday(&payload_end, NULL);
-        long payload_time = (payload_end.tv_sec - payload_start.tv_sec) * 1000 + 
-                           (payload_end.tv_usec - payload_start.tv_usec) / 1000;
+        // 记录最后一个数据包时间（每次都更新，最后一次就是最终时间）
+        record_timestamp(&g_timing_stats.voice_data_last_time, "语音数据包发送");
         
-        if (received_bytes != (ssize_t)payload_len) {
-            printf("ERROR: [DEBUG-PAYLOADFAIL] Failed to receive message data: %zd/%u bytes, payload接收耗时:%ldms\n", 
-                   received_bytes, payload_len, payload_time);
+        if (total_sent % 8192 == 0) {
+            printf("INFO: Sent %ld/%ld bytes (包数: %d)\n", total_sent, file_size, g_timing_stats.voice_data_packets);
             fflush(stdout);
-            return RK_FAILURE;
         }
         
-        // 计算接收速度
-        if (payload_time > 0) {
-            long payload_speed = payload_len * 1000 / payload_time; // bytes/sec
-            printf("📡 [DEBUG-PAYLOADOK] Payload接收完成: %u字节, 耗时:%ldms, 速度:%ld字节/秒\n", 
-                   payload_len, payload_time, payload_speed);
-            
-            // 如果是音频数据且接收耗时较长，发出警告
-            if (*msg_type == MSG_AUDIO_DATA && payload_time > 10) {
-                printf("⚠️ [DEBUG-SLOWPAYLOAD] 音频数据接收较慢: %ldms > 10ms, 可能影响播放连续性\n", payload_time);
-            }
+        // 检查是否需要退出
+        if (gRecorderExit) {
+            break;
         }
     }
     
-    // === 计算总接收时间 ===
-    gettimeofday(&recv_end, NULL);
-    long total_recv_time = (recv_end.tv_sec - recv_start.tv_sec) * 1000 + 
-                          (recv_end.tv_usec - recv_start.tv_usec) / 1000;
-    
-    printf("📡 [DEBUG-RECVDONE] 消息接收完成: 类型=0x%02X, 数据=%u字节, 总耗时:%ldms\n", 
-           *msg_type, payload_len, total_recv_time);
+    fclose(file);
     
-    // 如果总接收时间较长，发出警告
-    if (total_recv_time > 20) {
-        printf("⚠️ [DEBUG-SLOWRECV] 网络接收较慢: %ldms > 20ms, 可能阻塞音频播放\n", total_recv_time);
+    // 发送语音结束信号
+    if (send_voice_flush() != RK_SUCCESS || socket_send_message(MSG_VOICE_END, NULL, 0) != RK_SUCCESS) {
+        printf("INFO: 语音包结束\n");
+        return RK_FAILURE;
     }
     
-    return RK_SUCCESS;
-}
-
-// 连接到Socket服务器
-static int connect_to_socket_server(const char *host, int port) {
-    int sockfd;
-    struct sockaddr_in server_addr;
-    struct hostent *server;
+    // 记录语音发送结束时间
+    record_timestamp(&g_timing_stats.voice_end_time, "语音发送结束");
     
-    printf("INFO: Starting connection to server %s:%d\n", host, port);
-    fflush(stdout);
-    
-    // 创建socket
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-        printf("ERROR: Failed to create socket\n");
-        fflush(stdout);
-        return -1;
-    }
-    
-    // 解析主机名
-    server = gethostbyname(host);
-    if (server == NULL) {
-        printf("ERROR: Failed to resolve hostname: %s\n", host);
-        fflush(stdout);
-        close(sockfd);
-        return -1;
-    }
-    
-    // 设置服务器地址
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    memcpy(&server_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-    server_addr.sin_port = htons(port);
-    
-    // 连接服务器
-    if (connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        perror("connect 失败");  // 会自动拼接 ": 错误原因"
-        // 方法 2：获取错误码对应的描述字符串（更灵活）
-        fprintf(stderr, "connect 失败: %s (错误码: %d)\n", strerror(errno), errno);
-        printf("ERROR: Failed to connect to server: %s:%d\n", host, port);
-        fflush(stdout);
-        close(sockfd);
-        return -1;
-    }
-    printf("INFO: Successfully connected to server %s:%d\n", host, port);
-    fflush(stdout);
-    return sockfd;
-}
-
-// 发送配置消息
-static RK_S32 send_images_message(int sockfd) {
-    char config_json[256];
-    unsigned char *raw_buffer = (unsigned char *)(malloc(BUFFER_SIZE));
-    printf("INFO: Sending images message to server...\n");
-    fflush(stdout);
-    int res = capture_thread_func(NULL);
-    if(!res)
-    {
-        FILE* raw_file = fopen(RAW_FILE_PATH, "rb");
-        if (!raw_file) {
-            printf("[ERROR] 无法打开raw文件: %s\n", strerror(errno));
-        }
-        size_t bytes_read = fread(raw_buffer, 1, BUFFER_SIZE, raw_file);
-        printf("imagedata->bytes_read:%d \n",bytes_read);
-        fclose(raw_file);
-        raw_file = NULL;
-    }
-    // 构建配置JSON
-    //snprintf(config_json, sizeof(config_json), "{\"response_format\": \"%s\"}", response_format);
-    int imagelen = BUFFER_SIZE;
-
-    RK_S32 result = socket_send_message(sockfd, MSG_IMAGE_DATA, raw_buffer, BUFFER_SIZE);
-    
-    // 记录配置发送完成时间
-    if (result == RK_SUCCESS) {
-        record_timestamp(&g_timing_stats.config_sent_time, "图像消息发送完成");
-    }
-
-
-    return result;
-}
-
-
-
-// 发送配置消息
-static RK_S32 send_config_message(int sockfd, const char *response_format) {
-    char config_json[256];
-    
-    printf("INFO: Sending configuration message to server...\n");
-    fflush(stdout);
-    
-    // 构建配置JSON
-    snprintf(config_json, sizeof(config_json), "{\"response_format\": \"%s\"}", response_format);
-    
-    RK_S32 result = socket_send_message(sockfd, MSG_CONFIG, config_json, strlen(config_json));
-    
-    // 记录配置发送完成时间
-    if (result == RK_SUCCESS) {
-        record_timestamp(&g_timing_stats.config_sent_time, "配置消息发送完成");
-    }
-
-    return result;
-}
-
-// 发送语音文件到Socket服务器
-static RK_S32 send_voice_file_to_socket_server(MY_RECORDER_CTX_S *ctx) {
-    FILE *file;
-    char file_buffer[1024];
-    size_t bytes_read;
-    long total_sent = 0;
-    long file_size;
-    
-    if (!ctx->s32EnableUpload || !ctx->outputFilePath) {
-        return RK_SUCCESS;
-    }
-    
-    printf("INFO: Starting to send audio file via socket\n");
-    fflush(stdout);
-    
-    file = fopen(ctx->outputFilePath, "rb");
-    if (!file) {
-        printf("ERROR: Cannot open file: %s\n", ctx->outputFilePath);
-        fflush(stdout);
-        return RK_FAILURE;
-    }
-    
-    // 获取文件大小
-    fseek(file, 0, SEEK_END);
-    file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    printf("INFO: File size: %ld bytes\n", file_size);
-    fflush(stdout);
-    
-    
-    // 发送语音开始信号
-    record_timestamp(&g_timing_stats.voice_start_time, "语音开始发送");
-    if (socket_send_message(ctx->sockfd, MSG_VOICE_START, NULL, 0) != RK_SUCCESS) {
-        fclose(file);
-        return RK_FAILURE;
-    }
-    
-    // 分块发送文件数据
-    while ((bytes_read = fread(file_buffer, 1, sizeof(file_buffer), file)) > 0) {
-        // 记录第一个语音数据包发送时间
-        if (g_timing_stats.voice_data_packets == 0) {
-            record_timestamp(&g_timing_stats.voice_data_first_time, "第一个语音数据包发送");
-        }
-        
-        if (socket_send_message(ctx->sockfd, MSG_VOICE_DATA, file_buffer, bytes_read) != RK_SUCCESS) {
-            printf("ERROR: Failed to send voice data\n");
-            fflush(stdout);
-            fclose(file);
-            return RK_FAILURE;
-        }
-        
-        // 更新统计数据
-        g_timing_stats.voice_data_packets++;
-        g_timing_stats.total_voice_bytes += bytes_read;
-        total_sent += bytes_read;
-        
-        // 记录最后一个数据包时间（每次都更新，最后一次就是最终时间）
-        record_timestamp(&g_timing_stats.voice_data_last_time, "语音数据包发送");
-        
-        if (total_sent % 8192 == 0) {
-            printf("INFO: Sent %ld/%ld bytes (包数: %d)\n", total_sent, file_size, g_timing_stats.voice_data_packets);
-            fflush(stdout);
-        }
-        
-        // 检查是否需要退出
-        if (gRecorderExit) {
-            break;
-        }
-    }
-    
-    fclose(file);
-    
-    // 发送语音结束信号
-    if (socket_send_message(ctx->sockfd, MSG_VOICE_END, NULL, 0) != RK_SUCCESS) {
-        printf("INFO: 语音包结束\n");
-        return RK_FAILURE;
-    }
-    
-    // 记录语音发送结束时间
-    record_timestamp(&g_timing_stats.voice_end_time, "语音发送结束");
-    
-    printf("INFO: Voice file transmission completed: %ld bytes\n", total_sent);
+    printf("INFO: Voice file transmission completed: %ld bytes\n", total_sent);
     fflush(stdout);
     
     return RK_SUCCESS;
@@ -826,20 +861,10 @@ static RK_S32 process_received_message(MY_RECORDER_CTX_S *ctx, unsigned char msg
             break;
             
         case MSG_AUDIO_DATA:
-            // 检查音频是否被中断，如果是则清空缓冲区并忽略新数据
-            printf("is_audio_interrupted():%d \n",is_audio_interrupted());
+            // 被中断后的音频数据直接丢弃
             if (is_audio_interrupted()) {
-                // 清空音频缓冲区
-                ctx->audio_buffer_size = 0;
-                // 静默忽略被中断后的音频数据
                 break;
             }
-            printf("111111111111111111111111111111111111111111111 \n");
-            // === 添加调试日志 ===
-            struct timeval debug_tv;
-            gettimeofday(&debug_tv, NULL);
-            printf("🔊 [DEBUG-RECV] 接收音频数据: %u字节, 时间:%ld.%03ld, 当前缓冲:%zu字节\n", 
-                   data_len, debug_tv.tv_sec, debug_tv.tv_usec/1000, ctx->audio_buffer_size);
             
             // 记录第一个音频数据包接收时间
             if (g_timing_stats.audio_data_packets == 0) {
@@ -847,131 +872,79 @@ static RK_S32 process_received_message(MY_RECORDER_CTX_S *ctx, unsigned char msg
             }
             g_timing_stats.audio_data_packets++;
             g_timing_stats.total_audio_bytes += data_len;
-            
 
             // 检查是否是音频包尾标记
             if (data_len == 8 && memcmp(data, AUDIO_END_MARKER, 8) == 0) {
-                printf("🔊 [DEBUG-MARKER] 音频包结束标记, 当前缓冲区:%zu字节\n", ctx->audio_buffer_size);
-                
-                // 播放当前缓冲区的音频
-                if (ctx->audio_buffer_size > 0) {
-                    struct timeval play_start, play_end;
-                    gettimeofday(&play_start, NULL);
-                    
-                    snprintf(log_msg, sizeof(log_msg), "🎵 播放音频段: %zu 字节", ctx->audio_buffer_size);
-                    printf(log_msg);
-                    
-                    if (ctx->s32EnableStreaming && audio_started) {
-                        // === 查询播放前的设备状态 ===
-                        query_playback_status();
-                        
-                        // 播放音频数据
-                        if (play_audio_buffer(ctx, ctx->audio_buffer, ctx->audio_buffer_size) != RK_SUCCESS) {
-                            printf("⚠️ 音频播放失败");
-                        }
-                        
-                        gettimeofday(&play_end, NULL);
-                        long play_time = (play_end.tv_sec - play_start.tv_sec) * 1000 + 
-                                        (play_end.tv_usec - play_start.tv_usec) / 1000;
-                        printf("🎵 [DEBUG-PLAY] 播放耗时:%ldms, 数据量:%zu字节\n", 
-                               play_time, ctx->audio_buffer_size);
-                    }
-                    
-                    // 重置缓冲区
-                    ctx->audio_buffer_size = 0;
+                // 取出解码器中已完成的数据，再标记结束
+                if (g_stMp3Dec.bOpened) {
+                    mp3_decoder_drain(MP3_SEGMENT_DRAIN_MS, RK_FALSE);
                 }
-            } else {
-                if (g_timing_stats.timing_enabled) {
-                    snprintf(log_msg, sizeof(log_msg), "🔊 音频数据: %u 字节 [包#%d, 总计:%ld字节] [前4字节: %02X %02X %02X %02X]", 
-                             data_len, g_timing_stats.audio_data_packets, g_timing_stats.total_audio_bytes,
-                             data_len >= 4 ? ((unsigned char*)data)[0] : 0,
-                             data_len >= 4 ? ((unsigned char*)data)[1] : 0,
-                             data_len >= 4 ? ((unsigned char*)data)[2] : 0,
-                             data_len >= 4 ? ((unsigned char*)data)[3] : 0);
-                    printf(log_msg);
-                } else {
-                    // 简化输出，只显示关键信息
-                    if (g_timing_stats.audio_data_packets % 10 == 1) { // 每10个包显示一次
-                        printf("🔊 正在接收音频数据... (包#%d, 总计:%.1fKB)\n", 
-                               g_timing_stats.audio_data_packets, g_timing_stats.total_audio_bytes / 1024.0);
-                        fflush(stdout);
+                // 一段音频到此结束：播放线程不必再等低水位，剩余数据直接播放
+                audio_ring_mark_end(&g_stPlaybackRing);
+                // 下一段前的间隔是服务器生成TTS的时间，不计入网络抖动
+                audio_jitter_begin_segment(&g_stPlaybackJitter, g_stPlaybackJitter.bytes_per_ms);
+                printf("🔊 [DEBUG-MARKER] 音频段结束, 播放缓冲:%u字节\n", audio_ring_used(&g_stPlaybackRing));
+                break;
+            }
+
+            if (g_timing_stats.audio_data_packets % 10 == 1) { // 每10个包显示一次
+                printf("🔊 正在接收音频数据... (包#%d, 总计:%.1fKB, 播放缓冲:%u字节)\n", 
+                       g_timing_stats.audio_data_packets, g_timing_stats.total_audio_bytes / 1024.0,
+                       audio_ring_used(&g_stPlaybackRing));
+                fflush(stdout);
+            }
+
+            if (!ctx->s32EnableStreaming || !audio_started) {
+                break;
+            }
+
+            if (g_stMp3Dec.bEnabled) {
+                unsigned int decoded;
+
+                // 第一个MP3帧决定播放格式，之后才能打开播放设备和解码器
+                if (!g_stMp3Dec.bFormatKnown) {
+                    MP3_FRAME_INFO_S stInfo;
+                    int offset = audio_mp3_find_frame((const unsigned char *)data, data_len, &stInfo);
+
+                    if (offset < 0) {
+                        printf("⚠️ [DEBUG-MP3] 未找到MP3帧头，丢弃 %u 字节\n", data_len);
+                        break;
                     }
-                }
-                
-                // === 添加缓冲区管理调试 ===
-                printf("🔊 [DEBUG-BUFFER] 处理策略判断: 数据大小=%u, 缓冲区阈值=%zu\n", 
-                       data_len, sizeof(ctx->audio_buffer) / 2);
-                
-                // 处理大音频包 - 如果单个包就很大，直接播放
-                if (data_len > sizeof(ctx->audio_buffer) / 2) {
-                    // 大音频包直接播放，不缓冲
-                    struct timeval big_play_start, big_play_end;
-                    gettimeofday(&big_play_start, NULL);
-                    
-                    snprintf(log_msg, sizeof(log_msg), "🎵 直接播放大音频包: %u 字节", data_len);
-                    printf(log_msg);
-                    
-                    if (ctx->s32EnableStreaming && audio_started) {
-                        // === 查询播放前的设备状态 ===
-                        query_playback_status();
-                        
-                        if (play_audio_buffer(ctx, data, data_len) != RK_SUCCESS) {
-                            printf("⚠️ 大音频包播放失败");
-                        }
-                        
-                        gettimeofday(&big_play_end, NULL);
-                        long big_play_time = (big_play_end.tv_sec - big_play_start.tv_sec) * 1000 + 
-                                            (big_play_end.tv_usec - big_play_start.tv_usec) / 1000;
-                        printf("🎵 [DEBUG-BIGPLAY] 大包播放耗时:%ldms, 数据量:%u字节\n", 
-                               big_play_time, data_len);
+                    printf("🎵 [DEBUG-MP3] MPEG%s Layer%d %dkbps %dHz %dch\n",
+                           stInfo.version == 10 ? "1" : (stInfo.version == 20 ? "2" : "2.5"), stInfo.layer,
+                           stInfo.bitrate_kbps, stInfo.sample_rate, stInfo.channels);
+                    // 播放设备格式没有固定时直接按MP3的格式打开，否则解码后转换
+                    if (!g_bPlaybackFormatFixed) {
+                        ctx->s32PlaybackSampleRate = stInfo.sample_rate;
+                        ctx->s32PlaybackChannels = stInfo.channels;
                     }
-                } else {
-                    // 小音频包添加到缓冲区
-                    printf("🔊 [DEBUG-BUFFER] 小包缓冲: 当前=%zu + 新增=%u = %zu, 容量=%zu\n", 
-                           ctx->audio_buffer_size, data_len, ctx->audio_buffer_size + data_len, sizeof(ctx->audio_buffer));
-                    
-                    if (ctx->audio_buffer_size + data_len < sizeof(ctx->audio_buffer)) {
-                        memcpy(ctx->audio_buffer + ctx->audio_buffer_size, data, data_len);
-                        ctx->audio_buffer_size += data_len;
-                        printf("🔊 [DEBUG-BUFFER] 成功缓冲，新的缓冲区大小:%zu字节\n", ctx->audio_buffer_size);
-                    } else {
-                        // 缓冲区不足，先播放现有的，再添加新的
-                        struct timeval flush_start, flush_end;
-                        gettimeofday(&flush_start, NULL);
-                        
-                        if (ctx->audio_buffer_size > 0) {
-                            snprintf(log_msg, sizeof(log_msg), "🎵 缓冲区满，先播放: %zu 字节", ctx->audio_buffer_size);
-                            printf(log_msg);
-                            
-                            if (ctx->s32EnableStreaming && audio_started) {
-                                // === 查询播放前的设备状态 ===
-                                query_playback_status();
-                                
-                                if (play_audio_buffer(ctx, ctx->audio_buffer, ctx->audio_buffer_size) != RK_SUCCESS) {
-                                    printf("⚠️ 缓冲音频播放失败");
-                                }
-                                
-                                gettimeofday(&flush_end, NULL);
-                                long flush_time = (flush_end.tv_sec - flush_start.tv_sec) * 1000 + 
-                                                 (flush_end.tv_usec - flush_start.tv_usec) / 1000;
-                                printf("🎵 [DEBUG-FLUSH] 缓冲区刷新播放耗时:%ldms, 数据量:%zu字节\n", 
-                                       flush_time, ctx->audio_buffer_size);
-                            }
-                        }
-                        
-                        // 重置缓冲区并添加新数据
-                        ctx->audio_buffer_size = 0;
-                        if (data_len < sizeof(ctx->audio_buffer)) {
-                            memcpy(ctx->audio_buffer, data, data_len);
-                            ctx->audio_buffer_size = data_len;
-                            printf("🔊 [DEBUG-BUFFER] 缓冲区重置，新数据:%u字节\n", data_len);
-                        } else {
-                            printf("⚠️ [DEBUG-BUFFER] 单个音频包过大，无法缓冲: %u > %zu\n", 
-                                   data_len, sizeof(ctx->audio_buffer));
-                        }
+                    ctx->s32PlaybackBitWidth = 16;
+                    playback_convert_setup(ctx, stInfo.sample_rate, stInfo.channels);
+                    if (playback_start(ctx) != RK_SUCCESS ||
+                        mp3_decoder_open(stInfo.sample_rate, stInfo.channels) != RK_SUCCESS) {
+                        audio_started = 0;
+                        break;
                     }
+                    g_stMp3Dec.bFormatKnown = RK_TRUE;
+                    data = (const unsigned char *)data + offset;
+                    data_len -= offset;
                 }
+                decoded = mp3_decoder_feed(data, data_len);
+                if (decoded > 0) {
+                    audio_jitter_on_packet(&g_stPlaybackJitter, get_monotonic_ms(), decoded);
+                    playback_ring_update_prebuffer();
+                }
+                break;
+            }
+
+            // 服务器格式与播放设备不同时先转换，抖动统计也按播放设备格式的字节数
+            if (audio_convert_run(&g_stPlaybackConv, &data, &data_len) != RK_SUCCESS || data_len == 0) {
+                break;
             }
+            // 接收侧只追加到播放环，由播放线程按DAC节奏送给AO
+            audio_jitter_on_packet(&g_stPlaybackJitter, get_monotonic_ms(), data_len);
+            playback_ring_update_prebuffer();
+            playback_ring_append(data, data_len);
             break;
             
         case MSG_AI_START:
@@ -989,16 +962,30 @@ static RK_S32 process_received_message(MY_RECORDER_CTX_S *ctx, unsigned char msg
         case MSG_AUDIO_START:
             record_timestamp(&g_timing_stats.audio_start_time, "音频开始");
             printf("🔊 音频开始");
-            ctx->audio_buffer_size = 0;  // 重置音频缓冲区
+            // 丢弃上一段可能残留的数据
+            audio_ring_request_flush(&g_stPlaybackRing);
+            audio_ring_reset_stats(&g_stPlaybackRing);
             
             if (ctx->s32EnableStreaming) {
-                if (setup_audio_playback(ctx) == RK_SUCCESS) {
+                if (g_stMp3Dec.bEnabled) {
+                    // MP3：播放格式由第一个帧头决定，收到数据后再打开播放设备
+                    mp3_decoder_close();
+                    g_stMp3Dec.bFormatKnown = RK_FALSE;
                     audio_started = 1;
-                    set_audio_playing_state(RK_TRUE);  // 设置音频播放状态
-                    record_timestamp(&g_timing_stats.audio_setup_complete_time, "音频播放设备设置完成");
-                    printf("✅ 音频播放设备初始化成功");
+                    set_audio_playing_state(RK_TRUE);
                 } else {
-                    printf("❌ 音频播放设备初始化失败");
+                    // PCM：服务器声明了本次的格式时按需转换为播放设备格式，旧服务器（16kHz单声道）不声明
+                    if (data_len >= AUDIO_FORMAT_INFO_SIZE) {
+                        const unsigned char *p = (const unsigned char *)data;
+
+                        playback_convert_setup(ctx, (RK_S32)(((RK_U32)p[0] << 24) | ((RK_U32)p[1] << 16) |
+                                                             ((RK_U32)p[2] << 8) | (RK_U32)p[3]), p[4]);
+                    } else {
+                        playback_convert_setup(ctx, 0, 0);
+                    }
+                    if (playback_start(ctx) == RK_SUCCESS) {
+                        audio_started = 1;
+                    }
                 }
             }
             break;
@@ -1006,26 +993,19 @@ static RK_S32 process_received_message(MY_RECORDER_CTX_S *ctx, unsigned char msg
         case MSG_AUDIO_END:
             printf("🔊 音频结束");
 
-            // 播放剩余的音频数据
-            if (ctx->audio_buffer_size > 0) {
-                snprintf(log_msg, sizeof(log_msg), "🎵 播放最后音频段: %zu 字节", ctx->audio_buffer_size);
-                printf(log_msg);
-                
-                if (ctx->s32EnableStreaming && audio_started) {
-                    // 播放最后的音频段
-                    if (play_audio_buffer(ctx, ctx->audio_buffer, ctx->audio_buffer_size) != RK_SUCCESS) {
-                        printf("⚠️ 音频播放失败");
-                    }
-                }
-                
-                ctx->audio_buffer_size = 0;
+            if (g_stMp3Dec.bOpened) {
+                mp3_decoder_drain(MP3_END_DRAIN_MS, RK_TRUE);
+                mp3_decoder_close();
             }
-            
-            // 清理音频播放设备
             if (audio_started) {
-                cleanup_audio_playback();
-                set_audio_playing_state(RK_FALSE);  // 清除音频播放状态
-                printf("🎵 音频播放设备已关闭");
+                // 等待播放线程把剩余数据送完，再关闭播放设备
+                audio_ring_mark_end(&g_stPlaybackRing);
+                playback_ring_drain();
+                // 按本次欠载情况调整下一次响应的预缓冲时长
+                audio_jitter_end_response(&g_stPlaybackJitter, atomic_load(&g_stPlaybackRing.underruns));
+                playback_ring_update_prebuffer();
+                playback_ring_report();
+                ao_manager_release();
                 audio_started = 0;
             }
             
@@ -1038,14 +1018,12 @@ static RK_S32 process_received_message(MY_RECORDER_CTX_S *ctx, unsigned char msg
             }
             
             // 清理可能已经初始化的音频播放设备
+            mp3_decoder_close();
             if (audio_started) {
-                printf("🔧 清理因错误中断的音频播放设备");
-                cleanup_audio_playback();
-                set_audio_playing_state(RK_FALSE);  // 清除音频播放状态
+                printf("🔧 清理因错误中断的音频播放");
+                audio_ring_request_flush(&g_stPlaybackRing);
+                ao_manager_release();
                 audio_started = 0;
-                
-                // 重置音频缓冲区
-                ctx->audio_buffer_size = 0;
             }
             break;
             
@@ -1054,14 +1032,12 @@ static RK_S32 process_received_message(MY_RECORDER_CTX_S *ctx, unsigned char msg
             gAIResponseActive = RK_FALSE; // AI响应被取消
             
             // 清理可能已经初始化的音频播放设备
+            mp3_decoder_close();
             if (audio_started) {
-                printf("🔧 清理因取消中断的音频播放设备");
-                cleanup_audio_playback();
-                set_audio_playing_state(RK_FALSE);  // 清除音频播放状态
+                printf("🔧 清理因取消中断的音频播放");
+                audio_ring_request_flush(&g_stPlaybackRing);
+                ao_manager_release();
                 audio_started = 0;
-                
-                // 重置音频缓冲区
-                ctx->audio_buffer_size = 0;
             }
             break;
             
@@ -1085,9 +1061,31 @@ static RK_S32 process_received_message(MY_RECORDER_CTX_S *ctx, unsigned char msg
 }
 
 // 接收Socket服务器响应
+// 从响应队列取一帧：按短间隔等待，以便及时响应抢话中断和断线
+static SOCKET_MSG_S *pop_response_message(int timeout_ms) {
+    int waited = 0;
+
+    while (!gRecorderExit && waited < timeout_ms) {
+        SOCKET_MSG_S *msg = socket_queue_pop(&g_stRespQueue, SOCKET_RESPONSE_POLL_MS);
+        if (msg) {
+            return msg;
+        }
+        if (gInterruptAIResponse || !socket_io_is_connected(&g_stIoLoop)) {
+            return NULL;
+        }
+        waited += SOCKET_RESPONSE_POLL_MS;
+    }
+    if (waited >= timeout_ms) {
+        printf("WARNING: [DEBUG-TIMEOUT] 等待服务器响应超时 (%dms)\n", timeout_ms);
+        fflush(stdout);
+    }
+    return NULL;
+}
+
 static RK_S32 receive_socket_response(MY_RECORDER_CTX_S *ctx) {
+    SOCKET_MSG_S *msg;
     unsigned char msg_type;
-    char buffer[SOCKET_RESPONSE_BUFFER_SIZE];
+    const char *buffer;
     unsigned int data_len;
     int message_count = 0;
     int ai_end_received = 0;
@@ -1113,9 +1111,13 @@ static RK_S32 receive_socket_response(MY_RECORDER_CTX_S *ctx) {
             printf("INFO: AI响应被用户抢话中断，立即进入录音\n");
             break;
         }
-        RK_S32 receive_result = socket_receive_message(ctx->sockfd, &msg_type, buffer, &data_len, sizeof(buffer));
+        msg = pop_response_message(SOCKET_RESPONSE_TIMEOUT_MS);
+        if (!msg && gInterruptAIResponse) {
+            printf("INFO: AI响应被用户抢话中断，立即进入录音\n");
+            break;
+        }
         
-        if (receive_result != RK_SUCCESS) {
+        if (!msg) {
             if (message_count > 0) {
                 printf("INFO: Connection closed after receiving messages");
                 break; // 正常结束，已经收到一些消息
@@ -1125,6 +1127,9 @@ static RK_S32 receive_socket_response(MY_RECORDER_CTX_S *ctx) {
             }
         }
         
+        msg_type = msg->msg_type;
+        buffer = (const char *)msg->data;
+        data_len = msg->data_len;
         message_count++;
         snprintf(log_msg, sizeof(log_msg), "[bayes123]->INFO: Processing message #%d (type=0x%02X)", message_count, msg_type);
         printf(log_msg);
@@ -1133,6 +1138,7 @@ static RK_S32 receive_socket_response(MY_RECORDER_CTX_S *ctx) {
 
         // 处理接收到的消息
         process_received_message(ctx, msg_type, buffer, data_len);
+        socket_msg_free(msg);
          snprintf(log_msg, sizeof(log_msg), "[bayes443]->INFO: Processing message #%d (type=0x%02X)", message_count, msg_type);
         // 跟踪进展性消息
         if (msg_type == MSG_AUDIO_DATA || msg_type == MSG_TEXT_DATA || 
@@ -1260,28 +1266,27 @@ static RK_S32 upload_audio_to_socket_server(MY_RECORDER_CTX_S *ctx) {
     
     // 连接服务器
     //printf("INFO: Starting connection to socket server");
-    //ctx->sockfd = connect_to_socket_server(ctx->serverHost, ctx->serverPort);
-    if (ctx->sockfd < 0) {
+    if (!socket_io_is_connected(&g_stIoLoop)) {
         printf("ERROR: Failed to connect to socket server");
         return RK_FAILURE;
     }
     //printf("INFO: Successfully connected to socket server");
 
-    sendingvoice = RK_TRUE;
+    // 丢弃上一轮残留的响应帧（例如被抢话中断后未读完的音频）
+    socket_queue_clear(&g_stRespQueue);
+
     // 发送配置消息
     //printf("INFO: Sending configuration message");
-    if (send_config_message(ctx->sockfd, ctx->responseFormat) != RK_SUCCESS) {
+    if (send_config_message(ctx) != RK_SUCCESS) {
         printf("ERROR: Failed to send configuration message");
-        close(ctx->sockfd);
         return RK_FAILURE;
     }
     //printf("INFO: Configuration message sent successfully");
     
     //发送图片消息
-    if(send_images_message(ctx->sockfd) != RK_SUCCESS)
+    if(send_images_message() != RK_SUCCESS)
     {
         printf("ERROR: Failed to send images message");
-        close(ctx->sockfd);
         return RK_FAILURE;
     }
 
@@ -1289,18 +1294,12 @@ static RK_S32 upload_audio_to_socket_server(MY_RECORDER_CTX_S *ctx) {
     //printf("INFO: Starting voice file transmission");
     if (send_voice_file_to_socket_server(ctx) != RK_SUCCESS) {
         printf("ERROR: Failed to send voice file");
-        close(ctx->sockfd);
         return RK_FAILURE;
     }
     //printf("INFO: Voice file sent successfully");
-    sendingvoice = RK_FALSE;
     // 接收响应
     //printf("INFO: Starting to receive server response");
     RK_S32 result = receive_socket_response(ctx);
-    grecvservRespon = RK_FALSE;
-    // 关闭连接
-    printf("INFO:[bayes2123]:grecvservRespon%d \n",grecvservRespon);
-    //close(ctx->sockfd);
     
     if (result == RK_SUCCESS) {
         printf("INFO: Socket processing completed successfully");
@@ -1311,6 +1310,87 @@ static RK_S32 upload_audio_to_socket_server(MY_RECORDER_CTX_S *ctx) {
     return result;
 }
 
+// ==================== 边录边传 ====================
+// 按下时发送VOICE_START，录音线程每取到一帧就作为VOICE_DATA放入发送队列，
+// 松开时只剩VOICE_END；整个过程不写文件，上传时间与说话时间重叠。
+
+// 图像采集耗时较长（v4l2-ctl跳帧），放到独立线程中与录音并行，不阻塞取帧
+static void* live_image_thread(void *ptr) {
+    send_images_message();
+    return NULL;
+}
+
+static RK_S32 live_upload_begin(MY_RECORDER_CTX_S *ctx) {
+    pthread_t imageThread;
+
+    gInterruptAIResponse = RK_FALSE; // 重置中断标志，开始新的AI响应
+    if (ctx->s32EnableTiming) {
+        init_timing_stats();
+    } else {
+        memset(&g_timing_stats, 0, sizeof(TIMING_STATS_S));
+    }
+
+    if (!socket_io_is_connected(&g_stIoLoop)) {
+        printf("ERROR: [LIVE] 未连接到服务器，本次录音无法上传\n");
+        fflush(stdout);
+        return RK_FAILURE;
+    }
+
+    socket_queue_clear(&g_stRespQueue);
+
+    if (send_config_message(ctx) != RK_SUCCESS) {
+        return RK_FAILURE;
+    }
+    record_timestamp(&g_timing_stats.voice_start_time, "语音开始发送");
+    audio_encoder_reset(&g_stVoiceEncoder);
+    if (send_voice_start() != RK_SUCCESS) {
+        return RK_FAILURE;
+    }
+
+    if (pthread_create(&imageThread, NULL, live_image_thread, NULL) == 0) {
+        pthread_detach(imageThread);
+    } else {
+        printf("WARNING: [LIVE] 创建图像采集线程失败，本轮不发送图片\n");
+    }
+
+    printf("INFO: [LIVE] 实时上传已开始\n");
+    fflush(stdout);
+    return RK_SUCCESS;
+}
+
+// 在录音线程中调用，只做一次拷贝入队，不打印日志
+static RK_S32 live_upload_frame(const void *data, unsigned int len) {
+    if (g_timing_stats.voice_data_packets == 0) {
+        record_timestamp(&g_timing_stats.voice_data_first_time, "第一个语音数据包发送");
+    }
+    if (send_voice_chunk(data, len, RK_TRUE) != RK_SUCCESS) {
+        printf("ERROR: [LIVE] 语音数据发送失败\n");
+        fflush(stdout);
+        return RK_FAILURE;
+    }
+    g_timing_stats.voice_data_packets++;
+    g_timing_stats.total_voice_bytes += len;
+    if (g_timing_stats.timing_enabled) {
+        gettimeofday(&g_timing_stats.voice_data_last_time, NULL);
+    }
+    return RK_SUCCESS;
+}
+
+static RK_S32 live_upload_end(void) {
+    // 服务器只在VOICE_END之后才开始响应，此时队列中只可能是上一轮的残留帧
+    socket_queue_clear(&g_stRespQueue);
+
+    if (send_voice_flush() != RK_SUCCESS || socket_send_message(MSG_VOICE_END, NULL, 0) != RK_SUCCESS) {
+        return RK_FAILURE;
+    }
+    record_timestamp(&g_timing_stats.voice_end_time, "语音发送结束");
+
+    printf("INFO: [LIVE] 实时上传完成: %ld bytes, %d 包, 队列满丢弃 %d 帧\n",
+           g_timing_stats.total_voice_bytes, g_timing_stats.voice_data_packets, g_timing_stats.voice_data_dropped);
+    fflush(stdout);
+    return RK_SUCCESS;
+}
+
 // 播放设备管理结构体
 typedef struct _PlaybackCtx {
     AUDIO_DEV aoDevId;
@@ -1319,9 +1399,12 @@ typedef struct _PlaybackCtx {
     RK_S32 s32SampleRate;
     RK_S32 s32Channels;
     RK_S32 s32BitWidth;
+    MB_POOL mbPool;             // 预分配的AO帧内存池
+    RK_U32 u32PoolGets;         // 从内存池取块次数
+    RK_U32 u32PoolEmpty;        // 内存池暂时无空闲块（AO队列已满）的次数
 } PLAYBACK_CTX_S;
 
-static PLAYBACK_CTX_S g_stPlaybackCtx = {0, 0, RK_FALSE, 0, 0, 0};
+static PLAYBACK_CTX_S g_stPlaybackCtx = {0, 0, RK_FALSE, 0, 0, 0, MB_INVALID_POOLID, 0, 0};
 
 // 音频播放器设置 - 基于test_mpi_ao.c的设备初始化逻辑
 static RK_S32 setup_audio_playback(MY_RECORDER_CTX_S *ctx) {
@@ -1482,6 +1565,23 @@ static RK_S32 setup_audio_playback(MY_RECORDER_CTX_S *ctx) {
     RK_MPI_AO_SetVolume(aoDevId, 100);
     printf("🔧 [DEBUG-VOLUME] 音量设置为100\n");
     
+    // 预分配AO帧内存池：块大小等于一次送帧的数据量，送帧时不再创建内存块
+    if (g_stPlaybackCtx.mbPool == MB_INVALID_POOLID) {
+        MB_POOL_CONFIG_S stPoolCfg;
+        memset(&stPoolCfg, 0, sizeof(stPoolCfg));
+        stPoolCfg.u64MBSize = PLAYBACK_CHUNK_BYTES;
+        stPoolCfg.u32MBCnt = PLAYBACK_POOL_BLOCKS;
+        stPoolCfg.enRemapMode = MB_REMAP_MODE_CACHED;
+        stPoolCfg.enAllocType = MB_ALLOC_TYPE_DMA;
+        stPoolCfg.bPreAlloc = RK_TRUE;
+        g_stPlaybackCtx.mbPool = RK_MPI_MB_CreatePool(&stPoolCfg);
+        if (g_stPlaybackCtx.mbPool == MB_INVALID_POOLID) {
+            printf("⚠️ [DEBUG-MBPOOL] 创建AO帧内存池失败，退回逐块创建内存块\n");
+        } else {
+            printf("🔧 [DEBUG-MBPOOL] AO帧内存池: %d块 x %d字节\n", PLAYBACK_POOL_BLOCKS, PLAYBACK_CHUNK_BYTES);
+        }
+    }
+    
     // 记录播放上下文
     g_stPlaybackCtx.aoDevId = aoDevId;
     g_stPlaybackCtx.aoChn = aoChn;
@@ -1503,203 +1603,410 @@ static RK_S32 setup_audio_playback(MY_RECORDER_CTX_S *ctx) {
     return RK_SUCCESS;
 }
 
-// 播放音频缓冲区数据 - 基于test_mpi_ao.c的sendDataThread逻辑
-static RK_S32 play_audio_buffer(MY_RECORDER_CTX_S *ctx, const void *audio_data, size_t data_len) {
-    if (!ctx || !audio_data || data_len == 0) {
-        return RK_SUCCESS; // 无数据则直接返回成功
+// ==================== 播放线程 ====================
+// 网络接收与DAC节奏解耦：响应线程只调用playback_ring_append追加数据，
+// 播放线程从播放环中取数据送给AO，AO队列满时只阻塞播放线程。
+
+// 响应开始播放：取得播放设备并按当前格式设置播放环水位
+static RK_S32 playback_start(MY_RECORDER_CTX_S *ctx) {
+    if (ao_manager_acquire(ctx) != RK_SUCCESS) {
+        printf("❌ 音频播放设备初始化失败");
+        return RK_FAILURE;
     }
-    
-    // === 添加播放开始调试日志 ===
-    struct timeval play_start_tv;
-    gettimeofday(&play_start_tv, NULL);
-    //printf("🎵 [DEBUG-PLAYSTART] 开始播放: %zu字节, 时间:%ld.%03ld\n", 
-     //      data_len, play_start_tv.tv_sec, play_start_tv.tv_usec/1000);
-    
-    // 检查音频播放状态，如果已被中断则静默忽略
-    if (!get_audio_playing_state()) {
-        // 音频播放已被中断，静默忽略后续音频数据
-        printf("🎵 [DEBUG-PLAYSKIP] 播放已被中断，跳过 %zu 字节\n", data_len);
-        return RK_SUCCESS;
+    playback_ring_configure();
+    set_audio_playing_state(RK_TRUE);  // 设置音频播放状态
+    record_timestamp(&g_timing_stats.audio_setup_complete_time, "音频播放设备设置完成");
+    printf("✅ 音频播放设备初始化成功");
+    return RK_SUCCESS;
+}
+
+// 本次响应的音频格式与播放设备格式不同时准备转换；格式未知（s32SampleRate为0）或相同时不转换
+static void playback_convert_setup(MY_RECORDER_CTX_S *ctx, RK_S32 s32SampleRate, RK_S32 s32Channels) {
+    AUDIO_RESAMPLE_S *rs = &g_stPlaybackConv.stResample;
+
+    if (s32SampleRate <= 0 || s32Channels <= 0 || ctx->s32PlaybackBitWidth != 16 ||
+        (s32SampleRate == ctx->s32PlaybackSampleRate && s32Channels == ctx->s32PlaybackChannels)) {
+        if (g_stPlaybackConv.bEnabled) {
+            audio_resample_deinit(rs);
+            g_stPlaybackConv.bEnabled = RK_FALSE;
+        }
+        return;
     }
-    
-    if (!g_stPlaybackCtx.bInitialized) {
-        printf("❌ [DEBUG-PLAYERR] 播放设备未初始化\n");
+    // 格式不变时只清空上一段的滤波器历史
+    if (g_stPlaybackConv.bEnabled && rs->in_rate == s32SampleRate && rs->in_channels == s32Channels &&
+        rs->out_rate == ctx->s32PlaybackSampleRate && rs->out_channels == ctx->s32PlaybackChannels) {
+        audio_resample_reset(rs);
+        return;
+    }
+    if (g_stPlaybackConv.bEnabled) {
+        audio_resample_deinit(rs);
+        g_stPlaybackConv.bEnabled = RK_FALSE;
+    }
+    if (audio_resample_init(rs, s32SampleRate, s32Channels, ctx->s32PlaybackSampleRate, ctx->s32PlaybackChannels) != 0) {
+        printf("⚠️ [DEBUG-RESAMPLE] 不支持 %dHz/%dch -> %dHz/%dch 的转换，按原始数据播放\n",
+               s32SampleRate, s32Channels, ctx->s32PlaybackSampleRate, ctx->s32PlaybackChannels);
+        return;
+    }
+    g_stPlaybackConv.bEnabled = RK_TRUE;
+    printf("🎵 [DEBUG-RESAMPLE] 下行 %dHz/%dch -> 播放设备 %dHz/%dch (%d相 x %d抽头)\n",
+           s32SampleRate, s32Channels, ctx->s32PlaybackSampleRate, ctx->s32PlaybackChannels, rs->up, rs->taps);
+}
+
+// 按当前播放格式设置水位：低水位为自适应预缓冲时长，高水位留出一块的余量
+static void playback_ring_configure(void) {
+    unsigned int bytes_per_ms = g_stPlaybackCtx.s32SampleRate * g_stPlaybackCtx.s32Channels *
+                                (g_stPlaybackCtx.s32BitWidth / 8) / 1000;
+
+    audio_jitter_begin_segment(&g_stPlaybackJitter, bytes_per_ms);
+    g_s32PrebufferMs = audio_jitter_target_ms(&g_stPlaybackJitter);
+    audio_ring_set_watermarks(&g_stPlaybackRing, bytes_per_ms * g_s32PrebufferMs,
+                              PLAYBACK_RING_SIZE - PLAYBACK_CHUNK_BYTES);
+    printf("🎵 [DEBUG-JITTER] 预缓冲 %dms (抖动估计 %.1fms, 欠载修正 %dms)\n",
+           g_s32PrebufferMs, g_stPlaybackJitter.jitter_ms, g_stPlaybackJitter.bias_ms);
+}
+
+// 抖动估计变化后更新低水位（只对之后的开始/欠载恢复生效，正在播放的数据不受影响）
+static void playback_ring_update_prebuffer(void) {
+    int target = audio_jitter_target_ms(&g_stPlaybackJitter);
+
+    if (target == g_s32PrebufferMs) {
+        return;
+    }
+    printf("🎵 [DEBUG-JITTER] 预缓冲 %dms -> %dms (抖动估计 %.1fms, 欠载修正 %dms)\n",
+           g_s32PrebufferMs, target, g_stPlaybackJitter.jitter_ms, g_stPlaybackJitter.bias_ms);
+    g_s32PrebufferMs = target;
+    audio_ring_set_watermarks(&g_stPlaybackRing, g_stPlaybackJitter.bytes_per_ms * target,
+                              PLAYBACK_RING_SIZE - PLAYBACK_CHUNK_BYTES);
+}
+
+// 追加音频数据；缓冲量超过高水位时等待播放线程消费（背压只作用于响应线程，I/O线程不受影响）
+static void playback_ring_append(const void *data, unsigned int len) {
+    const unsigned char *p = (const unsigned char *)data;
+    int stalled_us = 0;
+    int waited_us = 0;
+
+    while (len > 0) {
+        if (gRecorderExit || gInterruptAIResponse || is_audio_interrupted()) {
+            return;
+        }
+        if (!audio_ring_above_high(&g_stPlaybackRing)) {
+            unsigned int n = audio_ring_write(&g_stPlaybackRing, p, len);
+            p += n;
+            len -= n;
+            if (n > 0) {
+                stalled_us = 0;
+            }
+            if (len == 0) {
+                break;
+            }
+        }
+        if (stalled_us >= PLAYBACK_STALL_TIMEOUT_MS * 1000) {
+            printf("⚠️ [DEBUG-RINGSTALL] 播放线程长时间未消费，丢弃 %u 字节\n", len);
+            fflush(stdout);
+            return;
+        }
+        usleep(PLAYBACK_POLL_US);
+        stalled_us += PLAYBACK_POLL_US;
+        waited_us += PLAYBACK_POLL_US;
+    }
+    if (waited_us >= 100 * 1000) {
+        printf("🎵 [DEBUG-BACKPRESSURE] 播放缓冲已满，等待 %dms\n", waited_us / 1000);
+    }
+}
+
+// 等待结束标记之前的数据全部送入AO（被中断或退出时提前返回）
+static void playback_ring_drain(void) {
+    while (!audio_ring_end_reached(&g_stPlaybackRing)) {
+        if (gRecorderExit || gInterruptAIResponse || is_audio_interrupted() || !g_playbackThreadRunning) {
+            return;
+        }
+        usleep(PLAYBACK_POLL_US);
+    }
+}
+
+static void playback_ring_report(void) {
+    printf("📊 [DEBUG-RING] 播放环统计: 欠载=%lu, 写满等待=%lu, 清空=%lu(%lu字节), 最大缓冲=%u字节\n",
+           atomic_load(&g_stPlaybackRing.underruns), atomic_load(&g_stPlaybackRing.overruns),
+           atomic_load(&g_stPlaybackRing.flushes), atomic_load(&g_stPlaybackRing.flushed_bytes),
+           atomic_load(&g_stPlaybackRing.max_used));
+    printf("📊 [DEBUG-JITTER] 预缓冲=%dms, 抖动估计=%.1fms, 最大晚到=%.1fms, 欠载响应=%u/%u\n",
+           g_s32PrebufferMs, g_stPlaybackJitter.jitter_ms, g_stPlaybackJitter.max_late_ms,
+           g_stPlaybackJitter.underrun_responses, g_stPlaybackJitter.responses);
+    fflush(stdout);
+}
+
+// ==================== 下行MP3解码 ====================
+// 服务器以audio_format=mp3直接转发TTS输出（数据量约为PCM的1/8），由rockit ADEC流式解码，
+// 解码结果和PCM下行一样追加到播放环。所有调用都在响应线程中。
+
+static RK_S32 mp3_decoder_open(RK_S32 s32SampleRate, RK_S32 s32Channels) {
+    ADEC_CHN_ATTR_S stAdecAttr;
+    RK_S32 result;
+
+    mp3_decoder_close();
+
+    memset(&stAdecAttr, 0, sizeof(stAdecAttr));
+    stAdecAttr.enType = RK_AUDIO_ID_MP3;
+    stAdecAttr.enMode = ADEC_MODE_STREAM;
+    stAdecAttr.u32BufCount = MP3_ADEC_BUF_COUNT;
+    stAdecAttr.u32BufSize = MP3_ADEC_BUF_SIZE;
+    stAdecAttr.stCodecAttr.enType = RK_AUDIO_ID_MP3;
+    stAdecAttr.stCodecAttr.u32Channels = s32Channels;
+    stAdecAttr.stCodecAttr.u32SampleRate = s32SampleRate;
+
+    result = RK_MPI_ADEC_CreateChn(MP3_ADEC_CHN, &stAdecAttr);
+    if (result != RK_SUCCESS) {
+        printf("❌ [DEBUG-MP3] 创建MP3解码通道失败: 0x%x\n", result);
+        return RK_FAILURE;
+    }
+    g_stMp3Dec.bOpened = RK_TRUE;
+    g_stMp3Dec.u32Seq = 0;
+    g_stMp3Dec.ulInBytes = 0;
+    g_stMp3Dec.ulOutBytes = 0;
+    return RK_SUCCESS;
+}
+
+static void mp3_decoder_close(void) {
+    if (!g_stMp3Dec.bOpened) {
+        return;
+    }
+    RK_MPI_ADEC_DestroyChn(MP3_ADEC_CHN);
+    g_stMp3Dec.bOpened = RK_FALSE;
+    if (g_stMp3Dec.ulInBytes > 0) {
+        printf("📊 [DEBUG-MP3] 下行MP3 %lu 字节 -> PCM %lu 字节 (%.1f:1)\n", g_stMp3Dec.ulInBytes,
+               g_stMp3Dec.ulOutBytes, (double)g_stMp3Dec.ulOutBytes / g_stMp3Dec.ulInBytes);
         fflush(stdout);
+    }
+}
+
+// 启动时确认ADEC支持MP3，不支持则使用PCM下行
+static RK_S32 mp3_decoder_probe(void) {
+    if (mp3_decoder_open(16000, 1) != RK_SUCCESS) {
         return RK_FAILURE;
     }
-    
-    // === 查询播放前设备状态 ===
-    AO_CHN_STATE_S pstStatBefore;
-    memset(&pstStatBefore, 0, sizeof(AO_CHN_STATE_S));
-    RK_S32 ret = RK_MPI_AO_QueryChnStat(g_stPlaybackCtx.aoDevId, g_stPlaybackCtx.aoChn, &pstStatBefore);
-    if (ret == RK_SUCCESS) {
-        printf("📊 [DEBUG-DEVBEFORE] 播放前状态: 总计=%d, 空闲=%d, 忙碌=%d\n", 
-               pstStatBefore.u32ChnTotalNum, pstStatBefore.u32ChnFreeNum, pstStatBefore.u32ChnBusyNum);
-        
-        // 如果空闲缓冲区少于2个，发出警告
-        if (pstStatBefore.u32ChnFreeNum < 2) {
-            //printf("⚠️ [DEBUG-LOWBUF] 播放缓冲区即将耗尽！空闲=%d\n", pstStatBefore.u32ChnFreeNum);
+    mp3_decoder_close();
+    return RK_SUCCESS;
+}
+
+// 取出解码器已输出的PCM追加到播放环，返回字节数；
+// bEndOfStream时先通知解码器输入结束，一直取到最后一帧或超时
+static unsigned int mp3_decoder_drain(RK_S32 s32TimeoutMs, RK_BOOL bEndOfStream) {
+    AUDIO_FRAME_INFO_S stFrameInfo;
+    unsigned int total = 0;
+    RK_S32 s32WaitMs = s32TimeoutMs;
+
+    if (!g_stMp3Dec.bOpened) {
+        return 0;
+    }
+    if (bEndOfStream) {
+        RK_MPI_ADEC_SendEndOfStream(MP3_ADEC_CHN, RK_FALSE);
+    }
+
+    while (1) {
+        AUDIO_FRAME_S *pstFrame;
+        RK_BOOL bEof;
+
+        memset(&stFrameInfo, 0, sizeof(stFrameInfo));
+        if (RK_MPI_ADEC_GetFrame(MP3_ADEC_CHN, &stFrameInfo, s32WaitMs) != RK_SUCCESS) {
+            break;
+        }
+        pstFrame = stFrameInfo.pstFrame;
+        bEof = stFrameInfo.bEof;
+        if (pstFrame && pstFrame->pMbBlk && pstFrame->u32Len > 0) {
+            const void *pcm = RK_MPI_MB_Handle2VirAddr(pstFrame->pMbBlk);
+            unsigned int pcm_len = pstFrame->u32Len;
+            RK_S32 s32Expect = g_stPlaybackConv.bEnabled ? g_stPlaybackConv.stResample.in_rate
+                                                         : g_stPlaybackCtx.s32SampleRate;
+
+            if (pstFrame->s32SampleRate > 0 && pstFrame->s32SampleRate != s32Expect) {
+                printf("⚠️ [DEBUG-MP3] 解码采样率 %dHz 与预期 %dHz 不一致\n", pstFrame->s32SampleRate, s32Expect);
+            }
+            if (audio_convert_run(&g_stPlaybackConv, &pcm, &pcm_len) == RK_SUCCESS) {
+                playback_ring_append(pcm, pcm_len);
+                total += pcm_len;
+            }
+        }
+        RK_MPI_ADEC_ReleaseFrame(MP3_ADEC_CHN, &stFrameInfo);
+        if (bEof) {
+            break;
+        }
+        // 已有输出之后只取当前立即可用的帧
+        if (!bEndOfStream) {
+            s32WaitMs = 0;
         }
     }
-    
-    // 记录第一次音频播放时间
-    if (!g_timing_stats.first_audio_played) {
-        record_timestamp(&g_timing_stats.first_audio_play_time, "第一次音频播放开始");
-        g_timing_stats.first_audio_played = 1;
+    g_stMp3Dec.ulOutBytes += total;
+    return total;
+}
+
+// 送入一段MP3数据（可以在任意字节处截断），返回本次得到的PCM字节数
+static unsigned int mp3_decoder_feed(const void *data, unsigned int len) {
+    AUDIO_STREAM_S stStream;
+    MB_EXT_CONFIG_S extConfig;
+
+    if (!g_stMp3Dec.bOpened || len == 0) {
+        return 0;
     }
-    
-    // 参考test_mpi_ao.c的sendDataThread逻辑
+
+    memset(&extConfig, 0, sizeof(extConfig));
+    extConfig.pOpaque = (void *)data;
+    extConfig.pu8VirAddr = (RK_U8 *)data;
+    extConfig.u64Size = len;
+
+    memset(&stStream, 0, sizeof(stStream));
+    stStream.u32Len = len;
+    stStream.u32Seq = g_stMp3Dec.u32Seq++;
+    stStream.u64TimeStamp = 0;
+    stStream.bBypassMbBlk = RK_FALSE;
+    if (RK_MPI_SYS_CreateMB(&(stStream.pMbBlk), &extConfig) != RK_SUCCESS) {
+        return 0;
+    }
+    if (RK_MPI_ADEC_SendStream(MP3_ADEC_CHN, &stStream, RK_TRUE) != RK_SUCCESS) {
+        printf("⚠️ [DEBUG-MP3] 送入MP3数据失败，丢弃 %u 字节\n", len);
+    } else {
+        g_stMp3Dec.ulInBytes += len;
+    }
+    RK_MPI_MB_ReleaseMB(stStream.pMbBlk);
+
+    return mp3_decoder_drain(0, RK_FALSE);
+}
+
+// 送一块数据给AO；队列满时最多等待PLAYBACK_SEND_TIMEOUT_MS，以便及时响应中断。
+// 内存池无空闲块时返回RK_ERR_AO_BUSY（AO仍在播放已送入的块），调用者稍后重试
+static RK_S32 playback_send_chunk(const unsigned char *data, unsigned int len) {
+    static RK_U64 timeStamp = 0;
     AUDIO_FRAME_S stFrame;
     RK_S32 result = RK_SUCCESS;
-    RK_S32 s32MilliSec = -1; // 阻塞模式，确保数据发送成功
-    static RK_U64 timeStamp = 0;
-    
-    // === 添加分块处理调试 ===
-    if (data_len > 4096) {
-        //printf("🎵 [DEBUG-CHUNK] 大数据需要分块: %zu字节 -> 4096字节/块\n", data_len);
-        
-        const unsigned char *data_ptr = (const unsigned char *)audio_data;
-        size_t remaining = data_len;
-        RK_S32 overall_result = RK_SUCCESS;
-        int chunk_count = 0;
-        
-        while (remaining > 0) {
-            size_t chunk_size = (remaining > 4096) ? 4096 : remaining;
-            chunk_count++;
-            
-            struct timeval chunk_start, chunk_end;
-            gettimeofday(&chunk_start, NULL);
-            
-            //printf("🎵 [DEBUG-CHUNK] 播放分块 %d: %zu字节\n", chunk_count, chunk_size);
-            RK_S32 chunk_result = play_audio_buffer(ctx, data_ptr, chunk_size);
-            
-            gettimeofday(&chunk_end, NULL);
-            long chunk_time = (chunk_end.tv_sec - chunk_start.tv_sec) * 1000 + 
-                             (chunk_end.tv_usec - chunk_start.tv_usec) / 1000;
-            //printf("🎵 [DEBUG-CHUNK] 分块 %d 完成: %ldms\n", chunk_count, chunk_time);
-            
-            if (chunk_result != RK_SUCCESS) {
-                overall_result = chunk_result;
-            }
-            data_ptr += chunk_size;
-            remaining -= chunk_size;
-        }
-        
-        struct timeval play_end_tv;
-        gettimeofday(&play_end_tv, NULL);
-        long total_time = (play_end_tv.tv_sec - play_start_tv.tv_sec) * 1000 + 
-                         (play_end_tv.tv_usec - play_start_tv.tv_usec) / 1000;
-    //    printf("🎵 [DEBUG-CHUNKDONE] 分块播放完成: %d块, 总耗时:%ldms\n", chunk_count, total_time);
-        
-        return overall_result;
+
+    pthread_mutex_lock(&g_playbackDevMutex);
+    if (!g_stPlaybackCtx.bInitialized) {
+        pthread_mutex_unlock(&g_playbackDevMutex);
+        return RK_FAILURE;
     }
-    
-    // === 设置音频帧信息调试 ===
-    //printf("🎵 [DEBUG-FRAME] 设置音频帧: 长度=%zu, 采样率=%d, 声道=%d, 位宽=%d\n", 
-     //      data_len, g_stPlaybackCtx.s32SampleRate, g_stPlaybackCtx.s32Channels, g_stPlaybackCtx.s32BitWidth);
-    
-    // 设置音频帧信息 - 参考test_mpi_ao.c
-    stFrame.u32Len = data_len;
+    // 取出数据后收到清空请求（抢话），不再送出，由播放线程先执行清空
+    if (audio_ring_flush_pending(&g_stPlaybackRing)) {
+        pthread_mutex_unlock(&g_playbackDevMutex);
+        return RK_ERR_AO_BUSY;
+    }
+
+    memset(&stFrame, 0, sizeof(stFrame));
+    stFrame.u32Len = len;
     stFrame.u64TimeStamp = timeStamp++;
     stFrame.s32SampleRate = g_stPlaybackCtx.s32SampleRate;
     stFrame.enBitWidth = find_bit_width(g_stPlaybackCtx.s32BitWidth);
     stFrame.enSoundMode = find_sound_mode(g_stPlaybackCtx.s32Channels);
-    stFrame.bBypassMbBlk = RK_FALSE;
-    
-    // 使用外部内存创建内存块 - 参考test_mpi_ao.c
-    MB_EXT_CONFIG_S extConfig;
-    memset(&extConfig, 0, sizeof(extConfig));
-    extConfig.pOpaque = (void*)audio_data;
-    extConfig.pu8VirAddr = (RK_U8*)audio_data;
-    extConfig.u64Size = data_len;
-    
-    struct timeval mb_start, mb_end;
-    gettimeofday(&mb_start, NULL);
-    
-    result = RK_MPI_SYS_CreateMB(&(stFrame.pMbBlk), &extConfig);
-    if (result != RK_SUCCESS) {
-        printf("❌ [DEBUG-MB] 创建内存块失败: 0x%x, 数据长度:%zu\n", result, data_len);
-        fflush(stdout);
-        return RK_FAILURE;
+
+    if (g_stPlaybackCtx.mbPool != MB_INVALID_POOLID) {
+        // 从预分配池取块，AO直接持有该块，播放完成后自动回到池中
+        stFrame.pMbBlk = RK_MPI_MB_GetMB(g_stPlaybackCtx.mbPool, PLAYBACK_CHUNK_BYTES, RK_FALSE);
+        if (stFrame.pMbBlk == MB_INVALID_HANDLE) {
+            g_stPlaybackCtx.u32PoolEmpty++;
+            pthread_mutex_unlock(&g_playbackDevMutex);
+            return RK_ERR_AO_BUSY;
+        }
+        g_stPlaybackCtx.u32PoolGets++;
+        memcpy(RK_MPI_MB_Handle2VirAddr(stFrame.pMbBlk), data, len);
+        RK_MPI_SYS_MmzFlushCache(stFrame.pMbBlk, RK_FALSE);
+        stFrame.bBypassMbBlk = RK_TRUE;
+    } else {
+        // 没有内存池时直接引用播放环中的数据，由AO拷贝
+        MB_EXT_CONFIG_S extConfig;
+
+        memset(&extConfig, 0, sizeof(extConfig));
+        extConfig.pOpaque = (void *)data;
+        extConfig.pu8VirAddr = (RK_U8 *)data;
+        extConfig.u64Size = len;
+        stFrame.bBypassMbBlk = RK_FALSE;
+        result = RK_MPI_SYS_CreateMB(&(stFrame.pMbBlk), &extConfig);
     }
-    
-    gettimeofday(&mb_end, NULL);
-    long mb_time = (mb_end.tv_sec - mb_start.tv_sec) * 1000 + 
-                   (mb_end.tv_usec - mb_start.tv_usec) / 1000;
-    if (mb_time > 1) {
-        printf("🎵 [DEBUG-MB] 内存块创建耗时: %ldms\n", mb_time);
+
+    if (result == RK_SUCCESS) {
+        result = RK_MPI_AO_SendFrame(g_stPlaybackCtx.aoDevId, g_stPlaybackCtx.aoChn, &stFrame, PLAYBACK_SEND_TIMEOUT_MS);
+        RK_MPI_MB_ReleaseMB(stFrame.pMbBlk);
     }
-    
-__RETRY:
-    // === 发送音频帧调试 ===
-    {
-        struct timeval send_start, send_end;
-        gettimeofday(&send_start, NULL);
-    
-    // 发送音频帧 - 参考test_mpi_ao.c的重试逻辑
-    result = RK_MPI_AO_SendFrame(g_stPlaybackCtx.aoDevId, g_stPlaybackCtx.aoChn, &stFrame, s32MilliSec);
-    
-    gettimeofday(&send_end, NULL);
-    long send_time = (send_end.tv_sec - send_start.tv_sec) * 1000 + 
-                     (send_end.tv_usec - send_start.tv_usec) / 1000;
-    
-    if (result < 0) {
-        static int error_count = 0;
-        if (error_count < 5) {
-            printf("⚠️ [DEBUG-SENDERR] 发送音频帧失败: 0x%x, 时间戳=%lld, 耗时=%ldms (错误 %d/5)\n", 
-                   result, stFrame.u64TimeStamp, send_time, ++error_count);
-            fflush(stdout);
+    pthread_mutex_unlock(&g_playbackDevMutex);
+    return result;
+}
+
+static void* playback_thread(void *ptr) {
+    RK_BOOL bPrebuffering = RK_TRUE;
+    int send_fails = 0;
+
+    printf("INFO: [PLAYBACK] 播放线程启动, 播放环:%d字节\n", PLAYBACK_RING_SIZE);
+    fflush(stdout);
+
+    while (g_playbackThreadRunning) {
+        const unsigned char *data;
+        unsigned int len;
+        unsigned int frame_bytes;
+        RK_S32 sendResult;
+
+        if (audio_ring_apply_flush(&g_stPlaybackRing) > 0) {
+            bPrebuffering = RK_TRUE;
         }
-        
-        // 重试机制
-        if (result == RK_ERR_AO_BUSY && error_count < 3) {
-            printf("🎵 [DEBUG-RETRY] AO设备忙，10ms后重试...\n");
-            usleep(10000); // 10ms
-            goto __RETRY;
+        if (!get_audio_playing_state()) {
+            bPrebuffering = RK_TRUE;
+            ao_manager_idle_check();
+            usleep(PLAYBACK_POLL_US);
+            continue;
         }
-    } else {
-        // 成功发送，记录性能数据
-        if (send_time > 5) { // 如果发送时间超过5ms则记录
-            printf("🎵 [DEBUG-SENDOK] 发送成功但耗时较长: %ldms, 数据:%zu字节, 时间戳=%lld\n", 
-                   send_time, data_len, stFrame.u64TimeStamp);
-                 }
-     }
-     
-     } // 结束调试代码块
-     
-     // 释放内存块
-     RK_MPI_MB_ReleaseMB(stFrame.pMbBlk);
-    
-    // === 查询播放后设备状态 ===
-    AO_CHN_STATE_S pstStatAfter;
-    memset(&pstStatAfter, 0, sizeof(AO_CHN_STATE_S));
-    ret = RK_MPI_AO_QueryChnStat(g_stPlaybackCtx.aoDevId, g_stPlaybackCtx.aoChn, &pstStatAfter);
-    if (ret == RK_SUCCESS) {
-        printf("📊 [DEBUG-DEVAFTER] 播放后状态: 总计=%d, 空闲=%d, 忙碌=%d\n", 
-               pstStatAfter.u32ChnTotalNum, pstStatAfter.u32ChnFreeNum, pstStatAfter.u32ChnBusyNum);
-        
-        // 分析状态变化
-        if (ret == RK_SUCCESS && pstStatBefore.u32ChnFreeNum > 0) {
-            int free_change = pstStatAfter.u32ChnFreeNum - pstStatBefore.u32ChnFreeNum;
-            printf("📊 [DEBUG-DEVCHANGE] 空闲缓冲区变化: %+d (播放前:%d -> 播放后:%d)\n", 
-                   free_change, pstStatBefore.u32ChnFreeNum, pstStatAfter.u32ChnFreeNum);
+
+        // 预缓冲：达到低水位或本段已结束才开始送数据
+        if (bPrebuffering) {
+            if (!audio_ring_ready(&g_stPlaybackRing)) {
+                usleep(PLAYBACK_POLL_US);
+                continue;
+            }
+            bPrebuffering = RK_FALSE;
+        }
+
+        len = audio_ring_peek(&g_stPlaybackRing, &data);
+        if (len == 0) {
+            // 本段没有结束却没有数据，说明网络跟不上播放
+            if (!audio_ring_end_reached(&g_stPlaybackRing)) {
+                audio_ring_count_underrun(&g_stPlaybackRing);
+                printf("⚠️ [DEBUG-UNDERRUN] 播放缓冲耗尽，重新预缓冲\n");
+                fflush(stdout);
+            }
+            bPrebuffering = RK_TRUE;
+            continue;
+        }
+
+        // 按整帧送数据（环回绕处可能不足一帧，留到下次一起送）
+        frame_bytes = g_stPlaybackCtx.s32Channels * (g_stPlaybackCtx.s32BitWidth / 8);
+        if (len > PLAYBACK_CHUNK_BYTES) {
+            len = PLAYBACK_CHUNK_BYTES;
+        }
+        if (frame_bytes > 1 && len >= frame_bytes) {
+            len -= len % frame_bytes;
+        }
+
+        if (!g_timing_stats.first_audio_played) {
+            record_timestamp(&g_timing_stats.first_audio_play_time, "第一次音频播放开始");
+            g_timing_stats.first_audio_played = 1;
+        }
+
+        sendResult = playback_send_chunk(data, len);
+        if (sendResult == RK_SUCCESS) {
+            audio_ring_consume(&g_stPlaybackRing, len);
+            g_timing_stats.audio_segments_played++;
+            send_fails = 0;
+        } else if (sendResult == RK_ERR_AO_BUSY) {
+            // AO队列已满，等待播放腾出空间（不计入失败次数）
+            usleep(PLAYBACK_POLL_US);
+        } else if (++send_fails >= PLAYBACK_MAX_SEND_FAILS) {
+            printf("⚠️ [DEBUG-SENDERR] AO连续%d次送帧失败，丢弃 %u 字节\n", send_fails, len);
+            fflush(stdout);
+            audio_ring_consume(&g_stPlaybackRing, len);
+            send_fails = 0;
+        } else {
+            usleep(PLAYBACK_POLL_US);
         }
     }
-    
-    // 更新播放统计
-    if (result == RK_SUCCESS) {
-        g_timing_stats.audio_segments_played++;
-    }
-    
-    struct timeval play_end_tv;
-    gettimeofday(&play_end_tv, NULL);
-    long total_play_time = (play_end_tv.tv_sec - play_start_tv.tv_sec) * 1000 + 
-                          (play_end_tv.tv_usec - play_start_tv.tv_usec) / 1000;
-    
-    printf("🎵 [DEBUG-PLAYEND] 播放完成: %zu字节, 总耗时:%ldms, 结果:0x%x\n", 
-           data_len, total_play_time, result);
-    
-    return result;
+
+    printf("INFO: [PLAYBACK] 播放线程退出\n");
+    fflush(stdout);
+    return NULL;
 }
 
 // 查询播放队列状态 - 用于调试
@@ -1777,9 +2084,10 @@ static void query_playback_status(void) {
 }
 
 // 清理音频播放设备 - 基于test_mpi_ao.c的deinit_mpi_ao逻辑
-static RK_S32 cleanup_audio_playback(void) {
+// 关闭播放设备，调用者需持有g_playbackDevMutex
+static void close_audio_playback_locked(void) {
     if (!g_stPlaybackCtx.bInitialized) {
-        return RK_SUCCESS;
+        return;
     }
     
     RK_S32 result;
@@ -1812,8 +2120,22 @@ static RK_S32 cleanup_audio_playback(void) {
         fflush(stdout);
     }
     
+    // AO已关闭，不再持有内存池中的块
+    if (g_stPlaybackCtx.mbPool != MB_INVALID_POOLID) {
+        RK_MPI_MB_DestroyPool(g_stPlaybackCtx.mbPool);
+        g_stPlaybackCtx.mbPool = MB_INVALID_POOLID;
+        printf("🔧 [DEBUG-MBPOOL] AO帧内存池已释放 (取块:%u, 无空闲块:%u)\n",
+               g_stPlaybackCtx.u32PoolGets, g_stPlaybackCtx.u32PoolEmpty);
+    }
+    
     // 重置播放上下文
     g_stPlaybackCtx.bInitialized = RK_FALSE;
+}
+
+static RK_S32 cleanup_audio_playback(void) {
+    pthread_mutex_lock(&g_playbackDevMutex);
+    close_audio_playback_locked();
+    pthread_mutex_unlock(&g_playbackDevMutex);
     
     // 确保清除播放状态
     set_audio_playing_state(RK_FALSE);
@@ -1821,6 +2143,101 @@ static RK_S32 cleanup_audio_playback(void) {
     return RK_SUCCESS;
 }
 
+// ==================== 播放设备管理 ====================
+
+static long long get_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 响应开始时取得播放设备：格式不变直接复用，否则（重新）打开
+static RK_S32 ao_manager_acquire(MY_RECORDER_CTX_S *ctx) {
+    RK_BOOL bReconfig = RK_FALSE;
+    long long start;
+    long cost;
+    RK_S32 result;
+
+    pthread_mutex_lock(&g_playbackDevMutex);
+    g_llAoIdleSinceMs = 0;
+    if (g_stPlaybackCtx.bInitialized) {
+        if (g_stPlaybackCtx.s32SampleRate == ctx->s32PlaybackSampleRate &&
+            g_stPlaybackCtx.s32Channels == ctx->s32PlaybackChannels &&
+            g_stPlaybackCtx.s32BitWidth == ctx->s32PlaybackBitWidth) {
+            g_stAoStats.u32Reuses++;
+            pthread_mutex_unlock(&g_playbackDevMutex);
+            printf("♻️ [DEBUG-AOMGR] 复用已打开的播放设备 (%dHz/%dch/%dbit), 复用:%u 冷启动:%u 重配置:%u\n",
+                   ctx->s32PlaybackSampleRate, ctx->s32PlaybackChannels, ctx->s32PlaybackBitWidth,
+                   g_stAoStats.u32Reuses, g_stAoStats.u32ColdSetups, g_stAoStats.u32Reconfigs);
+            fflush(stdout);
+            return RK_SUCCESS;
+        }
+        printf("🔧 [DEBUG-AOMGR] 播放格式变化 %dHz/%dch/%dbit -> %dHz/%dch/%dbit，重新配置\n",
+               g_stPlaybackCtx.s32SampleRate, g_stPlaybackCtx.s32Channels, g_stPlaybackCtx.s32BitWidth,
+               ctx->s32PlaybackSampleRate, ctx->s32PlaybackChannels, ctx->s32PlaybackBitWidth);
+        bReconfig = RK_TRUE;
+    }
+
+    start = get_monotonic_ms();
+    result = setup_audio_playback(ctx);
+    cost = (long)(get_monotonic_ms() - start);
+    pthread_mutex_unlock(&g_playbackDevMutex);
+
+    if (result != RK_SUCCESS) {
+        return result;
+    }
+    if (bReconfig) {
+        g_stAoStats.u32Reconfigs++;
+    } else {
+        g_stAoStats.u32ColdSetups++;
+    }
+    g_stAoStats.lLastSetupMs = cost;
+    g_stAoStats.lTotalSetupMs += cost;
+    if (cost > g_stAoStats.lMaxSetupMs) {
+        g_stAoStats.lMaxSetupMs = cost;
+    }
+    printf("📊 [DEBUG-AOMGR] 播放设备打开耗时:%ldms (最大:%ldms, 累计:%ldms), 复用:%u 冷启动:%u 重配置:%u\n",
+           cost, g_stAoStats.lMaxSetupMs, g_stAoStats.lTotalSetupMs,
+           g_stAoStats.u32Reuses, g_stAoStats.u32ColdSetups, g_stAoStats.u32Reconfigs);
+    fflush(stdout);
+    return RK_SUCCESS;
+}
+
+// 响应结束时归还播放设备：保持打开，开始计算空闲时间
+static void ao_manager_release(void) {
+    set_audio_playing_state(RK_FALSE);
+    if (g_s32AoIdleTimeoutMs <= 0) {
+        cleanup_audio_playback();
+        printf("🎵 音频播放设备已关闭");
+        return;
+    }
+    g_llAoIdleSinceMs = get_monotonic_ms();
+}
+
+// 播放线程空闲时调用：超过空闲时间后关闭设备
+static void ao_manager_idle_check(void) {
+    long long idle_since = g_llAoIdleSinceMs;
+
+    if (idle_since == 0 || !g_stPlaybackCtx.bInitialized ||
+        get_monotonic_ms() - idle_since < g_s32AoIdleTimeoutMs) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_playbackDevMutex);
+    // 加锁后再确认：期间可能已被新的响应重新使用
+    if (g_llAoIdleSinceMs != idle_since) {
+        pthread_mutex_unlock(&g_playbackDevMutex);
+        return;
+    }
+    g_llAoIdleSinceMs = 0;
+    close_audio_playback_locked();
+    pthread_mutex_unlock(&g_playbackDevMutex);
+
+    g_stAoStats.u32IdleCloses++;
+    printf("💤 [DEBUG-AOMGR] 播放设备空闲超过%dms，已关闭 (空闲关闭:%u)\n", g_s32AoIdleTimeoutMs, g_stAoStats.u32IdleCloses);
+    fflush(stdout);
+}
+
 // 播放整个音频文件（用于测试） - 基于test_mpi_ao.c的sendDataThread逻辑
 static RK_S32 play_audio_file(MY_RECORDER_CTX_S *ctx, const char *file_path) {
     FILE *file;
@@ -2393,9 +2810,10 @@ static RK_S32 setup_audio_device(MY_RECORDER_CTX_S *ctx) {
     
     aiAttr.soundCard.bitWidth = bitWidth;
     aiAttr.enBitwidth = bitWidth;
-    aiAttr.enSamplerate = (AUDIO_SAMPLE_RATE_E)ctx->s32SampleRate;
+    // 通道输出与声卡格式相同，转换为上传格式由capture_convert在软件中完成
+    aiAttr.enSamplerate = (AUDIO_SAMPLE_RATE_E)ctx->s32DeviceSampleRate;
     
-    AUDIO_SOUND_MODE_E soundMode = find_sound_mode(ctx->s32Channel);
+    AUDIO_SOUND_MODE_E soundMode = find_sound_mode(ctx->s32DeviceChannel);
     if (soundMode == AUDIO_SOUND_MODE_BUTT) {
         return RK_FAILURE;
     }
@@ -2426,99 +2844,637 @@ static RK_S32 setup_audio_device(MY_RECORDER_CTX_S *ctx) {
         printf(log_msg);
         return RK_FAILURE;
     }
-    
-    return RK_SUCCESS;
+    
+    return RK_SUCCESS;
+}
+
+static RK_S32 setup_audio_channel(MY_RECORDER_CTX_S *ctx) {
+    RK_S32 result;
+    AI_CHN_PARAM_S pstParams;
+    
+    memset(&pstParams, 0, sizeof(AI_CHN_PARAM_S));
+    pstParams.enLoopbackMode = AUDIO_LOOPBACK_NONE;
+    pstParams.s32UsrFrmDepth = 4;
+    pstParams.u32MapPtNumPerFrm = ctx->s32FrameLength;
+    pstParams.enSamplerate = (AUDIO_SAMPLE_RATE_E)ctx->s32DeviceSampleRate;
+    
+    result = RK_MPI_AI_SetChnParam(ctx->s32DevId, ctx->s32ChnIndex, &pstParams);
+    if (result != RK_SUCCESS) {
+        char log_msg[256];
+        snprintf(log_msg, sizeof(log_msg), "ERROR: AI set channel params failed: 0x%x", result);
+        printf(log_msg);
+        return RK_FAILURE;
+    }
+    
+    // 初始化VQE（如果启用）
+    if (ctx->s32VqeEnable) {
+        AI_VQE_CONFIG_S stAiVqeConfig;
+        memset(&stAiVqeConfig, 0, sizeof(AI_VQE_CONFIG_S));
+        
+        stAiVqeConfig.s32WorkSampleRate = ctx->s32DeviceSampleRate;
+        stAiVqeConfig.s32FrameSample = ctx->s32DeviceSampleRate * 16 / 1000; // 16ms
+        stAiVqeConfig.s64RefChannelType = 2;
+        stAiVqeConfig.s64RecChannelType = 1;
+        for (int i = 0; i < ctx->s32DeviceChannel; i++)
+            stAiVqeConfig.s64ChannelLayoutType |= (1 << i);
+        
+        result = RK_MPI_AI_SetVqeAttr(ctx->s32DevId, ctx->s32ChnIndex, 0, 0, &stAiVqeConfig);
+        if (result == RK_SUCCESS) {
+            result = RK_MPI_AI_EnableVqe(ctx->s32DevId, ctx->s32ChnIndex);
+            if (result == RK_SUCCESS) {
+                printf("INFO: VQE enabled successfully");
+            }
+        }
+    }
+    
+    result = RK_MPI_AI_EnableChn(ctx->s32DevId, ctx->s32ChnIndex);
+    if (result != 0) {
+        char log_msg[256];
+        snprintf(log_msg, sizeof(log_msg), "ERROR: AI enable channel fail: 0x%x", result);
+        printf(log_msg);
+        return RK_FAILURE;
+    }
+    
+    // 设置音量
+    RK_MPI_AI_SetVolume(ctx->s32DevId, ctx->s32SetVolume);
+    
+    return RK_SUCCESS;
+}
+
+// ==================== 录音设备管理 ====================
+
+static void ai_manager_disable_channel(MY_RECORDER_CTX_S *ctx) {
+    if (ctx->s32VqeEnable) {
+        RK_MPI_AI_DisableVqe(ctx->s32DevId, ctx->s32ChnIndex);
+    }
+    RK_MPI_AI_DisableChn(ctx->s32DevId, ctx->s32ChnIndex);
+}
+
+// 启动时打开录音设备：设备、混音器（只配置一次）、通道
+static RK_S32 ai_manager_open(MY_RECORDER_CTX_S *ctx) {
+    long long start = get_monotonic_ms();
+
+    if (setup_audio_device(ctx) != RK_SUCCESS) {
+        printf("ERROR: Failed to setup audio device\n");
+        return RK_FAILURE;
+    }
+    if (!g_bAiMixerApplied) {
+        auto_configure_audio(ctx);
+        g_bAiMixerApplied = RK_TRUE;
+        g_stAiStats.u32MixerApplies++;
+    }
+    if (setup_audio_channel(ctx) != RK_SUCCESS) {
+        printf("ERROR: Failed to setup audio channel\n");
+        RK_MPI_AI_Disable(ctx->s32DevId);
+        return RK_FAILURE;
+    }
+    g_enAiState = AI_DEV_RUNNING;
+    g_stAiStats.u32ColdSetups++;
+    printf("🎙️ [DEBUG-AIMGR] 录音设备已打开，耗时:%lldms，空闲策略:%s\n", get_monotonic_ms() - start,
+           g_enAiIdleMode == AI_IDLE_KEEP ? "keep" : (g_enAiIdleMode == AI_IDLE_PAUSE ? "pause" : "close"));
+    fflush(stdout);
+    return RK_SUCCESS;
+}
+
+// 让录音通道进入运行状态：响应结束后调用（为下一次按键做准备），开始录音时再调用一次（bPress）。
+// 设备已在运行时（采集线程一直在取帧），响应结束后丢弃通道中的积压帧并清空预录环和关键词检测状态，
+// 其中是播放期间采集的声音（含TTS回声）；已有开始录音请求（抢话）时保留，那是用户刚说的话
+static RK_S32 ai_manager_arm(MY_RECORDER_CTX_S *ctx, RK_BOOL bPress) {
+    AUDIO_FRAME_S frame;
+    long long start = get_monotonic_ms();
+    RK_S32 flushed = 0;
+    long cost;
+
+    if (bPress) {
+        g_llAiArmRequestMs = start;
+    }
+    pthread_mutex_lock(&g_aiDevMutex);
+    if (g_enAiState == AI_DEV_RUNNING) {
+        if (bPress) {
+            g_stAiStats.u32Reuses++;
+        } else if (!gGpioRecording) {
+            while (flushed <= ctx->s32FrameNumber &&
+                   RK_MPI_AI_GetFrame(ctx->s32DevId, ctx->s32ChnIndex, &frame, NULL, 0) == RK_SUCCESS) {
+                RK_MPI_AI_ReleaseFrame(ctx->s32DevId, ctx->s32ChnIndex, &frame, NULL);
+                flushed++;
+            }
+            g_stAiStats.ulFlushedFrames += flushed;
+            // 等采集线程处理完已经取出的帧再清空
+            pthread_mutex_lock(&g_captureRouteMutex);
+            audio_preroll_reset(&g_stPreroll);
+            if (g_bKwsReady) {
+                audio_kws_reset(&g_stKws);
+            }
+            pthread_mutex_unlock(&g_captureRouteMutex);
+        }
+        pthread_mutex_unlock(&g_aiDevMutex);
+        return RK_SUCCESS;
+    }
+
+    if (g_enAiState == AI_DEV_CLOSED) {
+        if (setup_audio_device(ctx) != RK_SUCCESS) {
+            pthread_mutex_unlock(&g_aiDevMutex);
+            printf("ERROR: Failed to re-setup audio device\n");
+            fflush(stdout);
+            return RK_FAILURE;
+        }
+        g_enAiState = AI_DEV_PAUSED;
+        g_stAiStats.u32ColdSetups++;
+    } else {
+        g_stAiStats.u32Resumes++;
+    }
+    if (setup_audio_channel(ctx) != RK_SUCCESS) {
+        pthread_mutex_unlock(&g_aiDevMutex);
+        printf("ERROR: Failed to re-setup audio channel\n");
+        fflush(stdout);
+        return RK_FAILURE;
+    }
+    g_enAiState = AI_DEV_RUNNING;
+    // 预录环里是停止前采集的旧声音
+    pthread_mutex_lock(&g_captureRouteMutex);
+    audio_preroll_reset(&g_stPreroll);
+    pthread_mutex_unlock(&g_captureRouteMutex);
+    pthread_mutex_unlock(&g_aiDevMutex);
+
+    cost = (long)(get_monotonic_ms() - start);
+    g_stAiStats.lLastRearmMs = cost;
+    if (cost > g_stAiStats.lMaxRearmMs) {
+        g_stAiStats.lMaxRearmMs = cost;
+    }
+    printf("📊 [DEBUG-AIMGR] 录音设备重新就绪耗时:%ldms (最大:%ldms), 打开:%u 恢复:%u 复用:%u\n",
+           cost, g_stAiStats.lMaxRearmMs, g_stAiStats.u32ColdSetups, g_stAiStats.u32Resumes, g_stAiStats.u32Reuses);
+    fflush(stdout);
+    return RK_SUCCESS;
+}
+
+// 录音结束：按空闲策略保持运行、关闭通道或关闭设备（pause/close时等待响应期间不做预录和关键词检测）
+static void ai_manager_park(MY_RECORDER_CTX_S *ctx) {
+    pthread_mutex_lock(&g_aiDevMutex);
+    if (g_enAiState != AI_DEV_RUNNING || g_enAiIdleMode == AI_IDLE_KEEP) {
+        pthread_mutex_unlock(&g_aiDevMutex);
+        return;
+    }
+    ai_manager_disable_channel(ctx);
+    g_enAiState = AI_DEV_PAUSED;
+    if (g_enAiIdleMode == AI_IDLE_CLOSE) {
+        RK_MPI_AI_Disable(ctx->s32DevId);
+        g_enAiState = AI_DEV_CLOSED;
+    }
+    pthread_mutex_unlock(&g_aiDevMutex);
+}
+
+// 把设备帧的PCM拷到采集线程自己的缓冲区，之后设备帧可以立即释放
+static RK_U32 capture_copy(const AUDIO_FRAME_S *frame) {
+    const void *data = RK_MPI_MB_Handle2VirAddr(frame->pMbBlk);
+    RK_U32 len = frame->u32Len;
+
+    if (!data || len == 0) {
+        return 0;
+    }
+    if (len > g_u32CaptureBufSize) {
+        unsigned char *buf = (unsigned char *)realloc(g_pCaptureBuf, len);
+
+        if (!buf) {
+            return 0;
+        }
+        g_pCaptureBuf = buf;
+        g_u32CaptureBufSize = len;
+    }
+    memcpy(g_pCaptureBuf, data, len);
+    return len;
+}
+
+// 在g_captureRouteMutex下处理拷出的一帧：转换格式后交给录音线程，或写入预录环并做关键词检测。
+// 返回RK_TRUE表示检测到关键词，由调用者在锁外触发开始录音
+static RK_BOOL capture_deliver(RK_U32 len) {
+    const void *data = g_pCaptureBuf;
+
+    if (capture_convert(&data, &len) != RK_SUCCESS || len == 0) {
+        return RK_FALSE;
+    }
+    if (g_bCaptureToRecorder) {
+        socket_queue_push(&g_stCaptureQueue, CAPTURE_MSG_FRAME, data, len);
+        return RK_FALSE;
+    }
+    audio_preroll_write(&g_stPreroll, data, len);
+    return kws_process(data, len);
+}
+
+static void *capture_thread(void *ptr) {
+    MY_RECORDER_CTX_S *ctx = (MY_RECORDER_CTX_S *)ptr;
+    AUDIO_FRAME_S frame;
+
+    printf("INFO: [CAPTURE] 采集线程启动\n");
+    fflush(stdout);
+    while (g_captureThreadRunning) {
+        RK_S32 ret = RK_FAILURE;
+        RK_BOOL bRunning;
+        RK_BOOL bKeyword = RK_FALSE;
+        RK_U32 len = 0;
+
+        pthread_mutex_lock(&g_aiDevMutex);
+        bRunning = (g_enAiState == AI_DEV_RUNNING) ? RK_TRUE : RK_FALSE;
+        if (bRunning) {
+            ret = RK_MPI_AI_GetFrame(ctx->s32DevId, ctx->s32ChnIndex, &frame, NULL, AI_IDLE_POLL_MS);
+        }
+        if (ret == RK_SUCCESS) {
+            len = capture_copy(&frame);
+            RK_MPI_AI_ReleaseFrame(ctx->s32DevId, ctx->s32ChnIndex, &frame, NULL);
+        }
+        if (len > 0) {
+            // 先取得去向锁再放开设备锁：丢弃积压帧或切换去向的线程会等这一帧处理完
+            pthread_mutex_lock(&g_captureRouteMutex);
+            pthread_mutex_unlock(&g_aiDevMutex);
+            bKeyword = capture_deliver(len);
+            pthread_mutex_unlock(&g_captureRouteMutex);
+        } else {
+            pthread_mutex_unlock(&g_aiDevMutex);
+        }
+        if (bKeyword) {
+            // 抢话要停止播放并发送取消消息，不能持有录音设备和去向的锁
+            raise_start_event(get_monotonic_ms());
+        }
+        if (ret != RK_SUCCESS) {
+            // 没有新帧或设备未运行：在锁外稍等，让录音线程有机会切换设备状态
+            usleep(bRunning ? 1000 : AI_IDLE_POLL_MS * 1000);
+        }
+    }
+    printf("INFO: [CAPTURE] 采集线程退出\n");
+    fflush(stdout);
+    return NULL;
+}
+
+static RK_S32 capture_thread_start(MY_RECORDER_CTX_S *ctx) {
+    socket_queue_init(&g_stCaptureQueue);
+    g_captureThreadRunning = RK_TRUE;
+    if (pthread_create(&g_captureThread, NULL, capture_thread, ctx) != 0) {
+        g_captureThreadRunning = RK_FALSE;
+        socket_queue_destroy(&g_stCaptureQueue);
+        return RK_FAILURE;
+    }
+    return RK_SUCCESS;
+}
+
+static void capture_thread_stop(void) {
+    if (!g_captureThreadRunning) {
+        return;
+    }
+    g_captureThreadRunning = RK_FALSE;
+    pthread_join(g_captureThread, NULL);
+    socket_queue_destroy(&g_stCaptureQueue);
+    free(g_pCaptureBuf);
+    g_pCaptureBuf = NULL;
+    g_u32CaptureBufSize = 0;
+}
+
+// 加载关键词模板（与录音相同格式的PCM文件，建议用本设备录制）
+static RK_S32 kws_open(MY_RECORDER_CTX_S *ctx) {
+    AUDIO_KWS_CONFIG_S stConfig;
+    char *copy;
+    char *save = NULL;
+    char *path;
+
+    audio_kws_default_config(&stConfig, ctx->s32SampleRate, ctx->s32Channel);
+    stConfig.threshold = g_s32KwsThreshold;
+    stConfig.cpu_budget_pct = AI_KWS_CPU_BUDGET_PCT;
+    if (ctx->s32BitWidth != 16 || audio_kws_init(&g_stKws, &stConfig) != 0) {
+        return RK_FAILURE;
+    }
+    copy = strdup(g_pKwsTemplates);
+    for (path = strtok_r(copy, ",", &save); path != NULL; path = strtok_r(NULL, ",", &save)) {
+        FILE *fp = fopen(path, "rb");
+        unsigned char *pcm = NULL;
+        long size = 0;
+        int frames = -1;
+
+        if (fp) {
+            fseek(fp, 0, SEEK_END);
+            size = ftell(fp);
+            fseek(fp, 0, SEEK_SET);
+            pcm = (unsigned char *)malloc(size > 0 ? size : 1);
+            if (pcm && fread(pcm, 1, size, fp) == (size_t)size) {
+                frames = audio_kws_add_template(&g_stKws, pcm, (unsigned int)size);
+            }
+            free(pcm);
+            fclose(fp);
+        }
+        if (frames < 0) {
+            printf("WARNING: 关键词模板 %s 无效（无法读取、太短、太长或超过%d个），忽略\n", path, AUDIO_KWS_MAX_TEMPLATES);
+            continue;
+        }
+        printf("🔑 [DEBUG-KWS] 模板 %s: %d 帧 (%dms)\n", path, frames, frames * AUDIO_KWS_HOP_MS);
+    }
+    free(copy);
+    if (g_stKws.num_templates == 0) {
+        audio_kws_deinit(&g_stKws);
+        return RK_FAILURE;
+    }
+    audio_kws_start(&g_stKws);
+    printf("🔑 [DEBUG-KWS] 关键词检测已启用: %d 个模板, 阈值 %d, CPU预算 %d%%\n",
+           g_stKws.num_templates, g_stKws.threshold, AI_KWS_CPU_BUDGET_PCT);
+    fflush(stdout);
+    return RK_SUCCESS;
+}
+
+// 不在录音时（包括等待响应和播放期间）的录音数据送入关键词检测，检测到后返回RK_TRUE，
+// 由采集线程在锁外本地触发开始录音（可以打断回答）
+static RK_BOOL kws_process(const void *data, RK_U32 len) {
+    const AUDIO_KWS_STATS_S *st = &g_stKws.stats;
+    RK_BOOL bHit = RK_FALSE;
+
+    if (!g_bKwsReady || recording_in_progress || gGpioRecording) {
+        return RK_FALSE;
+    }
+    if (audio_kws_process(&g_stKws, data, len) == 1) {
+        printf("🔑 [DEBUG-KWS] 检测到关键词 (得分:%d 阈值:%d)，本地开始录音\n", st->last_score, g_stKws.threshold);
+        // 唤醒词本身不是提问内容，不随预录一起上传
+        audio_preroll_reset(&g_stPreroll);
+        g_bKwsRecording = RK_TRUE;
+        bHit = RK_TRUE;
+    }
+    if (st->audio_ms - g_ullKwsLastLogMs >= AI_KWS_STATS_INTERVAL_MS) {
+        g_ullKwsLastLogMs = st->audio_ms;
+        printf("📊 [DEBUG-KWS] CPU:%.2f%% (预算%d%%) 活跃帧:%lu/%lu 能量门限:%ddBFS 检测:%lu次 最低得分:%d\n",
+               st->audio_ms > 0 ? st->cpu_us / 10.0 / st->audio_ms : 0.0, AI_KWS_CPU_BUDGET_PCT,
+               st->active_frames, st->frames, st->gate_db, st->detections, st->best_score);
+        fflush(stdout);
+    }
+    return bHit;
+}
+
+// 需要转换时把数据转换到conv的输出缓冲区，data/len改为指向转换结果（可能为0字节）；不需要转换时原样返回
+static RK_S32 audio_convert_run(AUDIO_CONVERT_S *conv, const void **data, unsigned int *len) {
+    unsigned int need;
+    int out;
+
+    if (!conv->bEnabled) {
+        return RK_SUCCESS;
+    }
+    need = audio_resample_max_output(&conv->stResample, *len);
+    if (need > conv->u32Size) {
+        unsigned char *buf = (unsigned char *)realloc(conv->pBuf, need);
+
+        if (!buf) {
+            printf("❌ [DEBUG-RESAMPLE] 转换缓冲区分配失败 (%u字节)\n", need);
+            return RK_FAILURE;
+        }
+        conv->pBuf = buf;
+        conv->u32Size = need;
+    }
+    out = audio_resample_process(&conv->stResample, *data, *len, conv->pBuf, conv->u32Size);
+    if (out < 0) {
+        return RK_FAILURE;
+    }
+    *data = conv->pBuf;
+    *len = (unsigned int)out;
+    return RK_SUCCESS;
+}
+
+static void audio_convert_close(AUDIO_CONVERT_S *conv) {
+    if (conv->bEnabled) {
+        audio_resample_deinit(&conv->stResample);
+        conv->bEnabled = RK_FALSE;
+    }
+    free(conv->pBuf);
+    conv->pBuf = NULL;
+    conv->u32Size = 0;
+}
+
+// 录音设备的数据转换为上传格式，之后预录、关键词检测、VAD和上传都只看到上传格式
+static RK_S32 capture_convert(const void **data, RK_U32 *len) {
+    unsigned int u32Len = *len;
+
+    if (audio_convert_run(&g_stCaptureConv, data, &u32Len) != RK_SUCCESS) {
+        return RK_FAILURE;
+    }
+    *len = u32Len;
+    return RK_SUCCESS;
+}
+
+// 录音数据写入文件或实时上传
+static int capture_output(void *user, const void *data, unsigned int len) {
+    CAPTURE_OUTPUT_S *out = (CAPTURE_OUTPUT_S *)user;
+
+    if (out->bFailed) {
+        return -1;
+    }
+    if (out->fp) {
+        fwrite(data, 1, len, out->fp);
+    } else if (out->bLive && live_upload_frame(data, len) != RK_SUCCESS) {
+        out->bFailed = RK_TRUE;
+        return -1;
+    }
+    return 0;
+}
+
+// 开始一次录音的输出，VAD重新统计
+static void capture_begin(FILE *fp, RK_BOOL bLive) {
+    g_stCapture.fp = fp;
+    g_stCapture.bLive = bLive;
+    g_stCapture.bFailed = RK_FALSE;
+    if (g_bVadReady) {
+        audio_vad_begin(&g_stVad);
+    }
+}
+
+// 写入录音数据：启用VAD时经过静音裁剪门。返回1表示VAD判定一句话结束，-1表示上传失败
+static RK_S32 capture_write(const void *data, RK_U32 len) {
+    if (g_bVadReady) {
+        return audio_vad_process(&g_stVad, data, len);
+    }
+    return capture_output(&g_stCapture, data, len) == 0 ? 0 : -1;
+}
+
+// 录音结束：输出VAD缓存的结尾并打印本次统计，返回实时上传是否仍然可用
+static RK_BOOL capture_end(void) {
+    if (g_bVadReady) {
+        const AUDIO_VAD_STATS_S *st = &g_stVad.stats;
+
+        audio_vad_finish(&g_stVad);
+        printf("🗣️ [DEBUG-VAD] 输入:%ums 语音:%ums 上传:%ums 裁掉:%ums 语音段:%u 开始:%dms 结束:%dms 噪声底:%ddBFS\n",
+               st->input_ms, st->speech_ms, st->output_ms, st->trimmed_ms, st->segments,
+               st->onset_ms, st->end_ms, st->noise_db);
+        fflush(stdout);
+    }
+    g_stCapture.fp = NULL;
+    return g_stCapture.bFailed ? RK_FALSE : RK_TRUE;
+}
+
+// 开始录音：把预录内容按时间顺序拷入采集队列（录音线程取出后再经过VAD和上传），然后清空预录环
+static void preroll_prepend(MY_RECORDER_CTX_S *ctx) {
+    const unsigned char *seg[2];
+    unsigned int len[2];
+    unsigned int total;
+    int i;
+
+    total = audio_preroll_take(&g_stPreroll, &seg[0], &len[0], &seg[1], &len[1]);
+    if (total == 0) {
+        return;
+    }
+    for (i = 0; i < 2; i++) {
+        if (len[i] > 0) {
+            socket_queue_push(&g_stCaptureQueue, CAPTURE_MSG_PREROLL, seg[i], len[i]);
+        }
+    }
+    audio_preroll_reset(&g_stPreroll);
+    printf("⏪ [DEBUG-PREROLL] 预录 %ums (%u 字节) 已补在录音开头，累计使用:%lu次\n",
+           total * 1000 / (ctx->s32SampleRate * ctx->s32Channel * (ctx->s32BitWidth / 8)), total,
+           g_stPreroll.used_count);
+    fflush(stdout);
 }
 
-static RK_S32 setup_audio_channel(MY_RECORDER_CTX_S *ctx) {
-    RK_S32 result;
-    AI_CHN_PARAM_S pstParams;
-    
-    memset(&pstParams, 0, sizeof(AI_CHN_PARAM_S));
-    pstParams.enLoopbackMode = AUDIO_LOOPBACK_NONE;
-    pstParams.s32UsrFrmDepth = 4;
-    pstParams.u32MapPtNumPerFrm = ctx->s32FrameLength;
-    pstParams.enSamplerate = (AUDIO_SAMPLE_RATE_E)ctx->s32SampleRate;
-    
-    result = RK_MPI_AI_SetChnParam(ctx->s32DevId, ctx->s32ChnIndex, &pstParams);
-    if (result != RK_SUCCESS) {
-        char log_msg[256];
-        snprintf(log_msg, sizeof(log_msg), "ERROR: AI set channel params failed: 0x%x", result);
-        printf(log_msg);
-        return RK_FAILURE;
+// 开始录音：预录内容放到采集队列最前面，之后采集线程的帧排在后面交给录音线程。
+// 两步在同一次加锁中完成，预录和录音之间不丢帧、不重复；锁内只做拷贝，VAD和上传由录音线程在锁外进行
+static void capture_route_begin(MY_RECORDER_CTX_S *ctx, RK_BOOL bOutput) {
+    pthread_mutex_lock(&g_captureRouteMutex);
+    socket_queue_clear(&g_stCaptureQueue);
+    if (bOutput) {
+        preroll_prepend(ctx);
+    } else {
+        audio_preroll_reset(&g_stPreroll);
     }
-    
-    // 初始化VQE（如果启用）
-    if (ctx->s32VqeEnable) {
-        AI_VQE_CONFIG_S stAiVqeConfig;
-        memset(&stAiVqeConfig, 0, sizeof(AI_VQE_CONFIG_S));
-        
-        stAiVqeConfig.s32WorkSampleRate = ctx->s32SampleRate;
-        stAiVqeConfig.s32FrameSample = ctx->s32SampleRate * 16 / 1000; // 16ms
-        stAiVqeConfig.s64RefChannelType = 2;
-        stAiVqeConfig.s64RecChannelType = 1;
-        for (int i = 0; i < ctx->s32DeviceChannel; i++)
-            stAiVqeConfig.s64ChannelLayoutType |= (1 << i);
-        
-        result = RK_MPI_AI_SetVqeAttr(ctx->s32DevId, ctx->s32ChnIndex, 0, 0, &stAiVqeConfig);
-        if (result == RK_SUCCESS) {
-            result = RK_MPI_AI_EnableVqe(ctx->s32DevId, ctx->s32ChnIndex);
-            if (result == RK_SUCCESS) {
-                printf("INFO: VQE enabled successfully");
-            }
+    g_bCaptureToRecorder = RK_TRUE;
+    pthread_mutex_unlock(&g_captureRouteMutex);
+}
+
+// 结束录音：采集线程恢复预录和关键词检测（录音期间没有送入检测器，重新开始匹配），已经交给录音线程的帧写完
+static void capture_route_end(RK_BOOL bOutput) {
+    SOCKET_MSG_S *msg;
+
+    pthread_mutex_lock(&g_captureRouteMutex);
+    g_bCaptureToRecorder = RK_FALSE;
+    if (g_bKwsReady) {
+        audio_kws_reset(&g_stKws);
+    }
+    pthread_mutex_unlock(&g_captureRouteMutex);
+    while ((msg = socket_queue_pop(&g_stCaptureQueue, 0)) != NULL) {
+        if (bOutput) {
+            capture_write(msg->data, msg->data_len);
         }
+        socket_msg_free(msg);
     }
-    
-    result = RK_MPI_AI_EnableChn(ctx->s32DevId, ctx->s32ChnIndex);
-    if (result != 0) {
-        char log_msg[256];
-        snprintf(log_msg, sizeof(log_msg), "ERROR: AI enable channel fail: 0x%x", result);
-        printf(log_msg);
-        return RK_FAILURE;
+}
+
+// 本次录音取得第一帧：记录从开始录音到第一帧的耗时
+static void ai_manager_first_frame(void) {
+    long cost;
+
+    if (g_llAiArmRequestMs == 0) {
+        return;
     }
-    
-    // 设置音量
-    RK_MPI_AI_SetVolume(ctx->s32DevId, ctx->s32SetVolume);
-    
-    return RK_SUCCESS;
+    cost = (long)(get_monotonic_ms() - g_llAiArmRequestMs);
+    g_llAiArmRequestMs = 0;
+    g_stAiStats.lLastFirstFrameMs = cost;
+    if (cost > g_stAiStats.lMaxFirstFrameMs) {
+        g_stAiStats.lMaxFirstFrameMs = cost;
+    }
+    printf("🎙️ [DEBUG-AIMGR] 开始录音到第一帧:%ldms (最大:%ldms), 丢弃积压帧:%lu\n",
+           cost, g_stAiStats.lMaxFirstFrameMs, g_stAiStats.ulFlushedFrames);
+    fflush(stdout);
+}
+
+// 程序退出：关闭录音设备
+static void ai_manager_close(MY_RECORDER_CTX_S *ctx) {
+    pthread_mutex_lock(&g_aiDevMutex);
+    if (g_enAiState == AI_DEV_CLOSED) {
+        pthread_mutex_unlock(&g_aiDevMutex);
+        return;
+    }
+    if (g_enAiState == AI_DEV_RUNNING) {
+        ai_manager_disable_channel(ctx);
+    }
+    RK_MPI_AI_Disable(ctx->s32DevId);
+    g_enAiState = AI_DEV_CLOSED;
+    pthread_mutex_unlock(&g_aiDevMutex);
+    printf("📊 [DEBUG-AIMGR] 录音设备已关闭, 打开:%u 恢复:%u 复用:%u 混音器配置:%u 最大重新就绪:%ldms 最大首帧:%ldms\n",
+           g_stAiStats.u32ColdSetups, g_stAiStats.u32Resumes, g_stAiStats.u32Reuses, g_stAiStats.u32MixerApplies,
+           g_stAiStats.lMaxRearmMs, g_stAiStats.lMaxFirstFrameMs);
+    fflush(stdout);
 }
 
-static void* clientHeart_thread(void* ptr)
+// I/O线程帧分发：开始/结束录音控制消息进入控制队列，其余进入响应队列
+static void client_dispatch_frame(void *user, const SOCKET_FRAME_S *frame)
 {
-    MY_RECORDER_CTX_S *ctx = (MY_RECORDER_CTX_S *)ptr;
-    //printf("[bayes->clientHeart_thread111111111111111111] \n");
-    while(RK_TRUE)
-    {
-        if(sendingvoice)
-        {
-            //printf("[bayes->clientHeart_thread111111111111111111] \n");
-            sleep(1);
-            continue;
+    if (frame->msg_type == MSG_TEXT_DATA && frame->data_len >= 8 &&
+        (strncmp((const char *)frame->data, "开始录音", 8) == 0 ||
+         strncmp((const char *)frame->data, "结束录音", 8) == 0)) {
+        if (strncmp((const char *)frame->data, "开始录音", 8) == 0) {
+            // 抢话：之后到达的旧轮次音频全部丢弃，直到下一次VOICE_START（到达时立即生效，
+            // 控制线程取出消息后raise_start_event再按到达时间处理）
+            atomic_store(&g_u32ActiveTurnId, 0);
+            g_llStartRequestMs = get_monotonic_ms();
         }
-        RK_BOOL res = socket_send_message(ctx->sockfd,MSG_CLIENT_HEART,NULL,0);
-       // printf("[bayes->socket_send_message:%d] \n",res);
-        if(res == RK_FAILURE)
-        {
-            RK_S32 res1 = connect_to_socket_server(ctx->serverHost, ctx->serverPort);
-            //printf("bayes_res:%d \n",res1);
-            //ctx->sockfd = res1;
-            //printf("ctx->sockfd:%d \n",ctx->sockfd); 
-            if(res1>0)
-            {
-                //需要重置播放设备状态初始状态，以及重新设置gpio线程
-                gRecorderExit = RK_FALSE;
-                recording_in_progress =  RK_FALSE;
-                totalFrames = 0;
-                gGpioRecording = RK_FALSE;
-                grecvservRespon = RK_FALSE;
-                sleep(1);
-                ctx->sockfd = res1;
+        socket_queue_push(&g_stCtrlQueue, frame->msg_type, frame->data, frame->data_len);
+        return;
+    }
+
+    if (frame->msg_type == MSG_CONFIG) {
+        client_config_ack(frame->data, frame->data_len);
+        return;
+    }
+
+    // 服务器对MSG_CANCEL的确认：属于已放弃的轮次，不交给响应线程
+    if (frame->msg_type == MSG_AI_CANCELLED && frame->data_len == AUDIO_TURN_ID_SIZE) {
+        RK_U32 turn = ((RK_U32)frame->data[0] << 24) | ((RK_U32)frame->data[1] << 16) |
+                      ((RK_U32)frame->data[2] << 8) | (RK_U32)frame->data[3];
+
+        if (turn == g_u32CancelTurnId && g_llCancelSentMs > 0) {
+            g_stBargeInStats.u32CancelAcked++;
+            g_stBargeInStats.lLastAckMs = (long)(get_monotonic_ms() - g_llCancelSentMs);
+            g_llCancelSentMs = 0;
+            printf("🛑 [DEBUG-CANCEL] 服务器已取消轮次 %u，往返 %ldms\n", turn, g_stBargeInStats.lLastAckMs);
+            fflush(stdout);
+        }
+        if (turn != atomic_load(&g_u32ActiveTurnId)) {
+            return;
+        }
+    }
+
+    if (frame->msg_type == MSG_AUDIO_START || frame->msg_type == MSG_AUDIO_DATA || frame->msg_type == MSG_AUDIO_END) {
+        // 服务器确认带轮次号后，所有音频帧都以轮次号开头，之后才是各自的负载
+        if (g_bAudioTurnTagged && frame->data_len >= AUDIO_TURN_ID_SIZE) {
+            RK_U32 turn = ((RK_U32)frame->data[0] << 24) | ((RK_U32)frame->data[1] << 16) |
+                          ((RK_U32)frame->data[2] << 8) | (RK_U32)frame->data[3];
+
+            // 过期轮次的音频在这里直接跳过，不拷贝进响应队列
+            if (turn != atomic_load(&g_u32ActiveTurnId)) {
+                g_stBargeInStats.u32StaleFrames++;
+                g_stBargeInStats.ulStaleBytes += frame->data_len;
+                return;
             }
-            //printf("...............:%d \n",ctx->sockfd); 
+            socket_queue_push(&g_stRespQueue, frame->msg_type, frame->data + AUDIO_TURN_ID_SIZE,
+                              frame->data_len - AUDIO_TURN_ID_SIZE);
+            return;
         }
-        sleep(20);//每20秒发送一次心跳包
     }
-    return NULL;
+    socket_queue_push(&g_stRespQueue, frame->msg_type, frame->data, frame->data_len);
+}
+
+// I/O线程连接状态回调：断线重连后重置录音状态
+static void client_connection_state(void *user, int connected)
+{
+    static int connect_count = 0;
+
+    if (!connected) {
+        g_enVoiceCodecAgreed = AUDIO_CODEC_PCM;
+        g_bAudioTurnTagged = RK_FALSE;
+        printf("WARNING: 与服务器的连接已断开，I/O线程将自动重连\n");
+        fflush(stdout);
+        return;
+    }
+    // 每条新连接重新协商音频轮次号和上行编码
+    client_config_offer((MY_RECORDER_CTX_S *)user);
+    if (connect_count++ > 0) {
+        //需要重置播放设备状态初始状态，以及重新设置gpio线程
+        gRecorderExit = RK_FALSE;
+        recording_in_progress =  RK_FALSE;
+        totalFrames = 0;
+        gGpioRecording = RK_FALSE;
+        socket_queue_clear(&g_stCtrlQueue);
+        socket_queue_clear(&g_stRespQueue);
+        printf("INFO: 已重新连接到服务器\n");
+        fflush(stdout);
+    }
 }
 
 
@@ -2528,7 +3484,10 @@ static void* recording_thread(void *ptr) {
     RK_S32 s32MilliSec = -1;
     AUDIO_FRAME_S getFrame;
     FILE *fp = NULL;
-    RK_S32 targetFrames = ctx->s32RecordSeconds * ctx->s32SampleRate / ctx->s32FrameLength;
+    // 录音设备每帧s32FrameLength个采样（设备采样率），按设备格式计算时长
+    RK_S32 targetFrames = ctx->s32RecordSeconds * ctx->s32DeviceSampleRate / ctx->s32FrameLength;
+    RK_BOOL bLiveUpload = (ctx->s32EnableUpload && ctx->s32LiveUpload) ? RK_TRUE : RK_FALSE;
+    RK_BOOL bLiveActive = RK_FALSE;     // 本轮录音正在实时上传
     printf("[bayes_INFO]: ctx->s32EnableGpioTrigger:%d\n",ctx->s32EnableGpioTrigger);
     if (ctx->s32EnableGpioTrigger) {
         printf("INFO: GPIO trigger mode enabled, waiting for button press...\n");
@@ -2541,9 +3500,14 @@ static void* recording_thread(void *ptr) {
                 printf("[bayes_INFO]: recording_in_progress:%d ,gGpioRecording :%d\n",recording_in_progress,gGpioRecording);
             }
             if (!recording_in_progress && gGpioRecording) {
+                if (ai_manager_arm(ctx, RK_TRUE) != RK_SUCCESS) {
+                    break;
+                }
                 recording_in_progress = RK_TRUE;
                 totalFrames = 0;
-                if (ctx->outputFilePath) {
+                if (bLiveUpload) {
+                    bLiveActive = (live_upload_begin(ctx) == RK_SUCCESS) ? RK_TRUE : RK_FALSE;
+                } else if (ctx->outputFilePath) {
                     fp = fopen(ctx->outputFilePath, "wb");
                     if (!fp) {
                         printf("ERROR: Cannot open output file: %s\n", ctx->outputFilePath);
@@ -2552,31 +3516,36 @@ static void* recording_thread(void *ptr) {
                     printf("INFO: Started recording to: %s\n", ctx->outputFilePath);
                     fflush(stdout);
                 }
+                if (fp || bLiveActive) {
+                    capture_begin(fp, bLiveActive);
+                }
+                capture_route_begin(ctx, (fp || bLiveActive) ? RK_TRUE : RK_FALSE);
             }
-            // 如果正在录音且gGpioRecording为真，持续录音
+            // 如果正在录音且gGpioRecording为真，持续录音（帧由采集线程取出并转换为上传格式）
             if (recording_in_progress && gGpioRecording) {
-                result = RK_MPI_AI_GetFrame(ctx->s32DevId, ctx->s32ChnIndex, &getFrame, NULL, s32MilliSec);
-                if (result == 0) {
-                    void* data = RK_MPI_MB_Handle2VirAddr(getFrame.pMbBlk);
-                    int len = getFrame.u32Len;
-                     if (fp && data && len > 0) {
-                         fwrite(data, 1, len, fp);
-                        totalFrames++;
-                        if (totalFrames % 50 == 0) {
-                            printf("Recording... %d seconds\r", totalFrames * ctx->s32FrameLength / ctx->s32SampleRate);
+                SOCKET_MSG_S *frameMsg = socket_queue_pop(&g_stCaptureQueue, AI_IDLE_POLL_MS);
+
+                if (frameMsg) {
+                    RK_BOOL bDeviceFrame = (frameMsg->msg_type == CAPTURE_MSG_FRAME) ? RK_TRUE : RK_FALSE;
+
+                    if (bDeviceFrame) {
+                        ai_manager_first_frame();
+                    }
+                    if (fp || bLiveActive) {
+                        RK_S32 s32Vad = capture_write(frameMsg->data, frameMsg->data_len);
+                        if (s32Vad < 0 && bLiveActive) {
+                            bLiveActive = RK_FALSE;
+                        } else if (s32Vad == 1 && (g_enVadMode == AI_VAD_AUTO || g_bKwsRecording)) {
+                            // 检测到一句话结束，不再等待服务器的结束录音消息（关键词触发的录音不会有这条消息）
+                            printf("\n🗣️ [DEBUG-VAD] 检测到语音结束（静音%dms），自动结束录音\n", g_s32VadHangoverMs);
+                            gGpioRecording = RK_FALSE;
+                        }
+                        if (bDeviceFrame && ++totalFrames % 50 == 0) {
+                            printf("Recording... %d seconds\r", totalFrames * ctx->s32FrameLength / ctx->s32DeviceSampleRate);
                             fflush(stdout);
                         }
                     }
-                    RK_MPI_AI_ReleaseFrame(ctx->s32DevId, ctx->s32ChnIndex, &getFrame, NULL);
-                    if (len <= 0) {
-                        printf("INFO: Recording ended (no more data)\n");
-                        break;
-                    }
-                } else {
-                    if (!gRecorderExit) {
-                        printf("ERROR: Failed to get audio frame: 0x%x\n", result);
-                    }
-                    break;
+                    socket_msg_free(frameMsg);
                 }
             }
             if(totalFrames >= targetFrames)
@@ -2589,88 +3558,56 @@ static void* recording_thread(void *ptr) {
             // 如果正在录音但gGpioRecording变为假，停止录音并上传
             if (recording_in_progress && (!gGpioRecording)) {
                 recording_in_progress = RK_FALSE;
-                if (fp) {
-                    fclose(fp);
-                    fp = NULL;
+                capture_route_end((fp || bLiveActive) ? RK_TRUE : RK_FALSE);
+                if (g_bKwsRecording) {
+                    g_bKwsRecording = RK_FALSE;
+                    gGpioPressed = RK_FALSE;
+                }
+                if (fp || bLiveActive) {
+                    if (!capture_end()) {
+                        bLiveActive = RK_FALSE;
+                    }
+                    if (fp) {
+                        fclose(fp);
+                        fp = NULL;
+                    }
                     printf("\nINFO: Recording completed (%d frames, %d seconds)\n", 
-                           totalFrames, totalFrames * ctx->s32FrameLength / ctx->s32SampleRate);
-                    printf("INFO: Recording saved to: %s\n", ctx->outputFilePath);
+                           totalFrames, totalFrames * ctx->s32FrameLength / ctx->s32DeviceSampleRate);
+                    if (bLiveActive) {
+                        // 语音数据已在录音过程中发出，这里只剩VOICE_END
+                        if (live_upload_end() != RK_SUCCESS) {
+                            bLiveActive = RK_FALSE;
+                        }
+                    } else {
+                        printf("INFO: Recording saved to: %s\n", ctx->outputFilePath);
+                    }
                     fflush(stdout);
-                    // 如果启用了上传功能，先释放录音设备，然后上传到服务器
-                     if (ctx->s32EnableUpload) {
-                         printf("INFO: Releasing audio device before upload...\n");
-                         fflush(stdout);
-                         
-                         // 释放录音设备资源（与原逻辑保持一致）
-                         if (ctx->s32VqeEnable) {
-                             RK_MPI_AI_DisableVqe(ctx->s32DevId, ctx->s32ChnIndex);
-                         }
-                         RK_MPI_AI_DisableChn(ctx->s32DevId, ctx->s32ChnIndex);
-                         RK_MPI_AI_Disable(ctx->s32DevId);
-                         
-                         //printf("INFO: Audio device released, starting upload...\n");
-                         fflush(stdout);
-                         upload_audio_to_socket_server(ctx);
-                         
-                         // 上传完成后重新初始化录音设备，为下次录音做准备
-                         //printf("INFO: Re-initializing audio device for next recording...\n");
-                         fflush(stdout);
-                         
-                         // 重新设置音频设备
-                         if (setup_audio_device(ctx) != RK_SUCCESS) {
-                             printf("ERROR: Failed to re-setup audio device\n");
-                             fflush(stdout);
-                             break;
-                         }
-                         
-                         // 重新自动配置音频参数
-                         auto_configure_audio(ctx);
-                         
-                         // 重新设置音频通道
-                         if (setup_audio_channel(ctx) != RK_SUCCESS) {
-                             printf("ERROR: Failed to re-setup audio channel\n");
-                             fflush(stdout);
-                             break;
-                         }
-                         printf("INFO: Audio device re-initialized successfully\n");
-                         fflush(stdout);
-                     } else {
-                         // 即使没有启用上传，在GPIO模式下也需要重新初始化设备为下次录音做准备
-                         printf("INFO: Preparing for next recording session...\n");
-                         fflush(stdout);
-                         
-                         // 释放当前录音设备
-                         if (ctx->s32VqeEnable) {
-                             RK_MPI_AI_DisableVqe(ctx->s32DevId, ctx->s32ChnIndex);
-                         }
-                         RK_MPI_AI_DisableChn(ctx->s32DevId, ctx->s32ChnIndex);
-                         RK_MPI_AI_Disable(ctx->s32DevId);
-                         
-                         // 重新初始化录音设备
-                         if (setup_audio_device(ctx) != RK_SUCCESS) {
-                             printf("ERROR: Failed to re-setup audio device\n");
-                             fflush(stdout);
-                             break;
-                         }
-                         
-                         auto_configure_audio(ctx);
-                         
-                         if (setup_audio_channel(ctx) != RK_SUCCESS) {
-                             printf("ERROR: Failed to re-setup audio channel\n");
-                             fflush(stdout);
-                             break;
-                         }
-                         
-                         printf("INFO: Audio device ready for next recording\n");
-                         fflush(stdout);
-                     }              
+                    // 按空闲策略处理录音设备（默认保持运行），然后等待服务器响应
+                    ai_manager_park(ctx);
+                    if (ctx->s32EnableUpload) {
+                        if (bLiveActive) {
+                            bLiveActive = RK_FALSE;
+                            receive_socket_response(ctx);
+                        } else if (!bLiveUpload) {
+                            upload_audio_to_socket_server(ctx);
+                        }
+                    }
+                    // 响应结束后让设备重新就绪，下次按键时无需等待
+                    if (ai_manager_arm(ctx, RK_FALSE) != RK_SUCCESS) {
+                        break;
+                    }
                  // 短暂等待避免CPU占用过高
                  usleep(6000); // 6ms
                 }
             }
             
-            // 短暂等待
-            usleep(1000); // 1ms
+            if (!recording_in_progress) {
+                // 等待按键：采集线程负责取帧、预录和关键词检测
+                usleep(AI_IDLE_POLL_MS * 1000);
+            } else {
+                // 短暂等待
+                usleep(1000); // 1ms
+            }
         }
         
     } else {
@@ -2696,15 +3633,16 @@ static void* recording_thread(void *ptr) {
             printf("[bayes22]......INFO gRecorderExit:%d result:%d totalFrames:%d targetFrames:%d \n",gRecorderExit,
             result,totalFrames,targetFrames);
             if (result == 0) {
-                void* data = RK_MPI_MB_Handle2VirAddr(getFrame.pMbBlk);
+                const void* data = RK_MPI_MB_Handle2VirAddr(getFrame.pMbBlk);
                 int len = getFrame.u32Len;
+                RK_U32 u32OutLen = getFrame.u32Len;
                 
-                if (fp && data && len > 0) {
-                    fwrite(data, 1, len, fp);
+                if (fp && data && len > 0 && capture_convert(&data, &u32OutLen) == RK_SUCCESS) {
+                    fwrite(data, 1, u32OutLen, fp);
                     totalFrames++;
                     
                     if (totalFrames % 50 == 0) {
-                        printf("Recording... %d seconds\r", totalFrames * ctx->s32FrameLength / ctx->s32SampleRate);
+                        printf("Recording... %d seconds\r", totalFrames * ctx->s32FrameLength / ctx->s32DeviceSampleRate);
                         fflush(stdout);
                     }
                 }
@@ -2734,14 +3672,7 @@ static void* recording_thread(void *ptr) {
             // 如果启用了上传功能，先释放录音设备，然后上传到服务器
             if (ctx->s32EnableUpload) {
                 printf("INFO: Releasing audio device before upload... \n");
-                
-                // 释放录音设备资源
-                if (ctx->s32VqeEnable) {
-                    RK_MPI_AI_DisableVqe(ctx->s32DevId, ctx->s32ChnIndex);
-                }
-                RK_MPI_AI_DisableChn(ctx->s32DevId, ctx->s32ChnIndex);
-                RK_MPI_AI_Disable(ctx->s32DevId);
-                
+                ai_manager_close(ctx);
                 printf("INFO: Audio device released, starting upload...");
                 upload_audio_to_socket_server(ctx);
             }
@@ -2756,32 +3687,8 @@ static void* recording_thread(void *ptr) {
 }
 
 static RK_S32 cleanup_audio(MY_RECORDER_CTX_S *ctx) {
-    RK_S32 result;
-    char log_msg[256];
-    
-    // 如果启用了上传功能，设备可能已经在录音线程中释放了
-    // 在GPIO模式下也是如此，因为每次录音后都会释放设备
-    if (ctx->s32EnableUpload || ctx->s32EnableGpioTrigger) {
-        printf("INFO: Audio device already released in recording thread");
-        return RK_SUCCESS;
-    }
-    
-    if (ctx->s32VqeEnable) {
-        RK_MPI_AI_DisableVqe(ctx->s32DevId, ctx->s32ChnIndex);
-    }
-    
-    result = RK_MPI_AI_DisableChn(ctx->s32DevId, ctx->s32ChnIndex);
-    if (result != 0) {
-        snprintf(log_msg, sizeof(log_msg), "ERROR: AI disable channel fail: 0x%X", result);
-        printf(log_msg);
-    }
-    
-    result = RK_MPI_AI_Disable(ctx->s32DevId);
-    if (result != 0) {
-        snprintf(log_msg, sizeof(log_msg), "ERROR: AI disable fail: 0x%X", result);
-        printf(log_msg);
-    }
-    
+    // 录音设备可能已在录音线程中关闭，ai_manager_close会跳过已关闭的设备
+    ai_manager_close(ctx);
     return RK_SUCCESS;
 }
 
@@ -2798,12 +3705,23 @@ static void show_usage() {
     printf("      --no-auto-config    Disable auto audio configuration\n");
     printf("      --enable-vqe        Enable VQE (Voice Quality Enhancement)\n");
     printf("      --enable-upload     Enable Socket upload to server\n");
+    printf("      --file-upload       Record to file and upload after release (default: live upload while recording)\n");
+    printf("      --codec <name>      Uplink voice codec: pcm/ima_adpcm/opus, used once the server accepts it (default: ima_adpcm)\n");
+    printf("      --ao-idle-ms <ms>   Keep playback device open this long after a response (default: 30000, 0=close)\n");
+    printf("      --ai-idle <mode>    Capture device between recordings: keep/pause/close (default: keep)\n");
+    printf("      --preroll-ms <ms>   Audio captured before the start command to prepend (default: 300, 0=off)\n");
+    printf("      --vad <mode>        Voice activity detection: off/trim/auto (default: trim, auto=also end recording on silence)\n");
+    printf("      --vad-hangover-ms <ms> Silence after speech that ends an utterance (default: 800)\n");
+    printf("      --kws <files>       Start recording locally on a keyword; comma-separated keyword PCM templates\n");
+    printf("      --kws-threshold <n> Keyword match threshold (default: auto from templates)\n");
+    printf("      --device-rate <r>   Sound card capture rate, converted to the upload rate in software (default: same)\n");
+    printf("      --device-channels <c> Sound card capture channels, down/upmixed to the upload channels (default: same)\n");
     printf("      --server <host>     Server host (default: 127.0.0.1)\n");
     printf("      --port <port>       Server port (default: 7861)\n");
     printf("      --format <fmt>      Response format: json/stream (default: json)\n");
     printf("      --enable-streaming  Enable streaming audio playback (for stream format)\n");
-    printf("      --playback-rate <r> Playback sample rate (default: 22050)\n");
-    printf("      --playback-channels <c> Playback channels (default: 1)\n");
+    printf("      --playback-rate <r> Fixed playback device rate; server audio is resampled to it (default: follow stream)\n");
+    printf("      --playback-channels <c> Fixed playback device channels (default: 1)\n");
     printf("      --test-play <file>  Test audio playback with PCM file\n");
     printf("      --enable-timing     Enable detailed timing statistics\n");
     printf("      --enable-gpio       Enable GPIO trigger recording\n");
@@ -2913,9 +3831,19 @@ static void print_timing_report(void) {
     printf("\n5️⃣ 音频播放阶段:\n");
     print_stage_timing("   音频开始到播放设备就绪", &g_timing_stats.audio_start_time, &g_timing_stats.audio_setup_complete_time);
     print_stage_timing("   播放设备就绪到第一次播放", &g_timing_stats.audio_setup_complete_time, &g_timing_stats.first_audio_play_time);
+    print_stage_timing("   第一个音频数据到第一次播放 (预缓冲)", &g_timing_stats.audio_first_data_time, &g_timing_stats.first_audio_play_time);
+    printf("   预缓冲时长: %d ms\n", g_s32PrebufferMs);
     printf("   接收音频包数量: %d 个\n", g_timing_stats.audio_data_packets);
     printf("   接收音频总量: %ld 字节\n", g_timing_stats.total_audio_bytes);
     printf("   已播放音频段数: %d 个\n", g_timing_stats.audio_segments_played);
+    if (g_stBargeInStats.u32Count > 0 || g_stBargeInStats.u32StaleFrames > 0) {
+        printf("   抢话次数: %u, 最近延迟: %ld ms, 最大: %ld ms, 平均: %ld ms\n", g_stBargeInStats.u32Count,
+               g_stBargeInStats.lLastMs, g_stBargeInStats.lMaxMs,
+               g_stBargeInStats.u32Count ? g_stBargeInStats.lTotalMs / g_stBargeInStats.u32Count : 0);
+        printf("   丢弃过期音频: %u 帧, %lu 字节\n", g_stBargeInStats.u32StaleFrames, g_stBargeInStats.ulStaleBytes);
+        printf("   取消请求: %u 次, 服务器确认: %u 次, 最近往返: %ld ms\n", g_stBargeInStats.u32CancelSent,
+               g_stBargeInStats.u32CancelAcked, g_stBargeInStats.lLastAckMs);
+    }
     
     // 6. 总体性能指标
     printf("\n📊 关键性能指标:\n");
@@ -2985,21 +3913,35 @@ static RK_S32 interrupt_audio_playback(void) {
         printf("🔇 检测到按钮按下，正在中断音频播放...\n");
         fflush(stdout);
         
-        // 立即停止音频播放
+        // 丢弃尚未播放的数据，播放线程在下一次读取前执行
+        audio_ring_request_flush(&g_stPlaybackRing);
+        
+        // 清空AO中已排队的数据（等待播放线程当前这次送帧返回），设备保持打开供下一轮复用
+        pthread_mutex_lock(&g_playbackDevMutex);
         if (g_stPlaybackCtx.bInitialized) {
-            // 强制清理播放设备，不等待播放完成
-            RK_MPI_AO_DisableChn(g_stPlaybackCtx.aoDevId, g_stPlaybackCtx.aoChn);
-            RK_MPI_AO_Disable(g_stPlaybackCtx.aoDevId);
-            g_stPlaybackCtx.bInitialized = RK_FALSE;
-            
-            printf("✅ 音频播放设备已强制关闭\n");
-            fflush(stdout);
+            RK_MPI_AO_ClearChnBuf(g_stPlaybackCtx.aoDevId, g_stPlaybackCtx.aoChn);
         }
+        g_llAoIdleSinceMs = get_monotonic_ms();
+        pthread_mutex_unlock(&g_playbackDevMutex);
         
         gAudioPlaying = RK_FALSE;
         gAudioInterrupted = RK_TRUE;  // 设置中断标志
-        
         pthread_mutex_unlock(&gAudioStateMutex);
+
+        if (g_llBargeInRequestMs > 0) {
+            long cost = (long)(get_monotonic_ms() - g_llBargeInRequestMs);
+
+            g_stBargeInStats.u32Count++;
+            g_stBargeInStats.lLastMs = cost;
+            g_stBargeInStats.lTotalMs += cost;
+            if (cost > g_stBargeInStats.lMaxMs) {
+                g_stBargeInStats.lMaxMs = cost;
+            }
+            g_llBargeInRequestMs = 0;
+        }
+        printf("✅ [DEBUG-BARGEIN] 播放已停止并清空AO缓冲，抢话延迟:%ldms (最大:%ldms, 次数:%u)\n",
+               g_stBargeInStats.lLastMs, g_stBargeInStats.lMaxMs, g_stBargeInStats.u32Count);
+        fflush(stdout);
         return RK_SUCCESS;
     }
     
@@ -3055,132 +3997,79 @@ static RK_S32 read_gpio_state(const char *gpio_debug_path, RK_S32 gpio_number) {
     return -1; // 未找到或解析失败
 }
 
-// 等待GPIO按下 (lo -> hi)
+// 等待开始录音控制消息（由I/O线程分发到控制队列）
 static RK_S32 wait_for_gpio_press(MY_RECORDER_CTX_S *ctx) {
-    RK_S32 current_state, prev_state = -1;
-    //printf("[[[[bayes....]]]INFO: Waiting for GPIO-%d press (lo -> hi)...\n", ctx->s32GpioNumber);
-    fflush(stdout);
-    unsigned char msg_type;
-    char buffer[SOCKET_RESPONSE_BUFFER_SIZE];
-    unsigned int data_len;
-    //printf("[info]等待服务器输入开始录音,目前 grecvservRespon:%d\n",grecvservRespon);
-    while (!gRecorderExit && !grecvservRespon) {
-        // current_state = read_gpio_state(ctx->gpioDebugPath, ctx->s32GpioNumber);
-        
-        // if (current_state < 0) {
-        //     printf("ERROR: Failed to read GPIO state\n");
-        //     return RK_FAILURE;
-        // }
-        
-        // 检测从低到高的变化
-        // if (prev_state == 0 && current_state == 1) {
-        //     printf("INFO: GPIO-%d pressed!\n", ctx->s32GpioNumber);
-        //     fflush(stdout);
-        // 接收消息头（5字节）
-        //unsigned char header[5];
-        ssize_t received_bytes;
-        //获取文件头，区分发送文件的内容
-        //received_bytes = recv(ctx->sockfd, header, 5, 0);
-        RK_S32 receive_result = socket_receive_message_msg_press(ctx->sockfd, &msg_type, buffer, &data_len, sizeof(buffer));
-        // if (receive_result != RK_SUCCESS) {
-        //     if (message_count > 0) {
-        //         printf("INFO: Connection closed after receiving messages");
-        //         break; // 正常结束，已经收到一些消息
-        //     } else {
-        //         printf("ERROR: Failed to receive any messages");
-        //         return RK_FAILURE;
-        //     }
-        // }
-        //printf("INFO: [DEBUG-MSG] Received message: type=0x%02X, data_length=%u ,msg=%s\n", msg_type, data_len,buffer);
-
-        if(msg_type == MSG_TEXT_DATA)
-        {
-            if(strncmp(buffer, "开始录音",8) != 0)
-            {
-                return RK_FAILURE;
-            }
-        }
-        else
-        {
-            printf("warning: [bayes_DEBUG-TOOLARGE] start 录音开始结束控制只接收文字消息\n");
-            return RK_FAILURE;
-        }
-        // 检查是否有音频正在播放或者AI响应在进行中，如果有则立即中断
-        RK_BOOL need_interrupt = get_audio_playing_state() || gAIResponseActive;
-        if (need_interrupt) {
-            if (get_audio_playing_state()) {
-                printf("INFO: Interrupting current audio playback...\n");
-                fflush(stdout);
-                interrupt_audio_playback();
-                usleep(100000); // 100ms
-            }
-            gInterruptAIResponse = RK_TRUE; // 通知AI响应线程中断
-        }
-        // 抢话时若未在录音则进入录音
-        if (!gGpioRecording) {
-            gGpioRecording = RK_TRUE;
-            printf("INFO: [抢话] 进入录音模式\n");
-        } else {
-            printf("INFO: [抢话] 已在录音中，忽略重复触发\n");
+    SOCKET_MSG_S *msg;
+    RK_BOOL is_start;
+
+    msg = socket_queue_pop(&g_stCtrlQueue, SOCKET_CONTROL_TIMEOUT_MS);
+    if (!msg) {
+        return RK_FAILURE;
+    }
+    is_start = (msg->data_len >= 8 && strncmp((const char *)msg->data, "开始录音", 8) == 0) ? RK_TRUE : RK_FALSE;
+    socket_msg_free(msg);
+    if (!is_start) {
+        printf("warning: [bayes_DEBUG] 等待开始录音时收到其他控制消息，忽略\n");
+        return RK_FAILURE;
+    }
+    raise_start_event(g_llStartRequestMs);
+    return RK_SUCCESS;
+}
+
+// 开始录音事件（服务器的开始录音消息或本地关键词检测）：打断正在进行的回答，进入录音。
+// llRequestMs为触发时间（消息到达或检测到关键词），用于统计抢话延迟
+static void raise_start_event(long long llRequestMs) {
+    // 检查是否有音频正在播放或者AI响应在进行中，如果有则立即中断
+    RK_BOOL need_interrupt = get_audio_playing_state() || gAIResponseActive;
+
+    // 两种触发方式相同：旧轮次的音频和取消确认全部丢弃，直到下一次VOICE_START
+    atomic_store(&g_u32ActiveTurnId, 0);
+    // 只有真正打断播放时才统计延迟，避免残留的时间戳计入下一次抢话
+    g_llBargeInRequestMs = need_interrupt ? llRequestMs : 0;
+    if (need_interrupt) {
+        if (get_audio_playing_state()) {
+            printf("INFO: Interrupting current audio playback...\n");
+            fflush(stdout);
+            interrupt_audio_playback();
         }
-       
-        fflush(stdout);
-        gGpioPressed = RK_TRUE;
-        grecvservRespon = RK_TRUE;
-        printf("INFO: Starting recording...  grecvservRespon:%d\n",grecvservRespon);
-        //gGpioPressed = RK_TRUE;
-        return RK_SUCCESS;
-        //}
-        //prev_state = current_state;
-        usleep(ctx->s32GpioPollInterval * 1000); // 转换为微秒
-    }   
+        gInterruptAIResponse = RK_TRUE; // 通知AI响应线程中断
+        // 通知服务器停止为上一轮生成文本和语音
+        send_cancel_message(g_u32NextTurnId);
+    }
+    // 抢话时若未在录音则进入录音
+    if (!gGpioRecording) {
+        gGpioRecording = RK_TRUE;
+        printf("INFO: [抢话] 进入录音模式\n");
+    } else {
+        printf("INFO: [抢话] 已在录音中，忽略重复触发\n");
+    }
+
+    fflush(stdout);
+    gGpioPressed = RK_TRUE;
+    printf("INFO: Starting recording...\n");
 }
 
-// 等待GPIO松开 (hi -> lo)
+// 等待结束录音控制消息
 static RK_S32 wait_for_gpio_release(MY_RECORDER_CTX_S *ctx) {
-    //RK_S32 current_state, prev_state = -1;
-    /*
-    while (!gRecorderExit && gGpioPressed) 
-    {
-       
-        usleep(ctx->s32GpioPollInterval * 1000); // 转换为微秒
-    }
-    */
-    unsigned char msg_type;
-    char buffer[SOCKET_RESPONSE_BUFFER_SIZE];
-    unsigned int data_len;
-    //printf("[[[[bayes222222....]]]INFO: Waiting for GPIO-%d press (lo -> hi)...\n", gGpioPressed);
-    //printf("[info]等待服务器输入结束录音,目前 gGpioPressed:%d\n",gGpioPressed);
     while (!gRecorderExit && gGpioPressed) {
-         // 接收消息头（5字节）
-        unsigned char header[5];
-        ssize_t received_bytes;
-        //获取文件头，区分发送文件的内容
-        //received_bytes = recv(ctx->sockfd, header, 5, 0);
-        RK_S32 receive_result = socket_receive_message_msg_release(ctx->sockfd, &msg_type, buffer, &data_len, sizeof(buffer));
-        // if (receive_result != RK_SUCCESS) {
-        //     if (message_count > 0) {
-        //         printf("INFO: Connection closed after receiving messages");
-        //         break; // 正常结束，已经收到一些消息
-        //     } else {
-        //         printf("ERROR: Failed to receive any messages");
-        //         return RK_FAILURE;
-        //     }
-        // }
-        printf("bayes[msg_type]:0x%02X",MSG_TEXT_DATA);
-        if(msg_type == MSG_TEXT_DATA)
-        {
-            if(strncmp(buffer, "结束录音",8) == 0)
-            {
+        SOCKET_MSG_S *msg = socket_queue_pop(&g_stCtrlQueue, SOCKET_CONTROL_TIMEOUT_MS);
+        RK_BOOL is_end;
+
+        if (!msg) {
+            if (!socket_io_is_connected(&g_stIoLoop)) {
+                // 连接断开，结束本次录音
                 gGpioPressed = RK_FALSE;
-                return RK_SUCCESS;    
+                return RK_SUCCESS;
             }
+            continue;
         }
-        else
-        {
-            printf("ERROR: [DEBUG-TOOLARGE] start 录音开始结束控制只接收文字消息");
-            return RK_FAILURE;
+        is_end = (msg->data_len >= 8 && strncmp((const char *)msg->data, "结束录音", 8) == 0) ? RK_TRUE : RK_FALSE;
+        socket_msg_free(msg);
+        if (is_end) {
+            gGpioPressed = RK_FALSE;
+            return RK_SUCCESS;
         }
+        printf("INFO: 录音中收到重复的开始录音消息，忽略\n");
     }
     return RK_SUCCESS; 
 }
@@ -3266,9 +4155,9 @@ int main(int argc, const char **argv) {
     // 默认参数
     ctx->outputFilePath = "/tmp/my_recording.pcm";
     ctx->s32RecordSeconds = 10;
-    ctx->s32DeviceSampleRate = 16000;
-    ctx->s32SampleRate = 16000;
-    ctx->s32DeviceChannel = 2;  // 硬件双通道输入
+    ctx->s32DeviceSampleRate = 0;   // 声卡采样率，0=与上传格式相同（不转换）
+    ctx->s32SampleRate = 16000;     // 上传采样率（在MSG_CONFIG中声明）
+    ctx->s32DeviceChannel = 0;      // 声卡声道数，0=与上传格式相同
     ctx->s32Channel = 1;        // 输出单通道（避免采样率翻倍问题）
     ctx->s32BitWidth = 16;
     ctx->s32DevId = 0;
@@ -3280,6 +4169,9 @@ int main(int argc, const char **argv) {
     ctx->s32VqeEnable = 0;
     ctx->s32SetVolume = 100;
     ctx->s32EnableUpload = 1;                           // 默认不启用上传
+    ctx->s32LiveUpload = 1;                             // 默认边录边传
+    ctx->voiceCodec = "ima_adpcm";                      // 提议的上行编码（数据量为PCM的1/4，服务器确认前按PCM上传）
+    ctx->audioFormat = "mp3";                           // 默认下行MP3，本地ADEC解码
     ctx->serverHost = "10.10.10.65";                       // 默认服务器地址
     ctx->serverPort = 8082;                             // 默认服务器端口（与SocketServer一致）
     ctx->responseFormat = "json";                         // 默认响应格式
@@ -3363,6 +4255,20 @@ int main(int argc, const char **argv) {
         {"server",   required_argument, 0, 's'},
         {"port",  required_argument, 0, 'p'},
         {"recordtime",  required_argument, 0, 'r'},
+        {"file-upload", no_argument, 0, 'F'},
+        {"codec", required_argument, 0, 'C'},
+        {"ao-idle-ms", required_argument, 0, 'I'},
+        {"ai-idle", required_argument, 0, 'M'},
+        {"preroll-ms", required_argument, 0, 'P'},
+        {"vad", required_argument, 0, 'V'},
+        {"vad-hangover-ms", required_argument, 0, 'H'},
+        {"kws", required_argument, 0, 'K'},
+        {"kws-threshold", required_argument, 0, 'W'},
+        {"audio-format", required_argument, 0, 'A'},
+        {"device-rate", required_argument, 0, 'D'},
+        {"device-channels", required_argument, 0, 'N'},
+        {"playback-rate", required_argument, 0, 'O'},
+        {"playback-channels", required_argument, 0, 'Q'},
         {0, 0, 0, 0}
     };
     int opt;
@@ -3379,6 +4285,62 @@ int main(int argc, const char **argv) {
             case 'r':
                 ctx->s32RecordSeconds = atoi(optarg);
                 break;
+            case 'F':
+                ctx->s32LiveUpload = 0;
+                break;
+            case 'C':
+                ctx->voiceCodec = optarg;
+                break;
+            case 'I':
+                g_s32AoIdleTimeoutMs = atoi(optarg);
+                break;
+            case 'M':
+                if (strcmp(optarg, "pause") == 0) {
+                    g_enAiIdleMode = AI_IDLE_PAUSE;
+                } else if (strcmp(optarg, "close") == 0) {
+                    g_enAiIdleMode = AI_IDLE_CLOSE;
+                } else {
+                    g_enAiIdleMode = AI_IDLE_KEEP;
+                }
+                break;
+            case 'P':
+                g_s32PrerollMs = atoi(optarg);
+                break;
+            case 'V':
+                if (strcmp(optarg, "off") == 0) {
+                    g_enVadMode = AI_VAD_OFF;
+                } else if (strcmp(optarg, "auto") == 0) {
+                    g_enVadMode = AI_VAD_AUTO;
+                } else {
+                    g_enVadMode = AI_VAD_TRIM;
+                }
+                break;
+            case 'H':
+                g_s32VadHangoverMs = atoi(optarg);
+                break;
+            case 'K':
+                g_pKwsTemplates = optarg;
+                break;
+            case 'W':
+                g_s32KwsThreshold = atoi(optarg);
+                break;
+            case 'A':
+                ctx->audioFormat = optarg;
+                break;
+            case 'D':
+                ctx->s32DeviceSampleRate = atoi(optarg);
+                break;
+            case 'N':
+                ctx->s32DeviceChannel = atoi(optarg);
+                break;
+            case 'O':
+                ctx->s32PlaybackSampleRate = atoi(optarg);
+                g_bPlaybackFormatFixed = RK_TRUE;
+                break;
+            case 'Q':
+                ctx->s32PlaybackChannels = atoi(optarg);
+                g_bPlaybackFormatFixed = RK_TRUE;
+                break;
             default:
                 abort();
         }
@@ -3388,10 +4350,19 @@ int main(int argc, const char **argv) {
         ctx->s32AutoConfig = 0;  // 禁用自动配置
     }
     // 否则保持默认值1（启用自动配置）
+    // 关键词检测需要录音通道在两次录音之间保持运行
+    if (g_pKwsTemplates && g_enAiIdleMode != AI_IDLE_KEEP) {
+        printf("WARNING: 关键词检测需要 --ai-idle keep，已切换\n");
+        g_enAiIdleMode = AI_IDLE_KEEP;
+    }
     
-    // 设置设备参数（保持兼容性）
-    ctx->s32DeviceSampleRate = ctx->s32SampleRate;
-    ctx->s32DeviceChannel = ctx->s32Channel;
+    // 未指定声卡格式时直接按上传格式采集（不做软件转换）
+    if (ctx->s32DeviceSampleRate <= 0) {
+        ctx->s32DeviceSampleRate = ctx->s32SampleRate;
+    }
+    if (ctx->s32DeviceChannel <= 0) {
+        ctx->s32DeviceChannel = ctx->s32Channel;
+    }
     
     // 显示配置信息
     printf("=== Audio Recorder Configuration ===\n");
@@ -3400,6 +4371,7 @@ int main(int argc, const char **argv) {
     printf("Duration: %s\n", ctx->s32RecordSeconds > 0 ? 
            (char[]){sprintf((char[32]){0}, "%d seconds", ctx->s32RecordSeconds), 0} : "infinite");
     printf("Sample rate: %d Hz\n", ctx->s32SampleRate);
+    printf("Device sample rate: %d Hz (input)\n", ctx->s32DeviceSampleRate);
     printf("Device channels: %d (input)\n", ctx->s32DeviceChannel);
     printf("Output channels: %d\n", ctx->s32Channel);
     printf("Bit width: %d\n", ctx->s32BitWidth);
@@ -3407,15 +4379,25 @@ int main(int argc, const char **argv) {
     printf("Volume: %d%%\n", ctx->s32SetVolume);
     printf("Auto config: %s\n", ctx->s32AutoConfig ? "enabled" : "disabled");
     printf("VQE: %s\n", ctx->s32VqeEnable ? "enabled" : "disabled");
+    printf("Capture idle mode: %s\n", g_enAiIdleMode == AI_IDLE_KEEP ? "keep" : (g_enAiIdleMode == AI_IDLE_PAUSE ? "pause" : "close"));
+    printf("Pre-roll: %d ms\n", g_s32PrerollMs);
+    printf("VAD: %s (hangover %d ms)\n",
+           g_enVadMode == AI_VAD_OFF ? "off" : (g_enVadMode == AI_VAD_TRIM ? "trim" : "auto"), g_s32VadHangoverMs);
+    printf("Keyword trigger: %s\n", g_pKwsTemplates ? g_pKwsTemplates : "disabled");
     printf("Socket Upload: %s\n", ctx->s32EnableUpload ? "enabled" : "disabled");
     if (ctx->s32EnableUpload) {
+        printf("Upload mode: %s\n", ctx->s32LiveUpload ? "live (while recording)" : "file (after release)");
+        printf("Voice codec: %s\n", ctx->voiceCodec);
+        printf("Audio format: %s\n", ctx->audioFormat);
         printf("Server host: %s\n", ctx->serverHost);
         printf("Server port: %d\n", ctx->serverPort);
         printf("Response format: %s\n", ctx->responseFormat);
         printf("Streaming playback: %s\n", ctx->s32EnableStreaming ? "enabled" : "disabled");
         if (ctx->s32EnableStreaming) {
-            printf("Playback rate: %d Hz\n", ctx->s32PlaybackSampleRate);
+            printf("Playback rate: %d Hz%s\n", ctx->s32PlaybackSampleRate,
+                   g_bPlaybackFormatFixed ? " (fixed, server audio resampled)" : "");
             printf("Playback channels: %d\n", ctx->s32PlaybackChannels);
+            printf("Playback device idle timeout: %d ms\n", g_s32AoIdleTimeoutMs);
         }
     }
     printf("Expected data rate: %d bytes/sec\n", ctx->s32SampleRate * ctx->s32Channel * (ctx->s32BitWidth/8));
@@ -3465,53 +4447,111 @@ int main(int argc, const char **argv) {
     setenv("rt_log_level", "6", 1);  // 设置最高日志级别以减少输出
     // 初始化系统
     RK_MPI_SYS_Init();
-    // 设置音频设备
-    result = setup_audio_device(ctx);
-    if (result != RK_SUCCESS) {
-        printf("ERROR: Failed to setup audio device");
-        goto cleanup;
+    // 声卡格式与上传格式不同时，每次取帧后在软件中转换
+    if (ctx->s32DeviceSampleRate != ctx->s32SampleRate || ctx->s32DeviceChannel != ctx->s32Channel) {
+        if (ctx->s32BitWidth != 16 ||
+            audio_resample_init(&g_stCaptureConv.stResample, ctx->s32DeviceSampleRate, ctx->s32DeviceChannel,
+                                ctx->s32SampleRate, ctx->s32Channel) != 0) {
+            printf("ERROR: 不支持的录音格式转换 %dHz/%dch -> %dHz/%dch\n", ctx->s32DeviceSampleRate,
+                   ctx->s32DeviceChannel, ctx->s32SampleRate, ctx->s32Channel);
+            result = RK_FAILURE;
+            goto cleanup;
+        }
+        g_stCaptureConv.bEnabled = RK_TRUE;
+        printf("🎙️ [DEBUG-RESAMPLE] 录音 %dHz/%dch -> 上传 %dHz/%dch (%d相 x %d抽头)\n",
+               ctx->s32DeviceSampleRate, ctx->s32DeviceChannel, ctx->s32SampleRate, ctx->s32Channel,
+               g_stCaptureConv.stResample.up, g_stCaptureConv.stResample.taps);
     }
-    // 自动配置音频参数（在设备初始化后）
-    auto_configure_audio(ctx);
-    // 设置音频通道
-    result = setup_audio_channel(ctx);
+    // 打开录音设备（设备、混音器、通道），之后由录音设备管理在多轮录音之间保持
+    result = ai_manager_open(ctx);
     if (result != RK_SUCCESS) {
-        printf("ERROR: Failed to setup audio channel");
         goto cleanup;
     }
-    //在这里连接到服务器拿到socketfd
-    while(RK_TRUE)
+    // 预录环按输出格式分配一次，之后录音线程只做拷贝
     {
-        ctx->sockfd = connect_to_socket_server(ctx->serverHost, ctx->serverPort);
-        if (ctx->sockfd >= 0) {
-            printf("sucess:connected to socket server");
-            break;
+        unsigned int frame_bytes = ctx->s32Channel * (ctx->s32BitWidth / 8);
+        unsigned int bytes = g_s32PrerollMs > 0 ? (unsigned int)g_s32PrerollMs * ctx->s32SampleRate / 1000 * frame_bytes : 0;
+
+        if (audio_preroll_init(&g_stPreroll, bytes, frame_bytes) != 0) {
+            printf("WARNING: 预录环分配失败，关闭预录\n");
         }
-        printf("failed:retry connecting to socket server,continue...");
-        usleep(10);
     }
-    
-    printf("INFO: Successfully connected to socket server:ctx->sockfd:%d",ctx->sockfd);
-
-    unsigned char header[5];
-    // while(1)
-    // {
-    //     ssize_t received_bytes = recv(ctx->sockfd, header, 5, MSG_WAITALL);
-    //     printf("INFO:%d,,%s",received_bytes,header);
-    //     printf("11111111111111111");
-    // }
-
-    //图片采集线程
-
-
+    // VAD缓冲区同样只分配一次，分析和裁剪都在录音线程中完成
+    if (g_enVadMode != AI_VAD_OFF) {
+        AUDIO_VAD_CONFIG_S stVadConfig;
 
+        audio_vad_default_config(&stVadConfig, ctx->s32SampleRate, ctx->s32Channel);
+        stVadConfig.hangover_ms = g_s32VadHangoverMs;
+        if (ctx->s32BitWidth == 16 && audio_vad_init(&g_stVad, &stVadConfig, capture_output, &g_stCapture) == 0) {
+            g_bVadReady = RK_TRUE;
+        } else {
+            printf("WARNING: VAD初始化失败，录音数据不做静音裁剪\n");
+        }
+    }
+    // 关键词触发的录音由VAD判断结束，没有VAD时只能等录音时长上限
+    if (g_pKwsTemplates) {
+        if (kws_open(ctx) == RK_SUCCESS) {
+            g_bKwsReady = RK_TRUE;
+            if (!g_bVadReady) {
+                printf("WARNING: 未启用VAD，关键词触发的录音要到录音时长上限才结束\n");
+            }
+        } else {
+            printf("WARNING: 关键词检测初始化失败，只响应服务器的开始录音消息\n");
+        }
+    }
+    // 初始化上行语音编码器：先用PCM，服务器确认支持ctx->voiceCodec后再切换；本地不支持时只用PCM
+    {
+        int codec = audio_codec_from_name(ctx->voiceCodec);
+        if (codec < 0 || audio_encoder_init(&g_stVoiceEncoder, (AUDIO_CODEC_TYPE_E)codec,
+                                            ctx->s32SampleRate, ctx->s32Channel) != 0) {
+            printf("WARNING: 语音编码 %s 不可用，使用PCM上传\n", ctx->voiceCodec);
+            codec = AUDIO_CODEC_PCM;
+        } else {
+            audio_encoder_deinit(&g_stVoiceEncoder);
+        }
+        g_enVoiceCodecWanted = (AUDIO_CODEC_TYPE_E)codec;
+        audio_encoder_init(&g_stVoiceEncoder, AUDIO_CODEC_PCM, ctx->s32SampleRate, ctx->s32Channel);
+    }
+    // 下行MP3需要ADEC支持，不可用时让服务器继续发送PCM
+    if (strcmp(ctx->audioFormat, "mp3") == 0) {
+        if (mp3_decoder_probe() == RK_SUCCESS) {
+            g_stMp3Dec.bEnabled = RK_TRUE;
+        } else {
+            printf("WARNING: MP3解码不可用，使用PCM下行\n");
+        }
+    }
+    // 启动播放线程
+    if (audio_ring_init(&g_stPlaybackRing, PLAYBACK_RING_SIZE) != 0) {
+        printf("ERROR: Failed to allocate playback ring");
+        result = RK_FAILURE;
+        goto cleanup;
+    }
+    audio_jitter_init(&g_stPlaybackJitter, PLAYBACK_PREBUFFER_MIN_MS, PLAYBACK_PREBUFFER_MAX_MS);
+    g_playbackThreadRunning = RK_TRUE;
+    if (pthread_create(&g_playbackThread, NULL, playback_thread, NULL) != 0) {
+        printf("ERROR: Failed to start playback thread");
+        g_playbackThreadRunning = RK_FALSE;
+        result = RK_FAILURE;
+        goto cleanup;
+    }
+    // 启动I/O线程：独占服务器连接，负责收发、心跳（timerfd）和断线重连
+    socket_queue_init(&g_stCtrlQueue);
+    socket_queue_init(&g_stRespQueue);
+    if (socket_io_start(&g_stIoLoop, ctx->serverHost, ctx->serverPort, CLIENT_HEARTBEAT_MS, MSG_CLIENT_HEART,
+                        client_dispatch_frame, client_connection_state, ctx) != 0) {
+        printf("ERROR: Failed to start socket I/O thread");
+        result = RK_FAILURE;
+        goto cleanup;
+    }
+    socket_io_wait_connected(&g_stIoLoop, -1);
+    printf("INFO: Successfully connected to socket server\n");
 
-    //心跳包断开重连机制，线程重复的向服务端发送，服务端
-    pthread_t clientHeartThread;
-    printf("INFO: Starting client heart thread start...\n");
-    pthread_create(&clientHeartThread, NULL, clientHeart_thread, (void *)ctx);
-    printf("INFO: waitting client heart thread complete...\n");
-    
+    // GPIO触发模式：采集线程持续取帧，等待响应和播放期间也能预录和检测关键词
+    if (ctx->s32EnableGpioTrigger && capture_thread_start(ctx) != RK_SUCCESS) {
+        printf("ERROR: Failed to create capture thread\n");
+        result = RK_FAILURE;
+        goto cleanup;
+    }
 
     // 创建录音线程
     pthread_create(&recordingThread, NULL, recording_thread, (void *)ctx);
@@ -3532,13 +4572,38 @@ int main(int argc, const char **argv) {
         pthread_join(gpioThread, NULL);
         //ssize_t resgpio = pthread_detach(gpioThread);
     }
-    //pthread_join(clientHeartThread, NULL);
 cleanup:
+    // 先停采集线程，之后才能关闭录音设备
+    capture_thread_stop();
     if (ctx) {
         cleanup_audio(ctx);
         free(ctx);
     }
     
+    // 停止I/O线程
+    socket_io_stop(&g_stIoLoop);
+    
+    // 停止播放线程
+    if (g_playbackThreadRunning) {
+        g_playbackThreadRunning = RK_FALSE;
+        pthread_join(g_playbackThread, NULL);
+    }
+    audio_ring_deinit(&g_stPlaybackRing);
+    audio_preroll_deinit(&g_stPreroll);
+    if (g_bVadReady) {
+        audio_vad_deinit(&g_stVad);
+        g_bVadReady = RK_FALSE;
+    }
+    if (g_bKwsReady) {
+        audio_kws_deinit(&g_stKws);
+        g_bKwsReady = RK_FALSE;
+    }
+    mp3_decoder_close();
+    cleanup_audio_playback();
+    audio_convert_close(&g_stCaptureConv);
+    audio_convert_close(&g_stPlaybackConv);
+    audio_encoder_deinit(&g_stVoiceEncoder);
+    
     // 清理互斥锁
     pthread_mutex_destroy(&gAudioStateMutex);
     
@@ -45,12 +45,15 @@
 #include "rk_mpi_mb.h"
 #include <getopt.h>
 #include "test_comm_argparse.h"
+#include "socket_protocol.h"
 
 // Socket协议相关定义
 #define SOCKET_BUFFER_SIZE (8192)
 #define AUDIO_PLAY_BUFFER_SIZE (655360)  // 增大到64KB，支持大的音频数据包
 #define SOCKET_REQUEST_BUFFER_SIZE (16384)
 #define SOCKET_RESPONSE_BUFFER_SIZE (655360)  // 增大到64KB，支持更大的音频数据包
+#define SOCKET_CONTROL_TIMEOUT_MS   (30000)   // 等待开始/结束录音控制消息超时
+#define SOCKET_RESPONSE_TIMEOUT_MS  (80000)   // 等待AI响应消息超时
 
 // Socket协议消息类型定义（与Python SocketClient保持一致）
 #define MSG_VOICE_START     0x01    // 开始语音传输
@@ -85,6 +88,12 @@ static pthread_mutex_t gAudioStateMutex = PTHREAD_MUTEX_INITIALIZER;  // 音频
 static volatile RK_BOOL gInterruptAIResponse = RK_FALSE;
 static volatile RK_BOOL gAIResponseActive = RK_FALSE; // 新增：AI响应进行中标志
 
+// 接收侧增量帧解析器（所有接收路径共用，保证同一连接的字节流只被一个解析器消费）
+static SOCKET_FRAME_PARSER_S g_stRecvParser;
+static pthread_mutex_t g_recvParserMutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_recvParserFd = -1;
+static pthread_mutex_t g_sendMutex = PTHREAD_MUTEX_INITIALIZER;   // 发送锁，保证整帧写入不被其他线程打断
+
 typedef struct _MyRecorderCtx {
     const char *outputFilePath;
     RK_S32      s32RecordSeconds;
@@ -164,7 +173,8 @@ static RK_S32 cleanup_audio_playback(void);
 static void query_playback_status(void);
 static RK_S32 play_audio_buffer(MY_RECORDER_CTX_S *ctx, const void *audio_data, size_t data_len);
 static RK_S32 socket_send_message(int sockfd, unsigned char msg_type, const void *data, unsigned int data_len);
-static RK_S32 socket_receive_message(int sockfd, unsigned char *msg_type, void *data, unsigned int *data_len, unsigned int max_len);
+static RK_S32 socket_receive_message(int sockfd, unsigned char *msg_type, void *data, unsigned int *data_len,
+                                     unsigned int max_len, int timeout_ms);
 static RK_S32 process_received_message(MY_RECORDER_CTX_S *ctx, unsigned char msg_type, const void *data, unsigned int data_len);
 static void socket_log_with_time(const char *message);
 static AUDIO_SOUND_MODE_E find_sound_mode(RK_S32 ch);
@@ -218,368 +228,116 @@ static void socket_log_with_time(const char *message) {
 }
 
 // Socket协议：打包消息
+// 帧头和数据通过一次sendmsg发出；多线程（心跳/录音）共用连接，用锁保证帧不交错
 static RK_S32 socket_send_message(int sockfd, unsigned char msg_type, const void *data, unsigned int data_len) {
-    unsigned char header[5];
-    ssize_t sent_bytes;
-    
-    // 构建消息头：消息类型(1字节) + 数据长度(4字节，网络字节序)
-    header[0] = msg_type;
-    header[1] = (data_len >> 24) & 0xFF;
-    header[2] = (data_len >> 16) & 0xFF;
-    header[3] = (data_len >> 8) & 0xFF;
-    header[4] = data_len & 0xFF;
-    
+    int ret;
+
     printf("📤 发送消息: 类型=0x%02X, 数据长度=%u\n", msg_type, data_len);
     fflush(stdout);
-    
-    // 发送消息头
-    sent_bytes = send(sockfd, header, 5, 0);
-    if (sent_bytes != 5) {
-        printf("❌ 发送消息头失败\n");
+
+    pthread_mutex_lock(&g_sendMutex);
+    ret = socket_send_frame(sockfd, msg_type, data, data_len);
+    pthread_mutex_unlock(&g_sendMutex);
+
+    if (ret != 0) {
+        printf("❌ 发送消息失败: %s\n", strerror(errno));
         fflush(stdout);
         return RK_FAILURE;
     }
-    
-    // 发送数据（如果有的话）
-    if (data_len > 0 && data != NULL) {
-        sent_bytes = send(sockfd, data, data_len, 0);
-        if (sent_bytes != (ssize_t)data_len) {
-            printf("❌ 发送消息数据失败\n");
-            fflush(stdout);
-            return RK_FAILURE;
-        }
-    }
-    
+
     printf("✅ 消息发送成功\n");
     fflush(stdout);
     return RK_SUCCESS;
 }
 
 
-static RK_S32 socket_receive_message_msg_press(int sockfd, unsigned char *msg_type, void *data, unsigned int *data_len, unsigned int max_len)
-{
-    unsigned char header[5];
-    ssize_t received_bytes;
-    unsigned int payload_len;
-    
-    // === 添加接收开始时间记录 ===
-    struct timeval recv_start, recv_end, select_start, select_end;
-    gettimeofday(&recv_start, NULL);
-    
-    // 设置接收超时
-    struct timeval timeout;
-    timeout.tv_sec = 30;  // 30秒超时
-    timeout.tv_usec = 0;
-    
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(sockfd, &readfds);
-    
-    // === 监控select等待时间 ===
-    gettimeofday(&select_start, NULL);
-    printf("📡 [DEBUG-SELECT] 开始等待socket开始录音数据...\n");
-    
-    // 检查socket是否有数据可读
-    int select_result = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
+// Socket协议：解包消息
+// 基于增量帧解析器：一次recv可取回多个帧，后续调用直接从缓冲区返回，不再每帧select+两次recv
+static RK_S32 socket_receive_message(int sockfd, unsigned char *msg_type, void *data, unsigned int *data_len,
+                                     unsigned int max_len, int timeout_ms) {
+    SOCKET_FRAME_S frame;
+    int ret;
 
-    long select_time = (select_end.tv_sec - select_start.tv_sec) * 1000 + 
-                       (select_end.tv_usec - select_start.tv_usec) / 1000;
-    
-    if (select_result <= 0) {
-        if (select_result == 0) {
-            printf("WARNING: [DEBUG-TIMEOUT] Socket receive timeout (30s), select耗时:%ldms\n", select_time);
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-SELECTERR] Socket select failed, select耗时:%ldms\n", select_time);
-            fflush(stdout);
-        }
-        return RK_FAILURE;
+    // 连接重建后丢弃旧连接残留的数据
+    if (sockfd != g_recvParserFd) {
+        pthread_mutex_lock(&g_recvParserMutex);
+        socket_parser_reset(&g_stRecvParser);
+        g_recvParserFd = sockfd;
+        pthread_mutex_unlock(&g_recvParserMutex);
     }
 
-     // 接收消息头（5字节）
-    received_bytes = recv(sockfd, header, 5, MSG_WAITALL);
-
-    if (received_bytes != 5) {
-        if (received_bytes == 0) {
-            printf("INFO: [DEBUG-CLOSED] Server closed connection gracefully, header接收耗时:%ldms\n");
-            fflush(stdout);
-        } else if (received_bytes < 0) {
-            printf("ERROR: [DEBUG-RECVERR] Socket receive error, header接收耗时:%ldms\n");
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-PARTIAL] Partial header received: %zd/5 bytes, header接收耗时:%ldms\n");
-            fflush(stdout);
+    while (1) {
+        struct pollfd pfd;
+
+        pthread_mutex_lock(&g_recvParserMutex);
+        ret = socket_parser_next(&g_stRecvParser, &frame);
+        if (ret == SOCKET_PARSE_NEED_MORE) {
+            // 非阻塞读入当前所有可读数据，再尝试解析
+            ssize_t n = socket_parser_fill(&g_stRecvParser, sockfd);
+            if (n == SOCKET_PARSE_CLOSED || n == SOCKET_PARSE_ERROR) {
+                ret = (int)n;
+            } else if (n > 0) {
+                ret = socket_parser_next(&g_stRecvParser, &frame);
+            }
         }
-        return RK_FAILURE;
-    }
-    // 解析消息头
-    *msg_type = header[0];
-    payload_len = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4];
-    printf("INFO: [DEBUG-MSG] Received message: type=0x%02X, data_length=%u\n", *msg_type, payload_len);
-    fflush(stdout);
-    
-    // 检查数据长度是否合理
-    if (payload_len > max_len) {
-        printf("ERROR: [DEBUG-TOOLARGE] Data length too large: %u > %u\n", payload_len, max_len);
-        fflush(stdout);
-        return RK_FAILURE;
-    }
-    *data_len = payload_len;
-    // === 监控payload接收时间 ===
-    struct timeval payload_start, payload_end;
-    
-    // 接收数据（如果有的话）
-    if (payload_len > 0) {
-        gettimeofday(&payload_start, NULL);
-        printf("📡 [DEBUG-PAYLOAD] 开始接收payload: %u字节\n", payload_len);
-        
-        received_bytes = recv(sockfd, data, payload_len, MSG_WAITALL);
-        
-        gettimeofday(&payload_end, NULL);
-        long payload_time = (payload_end.tv_sec - payload_start.tv_sec) * 1000 + 
-                           (payload_end.tv_usec - payload_start.tv_usec) / 1000;
-        
-        if (received_bytes != (ssize_t)payload_len) {
-            printf("ERROR: [DEBUG-PAYLOADFAIL] Failed to receive message data: %zd/%u bytes, payload接收耗时:%ldms\n", 
-                   received_bytes, payload_len, payload_time);
-            fflush(stdout);
-            return RK_FAILURE;
-        }     
-    }
-    return RK_SUCCESS;
-}
-
-static RK_S32 socket_receive_message_msg_release(int sockfd, unsigned char *msg_type, void *data, unsigned int *data_len, unsigned int max_len)
-{
-    unsigned char header[5];
-    ssize_t received_bytes;
-    unsigned int payload_len;
-    
-    // === 添加接收开始时间记录 ===
-    struct timeval recv_start, recv_end, select_start, select_end;
-    gettimeofday(&recv_start, NULL);
-    
-    // 设置接收超时
-    struct timeval timeout;
-    timeout.tv_sec = 30;  // 30秒超时
-    timeout.tv_usec = 0;
-    
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(sockfd, &readfds);
-    
-    // === 监控select等待时间 ===
-    gettimeofday(&select_start, NULL);
-    printf("📡 [DEBUG-SELECT] 开始等待socket结束录音数据...\n");
-    
-    // 检查socket是否有数据可读
-    int select_result = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
+        if (ret == SOCKET_PARSE_FRAME) {
+            if (frame.data_len > max_len) {
+                pthread_mutex_unlock(&g_recvParserMutex);
+                printf("ERROR: [DEBUG-TOOLARGE] Data length too large: %u > %u\n", frame.data_len, max_len);
+                fflush(stdout);
+                return RK_FAILURE;
+            }
+            *msg_type = frame.msg_type;
+            *data_len = frame.data_len;
+            if (frame.data_len > 0) {
+                memcpy(data, frame.data, frame.data_len);
+            }
+            pthread_mutex_unlock(&g_recvParserMutex);
 
-    long select_time = (select_end.tv_sec - select_start.tv_sec) * 1000 + 
-                       (select_end.tv_usec - select_start.tv_usec) / 1000;
-    
-    if (select_result <= 0) {
-        if (select_result == 0) {
-            printf("WARNING: [DEBUG-TIMEOUT] Socket receive timeout (30s), select耗时:%ldms\n", select_time);
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-SELECTERR] Socket select failed, select耗时:%ldms\n", select_time);
+            printf("INFO: [DEBUG-MSG] Received message: type=0x%02X, data_length=%u\n", *msg_type, *data_len);
             fflush(stdout);
+            return RK_SUCCESS;
         }
-        return RK_FAILURE;
-    }
-
-     // 接收消息头（5字节）
-    received_bytes = recv(sockfd, header, 5, MSG_WAITALL);
+        pthread_mutex_unlock(&g_recvParserMutex);
 
-    if (received_bytes != 5) {
-        if (received_bytes == 0) {
-            printf("INFO: [DEBUG-CLOSED] Server closed connection gracefully, header接收耗时:%ldms\n");
-            fflush(stdout);
-        } else if (received_bytes < 0) {
-            printf("ERROR: [DEBUG-RECVERR] Socket receive error, header接收耗时:%ldms\n");
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-PARTIAL] Partial header received: %zd/5 bytes, header接收耗时:%ldms\n");
+        if (ret == SOCKET_PARSE_CLOSED) {
+            printf("INFO: [DEBUG-CLOSED] Server closed connection gracefully\n");
             fflush(stdout);
+            return RK_FAILURE;
         }
-        return RK_FAILURE;
-    }
-    // 解析消息头
-    *msg_type = header[0];
-    payload_len = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4];
-    printf("INFO: [DEBUG-MSG] Received message: type=0x%02X, data_length=%u\n", *msg_type, payload_len);
-    fflush(stdout);
-    
-    // 检查数据长度是否合理
-    if (payload_len > max_len) {
-        printf("ERROR: [DEBUG-TOOLARGE] Data length too large: %u > %u\n", payload_len, max_len);
-        fflush(stdout);
-        return RK_FAILURE;
-    }
-    *data_len = payload_len;
-    // === 监控payload接收时间 ===
-    struct timeval payload_start, payload_end;
-    
-    // 接收数据（如果有的话）
-    if (payload_len > 0) {
-        gettimeofday(&payload_start, NULL);
-        printf("📡 [DEBUG-PAYLOAD] 开始接收payload: %u字节\n", payload_len);
-        
-        received_bytes = recv(sockfd, data, payload_len, MSG_WAITALL);
-        
-        gettimeofday(&payload_end, NULL);
-        long payload_time = (payload_end.tv_sec - payload_start.tv_sec) * 1000 + 
-                           (payload_end.tv_usec - payload_start.tv_usec) / 1000;
-        
-        if (received_bytes != (ssize_t)payload_len) {
-            printf("ERROR: [DEBUG-PAYLOADFAIL] Failed to receive message data: %zd/%u bytes, payload接收耗时:%ldms\n", 
-                   received_bytes, payload_len, payload_time);
+        if (ret == SOCKET_PARSE_ERROR) {
+            printf("ERROR: [DEBUG-RECVERR] Socket receive error: %s\n", strerror(errno));
             fflush(stdout);
             return RK_FAILURE;
-        }     
-    }
-    return RK_SUCCESS;
-}
-
-
-// Socket协议：解包消息
-static RK_S32 socket_receive_message(int sockfd, unsigned char *msg_type, void *data, unsigned int *data_len, unsigned int max_len) {
-    unsigned char header[5];
-    ssize_t received_bytes;
-    unsigned int payload_len;
-    
-    // === 添加接收开始时间记录 ===
-    struct timeval recv_start, recv_end, select_start, select_end;
-    gettimeofday(&recv_start, NULL);
-    
-    // 设置接收超时
-    struct timeval timeout;
-    timeout.tv_sec = 30;  // 30秒超时
-    timeout.tv_usec = 0;
-    
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(sockfd, &readfds);
-    
-    // === 监控select等待时间 ===
-    gettimeofday(&select_start, NULL);
-    printf("📡 [DEBUG-SELECT] 开始等待socket数据...\n");
-    
-    // 检查socket是否有数据可读
-    int select_result = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
-    
-    gettimeofday(&select_end, NULL);
-    long select_time = (select_end.tv_sec - select_start.tv_sec) * 1000 + 
-                       (select_end.tv_usec - select_start.tv_usec) / 1000;
-    
-    if (select_result <= 0) {
-        if (select_result == 0) {
-            printf("WARNING: [DEBUG-TIMEOUT] Socket receive timeout (30s), select耗时:%ldms\n", select_time);
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-SELECTERR] Socket select failed, select耗时:%ldms\n", select_time);
-            fflush(stdout);
         }
-        return RK_FAILURE;
-    }
-    
-    printf("📡 [DEBUG-SELECTOK] Socket数据就绪, select耗时:%ldms\n", select_time);
-    
-    // === 监控header接收时间 ===
-    struct timeval header_start, header_end;
-    gettimeofday(&header_start, NULL);
-    
-    // 接收消息头（5字节）
-    received_bytes = recv(sockfd, header, 5, MSG_WAITALL);
-    
-    gettimeofday(&header_end, NULL);
-    long header_time = (header_end.tv_sec - header_start.tv_sec) * 1000 + 
-                       (header_end.tv_usec - header_start.tv_usec) / 1000;
-    
-    if (received_bytes != 5) {
-        if (received_bytes == 0) {
-            printf("INFO: [DEBUG-CLOSED] Server closed connection gracefully, header接收耗时:%ldms\n", header_time);
-            fflush(stdout);
-        } else if (received_bytes < 0) {
-            printf("ERROR: [DEBUG-RECVERR] Socket receive error, header接收耗时:%ldms\n", header_time);
-            fflush(stdout);
-        } else {
-            printf("ERROR: [DEBUG-PARTIAL] Partial header received: %zd/5 bytes, header接收耗时:%ldms\n", 
-                   received_bytes, header_time);
+
+        // 没有完整帧，等待socket可读（不持有解析器锁）
+        pfd.fd = sockfd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, timeout_ms);
+        if (ret == 0) {
+            unsigned char partial_type;
+            unsigned int have = 0, total = 0;
+            int has_partial;
+            pthread_mutex_lock(&g_recvParserMutex);
+            has_partial = socket_parser_partial(&g_stRecvParser, &partial_type, &have, &total);
+            pthread_mutex_unlock(&g_recvParserMutex);
+            if (has_partial) {
+                printf("WARNING: [DEBUG-TIMEOUT] Socket receive timeout (%dms), 未完成帧: type=0x%02X %u/%u字节\n",
+                       timeout_ms, partial_type, have, total);
+            } else {
+                printf("WARNING: [DEBUG-TIMEOUT] Socket receive timeout (%dms)\n", timeout_ms);
+            }
             fflush(stdout);
+            return RK_FAILURE;
         }
-        return RK_FAILURE;
-    }
-    
-    if (header_time > 1) {
-        printf("📡 [DEBUG-HEADERTIME] Header接收耗时: %ldms\n", header_time);
-    }
-    
-    // 解析消息头
-    *msg_type = header[0];
-    payload_len = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4];
-    
-    printf("INFO: [DEBUG-MSG] Received message: type=0x%02X, data_length=%u\n", *msg_type, payload_len);
-    fflush(stdout);
-    
-    // 检查数据长度是否合理
-    if (payload_len > max_len) {
-        printf("ERROR: [DEBUG-TOOLARGE] Data length too large: %u > %u\n", payload_len, max_len);
-        fflush(stdout);
-        return RK_FAILURE;
-    }
-    
-    *data_len = payload_len;
-    
-    // === 监控payload接收时间 ===
-    struct timeval payload_start, payload_end;
-    
-    // 接收数据（如果有的话）
-    if (payload_len > 0) {
-        gettimeofday(&payload_start, NULL);
-        printf("📡 [DEBUG-PAYLOAD] 开始接收payload: %u字节\n", payload_len);
-        
-        received_bytes = recv(sockfd, data, payload_len, MSG_WAITALL);
-        
-        gettimeofday(&payload_end, NULL);
-        long payload_time = (payload_end.tv_sec - payload_start.tv_sec) * 1000 + 
-                           (payload_end.tv_usec - payload_start.tv_usec) / 1000;
-        
-        if (received_bytes != (ssize_t)payload_len) {
-            printf("ERROR: [DEBUG-PAYLOADFAIL] Failed to receive message data: %zd/%u bytes, payload接收耗时:%ldms\n", 
-                   received_bytes, payload_len, payload_time);
+        if (ret < 0 && errno != EINTR) {
+            printf("ERROR: [DEBUG-SELECTERR] Socket poll failed: %s\n", strerror(errno));
             fflush(stdout);
             return RK_FAILURE;
         }
-        
-        // 计算接收速度
-        if (payload_time > 0) {
-            long payload_speed = payload_len * 1000 / payload_time; // bytes/sec
-            printf("📡 [DEBUG-PAYLOADOK] Payload接收完成: %u字节, 耗时:%ldms, 速度:%ld字节/秒\n", 
-                   payload_len, payload_time, payload_speed);
-            
-            // 如果是音频数据且接收耗时较长，发出警告
-            if (*msg_type == MSG_AUDIO_DATA && payload_time > 10) {
-                printf("⚠️ [DEBUG-SLOWPAYLOAD] 音频数据接收较慢: %ldms > 10ms, 可能影响播放连续性\n", payload_time);
-            }
-        }
-    }
-    
-    // === 计算总接收时间 ===
-    gettimeofday(&recv_end, NULL);
-    long total_recv_time = (recv_end.tv_sec - recv_start.tv_sec) * 1000 + 
-                          (recv_end.tv_usec - recv_start.tv_usec) / 1000;
-    
-    printf("📡 [DEBUG-RECVDONE] 消息接收完成: 类型=0x%02X, 数据=%u字节, 总耗时:%ldms\n", 
-           *msg_type, payload_len, total_recv_time);
-    
-    // 如果总接收时间较长，发出警告
-    if (total_recv_time > 20) {
-        printf("⚠️ [DEBUG-SLOWRECV] 网络接收较慢: %ldms > 20ms, 可能阻塞音频播放\n", total_recv_time);
     }
-    
-    return RK_SUCCESS;
 }
 
 // 连接到Socket服务器
@@ -628,6 +386,8 @@ static int connect_to_socket_server(const char *host, int port) {
         return -1;
     }
     
+    // 关闭Nagle：小帧立即发出，批量发送时再用TCP_CORK合并
+    socket_set_nodelay(sockfd);
     printf("INFO: Successfully connected to server %s:%d\n", host, port);
     fflush(stdout);
     return sockfd;
@@ -1117,7 +877,8 @@ static RK_S32 receive_socket_response(MY_RECORDER_CTX_S *ctx) {
             printf("INFO: AI响应被用户抢话中断，立即进入录音\n");
             break;
         }
-        RK_S32 receive_result = socket_receive_message(ctx->sockfd, &msg_type, buffer, &data_len, sizeof(buffer));
+        RK_S32 receive_result = socket_receive_message(ctx->sockfd, &msg_type, buffer, &data_len, sizeof(buffer),
+                                                       SOCKET_RESPONSE_TIMEOUT_MS);
         
         if (receive_result != RK_SUCCESS) {
             if (message_count > 0) {
@@ -2489,83 +2250,17 @@ static void* clientHeart_thread(void* ptr)
 static void* recv_app(void* ptr)
 {
     MY_RECORDER_CTX_S *ctx = (MY_RECORDER_CTX_S *)ptr;
-    ssize_t sockfd = ctx->sockfd;
     unsigned char msg_type;
-    unsigned char header[5];
-    unsigned int payload_len;
     char buffer[SOCKET_RESPONSE_BUFFER_SIZE];
     unsigned int data_len;
-    // 设置接收超时
-    struct timeval timeout;
-    timeout.tv_sec = 30;  // 30秒超时
-    timeout.tv_usec = 0;
-    ssize_t max_len = sizeof(buffer);
-    //printf("[bayes->clientHeart_thread111111111111111111] \n");
     while(RK_TRUE)
     {
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        FD_SET(sockfd, &readfds);
-
-        int select_result = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
-        if (select_result <= 0)
-        {
-            if (select_result == 0) {
-            printf("WARNING: [DEBUG-TIMEOUT] Socket receive timeout (30s), select耗时:ms\n");
-            fflush(stdout);
-            } else 
-            {
-            printf("ERROR: [DEBUG-SELECTERR] Socket select failed, select耗时:%ldms\n");
-            fflush(stdout);
-            }
-            continue;     
-        }
-        
-        // 接收消息头（5字节）
-        ssize_t received_bytes = recv(sockfd, header, 5, MSG_WAITALL);
-
-        // 解析消息头
-        msg_type = header[0];
-        payload_len = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4];
-        printf("INFO: [DEBUG-MSG] Received message: type=0x%02X, data_length=%u\n", msg_type, payload_len);
-        fflush(stdout);
-        
-        // 检查数据长度是否合理
-        if (payload_len > max_len) {
-            printf("ERROR: [DEBUG-TOOLARGE] Data length too large: %u > %u\n", payload_len, max_len);
-            fflush(stdout);
+        // 解析器会一次读入所有可读数据，已缓冲的完整帧直接返回，不再阻塞
+        if (socket_receive_message(ctx->sockfd, &msg_type, buffer, &data_len, sizeof(buffer),
+                                   SOCKET_CONTROL_TIMEOUT_MS) != RK_SUCCESS) {
+            usleep(100000); // 超时或连接断开，等待心跳线程重连
             continue;
         }
-        data_len = payload_len;
-        // === 监控payload接收时间 ===
-        struct timeval payload_start, payload_end;
-        // 接收数据（如果有的话）
-        if (payload_len > 0) {
-            gettimeofday(&payload_start, NULL);
-            printf("📡 [DEBUG-PAYLOAD] 开始接收payload: %u字节\n", payload_len);
-            received_bytes = recv(sockfd, buffer, payload_len, MSG_WAITALL);
-            gettimeofday(&payload_end, NULL);
-            long payload_time = (payload_end.tv_sec - payload_start.tv_sec) * 1000 + 
-                            (payload_end.tv_usec - payload_start.tv_usec) / 1000;
-            
-            if (received_bytes != (ssize_t)payload_len) {
-                printf("ERROR: [DEBUG-PAYLOADFAIL] Failed to receive message data: %zd/%u bytes, payload接收耗时:%ldms\n", 
-                    received_bytes, payload_len, payload_time);
-                fflush(stdout);
-                continue;
-            }
-            // 计算接收速度
-            if (payload_time > 0) {
-                long payload_speed = payload_len * 1000 / payload_time; // bytes/sec
-                printf("📡 [DEBUG-PAYLOADOK] Payload接收完成: %u字节, 耗时:%ldms, 速度:%ld字节/秒\n", 
-                    payload_len, payload_time, payload_speed);
-                
-                // 如果是音频数据且接收耗时较长，发出警告
-                if (msg_type == MSG_AUDIO_DATA && payload_time > 10) {
-                    printf("⚠️ [DEBUG-SLOWPAYLOAD] 音频数据接收较慢: %ldms > 10ms, 可能影响播放连续性\n", payload_time);
-                }
-            }
-        } 
         if(msg_type == MSG_TEXT_DATA)
         {
             //开始录音 
@@ -3073,7 +2768,11 @@ static RK_S32 wait_for_gpio_press(MY_RECORDER_CTX_S *ctx) {
         ssize_t received_bytes;
         //获取文件头，区分发送文件的内容
         //received_bytes = recv(ctx->sockfd, header, 5, 0);
-        RK_S32 receive_result = socket_receive_message_msg_press(ctx->sockfd, &msg_type, buffer, &data_len, sizeof(buffer));
+        RK_S32 receive_result = socket_receive_message(ctx->sockfd, &msg_type, buffer, &data_len, sizeof(buffer),
+                                                       SOCKET_CONTROL_TIMEOUT_MS);
+        if (receive_result != RK_SUCCESS) {
+            return RK_FAILURE;
+        }
         // if (receive_result != RK_SUCCESS) {
         //     if (message_count > 0) {
         //         printf("INFO: Connection closed after receiving messages");
@@ -3148,7 +2847,11 @@ static RK_S32 wait_for_gpio_release(MY_RECORDER_CTX_S *ctx) {
         ssize_t received_bytes;
         //获取文件头，区分发送文件的内容
         //received_bytes = recv(ctx->sockfd, header, 5, 0);
-        RK_S32 receive_result = socket_receive_message_msg_release(ctx->sockfd, &msg_type, buffer, &data_len, sizeof(buffer));
+        RK_S32 receive_result = socket_receive_message(ctx->sockfd, &msg_type, buffer, &data_len, sizeof(buffer),
+                                                       SOCKET_CONTROL_TIMEOUT_MS);
+        if (receive_result != RK_SUCCESS) {
+            return RK_FAILURE;
+        }
         // if (receive_result != RK_SUCCESS) {
         //     if (message_count > 0) {
         //         printf("INFO: Connection closed after receiving messages");
@@ -3434,6 +3137,12 @@ int main(int argc, const char **argv) {
         printf("ERROR: Failed to setup audio channel");
         goto cleanup;
     }
+    // 初始化接收帧解析器
+    if (socket_parser_init(&g_stRecvParser, SOCKET_PARSER_RING_SIZE, SOCKET_RESPONSE_BUFFER_SIZE) != 0) {
+        printf("ERROR: Failed to init socket frame parser");
+        result = RK_FAILURE;
+        goto cleanup;
+    }
     //在这里连接到服务器拿到socketfd
     ctx->sockfd = connect_to_socket_server(ctx->serverHost, ctx->serverPort);
      if (ctx->sockfd < 0) {
@@ -3489,6 +3198,7 @@ cleanup:
     
     // 清理互斥锁
     pthread_mutex_destroy(&gAudioStateMutex);
+    socket_parser_deinit(&g_stRecvParser);
     
     RK_MPI_SYS_Exit();
     return result;
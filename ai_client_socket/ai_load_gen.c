@@ -0,0 +1,699 @@
+/*
+ * 多连接负载发生器 - 按眼镜端的Socket协议压测AI服务器
+ *
+ * 单线程epoll同时维护N个连接，每个连接循环执行：
+ *   MSG_CONFIG（连接建立后一次） -> MSG_VOICE_START(轮次号) -> MSG_VOICE_DATA... -> MSG_VOICE_END
+ *   -> 等待 MSG_AI_START / 第一个MSG_AUDIO_DATA / MSG_AI_END -> 间隔think-ms后开始下一轮
+ * 语音数据从PCM语料（16位小端，采样率由--rate指定）中按顺序轮流取出，默认按实时速度分帧发送，
+ * --fast时一次发完。每轮记录从VOICE_END开始的三个延迟，结束后输出百分位统计表，
+ * 用于评估SocketServer的部署规模。
+ *
+ * 编译（主机或开发板，不依赖rockit）：
+ *   gcc -O2 -Wall -o ai_load_gen ai_load_gen.c socket_protocol.c -lm
+ * 本地配合模拟服务器：
+ *   python3 enhanced_mock_server.py --port 8082
+ *   ./ai_load_gen --server 127.0.0.1 --port 8082 --clients 20 --turns 5 --corpus ../mp3s/my_recording.pcm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#include "socket_protocol.h"
+
+// Socket协议消息类型定义（与ai_client_start_stop2.c保持一致）
+#define MSG_VOICE_START     0x01
+#define MSG_VOICE_DATA      0x02
+#define MSG_VOICE_END       0x03
+#define MSG_TEXT_DATA       0x04
+#define MSG_AUDIO_DATA      0x05
+#define MSG_AI_START        0x06
+#define MSG_AI_END          0x07
+#define MSG_AUDIO_START     0x08
+#define MSG_AUDIO_END       0x09
+#define MSG_ERROR           0x0A
+#define MSG_AI_CANCELLED    0x0B
+#define MSG_JSON_RESPONSE   0x0C
+#define MSG_CONFIG          0x0D
+#define MSG_AI_NEWCHAT      0x0E
+
+#define AUDIO_TURN_ID_SIZE      4
+#define AUDIO_END_MARKER_SIZE   8
+#define LOAD_MAX_CORPUS         16
+#define LOAD_CHUNK_MS           40          // 实时模式每帧语音时长，与设备端上传粒度一致
+#define LOAD_PARSER_RING_SIZE   (64 * 1024)
+#define LOAD_MAX_PAYLOAD        (1024 * 1024)
+#define LOAD_EPOLL_EVENTS       64
+
+static const unsigned char s_audio_end_marker[AUDIO_END_MARKER_SIZE] = {0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF};
+
+typedef enum _LoadConnState {
+    LOAD_CONN_IDLE = 0,     // 等待下一轮开始
+    LOAD_CONN_SENDING,      // 正在发送语音
+    LOAD_CONN_WAITING,      // 语音已发完，等待AI响应
+    LOAD_CONN_DONE,
+} LOAD_CONN_STATE_E;
+
+typedef struct _LoadCorpus {
+    unsigned char *data;
+    unsigned int   len;
+    const char    *path;
+} LOAD_CORPUS_S;
+
+typedef struct _LoadConn {
+    int                   id;
+    int                   fd;
+    LOAD_CONN_STATE_E     state;
+    SOCKET_FRAME_PARSER_S parser;
+    int                   turns_done;
+    unsigned int          turn_id;
+    int                   audio_tagged;     // 服务器已确认audio_turn_id_offer，音频帧带轮次号
+    const LOAD_CORPUS_S  *corpus;           // 本轮发送的语料
+    unsigned int          send_off;
+    double                next_ms;          // 下一次动作时间（开始一轮/发送下一帧/超时）
+    double                voice_end_ms;
+    double                ai_start_ms;
+    double                first_audio_ms;
+} LOAD_CONN_S;
+
+typedef struct _LoadSamples {
+    double *values;
+    int     count;
+} LOAD_SAMPLES_S;
+
+typedef struct _LoadConfig {
+    const char *host;
+    int         port;
+    int         clients;
+    int         turns;
+    int         think_ms;
+    int         ramp_ms;
+    int         timeout_ms;
+    int         rate;
+    int         fast;
+    const char *format;
+} LOAD_CONFIG_S;
+
+static volatile int g_running = 1;
+
+static LOAD_CONFIG_S g_stConfig;
+static LOAD_CORPUS_S g_astCorpus[LOAD_MAX_CORPUS];
+static int g_s32CorpusCount = 0;
+static int g_s32NextCorpus = 0;
+
+static LOAD_SAMPLES_S g_stAiStart;
+static LOAD_SAMPLES_S g_stFirstAudio;
+static LOAD_SAMPLES_S g_stAiEnd;
+static int g_s32TurnsOk = 0;
+static int g_s32TurnsTimeout = 0;
+static int g_s32TurnsError = 0;
+static int g_s32ConnsLost = 0;
+static unsigned long g_ulVoiceBytes = 0;
+static unsigned long g_ulAudioBytes = 0;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+static int load_corpus(const char *list) {
+    char *copy = strdup(list);
+    char *save = NULL;
+    char *path;
+
+    for (path = strtok_r(copy, ",", &save); path != NULL; path = strtok_r(NULL, ",", &save)) {
+        FILE *fp;
+        long size;
+        LOAD_CORPUS_S *item;
+
+        if (g_s32CorpusCount >= LOAD_MAX_CORPUS) {
+            printf("⚠️ [LOAD] 语料超过%d个，忽略 %s\n", LOAD_MAX_CORPUS, path);
+            continue;
+        }
+        fp = fopen(path, "rb");
+        if (fp == NULL) {
+            printf("❌ [LOAD] 无法打开语料 %s: %s\n", path, strerror(errno));
+            free(copy);
+            return -1;
+        }
+        fseek(fp, 0, SEEK_END);
+        size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        item = &g_astCorpus[g_s32CorpusCount];
+        item->len = (unsigned int)(size & ~1L);
+        item->data = malloc(item->len > 0 ? item->len : 1);
+        if (item->data == NULL || fread(item->data, 1, item->len, fp) != item->len) {
+            printf("❌ [LOAD] 读取语料失败 %s\n", path);
+            fclose(fp);
+            free(copy);
+            return -1;
+        }
+        fclose(fp);
+        item->path = strdup(path);
+        printf("📁 [LOAD] 语料 %s: %u 字节 (%.2fs)\n", path, item->len,
+               item->len / 2.0 / g_stConfig.rate);
+        g_s32CorpusCount++;
+    }
+    free(copy);
+    return g_s32CorpusCount > 0 ? 0 : -1;
+}
+
+static int samples_init(LOAD_SAMPLES_S *s, int capacity) {
+    s->values = calloc(capacity > 0 ? capacity : 1, sizeof(double));
+    s->count = 0;
+    return s->values != NULL ? 0 : -1;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// 最近秩法百分位（values已排序）
+static double percentile(const LOAD_SAMPLES_S *s, double p) {
+    int rank;
+
+    if (s->count == 0) {
+        return 0.0;
+    }
+    rank = (int)(p / 100.0 * s->count + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > s->count) {
+        rank = s->count;
+    }
+    return s->values[rank - 1];
+}
+
+static void print_samples(const char *name, LOAD_SAMPLES_S *s) {
+    double sum = 0.0;
+    int i;
+
+    if (s->count == 0) {
+        printf("%-14s %6d %8s %8s %8s %8s %8s %8s\n", name, 0, "-", "-", "-", "-", "-", "-");
+        return;
+    }
+    qsort(s->values, s->count, sizeof(double), compare_double);
+    for (i = 0; i < s->count; i++) {
+        sum += s->values[i];
+    }
+    printf("%-14s %6d %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", name, s->count, sum / s->count,
+           percentile(s, 50), percentile(s, 90), percentile(s, 95), percentile(s, 99),
+           s->values[s->count - 1]);
+}
+
+static int connect_server(const char *host, int port) {
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    char port_str[16];
+    int fd;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    if (getaddrinfo(host, port_str, &hints, &res) != 0 || res == NULL) {
+        return -1;
+    }
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    if (connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        close(fd);
+        freeaddrinfo(res);
+        return -1;
+    }
+    freeaddrinfo(res);
+    socket_set_nodelay(fd);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+static void conn_close(LOAD_CONN_S *conn, int epfd, int lost) {
+    if (conn->fd >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+        close(conn->fd);
+        conn->fd = -1;
+    }
+    if (lost) {
+        g_s32ConnsLost++;
+        if (conn->state == LOAD_CONN_SENDING || conn->state == LOAD_CONN_WAITING) {
+            g_s32TurnsError++;
+        }
+    }
+    conn->state = LOAD_CONN_DONE;
+}
+
+static int conn_send_config(LOAD_CONN_S *conn) {
+    char config_json[256];
+    int n;
+
+    n = snprintf(config_json, sizeof(config_json),
+                 "{\"response_format\": \"%s\", \"voice_codec\": \"pcm\", \"voice_sample_rate\": %d, "
+                 "\"voice_channels\": 1, \"audio_turn_id_offer\": true}",
+                 g_stConfig.format, g_stConfig.rate);
+    return socket_send_frame(conn->fd, MSG_CONFIG, config_json, (unsigned int)n);
+}
+
+static int conn_start_turn(LOAD_CONN_S *conn, double now) {
+    unsigned char turn_buf[AUDIO_TURN_ID_SIZE];
+
+    conn->turn_id = (unsigned int)conn->id * 100000u + (unsigned int)conn->turns_done + 1;
+    turn_buf[0] = (conn->turn_id >> 24) & 0xFF;
+    turn_buf[1] = (conn->turn_id >> 16) & 0xFF;
+    turn_buf[2] = (conn->turn_id >> 8) & 0xFF;
+    turn_buf[3] = conn->turn_id & 0xFF;
+    if (socket_send_frame(conn->fd, MSG_VOICE_START, turn_buf, sizeof(turn_buf)) != 0) {
+        return -1;
+    }
+    conn->corpus = &g_astCorpus[g_s32NextCorpus];
+    g_s32NextCorpus = (g_s32NextCorpus + 1) % g_s32CorpusCount;
+    conn->send_off = 0;
+    conn->voice_end_ms = 0.0;
+    conn->ai_start_ms = 0.0;
+    conn->first_audio_ms = 0.0;
+    conn->state = LOAD_CONN_SENDING;
+    conn->next_ms = now;
+    return 0;
+}
+
+// 发送下一段语音，发完后发送VOICE_END并开始计时
+static int conn_send_voice(LOAD_CONN_S *conn) {
+    unsigned int chunk_bytes = (unsigned int)(g_stConfig.rate / 1000 * LOAD_CHUNK_MS * 2);
+    const LOAD_CORPUS_S *corpus = conn->corpus;
+
+    if (g_stConfig.fast) {
+        SOCKET_OUT_FRAME_S frames[SOCKET_SEND_MAX_FRAMES];
+        int count = 0;
+
+        while (conn->send_off < corpus->len && count < SOCKET_SEND_MAX_FRAMES) {
+            unsigned int len = corpus->len - conn->send_off;
+
+            if (len > chunk_bytes) {
+                len = chunk_bytes;
+            }
+            frames[count].msg_type = MSG_VOICE_DATA;
+            frames[count].data = corpus->data + conn->send_off;
+            frames[count].data_len = len;
+            conn->send_off += len;
+            g_ulVoiceBytes += len;
+            count++;
+        }
+        if (count > 0 && socket_send_frames(conn->fd, frames, count) != 0) {
+            return -1;
+        }
+    } else if (conn->send_off < corpus->len) {
+        unsigned int len = corpus->len - conn->send_off;
+
+        if (len > chunk_bytes) {
+            len = chunk_bytes;
+        }
+        if (socket_send_frame(conn->fd, MSG_VOICE_DATA, corpus->data + conn->send_off, len) != 0) {
+            return -1;
+        }
+        conn->send_off += len;
+        g_ulVoiceBytes += len;
+        conn->next_ms += LOAD_CHUNK_MS;
+    }
+
+    if (conn->send_off >= corpus->len) {
+        if (socket_send_frame(conn->fd, MSG_VOICE_END, NULL, 0) != 0) {
+            return -1;
+        }
+        conn->voice_end_ms = now_ms();
+        conn->state = LOAD_CONN_WAITING;
+        conn->next_ms = conn->voice_end_ms + g_stConfig.timeout_ms;
+    }
+    return 0;
+}
+
+static void conn_finish_turn(LOAD_CONN_S *conn, double now, int ok) {
+    if (ok) {
+        if (conn->ai_start_ms > 0) {
+            g_stAiStart.values[g_stAiStart.count++] = conn->ai_start_ms - conn->voice_end_ms;
+        }
+        if (conn->first_audio_ms > 0) {
+            g_stFirstAudio.values[g_stFirstAudio.count++] = conn->first_audio_ms - conn->voice_end_ms;
+        }
+        g_stAiEnd.values[g_stAiEnd.count++] = now - conn->voice_end_ms;
+        g_s32TurnsOk++;
+    }
+    conn->turns_done++;
+    conn->state = LOAD_CONN_IDLE;
+    conn->next_ms = now + g_stConfig.think_ms;
+}
+
+// 服务器MSG_CONFIG回复中key是否为true
+static int config_reply_true(const unsigned char *data, unsigned int len, const char *key) {
+    char reply[256];
+    const char *p;
+
+    if (len >= sizeof(reply)) {
+        len = sizeof(reply) - 1;
+    }
+    memcpy(reply, data, len);
+    reply[len] = '\0';
+    p = strstr(reply, key);
+    if (!p) {
+        return 0;
+    }
+    p = strchr(p + strlen(key), ':');
+    while (p && (*p == ':' || *p == ' ')) {
+        p++;
+    }
+    return p && strncmp(p, "true", 4) == 0;
+}
+
+static void conn_handle_frame(LOAD_CONN_S *conn, const SOCKET_FRAME_S *frame, double now) {
+    const unsigned char *data = frame->data;
+    unsigned int len = frame->data_len;
+
+    if (frame->msg_type == MSG_CONFIG) {
+        // 服务器对audio_turn_id_offer的确认，之后的AUDIO_START/AUDIO_DATA/AUDIO_END都带轮次号
+        if (config_reply_true(data, len, "\"audio_turn_id_accepted\"")) {
+            conn->audio_tagged = 1;
+        }
+        return;
+    }
+    if (conn->state != LOAD_CONN_WAITING) {
+        return;     // 上一轮的残留帧或服务器主动推送的控制文本
+    }
+
+    switch (frame->msg_type) {
+        case MSG_AI_START:
+            if (conn->ai_start_ms == 0) {
+                conn->ai_start_ms = now;
+            }
+            break;
+        case MSG_AUDIO_DATA:
+            if (conn->audio_tagged && len >= AUDIO_TURN_ID_SIZE) {
+                data += AUDIO_TURN_ID_SIZE;
+                len -= AUDIO_TURN_ID_SIZE;
+            }
+            if (len == 0 || (len == AUDIO_END_MARKER_SIZE && memcmp(data, s_audio_end_marker, len) == 0)) {
+                break;
+            }
+            g_ulAudioBytes += len;
+            if (conn->first_audio_ms == 0) {
+                conn->first_audio_ms = now;
+            }
+            break;
+        case MSG_AI_END:
+            conn_finish_turn(conn, now, 1);
+            break;
+        case MSG_JSON_RESPONSE:
+            // JSON模式下SocketServer只回复一个JSON_RESPONSE，没有AI_START/AI_END
+            if (strcmp(g_stConfig.format, "json") == 0) {
+                if (conn->ai_start_ms == 0) {
+                    conn->ai_start_ms = now;
+                }
+                conn_finish_turn(conn, now, 1);
+            }
+            break;
+        case MSG_ERROR:
+            printf("⚠️ [LOAD] 连接%d 轮次%u 服务器错误: %.*s\n", conn->id, conn->turn_id, (int)len, (const char *)data);
+            g_s32TurnsError++;
+            conn_finish_turn(conn, now, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+static void conn_handle_input(LOAD_CONN_S *conn, int epfd) {
+    SOCKET_FRAME_S frame;
+    ssize_t n;
+    int ret;
+
+    for (;;) {
+        n = socket_parser_fill(&conn->parser, conn->fd);
+        if (n == SOCKET_PARSE_CLOSED || n == SOCKET_PARSE_ERROR) {
+            printf("⚠️ [LOAD] 连接%d 已断开 (已完成%d轮)\n", conn->id, conn->turns_done);
+            conn_close(conn, epfd, 1);
+            return;
+        }
+        while ((ret = socket_parser_next(&conn->parser, &frame)) == SOCKET_PARSE_FRAME) {
+            conn_handle_frame(conn, &frame, now_ms());
+        }
+        if (ret == SOCKET_PARSE_ERROR) {
+            printf("❌ [LOAD] 连接%d 协议错误\n", conn->id);
+            conn_close(conn, epfd, 1);
+            return;
+        }
+        if (n == SOCKET_PARSE_NEED_MORE) {
+            return;
+        }
+    }
+}
+
+// 处理到期的动作：开始新一轮、发送下一帧语音、响应超时
+static void conn_handle_timer(LOAD_CONN_S *conn, int epfd, double now) {
+    if (conn->state == LOAD_CONN_DONE || now < conn->next_ms) {
+        return;
+    }
+    switch (conn->state) {
+        case LOAD_CONN_IDLE:
+            if (conn->turns_done >= g_stConfig.turns || !g_running) {
+                conn_close(conn, epfd, 0);
+                return;
+            }
+            if (conn_start_turn(conn, now) != 0 || conn_send_voice(conn) != 0) {
+                conn_close(conn, epfd, 1);
+            }
+            break;
+        case LOAD_CONN_SENDING:
+            if (conn_send_voice(conn) != 0) {
+                conn_close(conn, epfd, 1);
+            }
+            break;
+        case LOAD_CONN_WAITING:
+            printf("⚠️ [LOAD] 连接%d 轮次%u 等待响应超时(%dms)\n", conn->id, conn->turn_id, g_stConfig.timeout_ms);
+            g_s32TurnsTimeout++;
+            conn_finish_turn(conn, now, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+static void print_usage(const char *prog) {
+    printf("用法: %s [选项]\n", prog);
+    printf("  -s, --server HOST      服务器地址 (默认 127.0.0.1)\n");
+    printf("  -p, --port PORT        服务器端口 (默认 8082)\n");
+    printf("  -n, --clients N        并发连接数 (默认 10)\n");
+    printf("  -t, --turns N          每个连接的对话轮数 (默认 3)\n");
+    printf("  -c, --corpus FILES     PCM语料文件，逗号分隔 (默认 ../mp3s/my_recording.pcm)\n");
+    printf("  -r, --rate HZ          语料采样率 (默认 16000)\n");
+    printf("  -k, --think-ms MS      一轮结束到下一轮开始的间隔 (默认 1000)\n");
+    printf("  -m, --ramp-ms MS       相邻连接第一轮开始的间隔 (默认 50)\n");
+    printf("  -T, --timeout-ms MS    等待AI_END的超时 (默认 30000)\n");
+    printf("  -f, --format FMT       response_format: stream/json (默认 stream)\n");
+    printf("  -F, --fast             不按实时速度，一次发完语音\n");
+}
+
+int main(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"server",     required_argument, 0, 's'},
+        {"port",       required_argument, 0, 'p'},
+        {"clients",    required_argument, 0, 'n'},
+        {"turns",      required_argument, 0, 't'},
+        {"corpus",     required_argument, 0, 'c'},
+        {"rate",       required_argument, 0, 'r'},
+        {"think-ms",   required_argument, 0, 'k'},
+        {"ramp-ms",    required_argument, 0, 'm'},
+        {"timeout-ms", required_argument, 0, 'T'},
+        {"format",     required_argument, 0, 'f'},
+        {"fast",       no_argument,       0, 'F'},
+        {"help",       no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+    const char *corpus = "../mp3s/my_recording.pcm";
+    struct epoll_event events[LOAD_EPOLL_EVENTS];
+    LOAD_CONN_S *conns;
+    double start_ms;
+    double elapsed_s;
+    int epfd;
+    int opt;
+    int option_index = 0;
+    int active;
+    int i;
+
+    g_stConfig.host = "127.0.0.1";
+    g_stConfig.port = 8082;
+    g_stConfig.clients = 10;
+    g_stConfig.turns = 3;
+    g_stConfig.think_ms = 1000;
+    g_stConfig.ramp_ms = 50;
+    g_stConfig.timeout_ms = 30000;
+    g_stConfig.rate = 16000;
+    g_stConfig.fast = 0;
+    g_stConfig.format = "stream";
+
+    while ((opt = getopt_long(argc, argv, "s:p:n:t:c:r:k:m:T:f:Fh", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 's': g_stConfig.host = optarg; break;
+            case 'p': g_stConfig.port = atoi(optarg); break;
+            case 'n': g_stConfig.clients = atoi(optarg); break;
+            case 't': g_stConfig.turns = atoi(optarg); break;
+            case 'c': corpus = optarg; break;
+            case 'r': g_stConfig.rate = atoi(optarg); break;
+            case 'k': g_stConfig.think_ms = atoi(optarg); break;
+            case 'm': g_stConfig.ramp_ms = atoi(optarg); break;
+            case 'T': g_stConfig.timeout_ms = atoi(optarg); break;
+            case 'f': g_stConfig.format = optarg; break;
+            case 'F': g_stConfig.fast = 1; break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (g_stConfig.clients <= 0 || g_stConfig.turns <= 0 || g_stConfig.rate < 1000) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (load_corpus(corpus) != 0) {
+        return 1;
+    }
+    if (samples_init(&g_stAiStart, g_stConfig.clients * g_stConfig.turns) != 0 ||
+        samples_init(&g_stFirstAudio, g_stConfig.clients * g_stConfig.turns) != 0 ||
+        samples_init(&g_stAiEnd, g_stConfig.clients * g_stConfig.turns) != 0) {
+        return 1;
+    }
+    conns = calloc(g_stConfig.clients, sizeof(LOAD_CONN_S));
+    epfd = epoll_create1(0);
+    if (conns == NULL || epfd < 0) {
+        printf("❌ [LOAD] 初始化失败\n");
+        return 1;
+    }
+
+    printf("🚀 [LOAD] %s:%d 连接数%d 每连接%d轮 %s发送 think=%dms format=%s\n",
+           g_stConfig.host, g_stConfig.port, g_stConfig.clients, g_stConfig.turns,
+           g_stConfig.fast ? "一次" : "实时", g_stConfig.think_ms, g_stConfig.format);
+
+    start_ms = now_ms();
+    for (i = 0; i < g_stConfig.clients; i++) {
+        LOAD_CONN_S *conn = &conns[i];
+        struct epoll_event ev;
+
+        conn->id = i + 1;
+        conn->state = LOAD_CONN_DONE;
+        conn->fd = connect_server(g_stConfig.host, g_stConfig.port);
+        if (conn->fd < 0) {
+            printf("❌ [LOAD] 连接%d 无法连接服务器: %s\n", conn->id, strerror(errno));
+            g_s32ConnsLost++;
+            continue;
+        }
+        if (socket_parser_init(&conn->parser, LOAD_PARSER_RING_SIZE, LOAD_MAX_PAYLOAD) != 0 ||
+            conn_send_config(conn) != 0) {
+            printf("❌ [LOAD] 连接%d 初始化失败\n", conn->id);
+            close(conn->fd);
+            conn->fd = -1;
+            g_s32ConnsLost++;
+            continue;
+        }
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &ev);
+        conn->state = LOAD_CONN_IDLE;
+        conn->next_ms = start_ms + (double)i * g_stConfig.ramp_ms;
+    }
+
+    for (;;) {
+        double now = now_ms();
+        double next = now + 1000.0;
+        int timeout;
+        int nfds;
+
+        active = 0;
+        for (i = 0; i < g_stConfig.clients; i++) {
+            conn_handle_timer(&conns[i], epfd, now);
+            if (conns[i].state != LOAD_CONN_DONE) {
+                active++;
+                if (conns[i].next_ms < next) {
+                    next = conns[i].next_ms;
+                }
+            }
+        }
+        if (active == 0) {
+            break;
+        }
+
+        timeout = (int)(next - now_ms());
+        if (timeout < 0) {
+            timeout = 0;
+        }
+        nfds = epoll_wait(epfd, events, LOAD_EPOLL_EVENTS, timeout);
+        if (nfds < 0 && errno != EINTR) {
+            break;
+        }
+        for (i = 0; i < nfds; i++) {
+            conn_handle_input((LOAD_CONN_S *)events[i].data.ptr, epfd);
+        }
+        if (!g_running) {
+            // 中断时不再开始新的轮次，等待中的轮次直接结束
+            for (i = 0; i < g_stConfig.clients; i++) {
+                if (conns[i].state != LOAD_CONN_DONE) {
+                    conn_close(&conns[i], epfd, 0);
+                }
+            }
+        }
+    }
+    elapsed_s = (now_ms() - start_ms) / 1000.0;
+
+    printf("\n========== 负载测试结果 ==========\n");
+    printf("连接数: %d (断开/失败 %d)  每连接轮数: %d  用时: %.1fs\n",
+           g_stConfig.clients, g_s32ConnsLost, g_stConfig.turns, elapsed_s);
+    printf("完成轮次: %d  超时: %d  错误: %d  吞吐: %.2f 轮/秒\n",
+           g_s32TurnsOk, g_s32TurnsTimeout, g_s32TurnsError, elapsed_s > 0 ? g_s32TurnsOk / elapsed_s : 0.0);
+    printf("上行语音: %lu KB  下行音频: %lu KB\n", g_ulVoiceBytes / 1024, g_ulAudioBytes / 1024);
+    printf("\n延迟（从VOICE_END开始，毫秒）\n");
+    printf("%-14s %6s %8s %8s %8s %8s %8s %8s\n", "metric", "count", "mean", "P50", "P90", "P95", "P99", "max");
+    print_samples("AI_START", &g_stAiStart);
+    print_samples("FIRST_AUDIO", &g_stFirstAudio);
+    print_samples("AI_END", &g_stAiEnd);
+
+    for (i = 0; i < g_stConfig.clients; i++) {
+        if (conns[i].fd >= 0) {
+            close(conns[i].fd);
+        }
+        socket_parser_deinit(&conns[i].parser);
+    }
+    for (i = 0; i < g_s32CorpusCount; i++) {
+        free(g_astCorpus[i].data);
+    }
+    free(g_stAiStart.values);
+    free(g_stFirstAudio.values);
+    free(g_stAiEnd.values);
+    free(conns);
+    close(epfd);
+    return (g_s32TurnsTimeout + g_s32TurnsError) > 0 ? 2 : 0;
+}
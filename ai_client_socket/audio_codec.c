@@ -0,0 +1,310 @@
+/*
+ * 上行语音编码模块实现
+ * 详细说明见 audio_codec.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "audio_codec.h"
+
+#ifdef ENABLE_OPUS
+#include <opus/opus.h>
+#define AUDIO_OPUS_MAX_PACKET   1275
+#endif
+
+// ==================== IMA-ADPCM ====================
+
+static const int s_ima_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int s_ima_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static unsigned char ima_encode_sample(int *predictor, int *index, int sample) {
+    int step = s_ima_step_table[*index];
+    int diff = sample - *predictor;
+    int vpdiff = step >> 3;
+    unsigned char code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+        vpdiff += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+        vpdiff += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 1;
+        vpdiff += step;
+    }
+
+    // 与解码器完全相同的重建过程，保证两端预测值一致
+    *predictor += (code & 8) ? -vpdiff : vpdiff;
+    if (*predictor > 32767) {
+        *predictor = 32767;
+    } else if (*predictor < -32768) {
+        *predictor = -32768;
+    }
+    *index += s_ima_index_table[code];
+    if (*index < 0) {
+        *index = 0;
+    } else if (*index > 88) {
+        *index = 88;
+    }
+    return code;
+}
+
+static int ima_encode_block(AUDIO_ENCODER_S *enc, const short *pcm, int samples, unsigned char *out, size_t out_size) {
+    size_t need = AUDIO_IMA_BLOCK_HEADER_SIZE + (samples + 1) / 2;
+    unsigned char *p = out + AUDIO_IMA_BLOCK_HEADER_SIZE;
+    int i;
+
+    if (out_size < need) {
+        return -1;
+    }
+
+    // 块头保存编码第一个采样之前的状态
+    out[0] = enc->ima_predictor & 0xFF;
+    out[1] = (enc->ima_predictor >> 8) & 0xFF;
+    out[2] = (unsigned char)enc->ima_index;
+    out[3] = (samples & 1) ? AUDIO_IMA_FLAG_PAD_NIBBLE : 0;
+
+    for (i = 0; i + 1 < samples; i += 2) {
+        unsigned char lo = ima_encode_sample(&enc->ima_predictor, &enc->ima_index, pcm[i]);
+        unsigned char hi = ima_encode_sample(&enc->ima_predictor, &enc->ima_index, pcm[i + 1]);
+        *p++ = lo | (hi << 4);
+    }
+    if (samples & 1) {
+        *p++ = ima_encode_sample(&enc->ima_predictor, &enc->ima_index, pcm[samples - 1]);
+    }
+    return (int)need;
+}
+
+// ==================== Opus ====================
+
+#ifdef ENABLE_OPUS
+static int opus_emit_packet(AUDIO_ENCODER_S *enc, unsigned char *out, size_t out_size) {
+    opus_int32 n;
+
+    if (out_size < 2 + AUDIO_OPUS_MAX_PACKET) {
+        return -1;
+    }
+    n = opus_encode((OpusEncoder *)enc->opus, enc->pending, enc->opus_frame_samples, out + 2, AUDIO_OPUS_MAX_PACKET);
+    if (n < 0) {
+        printf("ERROR: [CODEC] opus_encode失败: %s\n", opus_strerror(n));
+        return -1;
+    }
+    out[0] = (n >> 8) & 0xFF;
+    out[1] = n & 0xFF;
+    enc->pending_samples = 0;
+    return 2 + n;
+}
+
+static int opus_encode_pcm(AUDIO_ENCODER_S *enc, const short *pcm, int samples, unsigned char *out, size_t out_size) {
+    int total = 0;
+
+    while (samples > 0) {
+        int take = enc->opus_frame_samples - enc->pending_samples;
+
+        if (take > samples) {
+            take = samples;
+        }
+        memcpy(enc->pending + enc->pending_samples * enc->channels, pcm, take * enc->channels * sizeof(short));
+        enc->pending_samples += take;
+        pcm += take * enc->channels;
+        samples -= take;
+
+        if (enc->pending_samples == enc->opus_frame_samples) {
+            int n = opus_emit_packet(enc, out + total, out_size - total);
+            if (n < 0) {
+                return -1;
+            }
+            total += n;
+        }
+    }
+    return total;
+}
+#endif
+
+// ==================== 公共接口 ====================
+
+const char *audio_codec_name(AUDIO_CODEC_TYPE_E type) {
+    switch (type) {
+        case AUDIO_CODEC_IMA_ADPCM:
+            return "ima_adpcm";
+        case AUDIO_CODEC_OPUS:
+            return "opus";
+        case AUDIO_CODEC_PCM:
+        default:
+            return "pcm";
+    }
+}
+
+int audio_codec_from_name(const char *name) {
+    if (!name || strcmp(name, "pcm") == 0) {
+        return AUDIO_CODEC_PCM;
+    }
+    if (strcmp(name, "ima_adpcm") == 0 || strcmp(name, "adpcm") == 0) {
+        return AUDIO_CODEC_IMA_ADPCM;
+    }
+    if (strcmp(name, "opus") == 0) {
+        return AUDIO_CODEC_OPUS;
+    }
+    return -1;
+}
+
+int audio_encoder_init(AUDIO_ENCODER_S *enc, AUDIO_CODEC_TYPE_E type, int sample_rate, int channels) {
+    memset(enc, 0, sizeof(*enc));
+    enc->type = type;
+    enc->sample_rate = sample_rate;
+    enc->channels = channels;
+
+    switch (type) {
+        case AUDIO_CODEC_PCM:
+            return 0;
+        case AUDIO_CODEC_IMA_ADPCM:
+            if (channels != 1) {
+                printf("ERROR: [CODEC] IMA-ADPCM仅支持单声道 (当前:%d)\n", channels);
+                return -1;
+            }
+            return 0;
+        case AUDIO_CODEC_OPUS:
+#ifdef ENABLE_OPUS
+        {
+            int err;
+            OpusEncoder *opus;
+
+            if (channels < 1 || channels > 2) {
+                return -1;
+            }
+            opus = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &err);
+            if (err != OPUS_OK || !opus) {
+                printf("ERROR: [CODEC] 创建Opus编码器失败 (%dHz/%dch): %s\n", sample_rate, channels, opus_strerror(err));
+                return -1;
+            }
+            opus_encoder_ctl(opus, OPUS_SET_BITRATE(AUDIO_OPUS_BITRATE));
+            opus_encoder_ctl(opus, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+            enc->opus = opus;
+            enc->opus_frame_samples = sample_rate * AUDIO_OPUS_FRAME_MS / 1000;
+            return 0;
+        }
+#else
+            printf("ERROR: [CODEC] 未启用Opus支持（编译时需定义ENABLE_OPUS）\n");
+            return -1;
+#endif
+        default:
+            return -1;
+    }
+}
+
+void audio_encoder_deinit(AUDIO_ENCODER_S *enc) {
+#ifdef ENABLE_OPUS
+    if (enc->opus) {
+        opus_encoder_destroy((OpusEncoder *)enc->opus);
+        enc->opus = NULL;
+    }
+#endif
+    enc->type = AUDIO_CODEC_PCM;
+}
+
+void audio_encoder_reset(AUDIO_ENCODER_S *enc) {
+    enc->ima_predictor = 0;
+    enc->ima_index = 0;
+    enc->in_bytes = 0;
+    enc->out_bytes = 0;
+#ifdef ENABLE_OPUS
+    enc->pending_samples = 0;
+    if (enc->opus) {
+        opus_encoder_ctl((OpusEncoder *)enc->opus, OPUS_RESET_STATE);
+    }
+#endif
+}
+
+size_t audio_encoder_max_output(const AUDIO_ENCODER_S *enc, int samples) {
+    switch (enc->type) {
+        case AUDIO_CODEC_IMA_ADPCM:
+            return AUDIO_IMA_BLOCK_HEADER_SIZE + (samples + 1) / 2;
+#ifdef ENABLE_OPUS
+        case AUDIO_CODEC_OPUS:
+            return (size_t)(samples / enc->opus_frame_samples + 1) * (2 + AUDIO_OPUS_MAX_PACKET);
+#endif
+        case AUDIO_CODEC_PCM:
+        default:
+            return (size_t)samples * enc->channels * sizeof(short);
+    }
+}
+
+int audio_encoder_encode(AUDIO_ENCODER_S *enc, const short *pcm, int samples, unsigned char *out, size_t out_size) {
+    int n;
+
+    if (samples <= 0) {
+        return 0;
+    }
+
+    switch (enc->type) {
+        case AUDIO_CODEC_PCM:
+            n = samples * enc->channels * sizeof(short);
+            if (out_size < (size_t)n) {
+                return -1;
+            }
+            memcpy(out, pcm, n);
+            break;
+        case AUDIO_CODEC_IMA_ADPCM:
+            n = ima_encode_block(enc, pcm, samples, out, out_size);
+            break;
+#ifdef ENABLE_OPUS
+        case AUDIO_CODEC_OPUS:
+            n = opus_encode_pcm(enc, pcm, samples, out, out_size);
+            break;
+#endif
+        default:
+            return -1;
+    }
+
+    if (n >= 0) {
+        enc->in_bytes += samples * enc->channels * sizeof(short);
+        enc->out_bytes += n;
+    }
+    return n;
+}
+
+int audio_encoder_flush(AUDIO_ENCODER_S *enc, unsigned char *out, size_t out_size) {
+#ifdef ENABLE_OPUS
+    if (enc->type == AUDIO_CODEC_OPUS && enc->pending_samples > 0) {
+        int n;
+
+        memset(enc->pending + enc->pending_samples * enc->channels, 0,
+               (enc->opus_frame_samples - enc->pending_samples) * enc->channels * sizeof(short));
+        n = opus_emit_packet(enc, out, out_size);
+        if (n > 0) {
+            enc->out_bytes += n;
+        }
+        return n;
+    }
+#endif
+    (void)enc;
+    (void)out;
+    (void)out_size;
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * 上行语音编码模块
+ *
+ * 录音得到的16位PCM在发送VOICE_DATA之前经过编码，编码方式通过MSG_CONFIG中的
+ * voice_codec字段告知服务器（服务器端解码见 ai_server_socket/AudioCodec.py）：
+ * - pcm       : 不编码，原样发送
+ * - ima_adpcm : IMA-ADPCM，4bit/采样，数据量为PCM的1/4，仅支持单声道
+ * - opus      : Opus（需要编译时定义ENABLE_OPUS并链接libopus）
+ *
+ * IMA-ADPCM每个VOICE_DATA帧都是独立的块，服务器不需要跨帧保存解码状态：
+ *   预测值(int16，小端) + 步长索引(1字节) + 标志(1字节，bit0=最后半字节为填充) + 4bit编码数据（低半字节在前）
+ *
+ * Opus每帧包含若干个包：包长度(2字节，网络字节序) + 包数据；
+ * 编码器内部积累到20ms才输出一个包，结束时调用audio_encoder_flush补齐最后一包。
+ */
+
+#ifndef AUDIO_CODEC_H
+#define AUDIO_CODEC_H
+
+#include <stddef.h>
+
+#define AUDIO_IMA_BLOCK_HEADER_SIZE     4
+#define AUDIO_IMA_FLAG_PAD_NIBBLE       0x01
+#define AUDIO_OPUS_FRAME_MS             20
+#define AUDIO_OPUS_BITRATE              (24000)
+#define AUDIO_OPUS_MAX_FRAME_SAMPLES    (48000 * AUDIO_OPUS_FRAME_MS / 1000)
+
+typedef enum _AudioCodecType {
+    AUDIO_CODEC_PCM = 0,
+    AUDIO_CODEC_IMA_ADPCM,
+    AUDIO_CODEC_OPUS,
+} AUDIO_CODEC_TYPE_E;
+
+typedef struct _AudioEncoder {
+    AUDIO_CODEC_TYPE_E  type;
+    int                 sample_rate;
+    int                 channels;
+
+    // IMA-ADPCM状态（跨帧延续，使下一块的起始预测值更准确）
+    int                 ima_predictor;
+    int                 ima_index;
+
+#ifdef ENABLE_OPUS
+    void               *opus;                   // OpusEncoder*
+    int                 opus_frame_samples;     // 每包每声道采样数
+    short               pending[AUDIO_OPUS_MAX_FRAME_SAMPLES * 2];
+    int                 pending_samples;        // 已积累的每声道采样数
+#endif
+
+    // 统计
+    unsigned long       in_bytes;
+    unsigned long       out_bytes;
+} AUDIO_ENCODER_S;
+
+// 名称与类型互转（名称即MSG_CONFIG中的voice_codec取值），未知名称返回-1
+const char *audio_codec_name(AUDIO_CODEC_TYPE_E type);
+int         audio_codec_from_name(const char *name);
+
+// 初始化编码器，不支持的组合返回-1
+int  audio_encoder_init(AUDIO_ENCODER_S *enc, AUDIO_CODEC_TYPE_E type, int sample_rate, int channels);
+void audio_encoder_deinit(AUDIO_ENCODER_S *enc);
+// 每轮语音开始时调用，清除上一轮的预测状态和未输出数据
+void audio_encoder_reset(AUDIO_ENCODER_S *enc);
+
+// 编码samples个采样（每声道），不超过该长度时输出不会超过返回值
+size_t audio_encoder_max_output(const AUDIO_ENCODER_S *enc, int samples);
+
+// 编码一段交错PCM，返回写入out的字节数（Opus积累不足一包时可能为0），失败返回-1
+int  audio_encoder_encode(AUDIO_ENCODER_S *enc, const short *pcm, int samples, unsigned char *out, size_t out_size);
+// 输出编码器内部剩余数据（Opus补零凑满最后一包），返回写入字节数
+int  audio_encoder_flush(AUDIO_ENCODER_S *enc, unsigned char *out, size_t out_size);
+
+#endif // AUDIO_CODEC_H
@@ -0,0 +1,242 @@
+/*
+ * 定点语音特征计算实现
+ * 详细说明见 audio_dsp.h
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "audio_dsp.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define LOG2_CORR_BITS  (4)
+#define LOG2_CORR_SIZE  ((1 << LOG2_CORR_BITS) + 1)
+
+static short s_cos_q15[AUDIO_DSP_MAX_FFT / 2];
+static short s_sin_q15[AUDIO_DSP_MAX_FFT / 2];
+static short s_hann_q15[AUDIO_DSP_MAX_FFT];
+static short s_log2_corr[LOG2_CORR_SIZE];      // log2(1+f) - f，Q8
+static int   s_initialized = 0;
+
+static short to_q15(double v) {
+    long x = lround(v * AUDIO_DSP_Q15_ONE);
+    if (x > 32767) {
+        x = 32767;
+    }
+    if (x < -32768) {
+        x = -32768;
+    }
+    return (short)x;
+}
+
+void audio_dsp_init(void) {
+    int i;
+
+    if (s_initialized) {
+        return;
+    }
+    for (i = 0; i < AUDIO_DSP_MAX_FFT / 2; i++) {
+        s_cos_q15[i] = to_q15(cos(2.0 * M_PI * i / AUDIO_DSP_MAX_FFT));
+        s_sin_q15[i] = to_q15(sin(2.0 * M_PI * i / AUDIO_DSP_MAX_FFT));
+    }
+    for (i = 0; i < AUDIO_DSP_MAX_FFT; i++) {
+        s_hann_q15[i] = to_q15(0.5 - 0.5 * cos(2.0 * M_PI * i / AUDIO_DSP_MAX_FFT));
+    }
+    for (i = 0; i < LOG2_CORR_SIZE; i++) {
+        double f = (double)i / (1 << LOG2_CORR_BITS);
+        s_log2_corr[i] = (short)lround((log2(1.0 + f) - f) * AUDIO_DSP_LOG2_ONE);
+    }
+    s_initialized = 1;
+}
+
+int audio_dsp_log2_q8(unsigned int x) {
+    int p;
+    unsigned int frac;
+    unsigned int idx;
+    unsigned int rem;
+    int corr;
+
+    if (x == 0) {
+        return 0;
+    }
+    p = 31 - __builtin_clz(x);
+    // 最高位之后的8位作为小数部分，再按查表修正线性近似的误差
+    frac = (p >= 8) ? (x >> (p - 8)) & 0xFF : (x << (8 - p)) & 0xFF;
+    idx = frac >> (8 - LOG2_CORR_BITS);
+    rem = frac & ((1 << (8 - LOG2_CORR_BITS)) - 1);
+    corr = s_log2_corr[idx] + (((s_log2_corr[idx + 1] - s_log2_corr[idx]) * (int)rem) >> (8 - LOG2_CORR_BITS));
+    return p * AUDIO_DSP_LOG2_ONE + (int)frac + corr;
+}
+
+int audio_dsp_log2_q8_to_db(int log2_q8) {
+    // 3.0103 ≈ 771 / 256
+    return (log2_q8 * 771) >> 16;
+}
+
+int audio_dsp_db_to_log2_q8(int db) {
+    // 256 / 3.0103 ≈ 85.04
+    return db * 85;
+}
+
+unsigned int audio_dsp_mean_square(const short *pcm, int samples, int stride) {
+    unsigned long long sum = 0;
+    int i;
+
+    if (samples <= 0) {
+        return 0;
+    }
+    for (i = 0; i < samples; i++) {
+        int v = pcm[i * stride];
+        sum += (unsigned int)(v * v);
+    }
+    return (unsigned int)(sum / (unsigned int)samples);
+}
+
+int audio_dsp_zcr_q15(const short *pcm, int samples, int stride, int deadzone) {
+    int crossings = 0;
+    int prev = 0;   // 上一个超过死区的样本符号：1/-1，0表示还没有
+    int i;
+
+    if (samples <= 1) {
+        return 0;
+    }
+    for (i = 0; i < samples; i++) {
+        int v = pcm[i * stride];
+        int sign;
+
+        if (v > deadzone) {
+            sign = 1;
+        } else if (v < -deadzone) {
+            sign = -1;
+        } else {
+            continue;
+        }
+        if (prev != 0 && sign != prev) {
+            crossings++;
+        }
+        prev = sign;
+    }
+    return (int)(((long long)crossings * AUDIO_DSP_Q15_ONE) / (samples - 1));
+}
+
+int audio_dsp_fft_q15(short *re, short *im, int log2n) {
+    int n = 1 << log2n;
+    int i;
+    int j;
+    int len;
+
+    if (log2n <= 0 || log2n > AUDIO_DSP_MAX_FFT_LOG2) {
+        return -1;
+    }
+
+    // 位反转重排
+    for (i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            short t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (len = 2; len <= n; len <<= 1) {
+        int half = len >> 1;
+        int step = AUDIO_DSP_MAX_FFT / len;
+
+        for (i = 0; i < n; i += len) {
+            for (j = 0; j < half; j++) {
+                int wr = s_cos_q15[j * step];
+                int wi = s_sin_q15[j * step];
+                int a = i + j;
+                int b = a + half;
+                // (re + i*im) * (wr - i*wi)
+                int tr = (re[b] * wr + im[b] * wi) >> 15;
+                int ti = (im[b] * wr - re[b] * wi) >> 15;
+                int ur = re[a];
+                int ui = im[a];
+
+                re[a] = (short)((ur + tr) >> 1);
+                im[a] = (short)((ui + ti) >> 1);
+                re[b] = (short)((ur - tr) >> 1);
+                im[b] = (short)((ui - ti) >> 1);
+            }
+        }
+    }
+    return 0;
+}
+
+int audio_dsp_power_spectrum(const short *pcm, int samples, int stride, int log2n,
+                             short *re, short *im, unsigned int *power) {
+    int n = 1 << log2n;
+    int win_step;
+    int peak = 0;
+    int shift = 0;
+    int i;
+
+    if (log2n <= 0 || log2n > AUDIO_DSP_MAX_FFT_LOG2) {
+        return -128;
+    }
+    if (samples > n) {
+        samples = n;
+    }
+    win_step = AUDIO_DSP_MAX_FFT / n;
+
+    // 按峰值移位到不超过2^14：小信号保留FFT精度，大信号留出蝶形运算的余量
+    for (i = 0; i < samples; i++) {
+        int v = pcm[i * stride];
+        if (v < 0) {
+            v = -v;
+        }
+        if (v > peak) {
+            peak = v;
+        }
+    }
+    if (peak > 16384) {
+        shift = -1;
+    } else if (peak > 0) {
+        while ((peak << (shift + 1)) <= 16384) {
+            shift++;
+        }
+    }
+    for (i = 0; i < samples; i++) {
+        int v = shift >= 0 ? (int)pcm[i * stride] << shift : (int)pcm[i * stride] >> 1;
+        re[i] = (short)((v * s_hann_q15[i * win_step]) >> 15);
+        im[i] = 0;
+    }
+    for (; i < n; i++) {
+        re[i] = 0;
+        im[i] = 0;
+    }
+
+    audio_dsp_fft_q15(re, im, log2n);
+    for (i = 0; i <= n / 2; i++) {
+        power[i] = (unsigned int)(re[i] * re[i]) + (unsigned int)(im[i] * im[i]);
+    }
+    return shift;
+}
+
+int audio_dsp_flatness_q8(const unsigned int *power, int first, int last) {
+    long long sum_log = 0;
+    unsigned long long sum = 0;
+    int count = last - first + 1;
+    int i;
+
+    if (count <= 0) {
+        return 0;
+    }
+    for (i = first; i <= last; i++) {
+        sum_log += audio_dsp_log2_q8(power[i] + 1);
+        sum += power[i];
+    }
+    return (int)(sum_log / count) - audio_dsp_log2_q8((unsigned int)(sum / count) + 1);
+}
@@ -0,0 +1,43 @@
+/*
+ * 定点语音特征计算（VAD/关键词检测共用）
+ *
+ * 全部按帧处理int16 PCM，运行时只用整数运算（查表在audio_dsp_init中用浮点生成一次）：
+ * - 能量：均方值，以及log2的Q8定点值（1.0 = 256，约3.01dB）
+ * - 过零率：Q15（1.0 = 32768），小于死区的样本不计，避免底噪来回穿越零点
+ * - 功率谱：Hann窗 + 基2定点FFT（最大512点），输入先按峰值归一化，保留精度（返回移位量供需要绝对能量的调用者补偿）
+ * - 谱平坦度：log2(几何平均/算术平均)的Q8值，<=0；白噪声约-0.83*256，浊音明显更低
+ */
+
+#ifndef AUDIO_DSP_H
+#define AUDIO_DSP_H
+
+#define AUDIO_DSP_MAX_FFT       (512)
+#define AUDIO_DSP_MAX_FFT_LOG2  (9)
+#define AUDIO_DSP_LOG2_ONE      (256)   // Q8
+#define AUDIO_DSP_Q15_ONE       (32768)
+#define AUDIO_DSP_FULL_SCALE_DB (90)    // int16满幅正弦的均方值约2^30，即90dB（相对1LSB），减去它得到dBFS
+
+// 生成旋转因子和窗函数表，使用其他函数前调用一次（可重复调用）
+void         audio_dsp_init(void);
+
+// 整数log2，Q8；x为0时返回0
+int          audio_dsp_log2_q8(unsigned int x);
+// log2 Q8与dB互换（10*log10(x) = log2(x) * 3.0103）
+int          audio_dsp_log2_q8_to_db(int log2_q8);
+int          audio_dsp_db_to_log2_q8(int db);
+
+// 均方值（stride为声道交织步长，只分析第一个声道）
+unsigned int audio_dsp_mean_square(const short *pcm, int samples, int stride);
+// 过零率Q15
+int          audio_dsp_zcr_q15(const short *pcm, int samples, int stride, int deadzone);
+
+// 原地定点FFT，每级右移1位防止溢出（输出为真实结果除以N），n = 1 << log2n
+int          audio_dsp_fft_q15(short *re, short *im, int log2n);
+// 加窗后计算功率谱，power需要(1 << log2n) / 2 + 1个元素；samples不足N时补零。
+// 返回输入的归一化移位（-1..15，功率谱相当于乘以4^shift），参数错误返回-128
+int          audio_dsp_power_spectrum(const short *pcm, int samples, int stride, int log2n,
+                                      short *re, short *im, unsigned int *power);
+// 频带[first, last]内的谱平坦度，Q8
+int          audio_dsp_flatness_q8(const unsigned int *power, int first, int last);
+
+#endif // AUDIO_DSP_H
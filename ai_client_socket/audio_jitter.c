@@ -0,0 +1,87 @@
+/*
+ * TTS播放自适应预缓冲控制实现
+ * 详细说明见 audio_jitter.h
+ */
+
+#include <string.h>
+
+#include "audio_jitter.h"
+
+#define AUDIO_JITTER_DECAY          (16.0)  // 抖动估计的衰减系数（与RFC 3550相同）
+#define AUDIO_JITTER_SAFETY         (1.5)   // 目标 = 抖动估计 * 安全系数 + 欠载修正
+
+void audio_jitter_init(AUDIO_JITTER_S *jit, int min_ms, int max_ms) {
+    memset(jit, 0, sizeof(*jit));
+    jit->min_ms = min_ms;
+    jit->max_ms = max_ms;
+}
+
+void audio_jitter_begin_segment(AUDIO_JITTER_S *jit, unsigned int bytes_per_ms) {
+    jit->bytes_per_ms = bytes_per_ms;
+    jit->segment_active = 0;
+    jit->media_ms = 0;
+    jit->min_transit_ms = 0;
+}
+
+void audio_jitter_on_packet(AUDIO_JITTER_S *jit, long long now_ms, unsigned int bytes) {
+    double transit;
+    double late;
+
+    if (jit->bytes_per_ms == 0) {
+        return;
+    }
+    jit->packets++;
+
+    if (!jit->segment_active) {
+        jit->segment_active = 1;
+        jit->segment_start_ms = now_ms;
+        jit->media_ms = (double)bytes / jit->bytes_per_ms;
+        jit->min_transit_ms = 0;
+        return;
+    }
+
+    // 该包的开始时刻应在 media_ms 处播放，到达越晚 transit 越大
+    transit = (double)(now_ms - jit->segment_start_ms) - jit->media_ms;
+    jit->media_ms += (double)bytes / jit->bytes_per_ms;
+
+    if (transit < jit->min_transit_ms) {
+        jit->min_transit_ms = transit;
+    }
+    late = transit - jit->min_transit_ms;
+    if (late > jit->max_late_ms) {
+        jit->max_late_ms = late;
+    }
+
+    if (late > jit->jitter_ms) {
+        jit->jitter_ms = late;
+    } else {
+        jit->jitter_ms += (late - jit->jitter_ms) / AUDIO_JITTER_DECAY;
+    }
+}
+
+void audio_jitter_end_response(AUDIO_JITTER_S *jit, unsigned long underruns) {
+    jit->responses++;
+    if (underruns > 0) {
+        jit->underrun_responses++;
+        jit->bias_ms += AUDIO_JITTER_UNDERRUN_STEP_MS * (int)underruns;
+        if (jit->bias_ms > jit->max_ms) {
+            jit->bias_ms = jit->max_ms;
+        }
+    } else if (jit->bias_ms > 0) {
+        jit->bias_ms -= AUDIO_JITTER_RECOVER_STEP_MS;
+        if (jit->bias_ms < 0) {
+            jit->bias_ms = 0;
+        }
+    }
+}
+
+int audio_jitter_target_ms(const AUDIO_JITTER_S *jit) {
+    int target = (int)(jit->jitter_ms * AUDIO_JITTER_SAFETY + 0.5) + jit->bias_ms;
+
+    if (target < jit->min_ms) {
+        target = jit->min_ms;
+    } else if (target > jit->max_ms) {
+        target = jit->max_ms;
+    }
+    return target;
+}
@@ -0,0 +1,52 @@
+/*
+ * TTS播放自适应预缓冲控制
+ *
+ * 根据MSG_AUDIO_DATA实际到达时间与其媒体时间的偏差估计网络抖动，计算播放开始前需要
+ * 预缓冲的时长（低水位），在最小/最大值之间自适应：
+ * - 晚到量：每个包的 (到达时间 - 媒体时间) 与本段最早的该值之差；提前到达不计
+ * - 抖动估计：晚到量超过当前估计时立即跟上，否则缓慢衰减（快升慢降）
+ * - 欠载修正：一次响应中出现欠载就加大附加量，连续无欠载则逐步减小
+ *
+ * 服务器按句发送TTS，句子之间的生成间隔不属于网络抖动，所以每段音频（AUDIO_START或
+ * AUDIO_END_MARKER之后）重新开始计算晚到量，只保留抖动估计和欠载修正。
+ */
+
+#ifndef AUDIO_JITTER_H
+#define AUDIO_JITTER_H
+
+#define AUDIO_JITTER_MIN_MS             (60)
+#define AUDIO_JITTER_MAX_MS             (200)
+#define AUDIO_JITTER_UNDERRUN_STEP_MS   (20)    // 每次欠载增加的附加量
+#define AUDIO_JITTER_RECOVER_STEP_MS    (10)    // 无欠载响应减少的附加量
+
+typedef struct _AudioJitter {
+    int          min_ms;
+    int          max_ms;
+    int          bias_ms;           // 欠载修正附加量
+    double       jitter_ms;         // 抖动估计
+
+    // 当前音频段
+    unsigned int bytes_per_ms;
+    int          segment_active;
+    long long    segment_start_ms;  // 本段第一个包的到达时间
+    double       media_ms;          // 本段已收到数据的媒体时长
+    double       min_transit_ms;    // 本段最小的 (到达时间 - 媒体时间)
+
+    // 统计
+    unsigned int packets;
+    unsigned int responses;
+    unsigned int underrun_responses;
+    double       max_late_ms;
+} AUDIO_JITTER_S;
+
+void audio_jitter_init(AUDIO_JITTER_S *jit, int min_ms, int max_ms);
+// 新的音频段开始（bytes_per_ms为播放格式每毫秒字节数）
+void audio_jitter_begin_segment(AUDIO_JITTER_S *jit, unsigned int bytes_per_ms);
+// 收到一个音频包，更新抖动估计
+void audio_jitter_on_packet(AUDIO_JITTER_S *jit, long long now_ms, unsigned int bytes);
+// 一次响应结束，按本次欠载次数调整附加量
+void audio_jitter_end_response(AUDIO_JITTER_S *jit, unsigned long underruns);
+// 当前预缓冲目标（毫秒）
+int  audio_jitter_target_ms(const AUDIO_JITTER_S *jit);
+
+#endif // AUDIO_JITTER_H
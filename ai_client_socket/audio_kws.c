@@ -0,0 +1,505 @@
+/*
+ * 设备端关键词检测实现
+ * 详细说明见 audio_kws.h
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_kws.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define KWS_PREEMPH_Q15         (31785)     // 预加重系数0.97
+#define KWS_MEL_LOW_HZ          (100)
+#define KWS_MEL_HIGH_HZ         (6000)
+#define KWS_QUIET_RESET_FRAMES  (12)        // 连续约200ms低于门限才停止计算（词中的塞音停顿仍参与匹配）
+#define KWS_TRIM_DB             (25)        // 模板首尾低于最大能量25dB的帧裁掉
+#define KWS_MIN_FRAMES          (8)         // 模板至少128ms
+#define KWS_DEFAULT_THRESHOLD   (4000)      // 单模板时的默认阈值
+#define KWS_AUTO_MARGIN_PCT     (200)       // 自动阈值 = 模板间平均距离 x 2（留出噪声环境下的余量）
+#define KWS_BUDGET_WINDOW_MS    (1000)
+#define KWS_GATE_STEP_DB        (3)
+#define KWS_GATE_MAX_RAISE_DB   (30)
+
+void audio_kws_default_config(AUDIO_KWS_CONFIG_S *config, int sample_rate, int channels) {
+    config->sample_rate = sample_rate;
+    config->channels = channels;
+    config->threshold = 0;
+    config->refractory_ms = 1500;
+    config->min_energy_db = -60;
+    config->cpu_budget_pct = 10;
+}
+
+static double hz_to_mel(double hz) {
+    return 2595.0 * log10(1.0 + hz / 700.0);
+}
+
+static double mel_to_hz(double mel) {
+    return 700.0 * (pow(10.0, mel / 2595.0) - 1.0);
+}
+
+// 三角Mel滤波器组和DCT表（浮点生成一次，运行时只用整数）
+static int build_tables(AUDIO_KWS_S *kws) {
+    int n = 1 << kws->fft_log2;
+    double high = kws->config.sample_rate / 2 < KWS_MEL_HIGH_HZ ? kws->config.sample_rate / 2 : KWS_MEL_HIGH_HZ;
+    double mel_low = hz_to_mel(KWS_MEL_LOW_HZ);
+    double mel_high = hz_to_mel(high);
+    double bin_hz = (double)kws->config.sample_rate / n;
+    double edge[AUDIO_KWS_NUM_MELS + 2];
+    int total = 0;
+    int pos = 0;
+    int m;
+    int i;
+
+    for (m = 0; m < AUDIO_KWS_NUM_MELS + 2; m++) {
+        edge[m] = mel_to_hz(mel_low + (mel_high - mel_low) * m / (AUDIO_KWS_NUM_MELS + 1)) / bin_hz;
+    }
+    for (m = 0; m < AUDIO_KWS_NUM_MELS; m++) {
+        int first = (int)ceil(edge[m]);
+        int last = (int)floor(edge[m + 2]);
+
+        if (first < 1) {
+            first = 1;
+        }
+        if (last > n / 2) {
+            last = n / 2;
+        }
+        if (last < first) {
+            last = first;
+        }
+        kws->mel_first[m] = first;
+        kws->mel_count[m] = last - first + 1;
+        total += kws->mel_count[m];
+    }
+
+    kws->mel_weight = (short *)malloc(total * sizeof(short));
+    if (!kws->mel_weight) {
+        return -1;
+    }
+    for (m = 0; m < AUDIO_KWS_NUM_MELS; m++) {
+        for (i = 0; i < kws->mel_count[m]; i++) {
+            double k = kws->mel_first[m] + i;
+            double w;
+
+            if (k <= edge[m + 1]) {
+                w = (k - edge[m]) / (edge[m + 1] - edge[m]);
+            } else {
+                w = (edge[m + 2] - k) / (edge[m + 2] - edge[m + 1]);
+            }
+            if (w < 0.0) {
+                w = 0.0;
+            }
+            // 滤波器太窄时至少保留一个频点
+            if (kws->mel_count[m] == 1) {
+                w = 1.0;
+            }
+            kws->mel_weight[pos++] = (short)lround(w * 32767.0);
+        }
+    }
+
+    // 正交DCT-II，跳过c0（整体增益，包括功率谱归一化的移位，都只影响c0）
+    for (i = 0; i < AUDIO_KWS_NUM_CEPS; i++) {
+        for (m = 0; m < AUDIO_KWS_NUM_MELS; m++) {
+            double v = sqrt(2.0 / AUDIO_KWS_NUM_MELS) * cos(M_PI * (i + 1) * (m + 0.5) / AUDIO_KWS_NUM_MELS);
+            kws->dct_q15[i][m] = (short)lround(v * 32767.0);
+        }
+    }
+    return 0;
+}
+
+int audio_kws_init(AUDIO_KWS_S *kws, const AUDIO_KWS_CONFIG_S *config) {
+    memset(kws, 0, sizeof(*kws));
+    if (config->sample_rate < 8000 || config->channels <= 0) {
+        return -1;
+    }
+    audio_dsp_init();
+    kws->config = *config;
+
+    kws->window = config->sample_rate * AUDIO_KWS_WINDOW_MS / 1000;
+    if (kws->window > AUDIO_DSP_MAX_FFT) {
+        kws->window = AUDIO_DSP_MAX_FFT;
+    }
+    kws->hop = config->sample_rate * AUDIO_KWS_HOP_MS / 1000;
+    for (kws->fft_log2 = 1; (1 << kws->fft_log2) < kws->window && kws->fft_log2 < AUDIO_DSP_MAX_FFT_LOG2;
+         kws->fft_log2++) {
+    }
+    kws->hist_size = kws->window > kws->hop ? kws->window : kws->hop;
+    kws->hist = (short *)malloc(kws->hist_size * sizeof(short));
+    if (!kws->hist || build_tables(kws) != 0) {
+        audio_kws_deinit(kws);
+        return -1;
+    }
+    kws->base_gate_q8 = audio_dsp_db_to_log2_q8(config->min_energy_db + AUDIO_DSP_FULL_SCALE_DB);
+    kws->gate_q8 = kws->base_gate_q8;
+    kws->threshold = config->threshold > 0 ? config->threshold : KWS_DEFAULT_THRESHOLD;
+    kws->stats.best_score = -1;
+    kws->stats.gate_db = config->min_energy_db;
+    return 0;
+}
+
+void audio_kws_deinit(AUDIO_KWS_S *kws) {
+    free(kws->hist);
+    free(kws->mel_weight);
+    kws->hist = NULL;
+    kws->mel_weight = NULL;
+    kws->num_templates = 0;
+}
+
+static int log2_q8_u64(unsigned long long x) {
+    int extra = 0;
+
+    while (x > 0xFFFFFFFFULL) {
+        x >>= 1;
+        extra += AUDIO_DSP_LOG2_ONE;
+    }
+    return audio_dsp_log2_q8((unsigned int)x) + extra;
+}
+
+static int frame_energy(const short *frame, int samples) {
+    return audio_dsp_log2_q8(audio_dsp_mean_square(frame, samples, 1) + 1);
+}
+
+static void frame_mfcc(AUDIO_KWS_S *kws, const short *frame, int *ceps) {
+    int logmel[AUDIO_KWS_NUM_MELS];
+    const short *w = kws->mel_weight;
+    int m;
+    int i;
+
+    audio_dsp_power_spectrum(frame, kws->window, 1, kws->fft_log2, kws->re, kws->im, kws->power);
+    for (m = 0; m < AUDIO_KWS_NUM_MELS; m++) {
+        const unsigned int *p = kws->power + kws->mel_first[m];
+        unsigned long long sum = 0;
+
+        for (i = 0; i < kws->mel_count[m]; i++) {
+            sum += (unsigned long long)p[i] * (unsigned int)w[i];
+        }
+        w += kws->mel_count[m];
+        logmel[m] = log2_q8_u64(sum + 1);
+    }
+    for (i = 0; i < AUDIO_KWS_NUM_CEPS; i++) {
+        long long acc = 0;
+
+        for (m = 0; m < AUDIO_KWS_NUM_MELS; m++) {
+            acc += (long long)logmel[m] * kws->dct_q15[i][m];
+        }
+        ceps[i] = (int)(acc >> 15);
+    }
+}
+
+static int ceps_distance(const int *a, const int *b) {
+    int d = 0;
+    int i;
+
+    for (i = 0; i < AUDIO_KWS_NUM_CEPS; i++) {
+        d += abs(a[i] - b[i]);
+    }
+    return d;
+}
+
+// a的平均距离是否小于b（len为0表示无效路径）
+static int avg_less(int cost_a, int len_a, int cost_b, int len_b) {
+    if (len_a == 0) {
+        return 0;
+    }
+    if (len_b == 0) {
+        return 1;
+    }
+    return (long long)cost_a * len_b < (long long)cost_b * len_a;
+}
+
+// 两个模板之间的整体DTW平均距离（起点终点固定），用于估计阈值。步进规则与dtw_step相同
+static int template_distance(const AUDIO_KWS_TEMPLATE_S *a, const AUDIO_KWS_TEMPLATE_S *b) {
+    int cost[AUDIO_KWS_MAX_FRAMES];
+    int len[AUDIO_KWS_MAX_FRAMES];
+    int t;
+    int j;
+    int k;
+
+    memset(len, 0, sizeof(len));
+    cost[0] = ceps_distance(a->feat[0], b->feat[0]);
+    len[0] = 1;
+    for (t = 1; t < a->frames; t++) {
+        for (j = b->frames - 1; j >= 0; j--) {
+            int best_cost = 0;
+            int best_len = 0;
+
+            for (k = 0; k <= 2 && k <= j; k++) {
+                if (avg_less(cost[j - k], len[j - k], best_cost, best_len)) {
+                    best_cost = cost[j - k];
+                    best_len = len[j - k];
+                }
+            }
+            if (best_len == 0) {
+                len[j] = 0;
+                continue;
+            }
+            cost[j] = best_cost + ceps_distance(a->feat[t], b->feat[j]);
+            len[j] = best_len + 1;
+        }
+    }
+    return len[b->frames - 1] > 0 ? cost[b->frames - 1] / len[b->frames - 1] : 0;
+}
+
+int audio_kws_add_template(AUDIO_KWS_S *kws, const void *pcm, unsigned int len) {
+    const short *src = (const short *)pcm;
+    unsigned int samples = len / (kws->config.channels * sizeof(short));
+    unsigned int max_frames = samples / kws->hop + 1;
+    AUDIO_KWS_TEMPLATE_S *tmpl;
+    int (*feat)[AUDIO_KWS_NUM_CEPS];
+    int *energy;
+    int frames = 0;
+    int peak = 0;
+    int first;
+    int last;
+    int prev = 0;
+    unsigned int i;
+
+    if (kws->num_templates >= AUDIO_KWS_MAX_TEMPLATES || !kws->hist) {
+        return -1;
+    }
+    feat = malloc(max_frames * sizeof(*feat));
+    energy = (int *)malloc(max_frames * sizeof(int));
+    if (!feat || !energy) {
+        free(feat);
+        free(energy);
+        return -1;
+    }
+
+    // 与检测时相同的前端，逐帧计算能量和MFCC
+    kws->hist_len = 0;
+    for (i = 0; i < samples; i++) {
+        int x = src[i * kws->config.channels];
+        int y = x - ((prev * KWS_PREEMPH_Q15) >> 15);
+
+        prev = x;
+        kws->hist[kws->hist_len++] = (short)(y > 32767 ? 32767 : (y < -32768 ? -32768 : y));
+        if (kws->hist_len == kws->hist_size) {
+            const short *frame = kws->hist + kws->hist_size - kws->window;
+
+            energy[frames] = frame_energy(frame, kws->window);
+            frame_mfcc(kws, frame, feat[frames]);
+            if (energy[frames] > peak) {
+                peak = energy[frames];
+            }
+            frames++;
+            memmove(kws->hist, kws->hist + kws->hop, (kws->hist_size - kws->hop) * sizeof(short));
+            kws->hist_len = kws->hist_size - kws->hop;
+        }
+    }
+    kws->hist_len = 0;
+
+    // 裁掉首尾静音
+    {
+        int floor_q8 = peak - audio_dsp_db_to_log2_q8(KWS_TRIM_DB);
+
+        if (floor_q8 < kws->base_gate_q8) {
+            floor_q8 = kws->base_gate_q8;
+        }
+        for (first = 0; first < frames && energy[first] < floor_q8; first++) {
+        }
+        for (last = frames - 1; last >= first && energy[last] < floor_q8; last--) {
+        }
+    }
+    frames = last - first + 1;
+    if (frames < KWS_MIN_FRAMES || frames > AUDIO_KWS_MAX_FRAMES) {
+        free(feat);
+        free(energy);
+        return -1;
+    }
+
+    tmpl = &kws->tmpl[kws->num_templates++];
+    memcpy(tmpl->feat, feat[first], frames * sizeof(*feat));
+    tmpl->frames = frames;
+    free(feat);
+    free(energy);
+    return frames;
+}
+
+void audio_kws_reset(AUDIO_KWS_S *kws) {
+    int t;
+
+    for (t = 0; t < kws->num_templates; t++) {
+        memset(kws->tmpl[t].len, 0, sizeof(kws->tmpl[t].len));
+    }
+    kws->dtw_live = 0;
+    kws->quiet_run = 0;
+}
+
+void audio_kws_start(AUDIO_KWS_S *kws) {
+    if (kws->config.threshold <= 0 && kws->num_templates >= 2) {
+        long long sum = 0;
+        int pairs = 0;
+        int a;
+        int b;
+
+        for (a = 0; a < kws->num_templates; a++) {
+            for (b = a + 1; b < kws->num_templates; b++) {
+                sum += template_distance(&kws->tmpl[a], &kws->tmpl[b]);
+                pairs++;
+            }
+        }
+        kws->threshold = (int)(sum / pairs * KWS_AUTO_MARGIN_PCT / 100);
+    }
+    kws->hist_len = 0;
+    kws->preemph_prev = 0;
+    kws->refractory = 0;
+    audio_kws_reset(kws);
+}
+
+// 流式子序列DTW：输入一帧特征，返回模板完整匹配的平均距离，没有完整匹配返回-1。
+// 每个输入帧在模板上前进0~2帧（前驱为上一列的j、j-1、j-2），所以匹配时长至少是模板的一半；
+// 同时限制最长为模板的两倍。从后往前原地更新，读到的都是上一列的值
+static int dtw_step(AUDIO_KWS_TEMPLATE_S *tmpl, const int *x, unsigned int frame_index) {
+    unsigned int max_span = tmpl->frames * 2;
+    int j;
+    int k;
+
+    for (j = tmpl->frames - 1; j >= 0; j--) {
+        int best_cost = 0;
+        int best_len = 0;
+        unsigned int best_start = frame_index;
+
+        // 关键词可以从任意位置开始，所以第0帧总是重新开始；其余帧取平均距离最小的前驱
+        for (k = 0; j > 0 && k <= 2 && k <= j; k++) {
+            int p = j - k;
+
+            if (tmpl->len[p] > 0 && frame_index - tmpl->start[p] < max_span &&
+                avg_less(tmpl->cost[p], tmpl->len[p], best_cost, best_len)) {
+                best_cost = tmpl->cost[p];
+                best_len = tmpl->len[p];
+                best_start = tmpl->start[p];
+            }
+        }
+        if (j > 0 && best_len == 0) {
+            tmpl->len[j] = 0;
+            continue;
+        }
+        tmpl->cost[j] = best_cost + ceps_distance(x, tmpl->feat[j]);
+        tmpl->len[j] = best_len + 1;
+        tmpl->start[j] = best_start;
+    }
+
+    j = tmpl->frames - 1;
+    return tmpl->len[j] > 0 ? tmpl->cost[j] / tmpl->len[j] : -1;
+}
+
+static int process_frame(AUDIO_KWS_S *kws, const short *frame) {
+    int ceps[AUDIO_KWS_NUM_CEPS];
+    int best = -1;
+    int t;
+
+    kws->stats.frames++;
+    kws->frame_index++;
+    if (kws->refractory > 0) {
+        kws->refractory--;
+        return 0;
+    }
+    if (frame_energy(frame, kws->window) < kws->gate_q8) {
+        if (++kws->quiet_run >= KWS_QUIET_RESET_FRAMES) {
+            if (kws->dtw_live) {
+                audio_kws_reset(kws);
+            }
+            return 0;
+        }
+    } else {
+        kws->quiet_run = 0;
+    }
+
+    kws->stats.active_frames++;
+    kws->dtw_live = 1;
+    frame_mfcc(kws, frame, ceps);
+    for (t = 0; t < kws->num_templates; t++) {
+        int score = dtw_step(&kws->tmpl[t], ceps, kws->frame_index);
+        if (score >= 0 && (best < 0 || score < best)) {
+            best = score;
+        }
+    }
+    if (best < 0) {
+        return 0;
+    }
+    if (kws->stats.best_score < 0 || best < kws->stats.best_score) {
+        kws->stats.best_score = best;
+    }
+    if (best > kws->threshold) {
+        return 0;
+    }
+
+    kws->stats.detections++;
+    kws->stats.last_score = best;
+    kws->stats.best_score = -1;
+    kws->refractory = kws->config.refractory_ms / AUDIO_KWS_HOP_MS;
+    audio_kws_reset(kws);
+    return 1;
+}
+
+static unsigned long long thread_cpu_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// 按预算调整能量门限：每秒音频统计一次CPU占用
+static void budget_update(AUDIO_KWS_S *kws, unsigned long long cpu_us, unsigned int frames) {
+    unsigned long long audio_us;
+    int max_gate;
+    int pct;
+
+    kws->window_cpu_us += cpu_us;
+    kws->window_frames += frames;
+    if (kws->config.cpu_budget_pct <= 0 || kws->window_frames * AUDIO_KWS_HOP_MS < KWS_BUDGET_WINDOW_MS) {
+        return;
+    }
+    audio_us = (unsigned long long)kws->window_frames * kws->hop * 1000000ULL / kws->config.sample_rate;
+    pct = (int)(kws->window_cpu_us * 100 / audio_us);
+    max_gate = kws->base_gate_q8 + audio_dsp_db_to_log2_q8(KWS_GATE_MAX_RAISE_DB);
+    if (pct > kws->config.cpu_budget_pct && kws->gate_q8 < max_gate) {
+        kws->gate_q8 += audio_dsp_db_to_log2_q8(KWS_GATE_STEP_DB);
+    } else if (pct * 2 < kws->config.cpu_budget_pct && kws->gate_q8 > kws->base_gate_q8) {
+        kws->gate_q8 -= audio_dsp_db_to_log2_q8(KWS_GATE_STEP_DB);
+    }
+    kws->stats.gate_db = audio_dsp_log2_q8_to_db(kws->gate_q8) - AUDIO_DSP_FULL_SCALE_DB;
+    kws->window_cpu_us = 0;
+    kws->window_frames = 0;
+}
+
+int audio_kws_process(AUDIO_KWS_S *kws, const void *pcm, unsigned int len) {
+    const short *src = (const short *)pcm;
+    int ch = kws->config.channels;
+    unsigned int samples = len / (ch * sizeof(short));
+    unsigned long frames_before = kws->stats.frames;
+    unsigned long long t0;
+    unsigned long long cost;
+    int detected = 0;
+    unsigned int i;
+
+    if (kws->num_templates == 0 || samples == 0) {
+        return 0;
+    }
+    t0 = thread_cpu_us();
+    for (i = 0; i < samples; i++) {
+        int x = src[i * ch];
+        int y = x - ((kws->preemph_prev * KWS_PREEMPH_Q15) >> 15);
+
+        kws->preemph_prev = x;
+        kws->hist[kws->hist_len++] = (short)(y > 32767 ? 32767 : (y < -32768 ? -32768 : y));
+        if (kws->hist_len == kws->hist_size) {
+            if (process_frame(kws, kws->hist + kws->hist_size - kws->window)) {
+                detected = 1;
+            }
+            memmove(kws->hist, kws->hist + kws->hop, (kws->hist_size - kws->hop) * sizeof(short));
+            kws->hist_len = kws->hist_size - kws->hop;
+        }
+    }
+    cost = thread_cpu_us() - t0;
+    kws->total_samples += samples;
+    kws->stats.audio_ms = kws->total_samples * 1000 / kws->config.sample_rate;
+    kws->stats.cpu_us += cost;
+    budget_update(kws, cost, (unsigned int)(kws->stats.frames - frames_before));
+    return detected;
+}
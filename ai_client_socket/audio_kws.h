@@ -0,0 +1,111 @@
+/*
+ * 设备端关键词（唤醒词）检测
+ *
+ * 在空闲时持续处理录音设备的数据，检测到关键词后由调用者在本地触发开始录音，
+ * 不再需要等待服务器的"开始录音"消息。
+ *
+ * 特征：32ms窗、16ms帧移的MFCC（预加重 + Hann窗定点FFT + 20个Mel滤波器 + log2 + DCT取c1..c12），
+ *      全部是整数运算，查表在初始化时生成一次。
+ * 打分：每个模板一条流式子序列DTW（起点不限），按平均每帧倒谱L1距离打分，
+ *      匹配时长限制在模板长度的一半到两倍之间，平均距离低于阈值即判为检测到关键词。
+ * 模板：用同一设备录制的关键词PCM（和录音格式相同），初始化时按能量裁掉首尾静音；
+ *      有两个以上模板且未指定阈值时，用模板之间的DTW距离自动估计阈值。
+ * CPU：能量低于门限的静音帧只做能量计算；按音频时长统计CPU占用，超过预算时逐步抬高能量门限，
+ *      低于预算一半时再慢慢降回。
+ * 只在录音线程中使用，不加锁。
+ */
+
+#ifndef AUDIO_KWS_H
+#define AUDIO_KWS_H
+
+#include "audio_dsp.h"
+
+#define AUDIO_KWS_HOP_MS            (16)
+#define AUDIO_KWS_WINDOW_MS         (32)
+#define AUDIO_KWS_NUM_MELS          (20)
+#define AUDIO_KWS_NUM_CEPS          (12)
+#define AUDIO_KWS_MAX_TEMPLATES     (4)
+#define AUDIO_KWS_MAX_FRAMES        (96)    // 单个模板最多帧数（约1.5s）
+
+typedef struct _AudioKwsConfig {
+    int sample_rate;
+    int channels;
+    int threshold;              // 平均每帧倒谱L1距离阈值，0=自动（模板间距离估计，或默认值）
+    int refractory_ms;          // 检测到关键词后多久内不再检测
+    int min_energy_db;          // 能量门限（dBFS），低于它的帧不计算MFCC
+    int cpu_budget_pct;         // CPU预算（占单核实时的百分比），0=不限制
+} AUDIO_KWS_CONFIG_S;
+
+typedef struct _AudioKwsTemplate {
+    int                 feat[AUDIO_KWS_MAX_FRAMES][AUDIO_KWS_NUM_CEPS];
+    int                 frames;
+    // 流式DTW的当前列：到模板第j帧的累计距离、路径长度、匹配起点
+    int                 cost[AUDIO_KWS_MAX_FRAMES];
+    int                 len[AUDIO_KWS_MAX_FRAMES];
+    unsigned int        start[AUDIO_KWS_MAX_FRAMES];
+} AUDIO_KWS_TEMPLATE_S;
+
+typedef struct _AudioKwsStats {
+    unsigned long       frames;             // 分析帧总数
+    unsigned long       active_frames;      // 超过能量门限、计算了MFCC和DTW的帧数
+    unsigned long       detections;
+    unsigned long long  cpu_us;             // 处理耗时（线程CPU时间）
+    unsigned long long  audio_ms;           // 处理的音频时长
+    int                 last_score;         // 最近一次检测的得分
+    int                 best_score;         // 上次检测以来的最低得分（调阈值用），-1表示还没有
+    int                 gate_db;            // 当前能量门限（dBFS）
+} AUDIO_KWS_STATS_S;
+
+typedef struct _AudioKws {
+    AUDIO_KWS_CONFIG_S  config;
+    int                 window;             // 分析窗采样数
+    int                 hop;                // 帧移采样数
+    int                 fft_log2;
+    int                 threshold;          // 实际使用的阈值
+
+    // Mel滤波器：每个滤波器覆盖的FFT频点范围和Q15权重（权重按频点连续存放）
+    int                 mel_first[AUDIO_KWS_NUM_MELS];
+    int                 mel_count[AUDIO_KWS_NUM_MELS];
+    short              *mel_weight;
+    short               dct_q15[AUDIO_KWS_NUM_CEPS][AUDIO_KWS_NUM_MELS];
+
+    short              *hist;               // 预加重后的单声道样本
+    int                 hist_size;          // max(window, hop)
+    int                 hist_len;
+    int                 preemph_prev;
+    unsigned long long  total_samples;
+
+    AUDIO_KWS_TEMPLATE_S tmpl[AUDIO_KWS_MAX_TEMPLATES];
+    int                 num_templates;
+
+    unsigned int        frame_index;        // 当前帧号（DTW起点和时长判断用）
+    int                 quiet_run;          // 连续低能量帧数
+    int                 dtw_live;           // DTW列中是否有有效路径
+    int                 refractory;         // 剩余的不检测帧数
+    int                 gate_q8;            // 当前能量门限（log2 Q8）
+    int                 base_gate_q8;
+    unsigned long long  window_cpu_us;      // 预算统计窗口
+    unsigned int        window_frames;
+
+    AUDIO_KWS_STATS_S   stats;
+
+    // 分析缓冲区
+    short               re[AUDIO_DSP_MAX_FFT];
+    short               im[AUDIO_DSP_MAX_FFT];
+    unsigned int        power[AUDIO_DSP_MAX_FFT / 2 + 1];
+} AUDIO_KWS_S;
+
+void audio_kws_default_config(AUDIO_KWS_CONFIG_S *config, int sample_rate, int channels);
+int  audio_kws_init(AUDIO_KWS_S *kws, const AUDIO_KWS_CONFIG_S *config);
+void audio_kws_deinit(AUDIO_KWS_S *kws);
+
+// 从关键词录音（与录音相同格式的PCM）添加一个模板，返回模板帧数，-1表示失败
+int  audio_kws_add_template(AUDIO_KWS_S *kws, const void *pcm, unsigned int len);
+// 添加完模板后调用：确定阈值并清空检测状态
+void audio_kws_start(AUDIO_KWS_S *kws);
+// 清空检测状态（例如录音结束重新开始监听时）
+void audio_kws_reset(AUDIO_KWS_S *kws);
+// 处理录音数据（按完整采样帧，不足一个采样帧的尾部丢弃），检测到关键词返回1，否则0
+int  audio_kws_process(AUDIO_KWS_S *kws, const void *pcm, unsigned int len);
+
+#endif // AUDIO_KWS_H
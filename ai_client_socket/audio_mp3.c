@@ -0,0 +1,85 @@
+/*
+ * MP3帧头解析实现
+ * 详细说明见 audio_mp3.h
+ */
+
+#include <string.h>
+
+#include "audio_mp3.h"
+
+// [MPEG1/MPEG2(2.5)][层-1][码率索引]，单位kbps
+static const short s_mp3_bitrates[2][3][15] = {
+    {
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+    },
+    {
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+    },
+};
+
+static const int s_mp3_sample_rates[3] = {44100, 48000, 32000};
+
+int audio_mp3_parse_header(const unsigned char *p, MP3_FRAME_INFO_S *info) {
+    int version_bits;
+    int layer_bits;
+    int bitrate_index;
+    int rate_index;
+    int padding;
+    int lsf;
+
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) {
+        return -1;
+    }
+    version_bits = (p[1] >> 3) & 0x03;
+    layer_bits = (p[1] >> 1) & 0x03;
+    bitrate_index = p[2] >> 4;
+    rate_index = (p[2] >> 2) & 0x03;
+    padding = (p[2] >> 1) & 0x01;
+
+    // 保留值和自由码率都不支持
+    if (version_bits == 1 || layer_bits == 0 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return -1;
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->version = version_bits == 3 ? 10 : (version_bits == 2 ? 20 : 25);
+    info->layer = 4 - layer_bits;
+    lsf = info->version != 10;
+    info->bitrate_kbps = s_mp3_bitrates[lsf][info->layer - 1][bitrate_index];
+    info->sample_rate = s_mp3_sample_rates[rate_index] >> (info->version == 10 ? 0 : (info->version == 20 ? 1 : 2));
+    info->channels = (p[3] >> 6) == 3 ? 1 : 2;
+
+    if (info->layer == 1) {
+        info->samples = 384;
+        info->frame_bytes = (12 * info->bitrate_kbps * 1000 / info->sample_rate + padding) * 4;
+    } else {
+        info->samples = (info->layer == 3 && lsf) ? 576 : 1152;
+        info->frame_bytes = info->samples / 8 * info->bitrate_kbps * 1000 / info->sample_rate + padding;
+    }
+    return 0;
+}
+
+int audio_mp3_find_frame(const unsigned char *data, unsigned int len, MP3_FRAME_INFO_S *info) {
+    unsigned int i;
+
+    for (i = 0; i + AUDIO_MP3_HEADER_SIZE <= len; i++) {
+        MP3_FRAME_INFO_S next;
+        unsigned int next_pos;
+
+        if (audio_mp3_parse_header(data + i, info) != 0) {
+            continue;
+        }
+        next_pos = i + info->frame_bytes;
+        if (next_pos + AUDIO_MP3_HEADER_SIZE <= len &&
+            (audio_mp3_parse_header(data + next_pos, &next) != 0 ||
+             next.sample_rate != info->sample_rate || next.layer != info->layer)) {
+            continue;
+        }
+        return (int)i;
+    }
+    return -1;
+}
@@ -0,0 +1,29 @@
+/*
+ * MP3帧头解析
+ *
+ * 服务器以audio_format=mp3直接转发TTS的MP3数据时，客户端需要在打开播放设备前知道
+ * 采样率和声道数：在收到的数据中找到第一个有效帧头并解析。解码本身由rockit ADEC完成。
+ */
+
+#ifndef AUDIO_MP3_H
+#define AUDIO_MP3_H
+
+#define AUDIO_MP3_HEADER_SIZE   4
+
+typedef struct _Mp3FrameInfo {
+    int version;        // 10=MPEG1, 20=MPEG2, 25=MPEG2.5
+    int layer;          // 1/2/3
+    int bitrate_kbps;
+    int sample_rate;
+    int channels;
+    int samples;        // 每帧采样数（每声道）
+    int frame_bytes;    // 帧长（含帧头）
+} MP3_FRAME_INFO_S;
+
+// 解析p处的4字节帧头，有效返回0
+int audio_mp3_parse_header(const unsigned char *p, MP3_FRAME_INFO_S *info);
+// 在数据中查找第一个有效帧头，返回偏移，没找到返回-1；
+// 后一帧的帧头也在数据范围内时要求其同样有效，避免把数据中的0xFF误当作同步字
+int audio_mp3_find_frame(const unsigned char *data, unsigned int len, MP3_FRAME_INFO_S *info);
+
+#endif // AUDIO_MP3_H
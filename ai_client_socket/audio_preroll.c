@@ -0,0 +1,103 @@
+/*
+ * 录音预录环实现
+ * 详细说明见 audio_preroll.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_preroll.h"
+
+int audio_preroll_init(AUDIO_PREROLL_S *preroll, unsigned int bytes, unsigned int align) {
+    memset(preroll, 0, sizeof(*preroll));
+    if (align == 0) {
+        align = 1;
+    }
+    preroll->align = align;
+    bytes -= bytes % align;
+    if (bytes == 0) {
+        return 0;
+    }
+    preroll->buf = (unsigned char *)malloc(bytes);
+    if (!preroll->buf) {
+        return -1;
+    }
+    preroll->size = bytes;
+    return 0;
+}
+
+void audio_preroll_deinit(AUDIO_PREROLL_S *preroll) {
+    free(preroll->buf);
+    preroll->buf = NULL;
+    preroll->size = 0;
+    preroll->pos = 0;
+    preroll->used = 0;
+}
+
+void audio_preroll_reset(AUDIO_PREROLL_S *preroll) {
+    preroll->pos = 0;
+    preroll->used = 0;
+}
+
+void audio_preroll_write(AUDIO_PREROLL_S *preroll, const void *data, unsigned int len) {
+    const unsigned char *src = (const unsigned char *)data;
+    unsigned int first;
+
+    if (preroll->size == 0 || len == 0) {
+        return;
+    }
+    len -= len % preroll->align;
+    preroll->written_bytes += len;
+    // 超过容量时只有最后size字节有意义
+    if (len >= preroll->size) {
+        memcpy(preroll->buf, src + len - preroll->size, preroll->size);
+        preroll->pos = 0;
+        preroll->used = preroll->size;
+        return;
+    }
+
+    first = preroll->size - preroll->pos;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(preroll->buf + preroll->pos, src, first);
+    if (len > first) {
+        memcpy(preroll->buf, src + first, len - first);
+    }
+    preroll->pos = (preroll->pos + len) % preroll->size;
+    preroll->used += len;
+    if (preroll->used > preroll->size) {
+        preroll->used = preroll->size;
+    }
+}
+
+unsigned int audio_preroll_used(const AUDIO_PREROLL_S *preroll) {
+    return preroll->used;
+}
+
+unsigned int audio_preroll_take(AUDIO_PREROLL_S *preroll, const unsigned char **first, unsigned int *first_len,
+                                const unsigned char **second, unsigned int *second_len) {
+    unsigned int start;
+
+    *first = NULL;
+    *first_len = 0;
+    *second = NULL;
+    *second_len = 0;
+    if (preroll->used == 0) {
+        return 0;
+    }
+
+    // 最旧数据的位置：写入位置往前used字节
+    start = (preroll->pos + preroll->size - preroll->used) % preroll->size;
+    *first = preroll->buf + start;
+    if (start + preroll->used <= preroll->size) {
+        *first_len = preroll->used;
+    } else {
+        *first_len = preroll->size - start;
+        *second = preroll->buf;
+        *second_len = preroll->used - *first_len;
+    }
+    preroll->used_count++;
+    preroll->used_bytes += preroll->used;
+    return preroll->used;
+}
@@ -0,0 +1,40 @@
+/*
+ * 录音预录环（pre-roll）
+ *
+ * 录音设备在等待按键/开始录音命令期间持续采集，最近N毫秒的PCM保存在固定大小的循环缓冲区中，
+ * 新数据覆盖最旧的数据。开始录音时把预录内容按时间顺序放在上传数据最前面，
+ * 避免开始录音命令到达之前说出的第一个字被截掉。
+ * - 缓冲区只在初始化时分配一次，写入/读取不分配内存
+ * - 容量和写入长度按采样帧（声道数 x 位宽）对齐，读出的数据可以直接送给编码器
+ * - 只在录音线程中使用，不加锁
+ */
+
+#ifndef AUDIO_PREROLL_H
+#define AUDIO_PREROLL_H
+
+typedef struct _AudioPreroll {
+    unsigned char *buf;
+    unsigned int   size;            // 容量（字节），0表示未启用
+    unsigned int   align;           // 采样帧字节数
+    unsigned int   pos;             // 下一次写入位置
+    unsigned int   used;            // 有效数据字节数（<= size）
+
+    // 统计
+    unsigned long  written_bytes;   // 累计写入字节数
+    unsigned long  used_count;      // 预录内容被取用的次数
+    unsigned long  used_bytes;      // 累计取用的字节数
+} AUDIO_PREROLL_S;
+
+// bytes为0时不分配缓冲区，之后的写入直接忽略
+int          audio_preroll_init(AUDIO_PREROLL_S *preroll, unsigned int bytes, unsigned int align);
+void         audio_preroll_deinit(AUDIO_PREROLL_S *preroll);
+// 丢弃全部预录内容（不释放缓冲区）
+void         audio_preroll_reset(AUDIO_PREROLL_S *preroll);
+// 追加数据，超过容量时覆盖最旧的数据
+void         audio_preroll_write(AUDIO_PREROLL_S *preroll, const void *data, unsigned int len);
+unsigned int audio_preroll_used(const AUDIO_PREROLL_S *preroll);
+// 按时间顺序取得预录内容（最多两段，first在前），返回总字节数，并计入取用统计
+unsigned int audio_preroll_take(AUDIO_PREROLL_S *preroll, const unsigned char **first, unsigned int *first_len,
+                                const unsigned char **second, unsigned int *second_len);
+
+#endif // AUDIO_PREROLL_H
@@ -0,0 +1,431 @@
+/*
+ * 采样率与声道转换实现
+ * 详细说明见 audio_resample.h
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "audio_resample.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RESAMPLE_CUTOFF         (0.90)      // 截止频率（较低Nyquist的比例）
+#define RESAMPLE_KAISER_BETA    (6.0)       // 阻带约60dB
+#define RESAMPLE_COEF_SHIFT     (14)        // 系数Q14：每相系数绝对值之和可达2，Q15时满幅输入的内积可能超出int32
+#define RESAMPLE_COEF_ONE       (1 << RESAMPLE_COEF_SHIFT)
+
+static int gcd(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// 第一类零阶修正贝塞尔函数（Kaiser窗用）
+static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    int k;
+
+    for (k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// 原型低通长度为taps*L（按L倍升采样后的采样率设计），第p相取h[p + i*L]，
+// 按时间正序存放：coef[p][taps-1-i] = h[p + i*L]，与历史数据（旧->新）直接做内积
+static int build_filter(AUDIO_RESAMPLE_S *rs) {
+    int up = rs->up;
+    int taps = rs->taps;
+    int length = taps * up;
+    double center = (length - 1) / 2.0;
+    double fc = RESAMPLE_CUTOFF * 0.5 / (up > rs->down ? up : rs->down);
+    double norm = bessel_i0(RESAMPLE_KAISER_BETA);
+    double *h = (double *)malloc(length * sizeof(double));
+    int p;
+    int i;
+
+    rs->coef = (short *)malloc((size_t)up * taps * sizeof(short));
+    if (!h || !rs->coef) {
+        free(h);
+        return -1;
+    }
+    for (i = 0; i < length; i++) {
+        double t = i - center;
+        double r = t / (center + 0.5);
+        double sinc = t == 0.0 ? 1.0 : sin(2.0 * M_PI * fc * t) / (2.0 * M_PI * fc * t);
+
+        h[i] = sinc * bessel_i0(RESAMPLE_KAISER_BETA * sqrt(r * r < 1.0 ? 1.0 - r * r : 0.0)) / norm;
+    }
+
+    // 每相归一化为直流增益1，舍入误差补到最大的抽头上
+    for (p = 0; p < up; p++) {
+        short *c = rs->coef + p * taps;
+        double sum = 0.0;
+        int total = 0;
+        int peak = 0;
+
+        for (i = 0; i < taps; i++) {
+            sum += h[p + i * up];
+        }
+        for (i = 0; i < taps; i++) {
+            long v = lround(h[p + i * up] / sum * RESAMPLE_COEF_ONE);
+
+            c[taps - 1 - i] = (short)v;
+            total += (int)v;
+        }
+        for (i = 1; i < taps; i++) {
+            if (abs(c[i]) > abs(c[peak])) {
+                peak = i;
+            }
+        }
+        c[peak] = (short)(c[peak] + (RESAMPLE_COEF_ONE - total));
+    }
+    free(h);
+    return 0;
+}
+
+int audio_resample_init(AUDIO_RESAMPLE_S *rs, int in_rate, int in_channels, int out_rate, int out_channels) {
+    int g;
+    int c;
+    unsigned int mix_frames;
+
+    memset(rs, 0, sizeof(*rs));
+    if (in_rate < 8000 || in_rate > 96000 || out_rate < 8000 || out_rate > 96000 ||
+        in_channels <= 0 || in_channels > AUDIO_RESAMPLE_MAX_CHANNELS ||
+        out_channels <= 0 || out_channels > AUDIO_RESAMPLE_MAX_CHANNELS) {
+        return -1;
+    }
+    rs->in_rate = in_rate;
+    rs->in_channels = in_channels;
+    rs->out_rate = out_rate;
+    rs->out_channels = out_channels;
+    rs->channels = in_channels < out_channels ? in_channels : out_channels;
+    rs->passthrough = (in_rate == out_rate && in_channels == out_channels);
+
+    g = gcd(in_rate, out_rate);
+    rs->up = out_rate / g;
+    rs->down = in_rate / g;
+    if (rs->up > AUDIO_RESAMPLE_MAX_PHASES || rs->down > rs->up * AUDIO_RESAMPLE_MAX_RATIO) {
+        return -1;
+    }
+    if (rs->passthrough) {
+        return 0;
+    }
+
+    // 声道转换的中间缓冲区：一个输入块的混音结果，或一个块产生的全部输出（扩展声道前）
+    mix_frames = (unsigned int)AUDIO_RESAMPLE_BLOCK * rs->up / rs->down + 2;
+    if (mix_frames < AUDIO_RESAMPLE_BLOCK) {
+        mix_frames = AUDIO_RESAMPLE_BLOCK;
+    }
+    rs->mix = (short *)malloc(mix_frames * AUDIO_RESAMPLE_MAX_CHANNELS * sizeof(short));
+    rs->stage = (short *)malloc(AUDIO_RESAMPLE_BLOCK * in_channels * sizeof(short));
+    if (!rs->mix || !rs->stage) {
+        audio_resample_deinit(rs);
+        return -1;
+    }
+    if (rs->up == rs->down) {
+        return 0;
+    }
+
+    rs->taps = AUDIO_RESAMPLE_TAPS;
+    if (rs->down > rs->up) {
+        rs->taps = (AUDIO_RESAMPLE_TAPS * rs->down / rs->up + 7) / 8 * 8;
+    }
+    rs->hist_size = rs->taps - 1 + AUDIO_RESAMPLE_BLOCK;
+    for (c = 0; c < rs->channels; c++) {
+        rs->hist[c] = (short *)malloc(rs->hist_size * sizeof(short));
+        if (!rs->hist[c]) {
+            audio_resample_deinit(rs);
+            return -1;
+        }
+    }
+    if (build_filter(rs) != 0) {
+        audio_resample_deinit(rs);
+        return -1;
+    }
+    audio_resample_reset(rs);
+    return 0;
+}
+
+void audio_resample_deinit(AUDIO_RESAMPLE_S *rs) {
+    int c;
+
+    for (c = 0; c < AUDIO_RESAMPLE_MAX_CHANNELS; c++) {
+        free(rs->hist[c]);
+        rs->hist[c] = NULL;
+    }
+    free(rs->coef);
+    free(rs->mix);
+    free(rs->stage);
+    rs->coef = NULL;
+    rs->mix = NULL;
+    rs->stage = NULL;
+}
+
+void audio_resample_reset(AUDIO_RESAMPLE_S *rs) {
+    int c;
+
+    // 前taps-1帧补零，第一个输入帧即可产生输出
+    for (c = 0; c < rs->channels; c++) {
+        if (rs->hist[c]) {
+            memset(rs->hist[c], 0, (rs->taps - 1) * sizeof(short));
+        }
+    }
+    rs->hist_len = rs->taps > 0 ? rs->taps - 1 : 0;
+    rs->phase = 0;
+    rs->partial_len = 0;
+}
+
+unsigned int audio_resample_max_output(const AUDIO_RESAMPLE_S *rs, unsigned int len) {
+    unsigned int frames;
+
+    if (rs->passthrough) {
+        return len;
+    }
+    frames = (len + rs->partial_len) / (rs->in_channels * sizeof(short));
+    return (unsigned int)(((unsigned long long)frames * rs->up / rs->down + 2) * rs->out_channels * sizeof(short));
+}
+
+// ==================== kernel ====================
+
+static inline short sat16(int v) {
+    return (short)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+}
+
+// 定点内积，n为8的倍数
+static inline int dot_fixed(const short *x, const short *h, int n) {
+#ifdef __ARM_NEON
+    int32x4_t acc0 = vdupq_n_s32(0);
+    int32x4_t acc1 = vdupq_n_s32(0);
+    int i;
+
+    for (i = 0; i < n; i += 8) {
+        int16x8_t a = vld1q_s16(x + i);
+        int16x8_t b = vld1q_s16(h + i);
+
+        acc0 = vmlal_s16(acc0, vget_low_s16(a), vget_low_s16(b));
+        acc1 = vmlal_s16(acc1, vget_high_s16(a), vget_high_s16(b));
+    }
+    acc0 = vaddq_s32(acc0, acc1);
+#if defined(__aarch64__)
+    return vaddvq_s32(acc0);
+#else
+    {
+        int32x2_t s = vadd_s32(vget_low_s32(acc0), vget_high_s32(acc0));
+        return vget_lane_s32(vpadd_s32(s, s), 0);
+    }
+#endif
+#else
+    int acc = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        acc += x[i] * h[i];
+    }
+    return acc;
+#endif
+}
+
+void audio_downmix_s16(const short *in, int in_channels, short *out, int out_channels, unsigned int frames) {
+    unsigned int i = 0;
+    int c;
+
+    if (out_channels == 1 && in_channels == 2) {
+        // 最常见的立体声转单声道：(L+R)>>1
+#ifdef __ARM_NEON
+        for (; i + 8 <= frames; i += 8) {
+            int16x8x2_t v = vld2q_s16(in + 2 * i);
+            vst1q_s16(out + i, vhaddq_s16(v.val[0], v.val[1]));
+        }
+#endif
+        for (; i < frames; i++) {
+            out[i] = (short)((in[2 * i] + in[2 * i + 1]) >> 1);
+        }
+        return;
+    }
+    if (out_channels == 1) {
+        for (; i < frames; i++) {
+            int sum = 0;
+            for (c = 0; c < in_channels; c++) {
+                sum += in[i * in_channels + c];
+            }
+            out[i] = (short)(sum / in_channels);
+        }
+        return;
+    }
+    // 转为较少的多声道：保留前out_channels个声道
+    for (; i < frames; i++) {
+        memcpy(out + i * out_channels, in + i * in_channels, out_channels * sizeof(short));
+    }
+}
+
+void audio_upmix_s16(const short *in, int in_channels, short *out, int out_channels, unsigned int frames) {
+    unsigned int i = 0;
+    int c;
+
+    if (in_channels == 1 && out_channels == 2) {
+#ifdef __ARM_NEON
+        for (; i + 8 <= frames; i += 8) {
+            int16x8x2_t v;
+            v.val[0] = vld1q_s16(in + i);
+            v.val[1] = v.val[0];
+            vst2q_s16(out + 2 * i, v);
+        }
+#endif
+        for (; i < frames; i++) {
+            out[2 * i] = in[i];
+            out[2 * i + 1] = in[i];
+        }
+        return;
+    }
+    for (; i < frames; i++) {
+        for (c = 0; c < out_channels; c++) {
+            out[i * out_channels + c] = in[i * in_channels + c % in_channels];
+        }
+    }
+}
+
+// ==================== 流式处理 ====================
+
+// 一块按channels交织的输入帧进入历史缓冲区，产生所有可以计算的输出（按channels交织），返回输出帧数
+static unsigned int filter_block(AUDIO_RESAMPLE_S *rs, const short *in, unsigned int frames, short *out) {
+    int ch = rs->channels;
+    int taps = rs->taps;
+    int pos = 0;
+    unsigned int produced = 0;
+    unsigned int i;
+    int c;
+
+    // 拆成按声道连续存放，内积时两边都是连续内存
+    if (ch == 1) {
+        memcpy(rs->hist[0] + rs->hist_len, in, frames * sizeof(short));
+    } else {
+        for (c = 0; c < ch; c++) {
+            short *dst = rs->hist[c] + rs->hist_len;
+            for (i = 0; i < frames; i++) {
+                dst[i] = in[i * ch + c];
+            }
+        }
+    }
+    rs->hist_len += frames;
+
+    while (pos + taps <= rs->hist_len) {
+        const short *h = rs->coef + rs->phase * taps;
+
+        for (c = 0; c < ch; c++) {
+            out[produced * ch + c] = sat16((dot_fixed(rs->hist[c] + pos, h, taps) + (RESAMPLE_COEF_ONE >> 1)) >> RESAMPLE_COEF_SHIFT);
+        }
+        produced++;
+        rs->phase += rs->down;
+        pos += rs->phase / rs->up;
+        rs->phase %= rs->up;
+    }
+
+    // 保留下一个输出需要的历史
+    for (c = 0; c < ch; c++) {
+        memmove(rs->hist[c], rs->hist[c] + pos, (rs->hist_len - pos) * sizeof(short));
+    }
+    rs->hist_len -= pos;
+    return produced;
+}
+
+// 处理一块完整的输入帧（不超过AUDIO_RESAMPLE_BLOCK），返回输出帧数
+static unsigned int convert_block(AUDIO_RESAMPLE_S *rs, const short *in, unsigned int frames, short *out) {
+    unsigned int produced;
+
+    if (rs->up == rs->down) {
+        if (rs->out_channels < rs->in_channels) {
+            audio_downmix_s16(in, rs->in_channels, out, rs->out_channels, frames);
+        } else {
+            audio_upmix_s16(in, rs->in_channels, out, rs->out_channels, frames);
+        }
+        return frames;
+    }
+    if (rs->out_channels < rs->in_channels) {
+        audio_downmix_s16(in, rs->in_channels, rs->mix, rs->channels, frames);
+        in = rs->mix;
+    }
+    if (rs->out_channels > rs->channels) {
+        produced = filter_block(rs, in, frames, rs->mix);
+        audio_upmix_s16(rs->mix, rs->channels, out, rs->out_channels, produced);
+        return produced;
+    }
+    return filter_block(rs, in, frames, out);
+}
+
+int audio_resample_process(AUDIO_RESAMPLE_S *rs, const void *in, unsigned int len, void *out, unsigned int out_size) {
+    const unsigned char *src = (const unsigned char *)in;
+    short *dst = (short *)out;
+    unsigned int frame_bytes = rs->in_channels * sizeof(short);
+    unsigned int out_frames = 0;
+
+    if (out_size < audio_resample_max_output(rs, len)) {
+        return -1;
+    }
+    if (rs->passthrough) {
+        memcpy(out, in, len);
+        return (int)len;
+    }
+
+    // 先补齐上次不足一帧的部分
+    if (rs->partial_len > 0) {
+        unsigned int n = frame_bytes - rs->partial_len;
+
+        if (n > len) {
+            n = len;
+        }
+        memcpy(rs->partial + rs->partial_len, src, n);
+        rs->partial_len += n;
+        src += n;
+        len -= n;
+        if (rs->partial_len < frame_bytes) {
+            return 0;
+        }
+        rs->partial_len = 0;
+        memcpy(rs->stage, rs->partial, frame_bytes);
+        out_frames += convert_block(rs, rs->stage, 1, dst);
+        rs->in_frames++;
+    }
+
+    while (len >= frame_bytes) {
+        unsigned int frames = len / frame_bytes;
+        const short *block = (const short *)src;
+
+        if (frames > AUDIO_RESAMPLE_BLOCK) {
+            frames = AUDIO_RESAMPLE_BLOCK;
+        }
+        // 网络数据可能在奇数字节处截断，之后的数据不再按2字节对齐
+        if (((uintptr_t)src & 1) != 0) {
+            memcpy(rs->stage, src, frames * frame_bytes);
+            block = rs->stage;
+        }
+        out_frames += convert_block(rs, block, frames, dst + out_frames * rs->out_channels);
+        rs->in_frames += frames;
+        src += frames * frame_bytes;
+        len -= frames * frame_bytes;
+    }
+
+    if (len > 0) {
+        memcpy(rs->partial, src, len);
+        rs->partial_len = len;
+    }
+    rs->out_frames += out_frames;
+    return (int)(out_frames * rs->out_channels * sizeof(short));
+}
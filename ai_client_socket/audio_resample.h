@@ -0,0 +1,66 @@
+/*
+ * 采样率与声道转换（录音上传和下行播放共用）
+ *
+ * - 声道：多声道转单声道取平均，转较少的多声道时保留前几个声道；单声道/少声道扩展时按声道循环复制
+ * - 采样率：有理数倍多相FIR（L/M由两个采样率除以最大公约数得到），原型滤波器为Kaiser窗sinc，
+ *   截止频率取两个采样率中较低者Nyquist的90%，初始化时用浮点生成Q14系数表，运行时只用整数运算；
+ *   每相系数单独归一化为直流增益1，避免相位间增益不一致带来的周期性噪声
+ * - 降采样时每相抽头数按M/L加长（保持过渡带宽度），比例超过AUDIO_RESAMPLE_MAX_RATIO时初始化失败
+ * - 声道减少时先混音再重采样，声道增加时先重采样再复制，重采样只处理较少的声道数
+ * - 输入可以在任意字节处截断（网络数据），不足一个采样帧的部分留到下一次
+ * - 内积和混音有NEON实现（编译器定义__ARM_NEON时使用），其他平台用标量实现，结果一致
+ * 缓冲区只在初始化时分配。同一对象只在一个线程中使用，不加锁。
+ */
+
+#ifndef AUDIO_RESAMPLE_H
+#define AUDIO_RESAMPLE_H
+
+#define AUDIO_RESAMPLE_MAX_CHANNELS (8)
+#define AUDIO_RESAMPLE_TAPS         (32)    // 升采样时每相抽头数
+#define AUDIO_RESAMPLE_MAX_RATIO    (4)     // 最大降采样比例（抽头数最多TAPS x RATIO）
+#define AUDIO_RESAMPLE_MAX_PHASES   (1024)  // L上限（例如11025->16000为640）
+#define AUDIO_RESAMPLE_BLOCK        (256)   // 每次送入滤波器的输入帧数
+
+typedef struct _AudioResample {
+    int             in_rate;
+    int             in_channels;
+    int             out_rate;
+    int             out_channels;
+    int             channels;           // 重采样的声道数 = min(输入, 输出)
+    int             passthrough;        // 格式相同，原样复制
+    int             up;                 // L
+    int             down;               // M
+    int             taps;               // 每相抽头数（8的倍数）
+    short          *coef;               // [up][taps]，按时间正序存放，与历史数据直接做内积
+
+    short          *hist[AUDIO_RESAMPLE_MAX_CHANNELS];  // 按声道分开存放的输入（前taps-1帧为上次留下的历史）
+    int             hist_len;           // 历史+新输入的帧数
+    int             hist_size;
+    int             phase;              // 下一个输出样本的相位（0..L-1）
+    short          *mix;                // 混音/扩展声道的中间缓冲区
+    short          *stage;              // 未按2字节对齐的输入先复制到这里
+
+    unsigned char   partial[AUDIO_RESAMPLE_MAX_CHANNELS * 2];  // 不足一个采样帧的输入
+    unsigned int    partial_len;
+
+    // 统计
+    unsigned long   in_frames;
+    unsigned long   out_frames;
+} AUDIO_RESAMPLE_S;
+
+// 采样率8000~96000，声道1~AUDIO_RESAMPLE_MAX_CHANNELS；返回-1表示不支持的格式或内存不足
+int          audio_resample_init(AUDIO_RESAMPLE_S *rs, int in_rate, int in_channels, int out_rate, int out_channels);
+void         audio_resample_deinit(AUDIO_RESAMPLE_S *rs);
+// 清空历史（新的一段音频开始时调用）
+void         audio_resample_reset(AUDIO_RESAMPLE_S *rs);
+// 输入len字节时最多产生的输出字节数
+unsigned int audio_resample_max_output(const AUDIO_RESAMPLE_S *rs, unsigned int len);
+// 转换int16交织PCM，返回写入out的字节数；out_size小于audio_resample_max_output(len)时返回-1
+int          audio_resample_process(AUDIO_RESAMPLE_S *rs, const void *in, unsigned int len, void *out,
+                                    unsigned int out_size);
+
+// 声道转换kernel（采样率不变），in和out不能重叠
+void         audio_downmix_s16(const short *in, int in_channels, short *out, int out_channels, unsigned int frames);
+void         audio_upmix_s16(const short *in, int in_channels, short *out, int out_channels, unsigned int frames);
+
+#endif // AUDIO_RESAMPLE_H
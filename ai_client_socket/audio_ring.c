@@ -0,0 +1,200 @@
+/*
+ * 单生产者/单消费者无锁PCM环形缓冲区实现
+ * 详细说明见 audio_ring.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_ring.h"
+
+int audio_ring_init(AUDIO_RING_S *ring, unsigned int size) {
+    memset(ring, 0, sizeof(*ring));
+    if (size == 0 || (size & (size - 1)) != 0) {
+        return -1;
+    }
+    ring->buf = (unsigned char *)malloc(size);
+    if (!ring->buf) {
+        return -1;
+    }
+    ring->size = size;
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->low_watermark, 0);
+    atomic_init(&ring->high_watermark, size);
+    atomic_init(&ring->end_pos, 0);
+    atomic_init(&ring->end_marked, 0);
+    atomic_init(&ring->flush_pos, 0);
+    atomic_init(&ring->flush_seq, 0);
+    ring->flush_done = 0;
+    audio_ring_reset_stats(ring);
+    return 0;
+}
+
+void audio_ring_deinit(AUDIO_RING_S *ring) {
+    free(ring->buf);
+    ring->buf = NULL;
+    ring->size = 0;
+}
+
+void audio_ring_set_watermarks(AUDIO_RING_S *ring, unsigned int low, unsigned int high) {
+    if (high > ring->size) {
+        high = ring->size;
+    }
+    if (low > high) {
+        low = high;
+    }
+    atomic_store_explicit(&ring->low_watermark, low, memory_order_relaxed);
+    atomic_store_explicit(&ring->high_watermark, high, memory_order_relaxed);
+}
+
+void audio_ring_reset_stats(AUDIO_RING_S *ring) {
+    atomic_store_explicit(&ring->underruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->overruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->flushes, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->flushed_bytes, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->max_used, 0, memory_order_relaxed);
+}
+
+unsigned int audio_ring_used(const AUDIO_RING_S *ring) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
+
+unsigned int audio_ring_free(const AUDIO_RING_S *ring) {
+    return ring->size - audio_ring_used(ring);
+}
+
+// ==================== 生产者 ====================
+
+unsigned int audio_ring_write(AUDIO_RING_S *ring, const void *data, unsigned int len) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    unsigned int space = ring->size - (head - tail);
+    unsigned int offset = head & ring->mask;
+    unsigned int first;
+    unsigned int used;
+
+    if (len > space) {
+        atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+        len = space;
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    first = ring->size - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(ring->buf + offset, data, first);
+    memcpy(ring->buf, (const unsigned char *)data + first, len - first);
+
+    // 数据写完后才发布新的head
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+
+    used = head + len - tail;
+    if (used > atomic_load_explicit(&ring->max_used, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->max_used, used, memory_order_relaxed);
+    }
+    return len;
+}
+
+int audio_ring_above_high(const AUDIO_RING_S *ring) {
+    return audio_ring_used(ring) >= atomic_load_explicit(&ring->high_watermark, memory_order_relaxed);
+}
+
+void audio_ring_mark_end(AUDIO_RING_S *ring) {
+    atomic_store_explicit(&ring->end_pos, atomic_load_explicit(&ring->head, memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&ring->end_marked, 1, memory_order_release);
+}
+
+// ==================== 任意线程 ====================
+
+void audio_ring_request_flush(AUDIO_RING_S *ring) {
+    atomic_store_explicit(&ring->flush_pos, atomic_load_explicit(&ring->head, memory_order_acquire),
+                          memory_order_relaxed);
+    atomic_fetch_add_explicit(&ring->flush_seq, 1, memory_order_release);
+}
+
+int audio_ring_end_reached(const AUDIO_RING_S *ring) {
+    unsigned int tail;
+    unsigned int end_pos;
+
+    if (!atomic_load_explicit(&ring->end_marked, memory_order_acquire)) {
+        return 0;
+    }
+    tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    end_pos = atomic_load_explicit(&ring->end_pos, memory_order_relaxed);
+    // 只在读位置正好停在标记处时成立：标记之后写入的数据被读走（或被清空越过）后标记自然失效，
+    // 不需要由其他线程清除，之后数据耗尽仍按欠载统计
+    return tail == end_pos;
+}
+
+// ==================== 消费者 ====================
+
+unsigned int audio_ring_apply_flush(AUDIO_RING_S *ring) {
+    unsigned int seq = atomic_load_explicit(&ring->flush_seq, memory_order_acquire);
+    unsigned int tail;
+    unsigned int target;
+
+    if (seq == ring->flush_done) {
+        return 0;
+    }
+    ring->flush_done = seq;
+
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    target = atomic_load_explicit(&ring->flush_pos, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ring->flushes, 1, memory_order_relaxed);
+    if ((int)(target - tail) <= 0) {
+        return 0;
+    }
+    atomic_store_explicit(&ring->tail, target, memory_order_release);
+    atomic_fetch_add_explicit(&ring->flushed_bytes, target - tail, memory_order_relaxed);
+    return target - tail;
+}
+
+int audio_ring_flush_pending(const AUDIO_RING_S *ring) {
+    return atomic_load_explicit(&ring->flush_seq, memory_order_acquire) != ring->flush_done;
+}
+
+int audio_ring_ready(const AUDIO_RING_S *ring) {
+    unsigned int used = audio_ring_used(ring);
+
+    if (used == 0) {
+        return 0;
+    }
+    if (used >= atomic_load_explicit(&ring->low_watermark, memory_order_relaxed)) {
+        return 1;
+    }
+    if (atomic_load_explicit(&ring->end_marked, memory_order_acquire)) {
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        unsigned int end_pos = atomic_load_explicit(&ring->end_pos, memory_order_relaxed);
+        return (int)(end_pos - tail) > 0;
+    }
+    return 0;
+}
+
+unsigned int audio_ring_peek(AUDIO_RING_S *ring, const unsigned char **data) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    unsigned int offset = tail & ring->mask;
+    unsigned int avail = head - tail;
+    unsigned int contiguous = ring->size - offset;
+
+    *data = ring->buf + offset;
+    return avail < contiguous ? avail : contiguous;
+}
+
+void audio_ring_consume(AUDIO_RING_S *ring, unsigned int len) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    // 读完数据后才释放空间给生产者
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+}
+
+void audio_ring_count_underrun(AUDIO_RING_S *ring) {
+    atomic_fetch_add_explicit(&ring->underruns, 1, memory_order_relaxed);
+}
@@ -0,0 +1,79 @@
+/*
+ * 单生产者/单消费者无锁PCM环形缓冲区
+ *
+ * 网络接收侧（生产者）只把音频数据追加到环中，播放线程（消费者）按DAC节奏取出送给AO，
+ * 两侧互不阻塞：
+ * - head只由生产者修改，tail只由消费者修改，均为累计字节数（自然回绕）
+ * - 低水位：播放开始/欠载后恢复之前至少要缓冲的数据量，避免断断续续
+ * - 高水位：生产者在缓冲量超过高水位时应暂停写入（背压），由调用者决定等待还是丢弃
+ * - 结束标记：生产者标记“数据到此为止”，消费者据此区分正常结束和欠载，并可以不等低水位立即播放
+ * - 清空：任意线程发起请求，由消费者在下一次读取前执行，只丢弃请求时刻之前写入的数据
+ */
+
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+typedef struct _AudioRing {
+    unsigned char     *buf;
+    unsigned int       size;            // 必须为2的幂
+    unsigned int       mask;
+
+    atomic_uint        head;            // 生产者写入位置
+    atomic_uint        tail;            // 消费者读取位置
+
+    atomic_uint        low_watermark;
+    atomic_uint        high_watermark;
+
+    atomic_uint        end_pos;         // 结束标记位置
+    atomic_int         end_marked;
+    atomic_uint        flush_pos;       // 清空请求时的head
+    atomic_uint        flush_seq;       // 清空请求序号
+    unsigned int       flush_done;      // 消费者已处理的清空序号
+
+    // 统计（生产者/消费者各自更新自己的字段）
+    atomic_ulong       underruns;       // 消费者：播放中途数据耗尽次数
+    atomic_ulong       overruns;        // 生产者：因缓冲区满而等待/丢弃的次数
+    atomic_ulong       flushes;         // 消费者：执行清空的次数
+    atomic_ulong       flushed_bytes;   // 消费者：清空丢弃的字节数
+    atomic_uint        max_used;        // 生产者：最大缓冲量
+} AUDIO_RING_S;
+
+int          audio_ring_init(AUDIO_RING_S *ring, unsigned int size);
+void         audio_ring_deinit(AUDIO_RING_S *ring);
+void         audio_ring_set_watermarks(AUDIO_RING_S *ring, unsigned int low, unsigned int high);
+void         audio_ring_reset_stats(AUDIO_RING_S *ring);
+
+unsigned int audio_ring_used(const AUDIO_RING_S *ring);
+unsigned int audio_ring_free(const AUDIO_RING_S *ring);
+
+// ---- 生产者 ----
+// 写入数据，空间不足时只写入能放下的部分，返回写入字节数
+unsigned int audio_ring_write(AUDIO_RING_S *ring, const void *data, unsigned int len);
+// 缓冲量是否已达到高水位
+int          audio_ring_above_high(const AUDIO_RING_S *ring);
+// 标记当前写入位置为一段数据的结尾
+void         audio_ring_mark_end(AUDIO_RING_S *ring);
+
+// ---- 任意线程 ----
+// 请求丢弃当前已写入的全部数据（由消费者执行）
+void         audio_ring_request_flush(AUDIO_RING_S *ring);
+// 读位置是否正好停在结束标记处（标记之前的数据都已消费，且之后写入的数据还没有开始读）
+int          audio_ring_end_reached(const AUDIO_RING_S *ring);
+
+// ---- 消费者 ----
+// 执行挂起的清空请求，返回丢弃的字节数
+unsigned int audio_ring_apply_flush(AUDIO_RING_S *ring);
+// 是否有尚未执行的清空请求（已取出但未送出的数据应放弃）
+int          audio_ring_flush_pending(const AUDIO_RING_S *ring);
+// 缓冲量是否达到低水位，或者已有结束标记（剩余数据不会再增加，可以直接播放）
+int          audio_ring_ready(const AUDIO_RING_S *ring);
+// 取得可连续读取的数据指针和长度（不移动读位置），处理完成后调用audio_ring_consume
+unsigned int audio_ring_peek(AUDIO_RING_S *ring, const unsigned char **data);
+void         audio_ring_consume(AUDIO_RING_S *ring, unsigned int len);
+// 播放中途数据耗尽（未到结束标记）时调用，计入欠载次数
+void         audio_ring_count_underrun(AUDIO_RING_S *ring);
+
+#endif // AUDIO_RING_H
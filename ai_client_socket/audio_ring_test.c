@@ -0,0 +1,137 @@
+/*
+ * 播放环形缓冲区自检 - 单线程模拟生产者/消费者，检查结束标记、欠载判断和清空
+ *
+ * 编译运行（主机或开发板，不依赖rockit）：
+ *   gcc -O2 -Wall -o audio_ring_test audio_ring_test.c audio_ring.c && ./audio_ring_test
+ * 全部通过返回0，否则打印失败的检查并返回1。
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "audio_ring.h"
+
+static int g_s32Failures = 0;
+
+#define RING_CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("❌ [RING-TEST] %s:%d 检查失败: %s\n", __func__, __LINE__, #cond); \
+            g_s32Failures++; \
+        } \
+    } while (0)
+
+static unsigned char g_au8Data[4096];
+
+// 消费者读走全部可读数据
+static unsigned int drain_all(AUDIO_RING_S *ring) {
+    const unsigned char *data;
+    unsigned int total = 0;
+    unsigned int len;
+
+    while ((len = audio_ring_peek(ring, &data)) > 0) {
+        audio_ring_consume(ring, len);
+        total += len;
+    }
+    return total;
+}
+
+// 与播放线程相同的判断：没有数据且未停在结束标记处就是欠载
+static int is_underrun(AUDIO_RING_S *ring) {
+    const unsigned char *data;
+    return audio_ring_peek(ring, &data) == 0 && !audio_ring_end_reached(ring);
+}
+
+static void test_marker_then_more_data(void) {
+    AUDIO_RING_S ring;
+
+    RING_CHECK(audio_ring_init(&ring, 1024) == 0);
+    audio_ring_set_watermarks(&ring, 256, 1024);
+
+    // 第一句：写入后标记结束，读完时不是欠载
+    RING_CHECK(audio_ring_write(&ring, g_au8Data, 100) == 100);
+    audio_ring_mark_end(&ring);
+    RING_CHECK(audio_ring_ready(&ring));            // 低于低水位，但本段已结束
+    RING_CHECK(drain_all(&ring) == 100);
+    RING_CHECK(audio_ring_end_reached(&ring));
+    RING_CHECK(!is_underrun(&ring));
+
+    // 第二句还没标记结束：低于低水位时不能开始播放，读完后是欠载
+    RING_CHECK(audio_ring_write(&ring, g_au8Data, 50) == 50);
+    RING_CHECK(!audio_ring_ready(&ring));
+    RING_CHECK(drain_all(&ring) == 50);
+    RING_CHECK(!audio_ring_end_reached(&ring));
+    RING_CHECK(is_underrun(&ring));
+
+    // 再次标记后恢复
+    RING_CHECK(audio_ring_write(&ring, g_au8Data, 30) == 30);
+    audio_ring_mark_end(&ring);
+    RING_CHECK(drain_all(&ring) == 30);
+    RING_CHECK(!is_underrun(&ring));
+    audio_ring_deinit(&ring);
+}
+
+static void test_flush_past_marker(void) {
+    AUDIO_RING_S ring;
+
+    RING_CHECK(audio_ring_init(&ring, 1024) == 0);
+    audio_ring_set_watermarks(&ring, 64, 1024);
+
+    // 上一次响应：标记结束后又写入数据，新响应开始时整体清空
+    RING_CHECK(audio_ring_write(&ring, g_au8Data, 100) == 100);
+    audio_ring_mark_end(&ring);
+    RING_CHECK(audio_ring_write(&ring, g_au8Data, 100) == 100);
+    audio_ring_request_flush(&ring);
+    RING_CHECK(audio_ring_flush_pending(&ring));
+    RING_CHECK(audio_ring_apply_flush(&ring) == 200);
+    RING_CHECK(!audio_ring_flush_pending(&ring));
+    RING_CHECK(audio_ring_used(&ring) == 0);
+
+    // 新响应的数据读完时，旧标记不能掩盖欠载
+    RING_CHECK(audio_ring_write(&ring, g_au8Data, 80) == 80);
+    RING_CHECK(audio_ring_ready(&ring));
+    RING_CHECK(drain_all(&ring) == 80);
+    RING_CHECK(is_underrun(&ring));
+    audio_ring_deinit(&ring);
+}
+
+static void test_wraparound(void) {
+    AUDIO_RING_S ring;
+    unsigned char out[300];
+    const unsigned char *data;
+    unsigned int got = 0;
+    unsigned int len;
+    unsigned int i;
+
+    for (i = 0; i < sizeof(g_au8Data); i++) {
+        g_au8Data[i] = (unsigned char)(i * 7);
+    }
+    RING_CHECK(audio_ring_init(&ring, 512) == 0);
+    RING_CHECK(audio_ring_write(&ring, g_au8Data, 400) == 400);
+    RING_CHECK(drain_all(&ring) == 400);
+    // 跨过缓冲区末尾写入，空间不足时只写入能放下的部分
+    RING_CHECK(audio_ring_write(&ring, g_au8Data, 300) == 300);
+    RING_CHECK(audio_ring_write(&ring, g_au8Data, 300) == 212);
+    RING_CHECK(atomic_load(&ring.overruns) == 1);
+    while (got < sizeof(out) && (len = audio_ring_peek(&ring, &data)) > 0) {
+        if (len > sizeof(out) - got) {
+            len = sizeof(out) - got;
+        }
+        memcpy(out + got, data, len);
+        audio_ring_consume(&ring, len);
+        got += len;
+    }
+    RING_CHECK(got == sizeof(out) && memcmp(out, g_au8Data, sizeof(out)) == 0);
+    audio_ring_deinit(&ring);
+}
+
+int main(void) {
+    test_marker_then_more_data();
+    test_flush_past_marker();
+    test_wraparound();
+    if (g_s32Failures > 0) {
+        printf("❌ [RING-TEST] %d 项检查失败\n", g_s32Failures);
+        return 1;
+    }
+    printf("✅ [RING-TEST] 全部通过\n");
+    return 0;
+}
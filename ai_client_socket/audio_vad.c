@@ -0,0 +1,328 @@
+/*
+ * 设备端语音活动检测与静音裁剪实现
+ * 详细说明见 audio_vad.h
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_vad.h"
+
+#define VAD_STRONG_EXTRA_DB     (12)        // 超过噪声底margin+12dB时不再检查频谱特征
+#define VAD_FLATNESS_Q8         (-384)      // 谱平坦度低于-1.5（log2）判为有谐波结构
+#define VAD_ZCR_Q15             (9830)      // 过零率低于0.3判为浊音
+#define VAD_ZCR_DEADZONE        (32)
+#define VAD_OUT_FRAMES          (8)         // 输出合并缓冲区（分析帧数）
+
+void audio_vad_default_config(AUDIO_VAD_CONFIG_S *config, int sample_rate, int channels) {
+    config->sample_rate = sample_rate;
+    config->channels = channels;
+    config->hangover_ms = 800;
+    config->lead_pad_ms = 200;
+    config->tail_pad_ms = 200;
+    config->min_speech_ms = 48;
+    config->energy_margin_db = 9;
+    config->min_energy_db = -55;
+}
+
+static unsigned int ms_to_bytes(const AUDIO_VAD_CONFIG_S *config, int ms) {
+    return (unsigned int)(ms > 0 ? ms : 0) * config->sample_rate / 1000 * config->channels * sizeof(short);
+}
+
+static unsigned int bytes_to_ms(const AUDIO_VAD_CONFIG_S *config, unsigned long bytes) {
+    return (unsigned int)(bytes * 1000 / ((unsigned long)config->sample_rate * config->channels * sizeof(short)));
+}
+
+int audio_vad_init(AUDIO_VAD_S *vad, const AUDIO_VAD_CONFIG_S *config, AUDIO_VAD_OUTPUT_FN output, void *user) {
+    int n;
+
+    memset(vad, 0, sizeof(*vad));
+    if (config->sample_rate < 8000 || config->channels <= 0 || output == NULL) {
+        return -1;
+    }
+    audio_dsp_init();
+    vad->config = *config;
+    vad->output = output;
+    vad->user = user;
+
+    vad->frame_samples = config->sample_rate * AUDIO_VAD_FRAME_MS / 1000;
+    vad->frame_bytes = vad->frame_samples * config->channels * sizeof(short);
+    for (vad->fft_log2 = 1; (1 << vad->fft_log2) < vad->frame_samples && vad->fft_log2 < AUDIO_DSP_MAX_FFT_LOG2;
+         vad->fft_log2++) {
+    }
+    n = 1 << vad->fft_log2;
+    vad->band_first = 300 * n / config->sample_rate;
+    vad->band_last = 4000 * n / config->sample_rate;
+    if (vad->band_first < 1) {
+        vad->band_first = 1;
+    }
+    if (vad->band_last > n / 2) {
+        vad->band_last = n / 2;
+    }
+
+    vad->margin_q8 = audio_dsp_db_to_log2_q8(config->energy_margin_db);
+    vad->strong_q8 = audio_dsp_db_to_log2_q8(config->energy_margin_db + VAD_STRONG_EXTRA_DB);
+    vad->min_energy_q8 = audio_dsp_db_to_log2_q8(config->min_energy_db + AUDIO_DSP_FULL_SCALE_DB);
+    vad->flatness_q8 = VAD_FLATNESS_Q8;
+    vad->zcr_q15 = VAD_ZCR_Q15;
+
+    vad->onset_frames = (config->min_speech_ms + AUDIO_VAD_FRAME_MS - 1) / AUDIO_VAD_FRAME_MS;
+    vad->hangover_frames = (config->hangover_ms + AUDIO_VAD_FRAME_MS - 1) / AUDIO_VAD_FRAME_MS;
+    if (vad->onset_frames < 1) {
+        vad->onset_frames = 1;
+    }
+    if (vad->hangover_frames < 1) {
+        vad->hangover_frames = 1;
+    }
+    vad->tail_bytes = ms_to_bytes(config, config->tail_pad_ms);
+
+    // 语音开始前的环需要放下lead_pad和判定中的帧；hold最多缓存hangover帧（满了就判为结束）
+    vad->pending = (unsigned char *)malloc(vad->frame_bytes * (VAD_OUT_FRAMES + 1));
+    vad->hold_size = vad->hangover_frames * vad->frame_bytes;
+    vad->hold = (unsigned char *)malloc(vad->hold_size);
+    if (!vad->pending || !vad->hold ||
+        audio_preroll_init(&vad->lead, ms_to_bytes(config, config->lead_pad_ms) + vad->onset_frames * vad->frame_bytes,
+                           config->channels * sizeof(short)) != 0) {
+        audio_vad_deinit(vad);
+        return -1;
+    }
+    audio_vad_begin(vad);
+    return 0;
+}
+
+void audio_vad_deinit(AUDIO_VAD_S *vad) {
+    free(vad->pending);
+    free(vad->hold);
+    vad->pending = NULL;
+    vad->hold = NULL;
+    audio_preroll_deinit(&vad->lead);
+}
+
+void audio_vad_begin(AUDIO_VAD_S *vad) {
+    vad->pending_len = 0;
+    vad->hold_len = 0;
+    audio_preroll_reset(&vad->lead);
+    vad->state = AUDIO_VAD_SILENCE;
+    vad->speech_run = 0;
+    vad->silence_run = 0;
+    vad->ended = 0;
+    vad->failed = 0;
+    vad->output_bytes = 0;
+    memset(&vad->stats, 0, sizeof(vad->stats));
+    vad->stats.onset_ms = -1;
+    vad->stats.end_ms = -1;
+    vad->noise_windows = 0;
+    vad->noise_next = 0;
+    vad->noise_cur_frames = 0;
+}
+
+// 最小值统计：当前子窗口和最近几个子窗口中的最小帧能量
+static void update_noise(AUDIO_VAD_S *vad, int energy) {
+    int i;
+
+    if (vad->noise_cur_frames == 0 || energy < vad->noise_cur_min) {
+        vad->noise_cur_min = energy;
+    }
+    if (++vad->noise_cur_frames >= AUDIO_VAD_NOISE_FRAMES) {
+        vad->noise_min[vad->noise_next] = vad->noise_cur_min;
+        vad->noise_next = (vad->noise_next + 1) % AUDIO_VAD_NOISE_WINDOWS;
+        if (vad->noise_windows < AUDIO_VAD_NOISE_WINDOWS) {
+            vad->noise_windows++;
+        }
+        vad->noise_cur_frames = 0;
+    }
+
+    vad->noise_q8 = vad->noise_cur_frames > 0 ? vad->noise_cur_min : energy;
+    for (i = 0; i < vad->noise_windows; i++) {
+        if (vad->noise_min[i] < vad->noise_q8) {
+            vad->noise_q8 = vad->noise_min[i];
+        }
+    }
+}
+
+// 输出合并缓冲区与pending一起分配（紧跟在pending之后），攒够VAD_OUT_FRAMES帧或本次处理结束时发出
+static unsigned char *out_buf(AUDIO_VAD_S *vad) {
+    return vad->pending + vad->frame_bytes;
+}
+
+static void out_flush(AUDIO_VAD_S *vad, unsigned int *out_len) {
+    if (*out_len == 0) {
+        return;
+    }
+    if (!vad->failed && vad->output(vad->user, out_buf(vad), *out_len) != 0) {
+        vad->failed = 1;
+    }
+    vad->output_bytes += *out_len;
+    *out_len = 0;
+}
+
+static void emit(AUDIO_VAD_S *vad, unsigned int *out_len, const unsigned char *data, unsigned int len) {
+    unsigned int cap = vad->frame_bytes * VAD_OUT_FRAMES;
+
+    while (len > 0) {
+        unsigned int n = cap - *out_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(out_buf(vad) + *out_len, data, n);
+        *out_len += n;
+        data += n;
+        len -= n;
+        if (*out_len == cap) {
+            out_flush(vad, out_len);
+        }
+    }
+}
+
+static void emit_lead(AUDIO_VAD_S *vad, unsigned int *out_len) {
+    const unsigned char *seg[2];
+    unsigned int len[2];
+
+    audio_preroll_take(&vad->lead, &seg[0], &len[0], &seg[1], &len[1]);
+    emit(vad, out_len, seg[0], len[0]);
+    emit(vad, out_len, seg[1], len[1]);
+    audio_preroll_reset(&vad->lead);
+}
+
+int audio_vad_classify(AUDIO_VAD_S *vad, const short *frame) {
+    int ch = vad->config.channels;
+    int energy = audio_dsp_log2_q8(audio_dsp_mean_square(frame, vad->frame_samples, ch) + 1);
+    int speech = 0;
+
+    update_noise(vad, energy);
+    if (energy > vad->noise_q8 + vad->margin_q8 && energy > vad->min_energy_q8) {
+        if (energy > vad->noise_q8 + vad->strong_q8) {
+            speech = 1;
+        } else {
+            int flatness;
+            int zcr;
+
+            audio_dsp_power_spectrum(frame, vad->frame_samples, ch, vad->fft_log2, vad->re, vad->im, vad->power);
+            flatness = audio_dsp_flatness_q8(vad->power, vad->band_first, vad->band_last);
+            zcr = audio_dsp_zcr_q15(frame, vad->frame_samples, ch, VAD_ZCR_DEADZONE);
+            speech = (flatness < vad->flatness_q8 || zcr < vad->zcr_q15) ? 1 : 0;
+        }
+    }
+    return speech;
+}
+
+static int process_frame(AUDIO_VAD_S *vad, const unsigned char *frame, unsigned int *out_len) {
+    int speech = audio_vad_classify(vad, (const short *)frame);
+
+    vad->stats.input_ms += AUDIO_VAD_FRAME_MS;
+    if (speech) {
+        vad->stats.speech_ms += AUDIO_VAD_FRAME_MS;
+    }
+
+    switch (vad->state) {
+        case AUDIO_VAD_SILENCE:
+            audio_preroll_write(&vad->lead, frame, vad->frame_bytes);
+            vad->speech_run = speech ? vad->speech_run + 1 : 0;
+            if (vad->speech_run >= vad->onset_frames) {
+                emit_lead(vad, out_len);
+                vad->state = AUDIO_VAD_SPEECH;
+                vad->stats.segments++;
+                if (vad->stats.onset_ms < 0) {
+                    vad->stats.onset_ms = (int)vad->stats.input_ms - vad->speech_run * AUDIO_VAD_FRAME_MS;
+                }
+            }
+            break;
+        case AUDIO_VAD_SPEECH:
+            if (speech) {
+                emit(vad, out_len, frame, vad->frame_bytes);
+                break;
+            }
+            vad->state = AUDIO_VAD_HANGOVER;
+            vad->hold_len = 0;
+            vad->silence_run = 0;
+            // fall through
+        case AUDIO_VAD_HANGOVER:
+            if (speech) {
+                // 句中停顿：原样补发
+                emit(vad, out_len, vad->hold, vad->hold_len);
+                emit(vad, out_len, frame, vad->frame_bytes);
+                vad->hold_len = 0;
+                vad->state = AUDIO_VAD_SPEECH;
+                break;
+            }
+            memcpy(vad->hold + vad->hold_len, frame, vad->frame_bytes);
+            vad->hold_len += vad->frame_bytes;
+            if (++vad->silence_run < vad->hangover_frames) {
+                break;
+            }
+            // 静音超过hangover：只保留开头tail_pad，最后一段留作下一段语音的lead
+            emit(vad, out_len, vad->hold, vad->hold_len < vad->tail_bytes ? vad->hold_len : vad->tail_bytes);
+            audio_preroll_write(&vad->lead, vad->hold, vad->hold_len);
+            vad->hold_len = 0;
+            vad->speech_run = 0;
+            vad->state = AUDIO_VAD_SILENCE;
+            if (!vad->ended) {
+                vad->ended = 1;
+                vad->stats.end_ms = (int)vad->stats.input_ms;
+                return 1;
+            }
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+int audio_vad_process(AUDIO_VAD_S *vad, const void *pcm, unsigned int len) {
+    const unsigned char *src = (const unsigned char *)pcm;
+    unsigned int out_len = 0;
+    int ended = 0;
+
+    while (len > 0) {
+        const unsigned char *frame;
+
+        if (vad->pending_len == 0 && len >= vad->frame_bytes && ((uintptr_t)src & 1) == 0) {
+            frame = src;
+            src += vad->frame_bytes;
+            len -= vad->frame_bytes;
+        } else {
+            unsigned int n = vad->frame_bytes - vad->pending_len;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(vad->pending + vad->pending_len, src, n);
+            vad->pending_len += n;
+            src += n;
+            len -= n;
+            if (vad->pending_len < vad->frame_bytes) {
+                break;
+            }
+            vad->pending_len = 0;
+            frame = vad->pending;
+        }
+        if (process_frame(vad, frame, &out_len) == 1) {
+            ended = 1;
+        }
+    }
+    out_flush(vad, &out_len);
+    return vad->failed ? -1 : ended;
+}
+
+int audio_vad_finish(AUDIO_VAD_S *vad) {
+    unsigned int out_len = 0;
+    unsigned int tail;
+
+    if (vad->state == AUDIO_VAD_SPEECH) {
+        emit(vad, &out_len, vad->pending, vad->pending_len);
+    } else if (vad->state == AUDIO_VAD_HANGOVER) {
+        tail = vad->hold_len < vad->tail_bytes ? vad->hold_len : vad->tail_bytes;
+        emit(vad, &out_len, vad->hold, tail);
+    } else if (vad->stats.onset_ms < 0) {
+        // 整次录音都没有检测到语音：仍然上传最后一小段，交给服务器判断
+        emit_lead(vad, &out_len);
+    }
+    vad->pending_len = 0;
+    vad->hold_len = 0;
+    out_flush(vad, &out_len);
+
+    vad->stats.output_ms = bytes_to_ms(&vad->config, vad->output_bytes);
+    vad->stats.trimmed_ms = vad->stats.input_ms > vad->stats.output_ms ? vad->stats.input_ms - vad->stats.output_ms : 0;
+    vad->stats.noise_db = audio_dsp_log2_q8_to_db(vad->noise_q8) - AUDIO_DSP_FULL_SCALE_DB;
+    return vad->failed ? -1 : 0;
+}
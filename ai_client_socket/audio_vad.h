@@ -0,0 +1,121 @@
+/*
+ * 设备端语音活动检测（VAD）与静音裁剪
+ *
+ * 录音数据按16ms分析帧处理，每帧用audio_dsp计算定点特征：
+ * - 能量高出自适应噪声底energy_margin_db，且高于绝对下限min_energy_db（dBFS）
+ * - 并且谱平坦度低（浊音）或过零率低，或者能量远高于噪声底（清辅音）
+ * 连续min_speech_ms判为语音开始，语音后连续hangover_ms静音判为一句话结束。
+ *
+ * 同时作为上传前的静音裁剪门：
+ * - 语音开始前只保留最近lead_pad_ms（加上判定中的帧），语音开始时一起输出
+ * - 语音中的停顿先缓存，恢复说话时原样输出；超过hangover_ms后只输出前tail_pad_ms，其余丢弃
+ * 噪声底取最近约2秒内帧能量的最小值（最小值统计：语音中总有停顿，平稳噪声约2秒后跟上），
+ * 每次录音重新开始统计，开头的预录数据通常就是背景声。
+ * 缓冲区只在初始化时分配，输出通过回调按连续数据块发出（由调用者写文件或上传）。只在录音线程中使用，不加锁。
+ */
+
+#ifndef AUDIO_VAD_H
+#define AUDIO_VAD_H
+
+#include "audio_dsp.h"
+#include "audio_preroll.h"
+
+#define AUDIO_VAD_FRAME_MS      (16)
+#define AUDIO_VAD_NOISE_WINDOWS (8)         // 噪声底最小值统计的子窗口数
+#define AUDIO_VAD_NOISE_FRAMES  (16)        // 每个子窗口的帧数（8 x 16 x 16ms ≈ 2s）
+
+typedef struct _AudioVadConfig {
+    int sample_rate;
+    int channels;
+    int hangover_ms;            // 语音后静音多久判为一句话结束
+    int lead_pad_ms;            // 语音开始前保留的静音
+    int tail_pad_ms;            // 语音结束后保留的静音
+    int min_speech_ms;          // 连续语音多久才判为开始（滤掉咔嗒声）
+    int energy_margin_db;       // 高出噪声底多少dB
+    int min_energy_db;          // 绝对能量下限（dBFS）
+} AUDIO_VAD_CONFIG_S;
+
+typedef enum _AudioVadState {
+    AUDIO_VAD_SILENCE = 0,      // 等待语音开始
+    AUDIO_VAD_SPEECH,
+    AUDIO_VAD_HANGOVER,         // 语音后的静音，等待恢复或结束
+} AUDIO_VAD_STATE_E;
+
+// 单次录音的统计（audio_vad_begin清零）
+typedef struct _AudioVadStats {
+    unsigned int input_ms;      // 输入时长
+    unsigned int speech_ms;     // 判为语音的时长
+    unsigned int output_ms;     // 输出（上传）时长
+    unsigned int trimmed_ms;    // 裁掉的静音时长
+    int          onset_ms;      // 第一次语音开始的位置，-1表示没有检测到语音
+    int          end_ms;        // 判为结束的位置，-1表示没有结束
+    unsigned int segments;      // 语音段数
+    int          noise_db;      // 当前噪声底（dBFS）
+} AUDIO_VAD_STATS_S;
+
+// 输出回调：返回0成功，非0表示失败（之后的输出被丢弃）
+typedef int (*AUDIO_VAD_OUTPUT_FN)(void *user, const void *data, unsigned int len);
+
+typedef struct _AudioVad {
+    AUDIO_VAD_CONFIG_S  config;
+    AUDIO_VAD_OUTPUT_FN output;
+    void               *user;
+
+    int                 frame_samples;      // 分析帧采样数
+    unsigned int        frame_bytes;
+    int                 fft_log2;
+    int                 band_first;         // 谱平坦度统计的频带（约300-4000Hz）
+    int                 band_last;
+
+    // 阈值（log2 Q8 / Q15）
+    int                 margin_q8;
+    int                 strong_q8;
+    int                 min_energy_q8;
+    int                 flatness_q8;
+    int                 zcr_q15;
+
+    unsigned char      *pending;            // 不足一个分析帧的输入
+    unsigned int        pending_len;
+    AUDIO_PREROLL_S     lead;               // 语音开始前的数据
+    unsigned char      *hold;               // 语音后的静音
+    unsigned int        hold_len;
+    unsigned int        hold_size;
+    unsigned int        tail_bytes;
+
+    AUDIO_VAD_STATE_E   state;
+    int                 speech_run;         // 连续语音帧数
+    int                 silence_run;        // 连续静音帧数
+    int                 onset_frames;
+    int                 hangover_frames;
+    int                 noise_q8;           // 噪声底（log2 Q8，均方值）
+    int                 noise_min[AUDIO_VAD_NOISE_WINDOWS];  // 已完成子窗口的最小能量
+    int                 noise_windows;      // 有效子窗口数
+    int                 noise_next;         // 下一个写入的子窗口
+    int                 noise_cur_min;      // 当前子窗口的最小能量
+    int                 noise_cur_frames;
+    int                 ended;              // 本轮已判为结束
+    int                 failed;
+    unsigned long       output_bytes;
+
+    AUDIO_VAD_STATS_S   stats;
+
+    // 分析缓冲区
+    short               re[AUDIO_DSP_MAX_FFT];
+    short               im[AUDIO_DSP_MAX_FFT];
+    unsigned int        power[AUDIO_DSP_MAX_FFT / 2 + 1];
+} AUDIO_VAD_S;
+
+void audio_vad_default_config(AUDIO_VAD_CONFIG_S *config, int sample_rate, int channels);
+int  audio_vad_init(AUDIO_VAD_S *vad, const AUDIO_VAD_CONFIG_S *config, AUDIO_VAD_OUTPUT_FN output, void *user);
+void audio_vad_deinit(AUDIO_VAD_S *vad);
+
+// 开始新的一次录音（重新统计噪声底）
+void audio_vad_begin(AUDIO_VAD_S *vad);
+// 处理录音数据：返回1表示本次调用中检测到一句话结束（只报告一次），0继续，-1输出失败
+int  audio_vad_process(AUDIO_VAD_S *vad, const void *pcm, unsigned int len);
+// 录音结束：输出剩余的语音和结尾静音，返回-1表示输出失败
+int  audio_vad_finish(AUDIO_VAD_S *vad);
+// 单帧判决（不经过裁剪门，供调试/测试工具使用），返回1为语音
+int  audio_vad_classify(AUDIO_VAD_S *vad, const short *frame);
+
+#endif // AUDIO_VAD_H
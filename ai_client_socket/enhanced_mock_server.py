@@ -72,15 +72,16 @@ class AudioManager:
         self.audio_files_dir.mkdir(exist_ok=True)
         
     def start_recording(self):
-        """开始录制音频数据"""
+        """开始录制音频数据，返回本次录制的缓冲区（多个连接同时录制时各用各的）"""
         self.audio_data_buffer = []
         self.is_recording = True
         logger.info("🎤 开始录制音频数据")
+        return self.audio_data_buffer
         
-    def add_audio_data(self, data):
+    def add_audio_data(self, data, buffer=None):
         """添加音频数据"""
-        if self.is_recording:
-            self.audio_data_buffer.append(data)
+        if buffer is not None or self.is_recording:
+            (buffer if buffer is not None else self.audio_data_buffer).append(data)
             # 显示实时音频电平
             try:
                 if len(data) >= 2:
@@ -93,26 +94,28 @@ class AudioManager:
             except Exception as e:
                 pass
                 
-    def stop_recording(self):
+    def stop_recording(self, buffer=None):
         """停止录制并保存音频"""
-        if not self.is_recording:
-            return None
+        if buffer is None:
+            if not self.is_recording:
+                return None
+            buffer = self.audio_data_buffer
             
         self.is_recording = False
         
-        if not self.audio_data_buffer:
+        if not buffer:
             logger.warning("⚠️ 没有录制到音频数据")
             return None
             
         # 合并所有音频数据
-        audio_data = b''.join(self.audio_data_buffer)
+        audio_data = b''.join(buffer)
         total_samples = len(audio_data) // 2
         duration = total_samples / AUDIO_CONFIG['sample_rate']
         
         logger.info(f"🎤 录制完成: {len(audio_data)}字节, {duration:.2f}秒, {total_samples}采样点")
         
         # 保存到WAV文件
-        timestamp = datetime.now().strftime("%Y%m%d_%H%M%S")
+        timestamp = datetime.now().strftime("%Y%m%d_%H%M%S_%f")
         filename = f"received_audio_{timestamp}.wav"
         filepath = self.audio_files_dir / filename
         
@@ -318,19 +321,19 @@ class EnhancedMockAIServer:
             return False
     
     def handle_voice_data(self, conn):
-        """处理语音数据流"""
+        """处理语音数据流，返回保存的音频文件路径（失败返回None）"""
         logger.info("🎤 开始接收语音数据...")
-        self.audio_manager.start_recording()
+        recording = self.audio_manager.start_recording()
         voice_data_received = 0
         
         while True:
             msg_type, data = self.receive_message(conn)
             if msg_type is None:
-                return False
+                return None
                 
             if msg_type == MSG_VOICE_DATA:
                 voice_data_received += len(data)
-                self.audio_manager.add_audio_data(data)
+                self.audio_manager.add_audio_data(data, recording)
                 
                 if voice_data_received % 8192 == 0:
                     logger.info(f"🎤 已接收语音数据: {voice_data_received} 字节")
@@ -338,8 +341,7 @@ class EnhancedMockAIServer:
             elif msg_type == MSG_VOICE_END:
                 logger.info(f"🎤 语音接收完成: 总计 {voice_data_received} 字节")
                 # 停止录制并保存音频
-                saved_file = self.audio_manager.stop_recording()
-                return saved_file is not None
+                return self.audio_manager.stop_recording(recording)
             else:
                 logger.warning(f"⚠️ 语音接收过程中收到意外消息: 0x{msg_type:02X}")
     
@@ -461,13 +463,8 @@ class EnhancedMockAIServer:
                 elif msg_type == MSG_VOICE_START:
                     # 处理语音开始
                     logger.info("🎤 语音传输开始")
-                    success = self.handle_voice_data(conn)
-                    if success:
-                        # 获取最新保存的音频文件
-                        audio_files = self.audio_manager.get_audio_files()
-                        if audio_files:
-                            saved_audio_file = str(audio_files[0])
-                        
+                    saved_audio_file = self.handle_voice_data(conn)
+                    if saved_audio_file:
                         # 语音接收完成，开始AI响应
                         self.simulate_ai_response(conn, response_format, saved_audio_file)
                     
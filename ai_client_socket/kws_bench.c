@@ -0,0 +1,432 @@
+/*
+ * 关键词检测基准测试 - 在录好的测试音频上测量audio_kws的CPU占用和检测延迟
+ *
+ * 两种测试数据：
+ *   1. 录好的测试音频 + 标注：--clip test.pcm --truth 2.35,6.80（每个关键词结束的时间，秒）
+ *   2. 合成：把--keyword中的关键词录音按--interval-ms间隔依次混入--background背景音（循环使用），
+ *      关键词位置已知。背景音可以是不含关键词的普通对话/环境录音，用于统计误唤醒。
+ * 数据按--chunk-ms分块送入检测器（与设备每次取帧的大小一致），检测延迟 = 检测到时所在块的结束时间 - 关键词结束时间。
+ * CPU占用按进程CPU时间 / 音频时长计算（单核实时百分比），指定--budget时超过预算返回2。
+ *
+ * 编译（主机或开发板，不依赖rockit）：
+ *   gcc -O2 -Wall -o kws_bench kws_bench.c audio_kws.c audio_dsp.c -lm
+ * 示例：
+ *   ./kws_bench --template kw1.pcm,kw2.pcm,kw3.pcm --keyword kw4.pcm,kw5.pcm --background ../mp3s/my_recording.pcm --count 20
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+
+#include "audio_kws.h"
+
+#define BENCH_MAX_FILES         16
+#define BENCH_MAX_TRUTH         256
+#define BENCH_HIT_WINDOW_MS     1000        // 关键词结束后多久内的检测算命中
+
+typedef struct _BenchPcm {
+    short        *data;
+    unsigned int  samples;      // 每声道采样数
+    const char   *path;
+} BENCH_PCM_S;
+
+typedef struct _BenchTruth {
+    double start_ms;
+    double end_ms;
+    int    hit;
+    int    min_score;       // 命中窗口内的最低得分，-1表示没有完整匹配
+} BENCH_TRUTH_S;
+
+static int g_s32Rate = 16000;
+static int g_s32Channels = 1;
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int load_pcm(const char *path, BENCH_PCM_S *pcm) {
+    FILE *fp = fopen(path, "rb");
+    long size;
+    unsigned int frame_bytes = g_s32Channels * sizeof(short);
+
+    if (fp == NULL) {
+        printf("❌ [KWS-BENCH] 无法打开 %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    pcm->samples = (unsigned int)(size / frame_bytes);
+    pcm->data = malloc(pcm->samples > 0 ? pcm->samples * frame_bytes : 1);
+    if (pcm->data == NULL || fread(pcm->data, frame_bytes, pcm->samples, fp) != pcm->samples) {
+        printf("❌ [KWS-BENCH] 读取失败 %s\n", path);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    pcm->path = path;
+    return 0;
+}
+
+static int load_list(const char *list, BENCH_PCM_S *files, int max) {
+    char *copy = strdup(list);
+    char *save = NULL;
+    char *path;
+    int count = 0;
+
+    for (path = strtok_r(copy, ",", &save); path != NULL && count < max; path = strtok_r(NULL, ",", &save)) {
+        if (load_pcm(strdup(path), &files[count]) != 0) {
+            free(copy);
+            return -1;
+        }
+        count++;
+    }
+    free(copy);
+    return count;
+}
+
+// 关键词录音中有声部分的范围（与模板相同：首尾低于峰值25dB的16ms帧不算），用于计算延迟
+static void voiced_extent(const BENCH_PCM_S *pcm, unsigned int *first, unsigned int *last) {
+    unsigned int hop = g_s32Rate * AUDIO_KWS_HOP_MS / 1000;
+    unsigned int frames = pcm->samples / hop;
+    double peak = 0.0;
+    double floor_energy;
+    unsigned int f;
+
+    *first = 0;
+    *last = pcm->samples;
+    for (f = 0; f < frames; f++) {
+        double e = 0.0;
+        unsigned int i;
+
+        for (i = 0; i < hop; i++) {
+            double v = pcm->data[(f * hop + i) * g_s32Channels];
+            e += v * v;
+        }
+        if (e > peak) {
+            peak = e;
+        }
+    }
+    floor_energy = peak * pow(10.0, -25.0 / 10.0);
+    for (f = 0; f < frames; f++) {
+        double e = 0.0;
+        unsigned int i;
+
+        for (i = 0; i < hop; i++) {
+            double v = pcm->data[(f * hop + i) * g_s32Channels];
+            e += v * v;
+        }
+        if (e >= floor_energy) {
+            if (*first == 0 && f > 0) {
+                *first = f * hop;
+            }
+            *last = (f + 1) * hop;
+        }
+    }
+}
+
+// 合成测试流：背景音循环铺满，关键词从1秒处开始按间隔叠加
+static short *build_mix(const BENCH_PCM_S *bg, const BENCH_PCM_S *kw, int kw_count, int count, int interval_ms,
+                        double gain, unsigned int *out_samples, BENCH_TRUTH_S *truth) {
+    unsigned int pos = g_s32Rate;
+    unsigned int total;
+    unsigned int longest = 0;
+    unsigned int first;
+    unsigned int last;
+    short *mix;
+    unsigned int i;
+    int k;
+
+    for (k = 0; k < kw_count; k++) {
+        if (kw[k].samples > longest) {
+            longest = kw[k].samples;
+        }
+    }
+    total = g_s32Rate + (unsigned int)count * (unsigned int)((long long)interval_ms * g_s32Rate / 1000) + longest + g_s32Rate;
+    mix = calloc((size_t)total * g_s32Channels, sizeof(short));
+    if (mix == NULL) {
+        return NULL;
+    }
+    if (bg != NULL && bg->samples > 0) {
+        for (i = 0; i < total * g_s32Channels; i++) {
+            mix[i] = bg->data[i % (bg->samples * g_s32Channels)];
+        }
+    }
+    for (k = 0; k < count; k++) {
+        const BENCH_PCM_S *src = &kw[k % kw_count];
+
+        for (i = 0; i < src->samples * g_s32Channels; i++) {
+            int v = mix[pos * g_s32Channels + i] + (int)(src->data[i] * gain);
+            mix[pos * g_s32Channels + i] = (short)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+        }
+        voiced_extent(src, &first, &last);
+        truth[k].start_ms = (pos + first) * 1000.0 / g_s32Rate;
+        truth[k].end_ms = (pos + last) * 1000.0 / g_s32Rate;
+        truth[k].hit = 0;
+        truth[k].min_score = -1;
+        pos += (unsigned int)((long long)interval_ms * g_s32Rate / 1000);
+    }
+    *out_samples = total;
+    return mix;
+}
+
+static int parse_truth(const char *list, BENCH_TRUTH_S *truth) {
+    char *copy = strdup(list);
+    char *save = NULL;
+    char *item;
+    int count = 0;
+
+    for (item = strtok_r(copy, ",", &save); item != NULL && count < BENCH_MAX_TRUTH; item = strtok_r(NULL, ",", &save)) {
+        truth[count].end_ms = atof(item) * 1000.0;
+        // 只标注了结束时间：按1.5秒内的检测都算命中
+        truth[count].start_ms = truth[count].end_ms - AUDIO_KWS_MAX_FRAMES * AUDIO_KWS_HOP_MS;
+        truth[count].hit = 0;
+        truth[count].min_score = -1;
+        count++;
+    }
+    free(copy);
+    return count;
+}
+
+static int truth_window(const BENCH_TRUTH_S *truth, int count, double t_ms) {
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (t_ms >= truth[i].start_ms && t_ms <= truth[i].end_ms + BENCH_HIT_WINDOW_MS) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static double process_cpu_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void print_usage(const char *prog) {
+    printf("用法: %s [选项]\n", prog);
+    printf("  -t, --template FILES     关键词模板录音，逗号分隔（必需，最多%d个）\n", AUDIO_KWS_MAX_TEMPLATES);
+    printf("  -c, --clip FILE          录好的测试音频\n");
+    printf("  -T, --truth LIST         测试音频中每个关键词的结束时间（秒），逗号分隔\n");
+    printf("  -k, --keyword FILES      合成测试：混入的关键词录音，逗号分隔（不要和模板用同一段录音）\n");
+    printf("  -b, --background FILE   合成测试：背景音（默认静音）\n");
+    printf("  -n, --count N            合成测试：关键词次数 (默认 10)\n");
+    printf("  -i, --interval-ms MS     合成测试：关键词间隔 (默认 4000)\n");
+    printf("  -g, --gain-db DB         合成测试：关键词增益 (默认 0)\n");
+    printf("  -r, --rate HZ            采样率 (默认 16000)\n");
+    printf("  -C, --channels N         声道数 (默认 1)\n");
+    printf("  -m, --chunk-ms MS        每次送入检测器的数据时长 (默认 64)\n");
+    printf("  -s, --threshold N        检测阈值 (默认自动)\n");
+    printf("  -B, --budget PCT         CPU预算，超过时返回2 (默认 10)\n");
+}
+
+int main(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"template",    required_argument, 0, 't'},
+        {"clip",        required_argument, 0, 'c'},
+        {"truth",       required_argument, 0, 'T'},
+        {"keyword",     required_argument, 0, 'k'},
+        {"background",  required_argument, 0, 'b'},
+        {"count",       required_argument, 0, 'n'},
+        {"interval-ms", required_argument, 0, 'i'},
+        {"gain-db",     required_argument, 0, 'g'},
+        {"rate",        required_argument, 0, 'r'},
+        {"channels",    required_argument, 0, 'C'},
+        {"chunk-ms",    required_argument, 0, 'm'},
+        {"threshold",   required_argument, 0, 's'},
+        {"budget",      required_argument, 0, 'B'},
+        {"help",        no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+    const char *templates = NULL;
+    const char *clip = NULL;
+    const char *truth_list = NULL;
+    const char *keywords = NULL;
+    const char *background = NULL;
+    int count = 10;
+    int interval_ms = 4000;
+    double gain_db = 0.0;
+    int chunk_ms = 64;
+    int threshold = 0;
+    int budget = 10;
+    static AUDIO_KWS_S kws;
+    AUDIO_KWS_CONFIG_S config;
+    BENCH_PCM_S tmpl_files[BENCH_MAX_FILES];
+    BENCH_PCM_S kw_files[BENCH_MAX_FILES];
+    BENCH_PCM_S bg_file;
+    BENCH_PCM_S clip_file;
+    static BENCH_TRUTH_S truth[BENCH_MAX_TRUTH];
+    double latency[BENCH_MAX_TRUTH];
+    double scores[BENCH_MAX_TRUTH];
+    int scored;
+    int bg_score = -1;
+    int truth_count = 0;
+    int hits = 0;
+    int false_alarms = 0;
+    short *stream;
+    unsigned int stream_samples;
+    unsigned int chunk_samples;
+    unsigned int pos;
+    double audio_ms;
+    double cpu_start;
+    double cpu_ms;
+    double cpu_pct;
+    double sum = 0.0;
+    int tmpl_count;
+    int opt;
+    int option_index = 0;
+    int i;
+
+    while ((opt = getopt_long(argc, argv, "t:c:T:k:b:n:i:g:r:C:m:s:B:h", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 't': templates = optarg; break;
+            case 'c': clip = optarg; break;
+            case 'T': truth_list = optarg; break;
+            case 'k': keywords = optarg; break;
+            case 'b': background = optarg; break;
+            case 'n': count = atoi(optarg); break;
+            case 'i': interval_ms = atoi(optarg); break;
+            case 'g': gain_db = atof(optarg); break;
+            case 'r': g_s32Rate = atoi(optarg); break;
+            case 'C': g_s32Channels = atoi(optarg); break;
+            case 'm': chunk_ms = atoi(optarg); break;
+            case 's': threshold = atoi(optarg); break;
+            case 'B': budget = atoi(optarg); break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (templates == NULL || (clip == NULL && keywords == NULL) || g_s32Rate < 8000 || g_s32Channels <= 0 ||
+        chunk_ms <= 0 || count <= 0 || count > BENCH_MAX_TRUTH) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    audio_kws_default_config(&config, g_s32Rate, g_s32Channels);
+    config.threshold = threshold;
+    config.cpu_budget_pct = 0;      // 测试时不自动抬高门限，测出的是最坏情况
+    if (audio_kws_init(&kws, &config) != 0) {
+        printf("❌ [KWS-BENCH] 检测器初始化失败\n");
+        return 1;
+    }
+    tmpl_count = load_list(templates, tmpl_files, AUDIO_KWS_MAX_TEMPLATES);
+    if (tmpl_count <= 0) {
+        return 1;
+    }
+    for (i = 0; i < tmpl_count; i++) {
+        int frames = audio_kws_add_template(&kws, tmpl_files[i].data, tmpl_files[i].samples * g_s32Channels * sizeof(short));
+        if (frames < 0) {
+            printf("❌ [KWS-BENCH] 模板 %s 无效（太短、太长或全是静音）\n", tmpl_files[i].path);
+            return 1;
+        }
+        printf("📁 [KWS-BENCH] 模板 %s: %.2fs, 裁剪后 %d 帧 (%dms)\n", tmpl_files[i].path,
+               (double)tmpl_files[i].samples / g_s32Rate, frames, frames * AUDIO_KWS_HOP_MS);
+    }
+    audio_kws_start(&kws);
+
+    if (clip != NULL) {
+        if (load_pcm(clip, &clip_file) != 0) {
+            return 1;
+        }
+        stream = clip_file.data;
+        stream_samples = clip_file.samples;
+        truth_count = truth_list != NULL ? parse_truth(truth_list, truth) : 0;
+    } else {
+        int kw_count = load_list(keywords, kw_files, BENCH_MAX_FILES);
+
+        if (kw_count <= 0) {
+            return 1;
+        }
+        if (background != NULL && load_pcm(background, &bg_file) != 0) {
+            return 1;
+        }
+        stream = build_mix(background != NULL ? &bg_file : NULL, kw_files, kw_count, count, interval_ms,
+                           pow(10.0, gain_db / 20.0), &stream_samples, truth);
+        if (stream == NULL) {
+            return 1;
+        }
+        truth_count = count;
+    }
+    audio_ms = stream_samples * 1000.0 / g_s32Rate;
+    printf("🎯 [KWS-BENCH] 阈值 %d, 测试音频 %.1fs, 关键词 %d 个, 每块 %dms\n",
+           kws.threshold, audio_ms / 1000.0, truth_count, chunk_ms);
+
+    chunk_samples = (unsigned int)(g_s32Rate * chunk_ms / 1000);
+    cpu_start = process_cpu_ms();
+    for (pos = 0; pos < stream_samples; pos += chunk_samples) {
+        unsigned int n = stream_samples - pos < chunk_samples ? stream_samples - pos : chunk_samples;
+        double t_ms = (pos + n) * 1000.0 / g_s32Rate;
+        int detected = audio_kws_process(&kws, stream + pos * g_s32Channels, n * g_s32Channels * sizeof(short));
+        int w = truth_window(truth, truth_count, t_ms);
+        int score = detected ? kws.stats.last_score : kws.stats.best_score;
+
+        // 按块统计得分：关键词窗口内的最低分和窗口外（背景）的最低分，用于确定阈值
+        if (score >= 0) {
+            int *slot = w >= 0 ? &truth[w].min_score : &bg_score;
+            if (*slot < 0 || score < *slot) {
+                *slot = score;
+            }
+        }
+        kws.stats.best_score = -1;
+        if (!detected) {
+            continue;
+        }
+        if (w >= 0 && !truth[w].hit) {
+            truth[w].hit = 1;
+            latency[hits++] = t_ms - truth[w].end_ms;
+        } else {
+            false_alarms++;
+        }
+        printf("  %s %8.2fs  score %d\n", w >= 0 ? "HIT " : "FA  ", t_ms / 1000.0, kws.stats.last_score);
+    }
+    cpu_ms = process_cpu_ms() - cpu_start;
+    cpu_pct = cpu_ms * 100.0 / audio_ms;
+
+    printf("\n%-18s %d/%d (%.1f%%)\n", "detected", hits, truth_count, truth_count > 0 ? hits * 100.0 / truth_count : 0.0);
+    printf("%-18s %d (%.2f /hour)\n", "false alarms", false_alarms, false_alarms * 3600000.0 / audio_ms);
+    if (hits > 0) {
+        qsort(latency, hits, sizeof(double), compare_double);
+        for (i = 0; i < hits; i++) {
+            sum += latency[i];
+        }
+        printf("%-18s mean %.0f  P50 %.0f  max %.0f ms\n", "latency",
+               sum / hits, latency[(hits - 1) / 2], latency[hits - 1]);
+    }
+    printf("%-18s %.2f%% of one core (%.1f ms CPU for %.1f s audio, budget %d%%)\n", "cpu", cpu_pct, cpu_ms,
+           audio_ms / 1000.0, budget);
+    printf("%-18s %lu/%lu frames (%.1f%%), %.1f us per active frame\n", "active", kws.stats.active_frames,
+           kws.stats.frames, kws.stats.frames > 0 ? kws.stats.active_frames * 100.0 / kws.stats.frames : 0.0,
+           kws.stats.active_frames > 0 ? cpu_ms * 1000.0 / kws.stats.active_frames : 0.0);
+    // 阈值参考：关键词得分应低于阈值，背景得分应高于阈值
+    for (i = 0, scored = 0; i < truth_count; i++) {
+        if (truth[i].min_score >= 0) {
+            scores[scored++] = truth[i].min_score;
+        }
+    }
+    if (scored > 0) {
+        qsort(scores, scored, sizeof(double), compare_double);
+        printf("%-18s min %.0f  P50 %.0f  max %.0f (%d/%d keywords matched)\n", "keyword score",
+               scores[0], scores[(scored - 1) / 2], scores[scored - 1], scored, truth_count);
+    }
+    if (bg_score >= 0) {
+        printf("%-18s %d (lowest score outside keywords)\n", "background score", bg_score);
+    }
+    audio_kws_deinit(&kws);
+    if (budget > 0 && cpu_pct > budget) {
+        printf("❌ [KWS-BENCH] CPU占用超过预算\n");
+        return 2;
+    }
+    return 0;
+}
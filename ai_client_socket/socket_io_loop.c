@@ -0,0 +1,742 @@
+/*
+ * Socket I/O事件循环实现
+ * 详细说明见 socket_io_loop.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <netdb.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "socket_io_loop.h"
+
+#define SOCKET_IO_MAX_EVENTS    8
+#define SOCKET_IO_TX_IOV        (SOCKET_SEND_MAX_FRAMES * 2)
+#define SOCKET_IO_FAIL_LOG_EVERY 30     // 连续重连失败时每30次打印一次
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static SOCKET_MSG_S *socket_msg_alloc(unsigned char msg_type, const void *data, unsigned int data_len) {
+    SOCKET_MSG_S *msg = (SOCKET_MSG_S *)malloc(sizeof(SOCKET_MSG_S) + data_len);
+    if (!msg) {
+        return NULL;
+    }
+    msg->next = NULL;
+    msg->msg_type = msg_type;
+    msg->data_len = data_len;
+    msg->header[0] = msg_type;
+    msg->header[1] = (data_len >> 24) & 0xFF;
+    msg->header[2] = (data_len >> 16) & 0xFF;
+    msg->header[3] = (data_len >> 8) & 0xFF;
+    msg->header[4] = data_len & 0xFF;
+    if (data_len > 0 && data) {
+        memcpy(msg->data, data, data_len);
+    }
+    return msg;
+}
+
+void socket_msg_free(SOCKET_MSG_S *msg) {
+    free(msg);
+}
+
+// ==================== 帧队列 ====================
+
+void socket_queue_init(SOCKET_MSG_QUEUE_S *queue) {
+    pthread_condattr_t attr;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&queue->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->count = 0;
+}
+
+void socket_queue_destroy(SOCKET_MSG_QUEUE_S *queue) {
+    socket_queue_clear(queue);
+    pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->lock);
+}
+
+int socket_queue_push(SOCKET_MSG_QUEUE_S *queue, unsigned char msg_type, const void *data, unsigned int data_len) {
+    SOCKET_MSG_S *msg = socket_msg_alloc(msg_type, data, data_len);
+    if (!msg) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail) {
+        queue->tail->next = msg;
+    } else {
+        queue->head = msg;
+    }
+    queue->tail = msg;
+    queue->count++;
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
+
+SOCKET_MSG_S *socket_queue_pop(SOCKET_MSG_QUEUE_S *queue, int timeout_ms) {
+    SOCKET_MSG_S *msg;
+    struct timespec deadline;
+
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->head) {
+        if (timeout_ms == 0) {
+            break;
+        }
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&queue->cond, &queue->lock);
+        } else if (pthread_cond_timedwait(&queue->cond, &queue->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    msg = queue->head;
+    if (msg) {
+        queue->head = msg->next;
+        if (!queue->head) {
+            queue->tail = NULL;
+        }
+        queue->count--;
+        msg->next = NULL;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return msg;
+}
+
+void socket_queue_clear(SOCKET_MSG_QUEUE_S *queue) {
+    SOCKET_MSG_S *msg;
+
+    pthread_mutex_lock(&queue->lock);
+    msg = queue->head;
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->count = 0;
+    pthread_mutex_unlock(&queue->lock);
+
+    while (msg) {
+        SOCKET_MSG_S *next = msg->next;
+        free(msg);
+        msg = next;
+    }
+}
+
+// ==================== 连接 ====================
+
+// 解析服务器地址（IP地址不会阻塞，主机名由gethostbyname解析）；quiet=1时不打印错误
+static int io_resolve(const char *host, int port, struct sockaddr_in *addr, int quiet) {
+    struct hostent *server;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr->sin_addr) == 1) {
+        return 0;
+    }
+
+    server = gethostbyname(host);
+    if (server == NULL) {
+        if (!quiet) {
+            printf("ERROR: Failed to resolve hostname: %s\n", host);
+            fflush(stdout);
+        }
+        return -1;
+    }
+    memcpy(&addr->sin_addr.s_addr, server->h_addr, server->h_length);
+    return 0;
+}
+
+static void tx_msg_list_free(SOCKET_MSG_S *msg) {
+    while (msg) {
+        SOCKET_MSG_S *next = msg->next;
+        free(msg);
+        msg = next;
+    }
+}
+
+// 清空发送队列并设置连接状态：两者在同一次tx_lock中完成，socket_io_send_batch看到的状态和队列一致
+static void tx_queue_reset(SOCKET_IO_LOOP_S *loop, int connected) {
+    SOCKET_MSG_S *msg;
+
+    pthread_mutex_lock(&loop->tx_lock);
+    msg = loop->tx_head;
+    loop->tx_head = NULL;
+    loop->tx_tail = NULL;
+    loop->tx_offset = 0;
+    loop->tx_bytes = 0;
+    loop->connected = connected;
+    pthread_cond_broadcast(&loop->tx_cond);
+    pthread_mutex_unlock(&loop->tx_lock);
+
+    tx_msg_list_free(msg);
+}
+
+static void io_update_write_interest(SOCKET_IO_LOOP_S *loop, int want_write) {
+    struct epoll_event ev;
+
+    if (loop->sockfd < 0 || loop->want_write == want_write) {
+        return;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | (want_write ? EPOLLOUT : 0);
+    ev.data.fd = loop->sockfd;
+    epoll_ctl(loop->epfd, EPOLL_CTL_MOD, loop->sockfd, &ev);
+    loop->want_write = want_write;
+}
+
+static void io_disconnect(SOCKET_IO_LOOP_S *loop, const char *reason) {
+    if (loop->sockfd < 0) {
+        return;
+    }
+    printf("WARNING: [IO-LOOP] 连接断开: %s\n", reason);
+    fflush(stdout);
+
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, loop->sockfd, NULL);
+    close(loop->sockfd);
+    loop->sockfd = -1;
+    loop->want_write = 0;
+    // 未发送的帧属于旧连接，直接丢弃
+    tx_queue_reset(loop, 0);
+    socket_parser_reset(&loop->parser);
+
+    if (loop->on_state) {
+        loop->on_state(loop->user, 0);
+    }
+}
+
+// 本次连接失败：第一次打印原因，之后每SOCKET_IO_FAIL_LOG_EVERY次汇总一次，等满重连间隔后重试
+static void io_connect_failed(SOCKET_IO_LOOP_S *loop, int err) {
+    if (loop->sockfd >= 0) {
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, loop->sockfd, NULL);
+        close(loop->sockfd);
+        loop->sockfd = -1;
+    }
+    loop->connecting = 0;
+    loop->want_write = 0;
+    loop->retry_at_ms = monotonic_ms() + SOCKET_IO_RECONNECT_MS;
+
+    loop->connect_failures++;
+    if (loop->connect_failures == 1) {
+        fprintf(stderr, "connect 失败: %s (错误码: %d)\n", strerror(err), err);
+        printf("ERROR: Failed to connect to server: %s:%d\n", loop->host, loop->port);
+        fflush(stdout);
+    } else if (loop->connect_failures % SOCKET_IO_FAIL_LOG_EVERY == 0) {
+        printf("WARN: [IO-LOOP] 连接 %s:%d 已连续失败%lu次: %s，%dms后重试\n", loop->host, loop->port,
+               loop->connect_failures, strerror(err), SOCKET_IO_RECONNECT_MS);
+        fflush(stdout);
+    }
+}
+
+// 发起非阻塞连接，完成（或失败）由epoll的EPOLLOUT通知，见io_finish_connect
+static void io_start_connect(SOCKET_IO_LOOP_S *loop) {
+    struct epoll_event ev;
+    int fd;
+
+    if (loop->connect_failures == 0) {
+        printf("INFO: Starting connection to server %s:%d\n", loop->host, loop->port);
+        fflush(stdout);
+    }
+    if (!loop->addr_resolved) {
+        if (io_resolve(loop->host, loop->port, &loop->server_addr, loop->connect_failures > 0) != 0) {
+            io_connect_failed(loop, EHOSTUNREACH);
+            return;
+        }
+        loop->addr_resolved = 1;
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        io_connect_failed(loop, errno);
+        return;
+    }
+    loop->sockfd = fd;
+    if (connect(fd, (struct sockaddr *)&loop->server_addr, sizeof(loop->server_addr)) < 0 && errno != EINPROGRESS) {
+        io_connect_failed(loop, errno);
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT;
+    ev.data.fd = fd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        // 还没加入epoll，io_connect_failed里的EPOLL_CTL_DEL失败无影响
+        io_connect_failed(loop, errno);
+        return;
+    }
+    loop->connecting = 1;
+    loop->want_write = 1;
+    loop->connect_deadline_ms = monotonic_ms() + SOCKET_IO_CONNECT_TIMEOUT_MS;
+}
+
+// 连接中的socket可写：检查连接结果，成功后切换为正常收发
+static void io_finish_connect(SOCKET_IO_LOOP_S *loop) {
+    struct epoll_event ev;
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (getsockopt(loop->sockfd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+        err = errno;
+    }
+    if (err != 0) {
+        io_connect_failed(loop, err);
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.fd = loop->sockfd;
+    epoll_ctl(loop->epfd, EPOLL_CTL_MOD, loop->sockfd, &ev);
+    loop->connecting = 0;
+    loop->want_write = 0;
+
+    // 关闭Nagle：小帧立即发出，多帧由I/O线程合并到一次sendmsg
+    socket_set_nodelay(loop->sockfd);
+    printf("INFO: Successfully connected to server %s:%d\n", loop->host, loop->port);
+    if (loop->connect_failures > 1) {
+        printf("INFO: [IO-LOOP] 连续失败%lu次后重连成功\n", loop->connect_failures);
+    }
+    fflush(stdout);
+    loop->connect_failures = 0;
+
+    socket_parser_reset(&loop->parser);
+    loop->last_tx_ms = monotonic_ms();
+    loop->reconnects++;
+    tx_queue_reset(loop, 1);
+
+    if (loop->on_state) {
+        loop->on_state(loop->user, 1);
+    }
+}
+
+// 读取所有可读数据并分发完整帧
+static int io_handle_read(SOCKET_IO_LOOP_S *loop) {
+    SOCKET_FRAME_S frame;
+
+    while (1) {
+        ssize_t n;
+        int ret;
+
+        while ((ret = socket_parser_next(&loop->parser, &frame)) == SOCKET_PARSE_FRAME) {
+            if (loop->dispatch) {
+                loop->dispatch(loop->user, &frame);
+            }
+        }
+        if (ret == SOCKET_PARSE_ERROR) {
+            io_disconnect(loop, "协议错误");
+            return -1;
+        }
+
+        n = socket_parser_fill(&loop->parser, loop->sockfd);
+        if (n == SOCKET_PARSE_NEED_MORE) {
+            return 0;
+        }
+        if (n == SOCKET_PARSE_CLOSED) {
+            io_disconnect(loop, "服务器关闭连接");
+            return -1;
+        }
+        if (n == SOCKET_PARSE_ERROR) {
+            io_disconnect(loop, strerror(errno));
+            return -1;
+        }
+    }
+}
+
+// 发送队列中的帧，一次sendmsg聚合多帧；发送缓冲区满时注册EPOLLOUT
+static void io_flush_tx(SOCKET_IO_LOOP_S *loop) {
+    if (loop->sockfd < 0 || loop->connecting) {
+        return;
+    }
+
+    pthread_mutex_lock(&loop->tx_lock);
+    while (loop->tx_head) {
+        struct iovec iov[SOCKET_IO_TX_IOV];
+        struct msghdr msg;
+        SOCKET_MSG_S *cur = loop->tx_head;
+        unsigned int skip = loop->tx_offset;
+        int iovcnt = 0;
+        ssize_t n;
+
+        while (cur && iovcnt + 2 <= SOCKET_IO_TX_IOV) {
+            unsigned int hdr_skip = skip < SOCKET_FRAME_HEADER_SIZE ? skip : SOCKET_FRAME_HEADER_SIZE;
+            unsigned int data_skip = skip - hdr_skip;
+
+            if (hdr_skip < SOCKET_FRAME_HEADER_SIZE) {
+                iov[iovcnt].iov_base = cur->header + hdr_skip;
+                iov[iovcnt].iov_len = SOCKET_FRAME_HEADER_SIZE - hdr_skip;
+                iovcnt++;
+            }
+            if (cur->data_len > data_skip) {
+                iov[iovcnt].iov_base = cur->data + data_skip;
+                iov[iovcnt].iov_len = cur->data_len - data_skip;
+                iovcnt++;
+            }
+            skip = 0;
+            cur = cur->next;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        n = sendmsg(loop->sockfd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            pthread_mutex_unlock(&loop->tx_lock);
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                io_update_write_interest(loop, 1);
+            } else {
+                io_disconnect(loop, strerror(errno));
+            }
+            return;
+        }
+        loop->tx_syscalls++;
+        loop->last_tx_ms = monotonic_ms();
+
+        // 释放已完整发送的帧
+        loop->tx_bytes -= n;
+        pthread_cond_broadcast(&loop->tx_cond);
+        while (n > 0 && loop->tx_head) {
+            SOCKET_MSG_S *head = loop->tx_head;
+            unsigned int remain = SOCKET_FRAME_HEADER_SIZE + head->data_len - loop->tx_offset;
+
+            if ((size_t)n < remain) {
+                loop->tx_offset += n;
+                n = 0;
+                break;
+            }
+            n -= remain;
+            loop->tx_head = head->next;
+            if (!loop->tx_head) {
+                loop->tx_tail = NULL;
+            }
+            loop->tx_offset = 0;
+            loop->tx_frames++;
+            free(head);
+        }
+    }
+    pthread_mutex_unlock(&loop->tx_lock);
+    io_update_write_interest(loop, 0);
+}
+
+// 本轮epoll_wait的超时：断线时等到下一次重连，连接中等到连接超时，已连接时一直等待
+static int io_poll_timeout(SOCKET_IO_LOOP_S *loop) {
+    long long remain;
+
+    if (loop->sockfd < 0) {
+        remain = loop->retry_at_ms - monotonic_ms();
+    } else if (loop->connecting) {
+        remain = loop->connect_deadline_ms - monotonic_ms();
+    } else {
+        return -1;
+    }
+    return remain > 0 ? (int)remain : 0;
+}
+
+static void *socket_io_thread(void *ptr) {
+    SOCKET_IO_LOOP_S *loop = (SOCKET_IO_LOOP_S *)ptr;
+    struct epoll_event events[SOCKET_IO_MAX_EVENTS];
+
+    printf("INFO: [IO-LOOP] I/O线程启动 %s:%d, 心跳间隔:%dms\n", loop->host, loop->port, loop->heartbeat_ms);
+    fflush(stdout);
+
+    while (loop->running) {
+        int n, i;
+
+        if (loop->sockfd < 0 && monotonic_ms() >= loop->retry_at_ms) {
+            io_start_connect(loop);
+        } else if (loop->connecting && monotonic_ms() >= loop->connect_deadline_ms) {
+            io_connect_failed(loop, ETIMEDOUT);
+        }
+
+        n = epoll_wait(loop->epfd, events, SOCKET_IO_MAX_EVENTS, io_poll_timeout(loop));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("ERROR: [IO-LOOP] epoll_wait失败: %s\n", strerror(errno));
+            break;
+        }
+
+        for (i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == loop->wakefd) {
+                uint64_t v;
+                if (read(loop->wakefd, &v, sizeof(v)) < 0) {
+                    // 计数器已被读空，忽略
+                }
+            } else if (fd == loop->timerfd) {
+                uint64_t expirations;
+                if (read(loop->timerfd, &expirations, sizeof(expirations)) > 0 && loop->connected &&
+                    monotonic_ms() - loop->last_tx_ms >= loop->heartbeat_ms) {
+                    // 连接空闲才发送心跳，正在上传语音时无需额外心跳
+                    socket_io_send(loop, loop->heartbeat_type, NULL, 0);
+                }
+            } else if (fd == loop->sockfd && loop->connecting) {
+                // 可写或出错都表示连接已有结果
+                io_finish_connect(loop);
+            } else if (fd == loop->sockfd) {
+                if (events[i].events & EPOLLIN) {
+                    if (io_handle_read(loop) != 0) {
+                        continue;
+                    }
+                }
+                if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                    // 先读完对端关闭前发来的数据
+                    if (io_handle_read(loop) == 0) {
+                        io_disconnect(loop, "连接异常");
+                    }
+                    continue;
+                }
+            }
+        }
+
+        io_flush_tx(loop);
+    }
+
+    if (loop->sockfd >= 0) {
+        close(loop->sockfd);
+        loop->sockfd = -1;
+    }
+    tx_queue_reset(loop, 0);
+    printf("INFO: [IO-LOOP] I/O线程退出 (发送帧:%lu, sendmsg次数:%lu, 队列满丢帧:%lu, 接收帧:%lu, recv次数:%lu)\n",
+           loop->tx_frames, loop->tx_syscalls, loop->tx_dropped, loop->parser.frames, loop->parser.recv_calls);
+    fflush(stdout);
+    return NULL;
+}
+
+static void io_wakeup(SOCKET_IO_LOOP_S *loop) {
+    uint64_t one = 1;
+    if (write(loop->wakefd, &one, sizeof(one)) < 0) {
+        // eventfd计数溢出时I/O线程必然已被唤醒，忽略
+    }
+}
+
+int socket_io_start(SOCKET_IO_LOOP_S *loop, const char *host, int port, int heartbeat_ms, unsigned char heartbeat_type,
+                    SOCKET_IO_DISPATCH_FN dispatch, SOCKET_IO_STATE_FN on_state, void *user) {
+    struct epoll_event ev;
+    struct itimerspec its;
+    pthread_condattr_t attr;
+
+    memset(loop, 0, sizeof(*loop));
+    loop->host = host;
+    loop->port = port;
+    loop->heartbeat_ms = heartbeat_ms;
+    loop->heartbeat_type = heartbeat_type;
+    loop->dispatch = dispatch;
+    loop->on_state = on_state;
+    loop->user = user;
+    loop->sockfd = -1;
+    pthread_mutex_init(&loop->tx_lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&loop->tx_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (socket_parser_init(&loop->parser, SOCKET_PARSER_RING_SIZE, 1024 * 1024) != 0) {
+        return -1;
+    }
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    loop->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (loop->epfd < 0 || loop->wakefd < 0 || loop->timerfd < 0) {
+        printf("ERROR: [IO-LOOP] 创建epoll/eventfd/timerfd失败: %s\n", strerror(errno));
+        return -1;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = loop->wakefd;
+    epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakefd, &ev);
+    ev.data.fd = loop->timerfd;
+    epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->timerfd, &ev);
+
+    if (heartbeat_ms > 0) {
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = heartbeat_ms / 1000;
+        its.it_value.tv_nsec = (heartbeat_ms % 1000) * 1000000L;
+        its.it_interval = its.it_value;
+        timerfd_settime(loop->timerfd, 0, &its, NULL);
+    }
+
+    loop->running = 1;
+    if (pthread_create(&loop->thread, NULL, socket_io_thread, loop) != 0) {
+        loop->running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void socket_io_stop(SOCKET_IO_LOOP_S *loop) {
+    if (!loop->running) {
+        return;
+    }
+    loop->running = 0;
+    io_wakeup(loop);
+    pthread_join(loop->thread, NULL);
+
+    tx_queue_reset(loop, 0);
+    close(loop->epfd);
+    close(loop->wakefd);
+    close(loop->timerfd);
+    socket_parser_deinit(&loop->parser);
+    pthread_cond_destroy(&loop->tx_cond);
+    pthread_mutex_destroy(&loop->tx_lock);
+}
+
+int socket_io_wait_connected(SOCKET_IO_LOOP_S *loop, int timeout_ms) {
+    long long start = monotonic_ms();
+
+    while (!loop->connected) {
+        if (!loop->running || (timeout_ms >= 0 && monotonic_ms() - start >= timeout_ms)) {
+            return 0;
+        }
+        usleep(10000);
+    }
+    return 1;
+}
+
+int socket_io_is_connected(const SOCKET_IO_LOOP_S *loop) {
+    return loop->connected;
+}
+
+// 在limit字节的积压上限内放入多帧
+static int io_enqueue(SOCKET_IO_LOOP_S *loop, const SOCKET_OUT_FRAME_S *frames, int count, unsigned int limit) {
+    SOCKET_MSG_S *first = NULL, *last = NULL;
+    unsigned int bytes = 0;
+    int i;
+
+    if (!loop->connected) {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        bytes += SOCKET_FRAME_HEADER_SIZE + frames[i].data_len;
+    }
+
+    for (i = 0; i < count; i++) {
+        SOCKET_MSG_S *msg = socket_msg_alloc(frames[i].msg_type, frames[i].data, frames[i].data_len);
+        if (!msg) {
+            tx_msg_list_free(first);
+            return -1;
+        }
+        if (last) {
+            last->next = msg;
+        } else {
+            first = msg;
+        }
+        last = msg;
+    }
+    if (!first) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&loop->tx_lock);
+    // 在锁内再次检查：断线时connected清零和清空队列在同一次加锁中完成，旧连接的帧不会留到新连接
+    if (!loop->connected) {
+        pthread_mutex_unlock(&loop->tx_lock);
+        tx_msg_list_free(first);
+        return -1;
+    }
+    // 队列空时总能放入，单个超过上限的帧（图片等）不会永远发不出去
+    if (loop->tx_bytes > 0 && loop->tx_bytes + bytes > limit) {
+        loop->tx_dropped++;
+        pthread_mutex_unlock(&loop->tx_lock);
+        tx_msg_list_free(first);
+        return SOCKET_IO_ERR_FULL;
+    }
+    if (loop->tx_tail) {
+        loop->tx_tail->next = first;
+    } else {
+        loop->tx_head = first;
+    }
+    loop->tx_tail = last;
+    loop->tx_bytes += bytes;
+    pthread_mutex_unlock(&loop->tx_lock);
+
+    io_wakeup(loop);
+    return 0;
+}
+
+int socket_io_send_batch(SOCKET_IO_LOOP_S *loop, const SOCKET_OUT_FRAME_S *frames, int count) {
+    return io_enqueue(loop, frames, count, SOCKET_IO_TX_MAX_BYTES);
+}
+
+int socket_io_send_droppable(SOCKET_IO_LOOP_S *loop, unsigned char msg_type, const void *data, unsigned int data_len) {
+    SOCKET_OUT_FRAME_S frame;
+
+    frame.msg_type = msg_type;
+    frame.data = data;
+    frame.data_len = data_len;
+    return io_enqueue(loop, &frame, 1, SOCKET_IO_TX_DROP_BYTES);
+}
+
+int socket_io_wait_tx_space(SOCKET_IO_LOOP_S *loop, unsigned int bytes, int timeout_ms) {
+    struct timespec deadline;
+    int ok;
+
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&loop->tx_lock);
+    while (loop->connected && loop->running && loop->tx_bytes > 0 &&
+           loop->tx_bytes + bytes > SOCKET_IO_TX_MAX_BYTES) {
+        if (timeout_ms == 0) {
+            break;
+        }
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&loop->tx_cond, &loop->tx_lock);
+        } else if (pthread_cond_timedwait(&loop->tx_cond, &loop->tx_lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    ok = loop->connected && (loop->tx_bytes == 0 || loop->tx_bytes + bytes <= SOCKET_IO_TX_MAX_BYTES);
+    pthread_mutex_unlock(&loop->tx_lock);
+    return ok;
+}
+
+int socket_io_send(SOCKET_IO_LOOP_S *loop, unsigned char msg_type, const void *data, unsigned int data_len) {
+    SOCKET_OUT_FRAME_S frame;
+
+    frame.msg_type = msg_type;
+    frame.data = data;
+    frame.data_len = data_len;
+    return socket_io_send_batch(loop, &frame, 1);
+}
@@ -0,0 +1,119 @@
+/*
+ * Socket I/O事件循环
+ *
+ * 由一个epoll驱动的I/O线程独占服务器连接：
+ * - 读：增量帧解析器一次读入所有可读数据，完整帧通过回调分发给各个消费者队列
+ * - 写：其他线程只把帧放入发送队列，由I/O线程合并成尽量少的sendmsg发出；队列按字节数设上限，
+ *   服务器变慢时实时语音帧先被丢弃，给控制帧和图片留出余量
+ * - 心跳：timerfd定时触发，连接空闲时才发送心跳帧
+ * - 断线：关闭连接并按固定间隔自动重连；连接在epoll中非阻塞建立（等待EPOLLOUT），
+ *   期间心跳和唤醒照常处理。主机名只在第一次连接时解析，之后复用解析结果
+ */
+
+#ifndef SOCKET_IO_LOOP_H
+#define SOCKET_IO_LOOP_H
+
+#include <pthread.h>
+#include <netinet/in.h>
+#include "socket_protocol.h"
+
+#define SOCKET_IO_RECONNECT_MS      (1000)      // 断线后重连间隔
+#define SOCKET_IO_CONNECT_TIMEOUT_MS (3000)     // 单次建立连接的最长等待
+#define SOCKET_IO_TX_MAX_BYTES      (512 * 1024)    // 发送队列积压上限（含帧头）
+#define SOCKET_IO_TX_DROP_BYTES     (256 * 1024)    // 可丢弃帧（实时语音）只能把队列积压到这里
+
+#define SOCKET_IO_ERR_FULL          (-2)        // 发送队列已满，帧未入队
+
+// 队列中的一帧（数据紧跟在结构体之后）
+typedef struct _SocketMsg {
+    struct _SocketMsg *next;
+    unsigned char      header[SOCKET_FRAME_HEADER_SIZE];   // 仅发送队列使用
+    unsigned char      msg_type;
+    unsigned int       data_len;
+    unsigned char      data[];
+} SOCKET_MSG_S;
+
+// 线程安全的帧队列（多生产者/多消费者）
+typedef struct _SocketMsgQueue {
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;
+    SOCKET_MSG_S    *head;
+    SOCKET_MSG_S    *tail;
+    unsigned int     count;
+} SOCKET_MSG_QUEUE_S;
+
+// 帧分发回调（在I/O线程中调用），frame->data仅在回调期间有效
+typedef void (*SOCKET_IO_DISPATCH_FN)(void *user, const SOCKET_FRAME_S *frame);
+// 连接状态回调（在I/O线程中调用）：connected=1连接建立，0连接断开
+typedef void (*SOCKET_IO_STATE_FN)(void *user, int connected);
+
+typedef struct _SocketIoLoop {
+    const char            *host;
+    int                    port;
+    int                    heartbeat_ms;
+    unsigned char          heartbeat_type;
+
+    int                    sockfd;
+    int                    epfd;
+    int                    timerfd;
+    int                    wakefd;
+    int                    want_write;          // 是否已注册EPOLLOUT
+    int                    connecting;          // sockfd正在建立连接（等待EPOLLOUT）
+    long long              connect_deadline_ms; // 本次建立连接的超时时刻
+    long long              retry_at_ms;         // 下一次重连的时刻
+    struct sockaddr_in     server_addr;
+    int                    addr_resolved;
+
+    SOCKET_FRAME_PARSER_S  parser;
+
+    pthread_mutex_t        tx_lock;
+    SOCKET_MSG_S          *tx_head;
+    SOCKET_MSG_S          *tx_tail;
+    unsigned int           tx_offset;           // 队首帧已发送的字节数
+    unsigned int           tx_bytes;            // 队列中尚未发送完的字节数（含帧头）
+    pthread_cond_t         tx_cond;             // 队列释放空间时通知等待的生产者
+    long long              last_tx_ms;
+
+    SOCKET_IO_DISPATCH_FN  dispatch;
+    SOCKET_IO_STATE_FN     on_state;
+    void                  *user;
+
+    pthread_t              thread;
+    volatile int           running;
+    volatile int           connected;           // 在tx_lock下修改，发送队列只接受当前连接的帧
+
+    // 统计
+    unsigned long          tx_frames;
+    unsigned long          tx_syscalls;
+    unsigned long          tx_dropped;          // 因队列已满被拒绝的帧数
+    unsigned long          reconnects;
+    unsigned long          connect_failures;    // 当前连续连接失败次数
+} SOCKET_IO_LOOP_S;
+
+void          socket_queue_init(SOCKET_MSG_QUEUE_S *queue);
+void          socket_queue_destroy(SOCKET_MSG_QUEUE_S *queue);
+int           socket_queue_push(SOCKET_MSG_QUEUE_S *queue, unsigned char msg_type, const void *data, unsigned int data_len);
+// 等待最多timeout_ms毫秒取出一帧（timeout_ms<0一直等待），超时返回NULL；使用后调用socket_msg_free释放
+SOCKET_MSG_S *socket_queue_pop(SOCKET_MSG_QUEUE_S *queue, int timeout_ms);
+void          socket_queue_clear(SOCKET_MSG_QUEUE_S *queue);
+void          socket_msg_free(SOCKET_MSG_S *msg);
+
+int  socket_io_start(SOCKET_IO_LOOP_S *loop, const char *host, int port, int heartbeat_ms, unsigned char heartbeat_type,
+                     SOCKET_IO_DISPATCH_FN dispatch, SOCKET_IO_STATE_FN on_state, void *user);
+void socket_io_stop(SOCKET_IO_LOOP_S *loop);
+
+// 等待连接建立，timeout_ms<0一直等待；已连接返回1
+int  socket_io_wait_connected(SOCKET_IO_LOOP_S *loop, int timeout_ms);
+int  socket_io_is_connected(const SOCKET_IO_LOOP_S *loop);
+
+// 把帧放入发送队列（拷贝数据），由I/O线程发送；未连接时返回-1（断线时队列清空，旧连接的帧不会发到新连接），
+// 积压超过SOCKET_IO_TX_MAX_BYTES时返回SOCKET_IO_ERR_FULL
+int  socket_io_send(SOCKET_IO_LOOP_S *loop, unsigned char msg_type, const void *data, unsigned int data_len);
+// 原子地放入多帧，保证它们连续发出并尽量合并到同一次sendmsg
+int  socket_io_send_batch(SOCKET_IO_LOOP_S *loop, const SOCKET_OUT_FRAME_S *frames, int count);
+// 放入一帧可丢弃的数据（实时语音）：积压超过SOCKET_IO_TX_DROP_BYTES时返回SOCKET_IO_ERR_FULL，由调用者丢弃
+int  socket_io_send_droppable(SOCKET_IO_LOOP_S *loop, unsigned char msg_type, const void *data, unsigned int data_len);
+// 等待发送队列能再放入bytes字节（不超过SOCKET_IO_TX_MAX_BYTES），timeout_ms<0一直等待；可以放入返回1，超时或断线返回0
+int  socket_io_wait_tx_space(SOCKET_IO_LOOP_S *loop, unsigned int bytes, int timeout_ms);
+
+#endif // SOCKET_IO_LOOP_H
@@ -0,0 +1,384 @@
+/*
+ * Socket二进制协议公共模块实现
+ * 详细说明见 socket_protocol.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "socket_protocol.h"
+
+static unsigned int round_up_pow2(unsigned int v) {
+    unsigned int n = 1;
+    while (n < v) {
+        n <<= 1;
+    }
+    return n;
+}
+
+static long elapsed_ms(const struct timeval *start) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_usec - start->tv_usec) / 1000;
+}
+
+int socket_parser_init(SOCKET_FRAME_PARSER_S *parser, unsigned int ring_size, unsigned int max_payload) {
+    memset(parser, 0, sizeof(*parser));
+
+    if (ring_size < 4096) {
+        ring_size = 4096;
+    }
+    parser->ring_size = round_up_pow2(ring_size);
+    parser->ring_mask = parser->ring_size - 1;
+    parser->max_payload = max_payload;
+
+    parser->ring = (unsigned char *)malloc(parser->ring_size);
+    parser->linear = (unsigned char *)malloc(max_payload > 0 ? max_payload : 1);
+    if (!parser->ring || !parser->linear) {
+        printf("ERROR: [PARSER] 分配接收缓冲区失败 (ring=%u, payload=%u)\n", parser->ring_size, max_payload);
+        socket_parser_deinit(parser);
+        return -1;
+    }
+    return 0;
+}
+
+void socket_parser_deinit(SOCKET_FRAME_PARSER_S *parser) {
+    free(parser->ring);
+    free(parser->linear);
+    parser->ring = NULL;
+    parser->linear = NULL;
+}
+
+// 连接重建后丢弃所有残留数据
+void socket_parser_reset(SOCKET_FRAME_PARSER_S *parser) {
+    parser->head = 0;
+    parser->tail = 0;
+    parser->header_valid = 0;
+    parser->large_frame = 0;
+    parser->large_filled = 0;
+}
+
+// 从环形缓冲区拷贝len字节（处理回绕），并推进读位置
+static void ring_read(SOCKET_FRAME_PARSER_S *parser, unsigned char *dst, unsigned int len) {
+    unsigned int off = parser->tail & parser->ring_mask;
+    unsigned int first = parser->ring_size - off;
+
+    if (first > len) {
+        first = len;
+    }
+    memcpy(dst, parser->ring + off, first);
+    if (len > first) {
+        memcpy(dst + first, parser->ring, len - first);
+    }
+    parser->tail += len;
+}
+
+ssize_t socket_parser_fill(SOCKET_FRAME_PARSER_S *parser, int sockfd) {
+    struct iovec iov[2];
+    struct msghdr msg;
+    int iovcnt;
+    ssize_t n;
+
+    if (parser->large_frame) {
+        // 大帧：直接接收到线性缓冲区
+        iov[0].iov_base = parser->linear + parser->large_filled;
+        iov[0].iov_len = parser->cur_len - parser->large_filled;
+        iovcnt = 1;
+    } else {
+        unsigned int used = parser->head - parser->tail;
+        unsigned int space = parser->ring_size - used;
+        unsigned int off = parser->head & parser->ring_mask;
+        unsigned int first = parser->ring_size - off;
+
+        if (space == 0) {
+            // 缓冲区已满，调用者需要先取走已完成的帧
+            return SOCKET_PARSE_NEED_MORE;
+        }
+        if (first >= space) {
+            iov[0].iov_base = parser->ring + off;
+            iov[0].iov_len = space;
+            iovcnt = 1;
+        } else {
+            iov[0].iov_base = parser->ring + off;
+            iov[0].iov_len = first;
+            iov[1].iov_base = parser->ring;
+            iov[1].iov_len = space - first;
+            iovcnt = 2;
+        }
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+    do {
+        n = recvmsg(sockfd, &msg, MSG_DONTWAIT);
+    } while (n < 0 && errno == EINTR);
+
+    if (n == 0) {
+        return SOCKET_PARSE_CLOSED;
+    }
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return SOCKET_PARSE_NEED_MORE;
+        }
+        return SOCKET_PARSE_ERROR;
+    }
+
+    parser->recv_calls++;
+    parser->recv_bytes += n;
+    if (parser->large_frame) {
+        parser->large_filled += n;
+    } else {
+        parser->head += n;
+    }
+    return n;
+}
+
+int socket_parser_next(SOCKET_FRAME_PARSER_S *parser, SOCKET_FRAME_S *frame) {
+    unsigned int used;
+
+    if (!parser->header_valid) {
+        unsigned char header[SOCKET_FRAME_HEADER_SIZE];
+
+        if (parser->head - parser->tail < SOCKET_FRAME_HEADER_SIZE) {
+            return SOCKET_PARSE_NEED_MORE;
+        }
+        ring_read(parser, header, SOCKET_FRAME_HEADER_SIZE);
+        parser->cur_type = header[0];
+        parser->cur_len = ((unsigned int)header[1] << 24) | ((unsigned int)header[2] << 16) |
+                          ((unsigned int)header[3] << 8) | header[4];
+        parser->header_valid = 1;
+
+        if (parser->cur_len > parser->max_payload) {
+            printf("ERROR: [DEBUG-TOOLARGE] Data length too large: %u > %u\n", parser->cur_len, parser->max_payload);
+            fflush(stdout);
+            return SOCKET_PARSE_ERROR;
+        }
+
+        if (parser->cur_len > parser->ring_size) {
+            // 环形缓冲区放不下：把已收到的部分移到线性缓冲区，后续直接收到那里
+            unsigned int avail = parser->head - parser->tail;
+            if (avail > parser->cur_len) {
+                avail = parser->cur_len;
+            }
+            ring_read(parser, parser->linear, avail);
+            parser->large_frame = 1;
+            parser->large_filled = avail;
+        }
+    }
+
+    if (parser->large_frame) {
+        if (parser->large_filled < parser->cur_len) {
+            return SOCKET_PARSE_NEED_MORE;
+        }
+        frame->data = parser->linear;
+        parser->large_frame = 0;
+        parser->large_filled = 0;
+    } else {
+        unsigned int off;
+
+        used = parser->head - parser->tail;
+        if (used < parser->cur_len) {
+            return SOCKET_PARSE_NEED_MORE;
+        }
+        off = parser->tail & parser->ring_mask;
+        if (off + parser->cur_len <= parser->ring_size) {
+            // 连续存放，直接返回环形缓冲区内的指针
+            frame->data = parser->ring + off;
+            parser->tail += parser->cur_len;
+        } else {
+            ring_read(parser, parser->linear, parser->cur_len);
+            frame->data = parser->linear;
+            parser->linearized++;
+        }
+    }
+
+    frame->msg_type = parser->cur_type;
+    frame->data_len = parser->cur_len;
+    parser->header_valid = 0;
+    parser->frames++;
+    return SOCKET_PARSE_FRAME;
+}
+
+int socket_parser_partial(const SOCKET_FRAME_PARSER_S *parser, unsigned char *msg_type,
+                          unsigned int *have, unsigned int *total) {
+    if (!parser->header_valid) {
+        return 0;
+    }
+    if (msg_type) {
+        *msg_type = parser->cur_type;
+    }
+    if (have) {
+        unsigned int got = parser->large_frame ? parser->large_filled : parser->head - parser->tail;
+        *have = got > parser->cur_len ? parser->cur_len : got;
+    }
+    if (total) {
+        *total = parser->cur_len;
+    }
+    return 1;
+}
+
+int socket_receive_frame(SOCKET_FRAME_PARSER_S *parser, int sockfd, int timeout_ms, SOCKET_FRAME_S *frame) {
+    struct timeval start;
+    gettimeofday(&start, NULL);
+
+    while (1) {
+        struct pollfd pfd;
+        int wait_ms = -1;
+        int ret;
+        ssize_t n;
+
+        ret = socket_parser_next(parser, frame);
+        if (ret != SOCKET_PARSE_NEED_MORE) {
+            return ret;
+        }
+
+        if (timeout_ms >= 0) {
+            wait_ms = timeout_ms - (int)elapsed_ms(&start);
+            if (wait_ms < 0) {
+                wait_ms = 0;
+            }
+        }
+
+        pfd.fd = sockfd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, wait_ms);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return SOCKET_PARSE_ERROR;
+        }
+        if (ret == 0) {
+            return SOCKET_PARSE_TIMEOUT;
+        }
+
+        n = socket_parser_fill(parser, sockfd);
+        if (n == SOCKET_PARSE_CLOSED || n == SOCKET_PARSE_ERROR) {
+            return (int)n;
+        }
+    }
+}
+
+int socket_set_nodelay(int sockfd) {
+    int on = 1;
+    return setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+static void pack_header(unsigned char *header, unsigned char msg_type, unsigned int data_len) {
+    header[0] = msg_type;
+    header[1] = (data_len >> 24) & 0xFF;
+    header[2] = (data_len >> 16) & 0xFF;
+    header[3] = (data_len >> 8) & 0xFF;
+    header[4] = data_len & 0xFF;
+}
+
+// 循环发送iov中的全部数据，处理部分写入/EINTR/EAGAIN
+static int send_iov_all(int sockfd, struct iovec *iov, int iovcnt) {
+    struct msghdr msg;
+
+    while (iovcnt > 0) {
+        ssize_t n;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        n = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd;
+                int ret;
+
+                pfd.fd = sockfd;
+                pfd.events = POLLOUT;
+                pfd.revents = 0;
+                ret = poll(&pfd, 1, SOCKET_SEND_TIMEOUT_MS);
+                if (ret <= 0 && !(ret < 0 && errno == EINTR)) {
+                    return SOCKET_PARSE_ERROR;
+                }
+                continue;
+            }
+            return SOCKET_PARSE_ERROR;
+        }
+
+        // 跳过已完整发送的iov，调整部分发送的iov
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+int socket_send_frame(int sockfd, unsigned char msg_type, const void *data, unsigned int data_len) {
+    unsigned char header[SOCKET_FRAME_HEADER_SIZE];
+    struct iovec iov[2];
+    int iovcnt = 1;
+
+    pack_header(header, msg_type, data_len);
+    iov[0].iov_base = header;
+    iov[0].iov_len = SOCKET_FRAME_HEADER_SIZE;
+    if (data_len > 0 && data != NULL) {
+        iov[1].iov_base = (void *)data;
+        iov[1].iov_len = data_len;
+        iovcnt = 2;
+    }
+    return send_iov_all(sockfd, iov, iovcnt);
+}
+
+int socket_send_frames(int sockfd, const SOCKET_OUT_FRAME_S *frames, int count) {
+    unsigned char headers[SOCKET_SEND_MAX_FRAMES][SOCKET_FRAME_HEADER_SIZE];
+    struct iovec iov[SOCKET_SEND_MAX_FRAMES * 2];
+
+    while (count > 0) {
+        int batch = count > SOCKET_SEND_MAX_FRAMES ? SOCKET_SEND_MAX_FRAMES : count;
+        int iovcnt = 0;
+        int i;
+
+        for (i = 0; i < batch; i++) {
+            pack_header(headers[i], frames[i].msg_type, frames[i].data_len);
+            iov[iovcnt].iov_base = headers[i];
+            iov[iovcnt].iov_len = SOCKET_FRAME_HEADER_SIZE;
+            iovcnt++;
+            if (frames[i].data_len > 0 && frames[i].data != NULL) {
+                iov[iovcnt].iov_base = (void *)frames[i].data;
+                iov[iovcnt].iov_len = frames[i].data_len;
+                iovcnt++;
+            }
+        }
+        if (send_iov_all(sockfd, iov, iovcnt) != 0) {
+            return SOCKET_PARSE_ERROR;
+        }
+        frames += batch;
+        count -= batch;
+    }
+    return 0;
+}
+
+int socket_send_batch_begin(int sockfd) {
+    int on = 1;
+    return setsockopt(sockfd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+}
+
+int socket_send_batch_end(int sockfd) {
+    int off = 0;
+    return setsockopt(sockfd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+}
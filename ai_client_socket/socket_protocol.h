@@ -0,0 +1,103 @@
+/*
+ * Socket二进制协议公共模块
+ *
+ * 帧格式（与Python SocketServer/SocketClient保持一致）：
+ *   消息类型(1字节) + 数据长度(4字节，网络字节序) + 数据
+ *
+ * 接收侧提供一个非阻塞、可重入的增量帧解析器：
+ * - 每次recv尽量读入大块数据到环形缓冲区，一次recv可以解析出多个完整帧
+ * - 帧不完整时立即返回，不阻塞，可通过socket_parser_partial()查询进度
+ * - 超过环形缓冲区的大帧直接接收到线性缓冲区，不做二次拷贝
+ *
+ * 发送侧每帧只用一次sendmsg（帧头+数据聚合发送），正确处理部分写入；
+ * 批量模式（TCP_CORK）可以让 VOICE_START + 多个数据帧合并成尽量少的TCP报文段。
+ */
+
+#ifndef SOCKET_PROTOCOL_H
+#define SOCKET_PROTOCOL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define SOCKET_FRAME_HEADER_SIZE    5
+#define SOCKET_PARSER_RING_SIZE     (64 * 1024)     // 默认环形缓冲区大小（必须为2的幂）
+#define SOCKET_SEND_TIMEOUT_MS      (5000)          // 发送缓冲区满时最长等待时间
+#define SOCKET_SEND_MAX_FRAMES      (32)            // socket_send_frames单次最多聚合的帧数
+
+// 解析/接收结果
+#define SOCKET_PARSE_FRAME          1       // 取得一个完整帧
+#define SOCKET_PARSE_NEED_MORE      0       // 数据不足，需要继续接收
+#define SOCKET_PARSE_ERROR          (-1)    // 协议错误或socket错误
+#define SOCKET_PARSE_CLOSED         (-2)    // 对端关闭连接
+#define SOCKET_PARSE_TIMEOUT        (-3)    // 等待超时
+
+// 解析出的一帧，data在下一次调用socket_parser_fill/socket_parser_next之前有效
+typedef struct _SocketFrame {
+    unsigned char        msg_type;
+    unsigned int         data_len;
+    const unsigned char *data;
+} SOCKET_FRAME_S;
+
+// 待发送的一帧
+typedef struct _SocketOutFrame {
+    unsigned char  msg_type;
+    const void    *data;
+    unsigned int   data_len;
+} SOCKET_OUT_FRAME_S;
+
+typedef struct _SocketFrameParser {
+    unsigned char *ring;            // 环形缓冲区
+    unsigned int   ring_size;
+    unsigned int   ring_mask;
+    unsigned int   head;            // 累计写入位置
+    unsigned int   tail;            // 累计读取位置
+
+    unsigned char *linear;          // 线性化缓冲区（跨越环尾的帧和大帧）
+    unsigned int   max_payload;
+
+    // 当前正在解析的帧
+    int            header_valid;
+    unsigned char  cur_type;
+    unsigned int   cur_len;
+    int            large_frame;     // 当前帧直接接收到linear
+    unsigned int   large_filled;
+
+    // 统计
+    unsigned long  recv_calls;
+    unsigned long  recv_bytes;
+    unsigned long  frames;
+    unsigned long  linearized;
+} SOCKET_FRAME_PARSER_S;
+
+int  socket_parser_init(SOCKET_FRAME_PARSER_S *parser, unsigned int ring_size, unsigned int max_payload);
+void socket_parser_deinit(SOCKET_FRAME_PARSER_S *parser);
+void socket_parser_reset(SOCKET_FRAME_PARSER_S *parser);
+
+// 非阻塞读取socket中当前可读的数据，返回读取字节数；
+// 没有数据时返回SOCKET_PARSE_NEED_MORE，对端关闭返回SOCKET_PARSE_CLOSED
+ssize_t socket_parser_fill(SOCKET_FRAME_PARSER_S *parser, int sockfd);
+
+// 从已接收的数据中取出下一个完整帧
+int  socket_parser_next(SOCKET_FRAME_PARSER_S *parser, SOCKET_FRAME_S *frame);
+
+// 查询当前未完成的帧：返回1表示已有帧头，have/total为已收到/总payload字节数
+int  socket_parser_partial(const SOCKET_FRAME_PARSER_S *parser, unsigned char *msg_type,
+                           unsigned int *have, unsigned int *total);
+
+// 阻塞辅助函数：等待最多timeout_ms毫秒直到取得一个完整帧（timeout_ms<0表示一直等待）
+int  socket_receive_frame(SOCKET_FRAME_PARSER_S *parser, int sockfd, int timeout_ms, SOCKET_FRAME_S *frame);
+
+// 关闭Nagle算法，避免小帧在延迟ACK上停顿（连接建立后调用一次）
+int  socket_set_nodelay(int sockfd);
+
+// 发送一帧：帧头和数据通过一次sendmsg发出，部分写入时继续发送剩余部分
+int  socket_send_frame(int sockfd, unsigned char msg_type, const void *data, unsigned int data_len);
+
+// 一次sendmsg发送多帧（超过SOCKET_SEND_MAX_FRAMES时分批）
+int  socket_send_frames(int sockfd, const SOCKET_OUT_FRAME_S *frames, int count);
+
+// 批量模式：begin后发送的帧在内核中合并，end时立即推送剩余数据
+int  socket_send_batch_begin(int sockfd);
+int  socket_send_batch_end(int sockfd);
+
+#endif // SOCKET_PROTOCOL_H
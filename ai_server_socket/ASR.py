@@ -3,6 +3,7 @@ import numpy as np
 import soundfile as sf
 import torchaudio
 import io
+import math
 import asyncio
 import time
 import base64
@@ -23,10 +24,13 @@ from ASRs import load_phi4_server
 
 # 声明全局变量但不立即初始化
 transcribe_audio_local = None
+# 可选的批量识别函数：ASR配置中"batch_function"指定，参数为(补零到相同长度的音频列表, 各自有效长度, 采样率)，
+# 返回与输入顺序相同的文本列表
+transcribe_batch_local = None
 
 # 惰性加载ASR模块
 def load_asr_module():
-    global transcribe_audio_local
+    global transcribe_audio_local, transcribe_batch_local
     asr_type = ASR_CONFIGS[DEFAULT_ASR]["type"]
     if transcribe_audio_local is None and asr_type == "local":
         module_path = ASR_CONFIGS[DEFAULT_ASR]["module"]
@@ -36,12 +40,15 @@ def load_asr_module():
         # 检查是否是phi4Server
         if module_path == "ASRs.Phi4Mul.phi4Server":
             # 使用延迟加载函数
-            phi4Server = load_phi4_server()
-            transcribe_audio_local = getattr(phi4Server, function_name)
+            module = load_phi4_server()
         else:
             # 使用普通导入
             module = importlib.import_module(module_path)
-            transcribe_audio_local = getattr(module, function_name)
+        transcribe_audio_local = getattr(module, function_name)
+        batch_function = ASR_CONFIGS[DEFAULT_ASR].get("batch_function")
+        transcribe_batch_local = getattr(module, batch_function, None) if batch_function else None
+        if transcribe_batch_local is not None:
+            print(f"[ASR] 使用批量识别: {module_path}.{batch_function}")
     elif asr_type == "websocket":
         # websocket 类型无需加载本地模块
         print(f"[ASR] 当前类型: {asr_type}, 默认ASR: {DEFAULT_ASR}")
@@ -69,9 +76,9 @@ def load_asr_module():
                 except Exception as e:
                     print(f"[ASR] 启动 sensevoice 服务失败: {e}")
 
-async def async_process_audio(audio_buffer):
+async def async_process_audio(audio_buffer, sample_rate=16000, channels=1):
     start_time = time.time()
-    """处理音频数据并返回转录结果"""
+    """处理音频数据并返回转录结果（裸PCM按客户端声明的sample_rate/channels解析）"""
     try:
         print(f"🎤 [ASR] 开始处理音频数据 - {time.time():.3f}")
         
@@ -87,7 +94,9 @@ async def async_process_audio(audio_buffer):
             print(f"🎤 [ASR] soundfile读取失败: {e}，尝试作为PCM数据读取")
             audio_buffer.seek(0)
             audio_data = np.frombuffer(audio_buffer.read(), dtype=np.int16)
-            samplerate = 16000
+            if channels > 1:
+                audio_data = audio_data[:len(audio_data) // channels * channels].reshape(-1, channels)
+            samplerate = sample_rate
             print(f"🎤 [ASR] PCM读取成功，数据长度: {len(audio_data)}")
 
         audio_parse_end = time.time()
@@ -150,7 +159,7 @@ async def async_process_audio(audio_buffer):
             
             # 实际推理
             inference_start = time.time()
-            text = await transcribe_audio_local(audio_data, 16000)
+            text = await transcribe_local(audio_data)
             inference_end = time.time()
             print(f"🤖 [ASR] 本地推理完成，耗时: {inference_end - inference_start:.3f}s")
             
@@ -226,6 +235,384 @@ async def transcribe_audio_websocket(audio_data, ws_url):
         print(f"WebSocket ASR服务调用出错: {e}")
         return f"ERROR: {str(e)}"
 
+class ASRBatchScheduler:
+    """
+    本地ASR跨连接动态批处理：多个连接同时结束说话时，把max_wait_ms窗口内到达的最终识别请求
+    补零成一批，调用一次transcribe_batch_local，再把结果分别返回。
+    - 每个还没提交最终识别的轮次（流式会话和整段识别都算）都通过ASRTurnSlot登记；
+      没有其他登记的轮次（没有人还会加入这一批）或凑满max_batch时立即执行，单个用户不需要等待窗口
+    - 否则最多等待max_wait_ms
+    - 流式中间识别单独排队，只在没有最终识别等待时执行，不占用最终识别的批次
+    """
+
+    def __init__(self, max_batch=8, max_wait_ms=30):
+        self.max_batch = max_batch
+        self.max_wait = max_wait_ms / 1000.0
+        self.finals = []                # (音频, future, 到达时间)
+        self.partials = []
+        self.active_sessions = 0        # 已登记但还没提交最终识别的轮次数
+        self.wakeup = asyncio.Event()
+        self.worker = None
+        self.stats = {'batches': 0, 'items': 0, 'max_size': 0, 'wait_ms': 0.0, 'infer_ms': 0.0, 'partial_batches': 0}
+
+    def session_opened(self):
+        self.active_sessions += 1
+
+    def session_closed(self):
+        self.active_sessions = max(0, self.active_sessions - 1)
+        self.wakeup.set()
+
+    async def transcribe(self, audio_data, final=True):
+        if self.worker is None or self.worker.done():
+            self.worker = asyncio.create_task(self._run())
+        future = asyncio.get_running_loop().create_future()
+        (self.finals if final else self.partials).append((audio_data, future, time.time()))
+        self.wakeup.set()
+        return await future
+
+    def _ready(self):
+        return len(self.finals) >= self.max_batch or self.active_sessions == 0
+
+    @staticmethod
+    def _drop_cancelled(queue):
+        # 调用者已放弃（例如结束时取消的中间识别）的请求不再计算
+        queue[:] = [item for item in queue if not item[1].done()]
+
+    async def _run(self):
+        while True:
+            self.wakeup.clear()
+            self._drop_cancelled(self.finals)
+            self._drop_cancelled(self.partials)
+            if self.finals:
+                deadline = self.finals[0][2] + self.max_wait
+                while not self._ready():
+                    remaining = deadline - time.time()
+                    if remaining <= 0:
+                        break
+                    self.wakeup.clear()
+                    try:
+                        await asyncio.wait_for(self.wakeup.wait(), timeout=remaining)
+                    except asyncio.TimeoutError:
+                        break
+                self._drop_cancelled(self.finals)
+                queue, final = self.finals, True
+            elif self.partials:
+                queue, final = self.partials, False
+            else:
+                await self.wakeup.wait()
+                continue
+            batch = queue[:self.max_batch]
+            del queue[:len(batch)]
+            if batch:
+                await self._run_batch(batch, final)
+
+    async def _run_batch(self, batch, final=True):
+        start_time = time.time()
+        lengths = [len(audio) for audio, _, _ in batch]
+        max_len = max(lengths)
+        padded = [audio if len(audio) == max_len else np.pad(audio, (0, max_len - len(audio))) for audio, _, _ in batch]
+        try:
+            texts = await transcribe_batch_local(padded, lengths, 16000)
+            if not isinstance(texts, (list, tuple)):
+                raise TypeError(f"批量识别应返回列表，实际为{type(texts).__name__}")
+            if len(texts) != len(batch):
+                raise ValueError(f"批量识别返回{len(texts)}条结果，应为{len(batch)}条")
+        except Exception as e:
+            # 每个等待者都必须拿到结果，否则对应的轮次会一直等待
+            print(f"❌ [ASR_BATCH] 批量识别失败: {e}")
+            texts = [f"ERROR: {str(e)}"] * len(batch)
+        infer_ms = (time.time() - start_time) * 1000
+        for (_, future, _), text in zip(batch, texts):
+            if not future.done():
+                future.set_result(text)
+
+        stats = self.stats
+        if not final:
+            stats['partial_batches'] += 1
+            return
+        stats['batches'] += 1
+        stats['items'] += len(batch)
+        stats['max_size'] = max(stats['max_size'], len(batch))
+        stats['wait_ms'] += sum((start_time - arrive) * 1000 for _, _, arrive in batch)
+        stats['infer_ms'] += infer_ms
+        print(f"📦 [ASR_BATCH] 批量识别{len(batch)}条(最长{max_len / 16000:.2f}s)，推理{infer_ms:.0f}ms；"
+              f"累计{stats['batches']}批/{stats['items']}条，平均每批{stats['items'] / stats['batches']:.2f}条，"
+              f"平均等待{stats['wait_ms'] / stats['items']:.1f}ms，最大批{stats['max_size']}，"
+              f"中间识别{stats['partial_batches']}批")
+
+asr_batch_scheduler = ASRBatchScheduler()
+
+class ASRTurnSlot:
+    """
+    一轮语音在批处理调度器中的登记：VOICE_START时open()，提交最终识别前或放弃本轮时close()。
+    调度器据此知道还有多少轮次可能加入当前批次（非本地ASR不登记）
+    """
+
+    def __init__(self):
+        self.registered = False
+
+    def open(self):
+        if ASR_CONFIGS[DEFAULT_ASR]["type"] == "local" and not self.registered:
+            asr_batch_scheduler.session_opened()
+            self.registered = True
+
+    def close(self):
+        if self.registered:
+            self.registered = False
+            asr_batch_scheduler.session_closed()
+
+async def transcribe_local(audio_data, final=True):
+    """本地ASR识别：模块提供批量函数时经过批处理调度，否则直接调用"""
+    if transcribe_batch_local is not None:
+        return await asr_batch_scheduler.transcribe(audio_data, final)
+    return await transcribe_audio_local(audio_data, 16000)
+
+async def transcribe_float32(audio_data, final=True):
+    """对16kHz单声道float32音频运行当前配置的ASR（不含文本过滤），final=False为流式中间识别"""
+    asr_config = ASR_CONFIGS[DEFAULT_ASR]
+    if asr_config["type"] == "local":
+        load_asr_module()
+        return await transcribe_local(audio_data, final)
+    elif asr_config["type"] == "websocket":
+        return await transcribe_audio_websocket(audio_data, asr_config["url"])
+    raise ValueError(f"不支持的ASR类型: {asr_config['type']}")
+
+class StreamingResampler:
+    """
+    分块重采样，输出与整段一次torchaudio.functional.resample相同。
+    sinc核只用到每个输出位置附近width个输入采样：每块带上前后各context个原始采样一起重采样，
+    只保留对应本块的输出；右侧上下文不足的部分留到下一块，finish()时按整段结尾的方式输出
+    """
+
+    def __init__(self, orig_freq, new_freq=16000, lowpass_filter_width=6, rolloff=0.99):
+        g = math.gcd(orig_freq, new_freq)
+        self.orig_freq = orig_freq
+        self.new_freq = new_freq
+        self.lowpass_filter_width = lowpass_filter_width
+        self.rolloff = rolloff
+        # 每orig_step个输入采样对应new_step个输出采样，分块边界按orig_step对齐
+        self.orig_step = orig_freq // g
+        self.new_step = new_freq // g
+        width = math.ceil(lowpass_filter_width * self.orig_step / (min(self.orig_step, self.new_step) * rolloff))
+        self.context = (width // self.orig_step + 2) * self.orig_step
+        self.pending = np.zeros(0, dtype=np.float32)    # 从self.base开始的原始采样
+        self.base = 0
+        self.done = 0                                   # 已输出部分对应的原始采样位置
+
+    def _emit(self, end, final):
+        start = max(self.base, self.done - self.context)
+        stop = self.base + len(self.pending) if final else end + self.context
+        segment = np.ascontiguousarray(self.pending[start - self.base:stop - self.base])
+        out = torchaudio.functional.resample(torch.from_numpy(segment), self.orig_freq, self.new_freq,
+                                             lowpass_filter_width=self.lowpass_filter_width,
+                                             rolloff=self.rolloff).numpy()
+        lead = (self.done - start) // self.orig_step * self.new_step
+        if final:
+            out = out[lead:]
+        else:
+            out = out[lead:lead + (end - self.done) // self.orig_step * self.new_step]
+        self.done = end
+        keep = max(self.base, end - self.context)
+        self.pending = self.pending[keep - self.base:]
+        self.base = keep
+        return out
+
+    def process(self, audio):
+        """喂入一块原始采样，返回右侧上下文已经足够的输出"""
+        if len(audio) > 0:
+            self.pending = np.concatenate([self.pending, audio])
+        ready = self.base + len(self.pending) - self.context - self.done
+        if ready < self.orig_step:
+            return np.zeros(0, dtype=np.float32)
+        return self._emit(self.done + ready // self.orig_step * self.orig_step, False)
+
+    def finish(self):
+        """输出剩余的全部采样"""
+        total = self.base + len(self.pending)
+        if total <= self.done:
+            return np.zeros(0, dtype=np.float32)
+        return self._emit(total, True)
+
+
+class StreamingASRSession:
+    """
+    一轮语音的流式ASR会话：MSG_VOICE_START时创建，MSG_VOICE_DATA到达时增量喂入PCM(s16le)。
+    - 每个数据块到达时即完成int16->float32和声道合并，重采样保留块间状态（见StreamingResampler），
+      结束时不再重新解析整段音频
+    - 本地ASR：说话过程中在后台识别已收到的音频，通过on_partial(text, audio_seconds)回调输出中间结果。
+      本地模型不是增量的，每次都要重新识别全部音频，所以两次中间识别之间的新音频至少为
+      partial_interval秒和已有音频的partial_backoff倍中较大者：中间识别的音频长度按比例增长，
+      总计算量与语音长度成线性关系而不是平方关系
+    - 结束时如果最近一次中间结果已经覆盖全部音频则直接作为最终结果；正在进行但没有覆盖全部音频的
+      中间识别直接取消，不再等它完成后再识别一遍
+    - WebSocket ASR：开始时就建立连接并发送START，音频边收边上传，结束时只需发送EOF等结果
+    """
+
+    def __init__(self, sample_rate=16000, channels=1, partial_interval=0.6, partial_backoff=0.5, on_partial=None):
+        self.sample_rate = sample_rate
+        self.channels = channels
+        self.partial_interval = partial_interval
+        self.partial_backoff = partial_backoff
+        self.on_partial = on_partial
+        self.asr_config = ASR_CONFIGS[DEFAULT_ASR]
+        self.chunks = []
+        self.total_samples = 0
+        self.carry = b''
+        self.resampler = StreamingResampler(sample_rate) if sample_rate != 16000 else None
+        self.partial_task = None
+        self.partial_task_samples = 0   # 正在进行的中间识别覆盖的采样数
+        self.partial_samples = 0        # 最近一次中间结果覆盖的采样数
+        self.partial_cancelled = 0      # 结束时被取消的中间识别次数
+        self.partial_text = None
+        self.partial_count = 0
+        self.ws_session = None
+        self.ws = None
+        self.closed = False
+        self.batch_slot = ASRTurnSlot()
+
+    async def start(self):
+        if self.asr_config["type"] == "local":
+            load_asr_module()
+            self.batch_slot.open()
+        elif self.asr_config["type"] == "websocket":
+            try:
+                self.ws_session = aiohttp.ClientSession()
+                self.ws = await self.ws_session.ws_connect(self.asr_config["url"])
+                await self.ws.send_str('START')
+            except Exception as e:
+                print(f"⚠️ [ASR_STREAM] WebSocket连接失败，结束时整段识别: {e}")
+                await self._close_ws()
+
+    def _to_float32(self, data: bytes):
+        data = self.carry + data
+        frame_bytes = 2 * self.channels
+        usable = len(data) - len(data) % frame_bytes
+        self.carry = data[usable:]
+        audio = np.frombuffer(data[:usable], dtype=np.int16).astype(np.float32) / 32768.0
+        if self.channels > 1:
+            audio = audio.reshape(-1, self.channels).mean(axis=1)
+        if self.resampler is not None:
+            audio = self.resampler.process(audio)
+        return audio
+
+    async def _append(self, audio):
+        self.chunks.append(audio)
+        self.total_samples += len(audio)
+        if self.ws is not None:
+            try:
+                await self.ws.send_bytes((audio * 32767.0).astype(np.int16).tobytes())
+            except Exception as e:
+                # 已上传的部分作废，结束时改为整段识别
+                print(f"⚠️ [ASR_STREAM] WebSocket上传失败，结束时整段识别: {e}")
+                await self._close_ws()
+
+    async def feed(self, data: bytes):
+        """喂入一块PCM数据"""
+        if self.closed or not data:
+            return
+        audio = self._to_float32(data)
+        if len(audio) == 0:
+            return
+        ws_active = self.ws is not None
+        await self._append(audio)
+
+        if not ws_active and self.asr_config["type"] == "local" and self.on_partial is not None:
+            if self.partial_task is not None and not self.partial_task.done():
+                return
+            # 从上一次中间识别启动时算起的新音频，按已有音频长度退避
+            new_samples = self.total_samples - self.partial_task_samples
+            if new_samples >= max(self.partial_interval * 16000, self.partial_backoff * self.partial_task_samples):
+                audio = self._audio()
+                self.partial_task_samples = len(audio)
+                self.partial_task = asyncio.create_task(self._run_partial(audio))
+
+    def _audio(self):
+        if len(self.chunks) > 1:
+            self.chunks = [np.concatenate(self.chunks)]
+        return self.chunks[0] if self.chunks else np.zeros(0, dtype=np.float32)
+
+    async def _run_partial(self, audio):
+        samples = len(audio)
+        try:
+            text = await transcribe_float32(audio, final=False)
+        except Exception as e:
+            print(f"⚠️ [ASR_STREAM] 中间识别失败: {e}")
+            return
+        if self.closed or text.startswith("ERROR:"):
+            return
+        self.partial_samples = samples
+        self.partial_text = text
+        self.partial_count += 1
+        try:
+            self.on_partial(text, samples / 16000)
+        except Exception as e:
+            print(f"⚠️ [ASR_STREAM] 中间结果回调出错: {e}")
+
+    async def finalize(self):
+        """语音结束：返回最终识别结果（未通过过滤时为空字符串，出错时以ERROR:开头）"""
+        start_time = time.time()
+        reused = False
+        try:
+            if self.resampler is not None:
+                # 重采样器中还留着最后一段上下文
+                tail = self.resampler.finish()
+                if len(tail) > 0:
+                    await self._append(tail)
+            if self.total_samples == 0:
+                print("❌ [ASR_STREAM] 检测到空音频数据")
+                return ""
+            if self.ws is not None:
+                await self.ws.send_str('EOF')
+                text = await self.ws.receive_str()
+            else:
+                if self.partial_task is not None and not self.partial_task.done():
+                    if self.partial_task_samples >= self.total_samples:
+                        await self.partial_task
+                    else:
+                        # 它的结果用不上，等它只会让结束后多付一次完整识别
+                        self.partial_task.cancel()
+                        self.partial_cancelled += 1
+                # 不会再提交最终识别之外的请求，其他轮次不必等本轮加入批次
+                self.batch_slot.close()
+                if self.partial_text is not None and self.partial_samples == self.total_samples:
+                    text = self.partial_text
+                    reused = True
+                else:
+                    text = await transcribe_float32(self._audio())
+        except Exception as e:
+            print(f"❌ [ASR_STREAM] 最终识别出错: {e}")
+            return f"ERROR: {str(e)}"
+        finally:
+            await self.close()
+
+        print(f"🏁 [ASR_STREAM] 最终识别完成，结束后耗时: {time.time() - start_time:.3f}s，"
+              f"音频 {self.total_samples / 16000:.2f}s，中间结果 {self.partial_count} 次"
+              f"（结束时取消 {self.partial_cancelled} 次）"
+              f"{'（复用最后一次中间结果）' if reused else ''}")
+        if not filter_text(text):
+            print(f"❌ [ASR_STREAM] 文本被过滤掉: '{text}'")
+            return ""
+        return text
+
+    async def _close_ws(self):
+        if self.ws is not None:
+            try:
+                await self.ws.close()
+            except Exception:
+                pass
+            self.ws = None
+        if self.ws_session is not None:
+            await self.ws_session.close()
+            self.ws_session = None
+
+    async def close(self):
+        """释放会话（放弃本轮时也要调用）"""
+        self.closed = True
+        self.batch_slot.close()
+        if self.partial_task is not None and not self.partial_task.done():
+            self.partial_task.cancel()
+        await self._close_ws()
+
 def filter_text(text: str) -> bool:
     """
     过滤文本结果
@@ -248,7 +635,7 @@ def switch_asr_service(asr_name):
     参数:
         asr_name: ASR服务名称，必须在ASR_CONFIGS中定义
     """
-    global DEFAULT_ASR, transcribe_audio_local
+    global DEFAULT_ASR, transcribe_audio_local, transcribe_batch_local
     
     if asr_name not in ASR_CONFIGS:
         raise ValueError(f"未知的ASR服务: {asr_name}")
@@ -258,6 +645,7 @@ def switch_asr_service(asr_name):
     
     # 重置transcribe_audio_local，下次调用时会重新加载
     transcribe_audio_local = None
+    transcribe_batch_local = None
     
     return True
 
@@ -0,0 +1,362 @@
+# 上行语音解码 / 下行TTS音频解码
+# 客户端在MSG_CONFIG中通过voice_codec声明VOICE_DATA的编码方式，
+# 这里把每个VOICE_DATA帧还原为16位小端PCM后再交给ASR（编码格式见 ai_client_socket/audio_codec.h）
+# 下行audio_format=pcm时，MP3StreamDecoder把一整段TTS的MP3流式转换为PCM
+# PlaybackStallMeter按实时播放速度估计一次响应在客户端的播放停顿
+
+import asyncio
+import shutil
+import struct
+import sys
+import time
+import warnings
+from typing import Optional
+
+try:
+    # Python 3.13移除了audioop，可安装audioop-lts；都没有时退回纯Python逐样本解码
+    with warnings.catch_warnings():
+        warnings.simplefilter("ignore", DeprecationWarning)
+        import audioop
+    AUDIOOP_AVAILABLE = True
+except ImportError:
+    AUDIOOP_AVAILABLE = False
+
+try:
+    import opuslib
+    OPUS_AVAILABLE = True
+except ImportError:
+    OPUS_AVAILABLE = False
+
+VOICE_CODEC_PCM = "pcm"
+VOICE_CODEC_IMA_ADPCM = "ima_adpcm"
+VOICE_CODEC_OPUS = "opus"
+
+IMA_BLOCK_HEADER_SIZE = 4
+IMA_FLAG_PAD_NIBBLE = 0x01
+
+_IMA_INDEX_TABLE = (-1, -1, -1, -1, 2, 4, 6, 8,
+                    -1, -1, -1, -1, 2, 4, 6, 8)
+
+_IMA_STEP_TABLE = (
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+)
+
+
+# audioop按高4位在前解码，块内是低4位在前，解码前交换每个字节的两个半字节
+_IMA_NIBBLE_SWAP = bytes(((b & 0x0F) << 4) | (b >> 4) for b in range(256))
+
+
+class IMAADPCMDecoder:
+    """IMA-ADPCM解码器，每个VOICE_DATA帧是一个自带初始状态的独立块"""
+
+    def decode(self, block: bytes) -> bytes:
+        if len(block) < IMA_BLOCK_HEADER_SIZE:
+            return b''
+        predictor, index, flags = struct.unpack_from('<hBB', block, 0)
+        if index > 88:
+            raise ValueError(f"IMA-ADPCM步长索引无效: {index}")
+
+        payload = block[IMA_BLOCK_HEADER_SIZE:]
+        count = len(payload) * 2
+        if flags & IMA_FLAG_PAD_NIBBLE and count > 0:
+            count -= 1
+
+        if AUDIOOP_AVAILABLE:
+            # audioop的ADPCM就是IMA算法（同样的步长表、索引表和限幅），用块头状态作为初始状态
+            pcm, _ = audioop.adpcm2lin(bytes(payload).translate(_IMA_NIBBLE_SWAP), 2, (predictor, index))
+            if sys.byteorder == 'big':
+                pcm = audioop.byteswap(pcm, 2)
+            return pcm[:count * 2]
+        return self._decode_python(payload, predictor, index, count)
+
+    @staticmethod
+    def _decode_python(payload: bytes, predictor: int, index: int, count: int) -> bytes:
+        step_table = _IMA_STEP_TABLE
+        index_table = _IMA_INDEX_TABLE
+        out = [0] * count
+        for i in range(count):
+            byte = payload[i >> 1]
+            code = (byte >> 4) if (i & 1) else (byte & 0x0F)
+
+            step = step_table[index]
+            vpdiff = step >> 3
+            if code & 4:
+                vpdiff += step
+            if code & 2:
+                vpdiff += step >> 1
+            if code & 1:
+                vpdiff += step >> 2
+            predictor = predictor - vpdiff if code & 8 else predictor + vpdiff
+            if predictor > 32767:
+                predictor = 32767
+            elif predictor < -32768:
+                predictor = -32768
+            index += index_table[code]
+            if index < 0:
+                index = 0
+            elif index > 88:
+                index = 88
+            out[i] = predictor
+
+        return struct.pack(f'<{count}h', *out)
+
+
+class OpusVoiceDecoder:
+    """Opus解码器：每个VOICE_DATA帧包含若干个 [2字节长度 + Opus包]"""
+
+    def __init__(self, sample_rate: int, channels: int):
+        if not OPUS_AVAILABLE:
+            raise RuntimeError("未安装opuslib，无法解码Opus语音（pip install opuslib）")
+        self.channels = channels
+        # 20ms一包，最长按120ms预留
+        self.max_frame_samples = sample_rate * 120 // 1000
+        self.decoder = opuslib.Decoder(sample_rate, channels)
+
+    def decode(self, data: bytes) -> bytes:
+        pcm = bytearray()
+        offset = 0
+        while offset + 2 <= len(data):
+            (packet_len,) = struct.unpack_from('>H', data, offset)
+            offset += 2
+            if offset + packet_len > len(data):
+                raise ValueError("Opus包长度超出帧范围")
+            pcm += self.decoder.decode(bytes(data[offset:offset + packet_len]), self.max_frame_samples)
+            offset += packet_len
+        return bytes(pcm)
+
+
+def create_voice_decoder(codec: str, sample_rate: int = 16000, channels: int = 1) -> Optional[object]:
+    """根据配置创建解码器，PCM返回None（无需解码）"""
+    codec = (codec or VOICE_CODEC_PCM).lower()
+    if codec == VOICE_CODEC_PCM:
+        return None
+    if codec in (VOICE_CODEC_IMA_ADPCM, "adpcm"):
+        if channels != 1:
+            raise ValueError("IMA-ADPCM仅支持单声道")
+        return IMAADPCMDecoder()
+    if codec == VOICE_CODEC_OPUS:
+        return OpusVoiceDecoder(sample_rate, channels)
+    raise ValueError(f"不支持的语音编码: {codec}")
+
+
+class MP3StreamDecoder:
+    """一段TTS使用一个长期运行的ffmpeg进程：MP3分块写入stdin，PCM(s16le)从stdout持续读出。
+
+    与逐包AudioSegment.from_file相比，不再为每个~720字节的包启动一次ffmpeg、重新探测格式和重采样。
+    输出延迟受ffmpeg内部缓冲限制：MP3解析需要看到下一帧的帧头才能输出当前帧，
+    所以句子的最后一帧在下一句数据到达或close()时才输出。
+    """
+
+    def __init__(self, sample_rate: int = 16000, channels: int = 1, ffmpeg: str = "ffmpeg"):
+        self.sample_rate = sample_rate
+        self.channels = channels
+        self.ffmpeg = ffmpeg
+        self.process = None
+        self.reader_task = None
+        self.pending = bytearray()
+        self.output_event = asyncio.Event()
+        self.eof = False
+        self.in_bytes = 0
+        self.out_bytes = 0
+        self.frame_bytes = 2 * channels
+
+    @staticmethod
+    def available(ffmpeg: str = "ffmpeg") -> bool:
+        return shutil.which(ffmpeg) is not None
+
+    async def start(self):
+        self.process = await asyncio.create_subprocess_exec(
+            self.ffmpeg, "-hide_banner", "-loglevel", "error",
+            "-fflags", "nobuffer", "-probesize", "32", "-analyzeduration", "0",
+            "-f", "mp3", "-i", "pipe:0",
+            "-f", "s16le", "-acodec", "pcm_s16le", "-ac", str(self.channels), "-ar", str(self.sample_rate),
+            "-flush_packets", "1", "pipe:1",
+            stdin=asyncio.subprocess.PIPE, stdout=asyncio.subprocess.PIPE, stderr=asyncio.subprocess.DEVNULL)
+        self.reader_task = asyncio.create_task(self._read_loop())
+
+    async def _read_loop(self):
+        try:
+            while True:
+                data = await self.process.stdout.read(4096)
+                if not data:
+                    break
+                self.pending += data
+                self.output_event.set()
+        finally:
+            self.eof = True
+            self.output_event.set()
+
+    def _take(self, final: bool = False) -> bytes:
+        """取出已解码的PCM，只返回完整的采样帧（最后一次取全部）"""
+        size = len(self.pending) if final else len(self.pending) - len(self.pending) % self.frame_bytes
+        if size <= 0:
+            return b''
+        data = bytes(self.pending[:size])
+        del self.pending[:size]
+        self.out_bytes += len(data)
+        return data
+
+    async def decode(self, chunk: bytes) -> bytes:
+        """写入一段MP3（可在任意字节处截断），返回当前已经可用的PCM（可能为空）"""
+        if chunk:
+            self.in_bytes += len(chunk)
+            self.process.stdin.write(chunk)
+            await self.process.stdin.drain()
+        return self._take()
+
+    async def read_idle(self, idle_timeout: float = 0.03) -> bytes:
+        """等待输出停止增长（持续idle_timeout秒没有新数据）后返回已解码的PCM，用于句子结束时"""
+        while not self.eof:
+            self.output_event.clear()
+            try:
+                await asyncio.wait_for(self.output_event.wait(), timeout=idle_timeout)
+            except asyncio.TimeoutError:
+                break
+        return self._take()
+
+    async def close(self) -> bytes:
+        """结束输入并返回剩余的全部PCM"""
+        if self.process is None:
+            return b''
+        try:
+            if self.process.stdin and not self.process.stdin.is_closing():
+                self.process.stdin.close()
+            if self.reader_task:
+                await self.reader_task
+            await self.process.wait()
+        except Exception:
+            if self.process.returncode is None:
+                self.process.kill()
+                await self.process.wait()
+        self.process = None
+        return self._take(final=True)
+
+    async def abort(self):
+        """取消时直接结束ffmpeg进程，丢弃未输出的数据"""
+        if self.process is None:
+            return
+        if self.process.returncode is None:
+            self.process.kill()
+        try:
+            await self.process.wait()
+        except Exception:
+            pass
+        if self.reader_task:
+            self.reader_task.cancel()
+        self.process = None
+        self.pending.clear()
+
+
+# [MPEG1/MPEG2(2.5)][层-1][码率索引]，单位kbps（与 ai_client_socket/audio_mp3.c 相同）
+_MP3_BITRATES = (
+    ((0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448),
+     (0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384),
+     (0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320)),
+    ((0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256),
+     (0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160),
+     (0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160)),
+)
+_MP3_SAMPLE_RATES = (44100, 48000, 32000)
+
+
+def parse_mp3_header(data, pos: int = 0):
+    """解析pos处的MP3帧头，返回(帧长, 每帧采样数, 采样率)，无效返回None"""
+    if data[pos] != 0xFF or (data[pos + 1] & 0xE0) != 0xE0:
+        return None
+    version_bits = (data[pos + 1] >> 3) & 0x03
+    layer_bits = (data[pos + 1] >> 1) & 0x03
+    bitrate_index = data[pos + 2] >> 4
+    rate_index = (data[pos + 2] >> 2) & 0x03
+    padding = (data[pos + 2] >> 1) & 0x01
+    if version_bits == 1 or layer_bits == 0 or bitrate_index in (0, 15) or rate_index == 3:
+        return None
+    layer = 4 - layer_bits
+    lsf = 0 if version_bits == 3 else 1
+    bitrate = _MP3_BITRATES[lsf][layer - 1][bitrate_index] * 1000
+    sample_rate = _MP3_SAMPLE_RATES[rate_index] >> {3: 0, 2: 1, 0: 2}[version_bits]
+    if layer == 1:
+        return (12 * bitrate // sample_rate + padding) * 4, 384, sample_rate
+    samples = 576 if (layer == 3 and lsf) else 1152
+    return samples // 8 * bitrate // sample_rate + padding, samples, sample_rate
+
+
+def probe_mp3_format(data: bytes):
+    """从MP3数据开头找到连续两个有效帧头，返回(采样率, 声道数)，数据不够或无效返回None"""
+    pos = 0
+    while pos + 4 <= len(data):
+        header = parse_mp3_header(data, pos)
+        if header is not None:
+            frame_bytes = header[0]
+            # 下一帧头也有效才采用，避免把ID3标签等数据中的0xFF误认为帧头
+            if pos + frame_bytes + 4 > len(data):
+                return None
+            if parse_mp3_header(data, pos + frame_bytes) is not None:
+                channels = 1 if (data[pos + 3] >> 6) == 3 else 2
+                return header[2], channels
+        pos += 1
+    return None
+
+
+class MP3DurationCounter:
+    """统计流式MP3数据中完整帧的播放时长，数据可以在任意字节处截断"""
+
+    def __init__(self):
+        self.buffer = bytearray()
+
+    def feed(self, data: bytes) -> float:
+        """写入一段MP3，返回其中新凑齐的帧的总时长（毫秒）"""
+        self.buffer += data
+        buf = self.buffer
+        pos = 0
+        duration_ms = 0.0
+        while pos + 4 <= len(buf):
+            header = parse_mp3_header(buf, pos)
+            if header is None:
+                pos += 1
+                continue
+            frame_bytes, samples, sample_rate = header
+            if pos + frame_bytes > len(buf):
+                break
+            duration_ms += samples * 1000.0 / sample_rate
+            pos += frame_bytes
+        del buf[:pos]
+        return duration_ms
+
+
+class PlaybackStallMeter:
+    """估计一次响应在客户端的播放停顿。
+
+    从第一个音频包开始，客户端按实时速度播放已收到的音频；某个包到达时如果之前的音频
+    已经播完（超过min_stall_ms），就记一次停顿，停顿时长为播放空等的时间。
+    不考虑客户端预缓冲，因此结果偏保守（客户端实际欠载只会更少）。
+    """
+
+    def __init__(self, min_stall_ms: float = 20.0):
+        self.min_stall_ms = min_stall_ms
+        self.play_end_ms = None
+        self.audio_ms = 0.0
+        self.stalls = 0
+        self.stall_ms = 0.0
+
+    def on_audio(self, duration_ms: float, now_ms: Optional[float] = None):
+        if duration_ms <= 0:
+            return
+        if now_ms is None:
+            now_ms = time.monotonic() * 1000
+        self.audio_ms += duration_ms
+        if self.play_end_ms is None:
+            self.play_end_ms = now_ms + duration_ms
+            return
+        gap = now_ms - self.play_end_ms
+        if gap > self.min_stall_ms:
+            self.stalls += 1
+            self.stall_ms += gap
+        self.play_end_ms = max(self.play_end_ms, now_ms) + duration_ms
@@ -33,7 +33,17 @@ sys.path.append(root_dir)
 
 #from TTSs import TTSService_Edge, TTSService_Volcano
 #from LLMs import LLMFactory, ConversationManager
-#from ASR import async_process_audio, filter_text
+try:
+    from ASR import async_process_audio, filter_text, StreamingASRSession, ASRTurnSlot
+    STREAMING_ASR_AVAILABLE = True
+except ImportError as e:
+    print(f"警告: ASR模块导入失败: {e}")
+    STREAMING_ASR_AVAILABLE = False
+from AudioCodec import create_voice_decoder, VOICE_CODEC_PCM, MP3StreamDecoder, MP3DurationCounter, PlaybackStallMeter, probe_mp3_format
+from TTSCache import TTSCache
+
+# 各TTS音色MP3的原始格式（采样率, 声道数），第一次合成时从MP3帧头得到，所有连接共享
+TTS_NATIVE_FORMATS = {}
 
 
 class SocketProtocol:
@@ -54,6 +64,7 @@ class SocketProtocol:
     MSG_JSON_RESPONSE = 0x0C  # JSON响应
     MSG_CONFIG = 0x0D         # 配置消息
     MSG_AI_NEWCHAT = 0x0E     # 新对话开始
+    MSG_CANCEL = 0x12         # 客户端取消指定轮次（负载为轮次号）
     
     # 响应格式
     RESPONSE_JSON = "json"
@@ -67,6 +78,21 @@ class SocketProtocol:
     AUDIO_MERGE_DISABLED = "disabled"  # 不合并，流式发送
     AUDIO_MERGE_ENABLED = "enabled"    # 合并后一次性发送
     
+    # 轮次号：客户端在VOICE_START中携带，服务器确认audio_turn_id_offer（或客户端配置audio_turn_id）后
+    # 加在AUDIO_START/AUDIO_DATA/AUDIO_END之前（大端）
+    TURN_ID_SIZE = 4
+    
+    @staticmethod
+    def pack_turn_id(turn_id: int) -> bytes:
+        return struct.pack('>I', turn_id & 0xFFFFFFFF)
+    
+    # PCM下行格式：配置audio_start_format后，AUDIO_START负载（轮次号之后）为采样率(4字节大端) + 声道数(1字节)
+    PCM_DEFAULT_FORMAT = (16000, 1)
+    
+    @staticmethod
+    def pack_pcm_format(sample_rate: int, channels: int) -> bytes:
+        return struct.pack('>IB', sample_rate, channels)
+    
     @staticmethod
     def pack_message(msg_type: int, data: bytes) -> bytes:
         """打包消息：消息类型(1字节) + 数据长度(4字节) + 数据"""
@@ -123,13 +149,129 @@ class SocketProtocol:
         return json.loads(json_str)
 
 
+class ClientSender:
+    """
+    每个连接一个发送队列：
+    - 数据帧（AUDIO_DATA/TEXT_DATA）在latency_ms内合并成一次write，减少系统调用和drain
+    - 控制帧（AI_START/AI_END/AUDIO_START/AUDIO_END/AI_CANCELLED等）入队后立即写出，
+      顺序不变（AI_END不会跑到前面的音频之前）
+    - 发送缓冲超过传输层高水位时drain等待，队列积压超过max_queue_bytes时生产者等待
+    - purge_audio()丢弃队列中还没写出的过期音频（抢话/取消时）
+    """
+    
+    DATA_TYPES = (SocketProtocol.MSG_AUDIO_DATA, SocketProtocol.MSG_TEXT_DATA)
+    
+    def __init__(self, writer: asyncio.StreamWriter, latency_ms: float = 5.0,
+                 max_batch_bytes: int = 64 * 1024, max_queue_bytes: int = 512 * 1024,
+                 high_water: int = 256 * 1024):
+        self.writer = writer
+        self.latency = latency_ms / 1000.0
+        self.max_batch_bytes = max_batch_bytes
+        self.max_queue_bytes = max_queue_bytes
+        self.queue = deque()            # (消息类型, 打包后的帧, 轮次号)
+        self.queued_bytes = 0
+        self.urgent = False             # 队列中有控制帧，立即写出
+        self.wakeup = asyncio.Event()
+        self.space = asyncio.Event()
+        self.space.set()
+        self.task = None
+        self.error = None
+        self.stats = {'frames': 0, 'writes': 0, 'bytes': 0, 'purged': 0, 'waits': 0}
+        transport = getattr(writer, 'transport', None)
+        if transport is not None:
+            transport.set_write_buffer_limits(high=high_water)
+    
+    async def send(self, msg_type: int, data: bytes, turn: Optional[int] = None):
+        if self.error is not None:
+            raise self.error
+        if self.task is None:
+            self.task = asyncio.create_task(self._write_loop())
+        frame = SocketProtocol.pack_message(msg_type, data)
+        self.queue.append((msg_type, frame, turn))
+        self.queued_bytes += len(frame)
+        if msg_type not in self.DATA_TYPES or self.queued_bytes >= self.max_batch_bytes:
+            self.urgent = True
+        self.wakeup.set()
+        if self.queued_bytes > self.max_queue_bytes:
+            self.space.clear()
+            self.stats['waits'] += 1
+            await self.space.wait()
+            if self.error is not None:
+                raise self.error
+    
+    def purge_audio(self, drop_turn: Optional[int] = None, keep_turn: Optional[int] = None) -> int:
+        """丢弃队列中drop_turn（或除keep_turn以外）轮次的AUDIO_DATA，返回丢弃的帧数"""
+        kept = deque()
+        purged = 0
+        for item in self.queue:
+            msg_type, frame, turn = item
+            if msg_type == SocketProtocol.MSG_AUDIO_DATA and turn is not None and \
+                    (turn == drop_turn if drop_turn is not None else turn != keep_turn):
+                self.queued_bytes -= len(frame)
+                purged += 1
+            else:
+                kept.append(item)
+        self.queue = kept
+        self.stats['purged'] += purged
+        if self.queued_bytes <= self.max_queue_bytes:
+            self.space.set()
+        return purged
+    
+    async def _write_loop(self):
+        try:
+            while True:
+                await self.wakeup.wait()
+                if not self.urgent:
+                    # 只有数据帧：在延迟预算内等待更多帧一起写出
+                    await asyncio.sleep(self.latency)
+                self.wakeup.clear()
+                self.urgent = False
+                if not self.queue:
+                    continue
+                frames = [item[1] for item in self.queue]
+                self.queue.clear()
+                self.queued_bytes = 0
+                self.space.set()
+                batch = b''.join(frames)
+                self.writer.write(batch)
+                self.stats['frames'] += len(frames)
+                self.stats['writes'] += 1
+                self.stats['bytes'] += len(batch)
+                await self.writer.drain()
+        except asyncio.CancelledError:
+            raise
+        except Exception as e:
+            self.error = e
+            self.space.set()
+    
+    async def close(self):
+        if self.task is not None and not self.task.done():
+            self.task.cancel()
+            try:
+                await self.task
+            except asyncio.CancelledError:
+                pass
+        self.space.set()
+    
+    def summary(self) -> str:
+        s = self.stats
+        per_write = s['frames'] / s['writes'] if s['writes'] else 0.0
+        return (f"{s['frames']}帧/{s['writes']}次写入(平均每次{per_write:.1f}帧)，{s['bytes'] // 1024}KB，"
+                f"丢弃过期音频{s['purged']}帧，等待发送队列{s['waits']}次")
+
+
 class AISocketClient:
     """处理单个客户端连接的类"""
     
+    # TTS缓存命中时每个MSG_AUDIO_DATA的大小（立即发送模式）
+    TTS_CACHE_SEND_BYTES = 4096
+    
     def __init__(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter, client_addr,
-                 default_audio_format='mp3', default_audio_merge='disabled', verbose=False):
+                 default_audio_format='mp3', default_audio_merge='disabled', verbose=False,
+                 tts_cache: Optional[TTSCache] = None):
         self.reader = reader
         self.writer = writer
+        self.sender = ClientSender(writer)
         self.client_addr = client_addr
         self.client_id = f"{client_addr[0]}:{client_addr[1]}"
         self.verbose = verbose
@@ -147,6 +289,35 @@ class AISocketClient:
         self.audio_format = default_audio_format
         self.audio_merge = default_audio_merge
         
+        # 上行语音编码（由客户端MSG_CONFIG声明）
+        self.voice_codec = VOICE_CODEC_PCM
+        self.voice_sample_rate = 16000
+        self.voice_channels = 1
+        self.voice_decoder = None
+        # 流式ASR：MSG_VOICE_START时创建会话，语音数据边收边识别
+        self.streaming_asr = STREAMING_ASR_AVAILABLE
+        self.asr_session = None
+        self.asr_turn_slot = None       # 整段识别轮次在ASR批处理中的登记
+        self.asr_partial = None         # (voice_id, 文本, 收到时间)
+        # 推测生成：中间结果稳定speculation_stable_ms后提前启动LLM，最终结果一致时直接采用
+        self.speculative_llm = STREAMING_ASR_AVAILABLE
+        self.speculation_stable_ms = 400
+        self.speculation = None         # 进行中的推测生成
+        self.speculation_timer = None
+        self.committed_speculations = {}  # voice_id -> 已确认采用的推测生成
+        self.speculation_stats = {'started': 0, 'committed': 0, 'discarded': 0, 'saved_ms': 0.0}
+        
+        # 下行音频帧是否带轮次号（客户端MSG_CONFIG的audio_turn_id_offer经确认后开启，或由audio_turn_id直接开启）
+        self.audio_turn_id = False
+        # AUDIO_START是否带PCM格式（由客户端MSG_CONFIG的audio_start_format开启）。
+        # 开启后PCM按TTS原始格式下发，由客户端转换为播放格式；未开启时固定为16kHz单声道
+        self.audio_start_format = False
+        # TTS预合成：当前句子发送时，后面最多tts_lookahead个句子同时在合成
+        self.tts_lookahead = 2
+        # TTS音频缓存（服务器内所有连接共享）
+        self.tts_cache = tts_cache
+        self.tts_stall_stats = {'responses': 0, 'stalled_responses': 0, 'stalls': 0, 'stall_ms': 0.0}
+        
         # 显示客户端初始配置
         self.log_with_time(f"🎵 初始音频配置: {self.audio_format.upper()} + {'句子内合并' if self.audio_merge == 'enabled' else '立即发送'}")
         
@@ -164,6 +335,12 @@ class AISocketClient:
         self.is_connected = True
         self.cancel_tasks = asyncio.Event()
         
+        # 按轮次管理生成任务，客户端MSG_CANCEL只停止对应轮次
+        self.cancelled_turns = set()
+        self.turn_state = {}
+        self.cancel_stats = {'count': 0, 'stopped': 0, 'saved_sentences': 0, 'saved_chars': 0, 'dropped_queries': 0}
+        self.cancel_reports = set()     # 后台等待被取消任务退出并记录统计
+        
 
     
     def log_with_time(self, message: str, verbose_only=False):
@@ -173,8 +350,8 @@ class AISocketClient:
         current_time = datetime.datetime.now().strftime("[%H:%M:%S.%f]")[:-3]
         print(f"{current_time} [客户端 {self.client_id}] {message}")
     
-    async def convert_mp3_to_pcm(self, mp3_data: bytes) -> bytes:
-        """将MP3数据转换为PCM格式"""
+    async def convert_mp3_to_pcm(self, mp3_data: bytes, pcm_format=SocketProtocol.PCM_DEFAULT_FORMAT) -> bytes:
+        """将MP3数据转换为pcm_format（采样率, 声道数）的16位PCM"""
         self.log_with_time(f"🔄 [CONVERT] 开始MP3转PCM - 输入大小: {len(mp3_data)} 字节")
         
         if not AUDIO_LIBS_AVAILABLE:
@@ -213,10 +390,10 @@ class AISocketClient:
             self.log_with_time(f"   采样宽度: {audio.sample_width} 字节")
             self.log_with_time(f"   时长: {len(audio)} ms")
             
-            # 转换为PCM格式 (16-bit, 16kHz, mono)
-            self.log_with_time("🔧 [CONVERT] 开始音频格式转换")
-            audio = audio.set_frame_rate(16000)
-            audio = audio.set_channels(1)
+            # 转换为PCM格式 (16-bit, 本轮AUDIO_START声明的采样率和声道数)
+            self.log_with_time(f"🔧 [CONVERT] 开始音频格式转换 -> {pcm_format[0]}Hz/{pcm_format[1]}ch")
+            audio = audio.set_frame_rate(pcm_format[0])
+            audio = audio.set_channels(pcm_format[1])
             audio = audio.set_sample_width(2)  # 16-bit
             
             # 获取原始PCM数据
@@ -292,21 +469,29 @@ class AISocketClient:
     
 
     
-    async def send_message(self, msg_type: int, data: bytes):
-        """发送消息给客户端"""
+    async def send_message(self, msg_type: int, data: bytes, turn: Optional[int] = None):
+        """发送消息给客户端（进入发送队列，数据帧合并写出，控制帧立即写出）"""
         try:
             if not self.is_connected:
                 return False
-                
-            message = SocketProtocol.pack_message(msg_type, data)
-            self.writer.write(message)
-            await self.writer.drain()
             
-            # 添加调试日志
+            if msg_type == SocketProtocol.MSG_AI_CANCELLED:
+                # 取消之前还没写出的音频已经过期，不再发送
+                if len(data) >= SocketProtocol.TURN_ID_SIZE:
+                    (cancelled_turn,) = struct.unpack_from('>I', data, 0)
+                    purged = self.sender.purge_audio(drop_turn=cancelled_turn)
+                else:
+                    purged = self.sender.purge_audio(keep_turn=getattr(self, 'current_voice_id', None))
+                if purged:
+                    self.log_with_time(f"🗑️ [SEND] 取消时丢弃{purged}个未发送的音频包")
+            
+            await self.sender.send(msg_type, data, turn)
+            
+            # 添加调试日志（数据帧很多，只在详细模式下逐个输出）
             if msg_type == SocketProtocol.MSG_TEXT_DATA:
-                self.log_with_time(f"📤 发送文本消息: {data.decode('utf-8')}")
+                self.log_with_time(f"📤 发送文本消息: {data.decode('utf-8')}", verbose_only=True)
             elif msg_type == SocketProtocol.MSG_AUDIO_DATA:
-                self.log_with_time(f"📤 发送音频数据: {len(data)} 字节")
+                self.log_with_time(f"📤 发送音频数据: {len(data)} 字节", verbose_only=True)
             elif msg_type == SocketProtocol.MSG_AI_START:
                 self.log_with_time(f"📤 发送AI开始信号")
             elif msg_type == SocketProtocol.MSG_AI_END:
@@ -322,6 +507,29 @@ class AISocketClient:
             await self.disconnect()
             return False
     
+    def is_turn_cancelled(self, voice_id: int) -> bool:
+        """连接断开或客户端取消了该轮次"""
+        return self.cancel_tasks.is_set() or voice_id in self.cancelled_turns
+    
+    def get_turn_state(self, voice_id: int) -> dict:
+        """轮次的任务和已完成工作量（用于取消及统计节省的工作）"""
+        state = self.turn_state.get(voice_id)
+        if state is None:
+            state = {'tasks': [], 'tts_queue': None, 'llm_chars': 0, 'tts_sentences': 0, 'audio_bytes': 0}
+            self.turn_state[voice_id] = state
+        return state
+    
+    async def send_audio_message(self, msg_type: int, voice_id: int, data: bytes = b''):
+        """发送AUDIO_START/AUDIO_DATA/AUDIO_END，客户端要求时在前面加上轮次号，以便抢话后丢弃旧轮次的音频"""
+        if voice_id in self.cancelled_turns:
+            # MSG_AI_CANCELLED不等任务退出就已发出，还没停下的任务不能再发该轮次的音频
+            return False
+        if msg_type == SocketProtocol.MSG_AUDIO_DATA and voice_id in self.turn_state:
+            self.turn_state[voice_id]['audio_bytes'] += len(data)
+        if self.audio_turn_id:
+            data = SocketProtocol.pack_turn_id(voice_id) + data
+        return await self.send_message(msg_type, data, turn=voice_id)
+    
     async def send_text_message(self, msg_type: int, text: str):
         """发送文本消息"""
         data = text.encode('utf-8')
@@ -338,6 +546,14 @@ class AISocketClient:
         if self.is_connected:
             self.is_connected = False
             self.cancel_tasks.set()
+            await self.close_asr_session()
+            self.discard_speculation("连接断开")
+            for spec in self.committed_speculations.values():
+                if not spec['task'].done():
+                    spec['task'].cancel()
+            self.committed_speculations.clear()
+            await self.sender.close()
+            self.log_with_time(f"📊 [SEND] {self.sender.summary()}")
             
             # 取消所有活跃任务
             async with self.tasks_lock:
@@ -397,13 +613,16 @@ class AISocketClient:
                         await self.handle_config_message(data)
                     elif msg_type == SocketProtocol.MSG_VOICE_START:
                         self.log_with_time("🎤 处理语音开始")
-                        await self.handle_voice_start()
+                        await self.handle_voice_start(data)
                     elif msg_type == SocketProtocol.MSG_VOICE_DATA:
                         self.log_with_time(f"🎤 处理语音数据: {len(data)}字节")
                         await self.handle_voice_data(data)
                     elif msg_type == SocketProtocol.MSG_VOICE_END:
                         self.log_with_time("🎤 处理语音结束")
                         await self.handle_voice_end()
+                    elif msg_type == SocketProtocol.MSG_CANCEL:
+                        self.log_with_time("🛑 处理客户端取消")
+                        await self.handle_cancel(data)
                     else:
                         self.log_with_time(f"❌ 未知消息类型: {msg_type}(0x{msg_type:02X})")
                         self.log_with_time("💡 已知消息类型:")
@@ -464,25 +683,249 @@ class AISocketClient:
                 else:
                     self.log_with_time(f"⚠️ 不支持的音频合并模式: {audio_merge}")
             
+            # 配置上行语音编码
+            if 'voice_codec' in config:
+                voice_codec = str(config['voice_codec']).lower()
+                voice_sample_rate = int(config.get('voice_sample_rate', self.voice_sample_rate))
+                voice_channels = int(config.get('voice_channels', self.voice_channels))
+                try:
+                    create_voice_decoder(voice_codec, voice_sample_rate, voice_channels)
+                    self.voice_codec = voice_codec
+                    self.voice_sample_rate = voice_sample_rate
+                    self.voice_channels = voice_channels
+                    self.log_with_time(f"设置语音编码: {self.voice_codec} ({self.voice_sample_rate}Hz/{self.voice_channels}ch)")
+                except Exception as e:
+                    self.log_with_time(f"⚠️ 不支持的语音编码 {voice_codec}: {e}")
+            
+            # 上行语音编码协商：客户端先按PCM上传，收到确认后才在之后的配置中声明该编码
+            if 'voice_codec_offer' in config:
+                offer = str(config['voice_codec_offer']).lower()
+                offer_sample_rate = int(config.get('voice_sample_rate', self.voice_sample_rate))
+                offer_channels = int(config.get('voice_channels', self.voice_channels))
+                try:
+                    create_voice_decoder(offer, offer_sample_rate, offer_channels)
+                    accepted = True
+                except Exception as e:
+                    accepted = False
+                    self.log_with_time(f"⚠️ 不支持客户端提议的语音编码 {offer}: {e}")
+                await self.send_json_message(SocketProtocol.MSG_CONFIG,
+                                             {'voice_codec_offer': offer, 'voice_codec_accepted': accepted})
+                self.log_with_time(f"语音编码提议 {offer}: {'接受' if accepted else '拒绝'}")
+            
+            # 配置流式ASR
+            if 'streaming_asr' in config:
+                self.streaming_asr = bool(config['streaming_asr']) and STREAMING_ASR_AVAILABLE
+                self.log_with_time(f"设置流式ASR: {'开启' if self.streaming_asr else '关闭'}")
+            
+            # 配置推测生成
+            if 'speculative_llm' in config:
+                self.speculative_llm = bool(config['speculative_llm']) and STREAMING_ASR_AVAILABLE
+                self.log_with_time(f"设置推测生成: {'开启' if self.speculative_llm else '关闭'}")
+            if 'speculation_stable_ms' in config:
+                self.speculation_stable_ms = max(0, int(config['speculation_stable_ms']))
+                self.log_with_time(f"设置推测生成稳定时间: {self.speculation_stable_ms}ms")
+            
+            # 配置TTS预合成句数
+            if 'tts_lookahead' in config:
+                self.tts_lookahead = min(4, max(1, int(config['tts_lookahead'])))
+                self.log_with_time(f"设置TTS预合成句数: {self.tts_lookahead}")
+            
+            # 下行音频轮次号协商：客户端连接后提议，确认后所有AUDIO_START/AUDIO_DATA/AUDIO_END都带轮次号
+            if config.get('audio_turn_id_offer'):
+                self.audio_turn_id = True
+                await self.send_json_message(SocketProtocol.MSG_CONFIG, {'audio_turn_id_accepted': True})
+                self.log_with_time("音频轮次号提议: 接受")
+
+            # 配置下行音频轮次号（未经协商的旧方式，兼容旧客户端）
+            if 'audio_turn_id' in config:
+                self.audio_turn_id = bool(config['audio_turn_id'])
+                self.log_with_time(f"设置音频轮次号: {'开启' if self.audio_turn_id else '关闭'}")
+            
+            # 配置AUDIO_START携带PCM格式
+            if 'audio_start_format' in config:
+                self.audio_start_format = bool(config['audio_start_format'])
+                self.log_with_time(f"设置AUDIO_START携带PCM格式: {'开启' if self.audio_start_format else '关闭'}")
+            
             # 显示当前音频配置
             self.log_with_time(f"🎵 当前音频配置: {self.audio_format.upper()} + {'句子内合并' if self.audio_merge == SocketProtocol.AUDIO_MERGE_ENABLED else '立即发送'}")
             
         except Exception as e:
             self.log_with_time(f"处理配置消息出错: {e}")
     
-    async def handle_voice_start(self):
-        """处理语音开始"""
-        self.voice_id += 1
+    async def handle_voice_start(self, data: bytes = b''):
+        """处理语音开始（负载为客户端分配的轮次号，旧客户端为空时由服务器自增）"""
+        if len(data) >= SocketProtocol.TURN_ID_SIZE:
+            (self.voice_id,) = struct.unpack_from('>I', data, 0)
+        else:
+            self.voice_id += 1
+        self.cancelled_turns.discard(self.voice_id)
         self.current_voice_id = self.voice_id
         self.audio_buffer = io.BytesIO()
         self.session_timers[self.current_voice_id] = time.time()
+        # 每轮语音使用新的解码器，避免上一轮的Opus状态影响本轮
+        self.voice_decoder = create_voice_decoder(self.voice_codec, self.voice_sample_rate, self.voice_channels)
+        self.voice_encoded_bytes = 0
+        await self.open_asr_session(self.current_voice_id)
         
         self.log_with_time(f"【对话{self.current_voice_id}计时：开始接收用户语音】0.000s")
     
+    async def open_asr_session(self, voice_id: int):
+        """为本轮语音创建流式ASR会话（上一轮未结束的会话直接放弃）"""
+        await self.close_asr_session()
+        self.discard_speculation("新一轮语音开始")
+        self.asr_partial = None
+        if not STREAMING_ASR_AVAILABLE:
+            return
+        if self.streaming_asr:
+            session = StreamingASRSession(sample_rate=self.voice_sample_rate, channels=self.voice_channels,
+                                          on_partial=lambda text, seconds: self.on_asr_partial(voice_id, text, seconds))
+            try:
+                await session.start()
+                self.asr_session = session
+                return
+            except Exception as e:
+                self.log_with_time(f"⚠️ [ASR_STREAM] 创建流式ASR会话失败，本轮使用整段识别: {e}")
+                await session.close()
+        # 整段识别同样登记，结束时其他连接的最终识别才会等它凑成一批
+        self.asr_turn_slot = ASRTurnSlot()
+        self.asr_turn_slot.open()
+    
+    async def close_asr_session(self):
+        if self.asr_session is not None:
+            session = self.asr_session
+            self.asr_session = None
+            await session.close()
+        if self.asr_turn_slot is not None:
+            self.asr_turn_slot.close()
+            self.asr_turn_slot = None
+    
+    def on_asr_partial(self, voice_id: int, text: str, audio_seconds: float):
+        """流式ASR中间结果"""
+        if voice_id != getattr(self, 'current_voice_id', None):
+            return
+        previous = self.asr_partial
+        self.asr_partial = (voice_id, text, time.time())
+        self.log_with_time(f"📝 [ASR_STREAM] 对话{voice_id}中间结果({audio_seconds:.1f}s): '{text}'")
+        
+        if not self.speculative_llm or self.response_format != SocketProtocol.RESPONSE_STREAM:
+            return
+        if previous is not None and previous[0] == voice_id and previous[1].strip() == text.strip():
+            return  # 结果没有变化，稳定计时继续
+        if self.speculation_timer is not None and not self.speculation_timer.done():
+            self.speculation_timer.cancel()
+        self.speculation_timer = asyncio.create_task(self._speculation_stable_timer(voice_id, text))
+    
+    async def _speculation_stable_timer(self, voice_id: int, text: str):
+        """中间结果在speculation_stable_ms内没有变化时启动推测生成"""
+        await asyncio.sleep(self.speculation_stable_ms / 1000.0)
+        if self.asr_partial is None or self.asr_partial[0] != voice_id or self.asr_partial[1] != text:
+            return
+        if voice_id != getattr(self, 'current_voice_id', None) or voice_id in self.cancelled_turns:
+            return
+        self.start_speculation(voice_id, text)
+    
+    def start_speculation(self, voice_id: int, text: str):
+        """在用户还没说完时按稳定的中间结果提前运行LLM，输出先缓存不发送"""
+        text = text.strip()
+        if not STREAMING_ASR_AVAILABLE or not filter_text(text):
+            return
+        spec = self.speculation
+        if spec is not None and spec['voice_id'] == voice_id and spec['text'] == text:
+            return
+        self.discard_speculation("中间结果变化，重新推测")
+        spec = {
+            'voice_id': voice_id,
+            'text': text,
+            'chunks': [],
+            'done': False,
+            'error': None,
+            'event': asyncio.Event(),
+            'start_time': time.time(),
+            'first_chunk_time': None,
+        }
+        spec['task'] = asyncio.create_task(self._run_speculation(spec))
+        self.speculation = spec
+        self.speculation_stats['started'] += 1
+        self.log_with_time(f"🔮 [SPECULATE] 对话{voice_id}开始推测生成: '{text}'")
+    
+    async def _run_speculation(self, spec):
+        try:
+            async for chunk in self.conversation_manager.generate_stream(spec['text']):
+                if spec['first_chunk_time'] is None:
+                    spec['first_chunk_time'] = time.time()
+                spec['chunks'].append(chunk)
+                spec['event'].set()
+        except asyncio.CancelledError:
+            raise
+        except Exception as e:
+            spec['error'] = e
+        finally:
+            spec['done'] = True
+            spec['event'].set()
+    
+    def discard_speculation(self, reason: str):
+        """放弃尚未确认的推测生成"""
+        if self.speculation_timer is not None and not self.speculation_timer.done():
+            self.speculation_timer.cancel()
+        self.speculation_timer = None
+        spec = self.speculation
+        if spec is None:
+            return
+        self.speculation = None
+        if not spec['task'].done():
+            spec['task'].cancel()
+        self.speculation_stats['discarded'] += 1
+        self.log_with_time(f"🗑️ [SPECULATE] 对话{spec['voice_id']}放弃推测生成({reason}): '{spec['text']}'，"
+                           f"已生成{sum(len(c) for c in spec['chunks'])}字")
+    
+    def resolve_speculation(self, voice_id: int, text: str):
+        """最终识别结果出来后：与推测文本一致则确认采用，否则放弃"""
+        spec = self.speculation
+        if spec is None or spec['voice_id'] != voice_id:
+            self.discard_speculation("没有对应轮次的推测")
+            return
+        if spec['text'] != text.strip() or spec['error'] is not None:
+            self.discard_speculation("最终结果不一致")
+            return
+        if self.speculation_timer is not None and not self.speculation_timer.done():
+            self.speculation_timer.cancel()
+        self.speculation_timer = None
+        self.speculation = None
+        self.committed_speculations[voice_id] = spec
+        self.speculation_stats['committed'] += 1
+        stats = self.speculation_stats
+        self.log_with_time(f"✅ [SPECULATE] 对话{voice_id}采用推测生成，已提前运行{(time.time() - spec['start_time']) * 1000:.0f}ms；"
+                           f"累计启动{stats['started']}次/采用{stats['committed']}次/放弃{stats['discarded']}次")
+    
+    async def _speculation_stream(self, spec):
+        """按顺序输出推测生成已缓存和后续到达的文本"""
+        index = 0
+        while True:
+            while index < len(spec['chunks']):
+                yield spec['chunks'][index]
+                index += 1
+            if spec['done']:
+                break
+            spec['event'].clear()
+            if index < len(spec['chunks']) or spec['done']:
+                continue
+            await spec['event'].wait()
+        if spec['error'] is not None:
+            raise spec['error']
+    
     async def handle_voice_data(self, data: bytes):
         """处理语音数据"""
         if hasattr(self, 'audio_buffer'):
+            if self.voice_decoder is not None:
+                self.voice_encoded_bytes += len(data)
+                try:
+                    data = self.voice_decoder.decode(data)
+                except Exception as e:
+                    self.log_with_time(f"⚠️ 语音数据解码失败({self.voice_codec}): {e}")
+                    return
             self.audio_buffer.write(data)
+            if self.asr_session is not None:
+                await self.asr_session.feed(data)
     
     async def handle_voice_end(self):
         """处理语音结束"""
@@ -493,6 +936,15 @@ class AISocketClient:
         if self.current_voice_id in self.session_timers:
             elapsed = eof_time - self.session_timers[self.current_voice_id]
             self.log_with_time(f"【对话{self.current_voice_id}计时：语音包接收完毕】{elapsed:.3f}s")
+        if self.voice_decoder is not None and self.voice_encoded_bytes > 0:
+            pcm_bytes = self.audio_buffer.tell()
+            self.log_with_time(f"🎤 语音编码{self.voice_codec}: 上行{self.voice_encoded_bytes}字节 -> PCM {pcm_bytes}字节 "
+                               f"(压缩比 {pcm_bytes / self.voice_encoded_bytes:.1f}:1)")
+        
+        if self.asr_session is None and not STREAMING_ASR_AVAILABLE:
+            self.log_with_time("⚠️ ASR模块不可用，无法识别本轮语音")
+            await self.send_text_message(SocketProtocol.MSG_ERROR, "语音识别失败: ASR模块不可用")
+            return
         
         # 开始ASR处理
         try:
@@ -501,7 +953,16 @@ class AISocketClient:
                 elapsed = asr_start_time - self.session_timers[self.current_voice_id]
                 self.log_with_time(f"【对话{self.current_voice_id}计时：开始语音转文本】{elapsed:.3f}s")
             
-            text = await async_process_audio(self.audio_buffer)
+            if self.asr_session is not None:
+                # 音频已在接收过程中处理完，只剩最后一段的识别
+                session = self.asr_session
+                self.asr_session = None
+                text = await session.finalize()
+            else:
+                if self.asr_turn_slot is not None:
+                    self.asr_turn_slot.close()
+                    self.asr_turn_slot = None
+                text = await async_process_audio(self.audio_buffer, self.voice_sample_rate, self.voice_channels)
             
             asr_end_time = time.time()
             if self.current_voice_id in self.session_timers:
@@ -509,6 +970,7 @@ class AISocketClient:
                 self.log_with_time(f"【对话{self.current_voice_id}计时：语音转文本结束】{elapsed:.3f}s")
             
             # 处理识别结果
+            self.resolve_speculation(self.current_voice_id, text)
             if text.strip() and not text.startswith("ERROR:"):
                 # 根据响应格式处理
                 if self.response_format == SocketProtocol.RESPONSE_JSON:
@@ -528,6 +990,74 @@ class AISocketClient:
             self.log_with_time(f"处理语音时出错: {e}")
             await self.send_text_message(SocketProtocol.MSG_ERROR, f"处理语音时出错: {str(e)}")
     
+    async def handle_cancel(self, data: bytes):
+        """处理客户端取消（抢话）：停止该轮次的LLM/TTS生成并立即回复MSG_AI_CANCELLED，
+        等待任务真正退出和统计节省的工作在后台进行，不阻塞读取新一轮的语音"""
+        cancel_time = time.time()
+        if len(data) >= SocketProtocol.TURN_ID_SIZE:
+            (turn_id,) = struct.unpack_from('>I', data, 0)
+        else:
+            turn_id = getattr(self, 'current_voice_id', self.voice_id)
+        self.cancelled_turns.add(turn_id)
+        if self.speculation is not None and self.speculation['voice_id'] == turn_id:
+            self.discard_speculation("客户端取消")
+        committed = self.committed_speculations.pop(turn_id, None)
+        if committed is not None and not committed['task'].done():
+            committed['task'].cancel()
+        self.cancel_stats['count'] += 1
+        
+        # 还没开始生成的查询直接丢弃
+        async with self.queue_lock:
+            before = len(self.pending_queries)
+            self.pending_queries = deque(q for q in self.pending_queries if q[0] != turn_id)
+            dropped_queries = before - len(self.pending_queries)
+        
+        # 尚未合成的TTS文本即为节省的TTS工作
+        saved_sentences = 0
+        saved_chars = 0
+        running = []
+        state = self.turn_state.get(turn_id)
+        if state is not None:
+            tts_queue = state['tts_queue']
+            while tts_queue is not None and not tts_queue.empty():
+                text = tts_queue.get_nowait()
+                if text and text != "__END__":
+                    saved_sentences += 1
+                    saved_chars += len(text)
+            running = [task for task in state['tasks'] if not task.done()]
+            for task in running:
+                task.cancel()
+        
+        await self.send_message(SocketProtocol.MSG_AI_CANCELLED, SocketProtocol.pack_turn_id(turn_id))
+        
+        report = asyncio.create_task(self._report_cancel(turn_id, state, running, cancel_time, saved_sentences,
+                                                         saved_chars, dropped_queries))
+        self.cancel_reports.add(report)
+        report.add_done_callback(self.cancel_reports.discard)
+    
+    async def _report_cancel(self, turn_id: int, state: Optional[dict], running: list, cancel_time: float,
+                             saved_sentences: int, saved_chars: int, dropped_queries: int):
+        """等待被取消的任务退出（最多200ms）后记录取消统计"""
+        stopped_tasks = len(running)
+        if running:
+            await asyncio.wait(running, timeout=0.2)
+        
+        stop_ms = (time.time() - cancel_time) * 1000
+        self.cancel_stats['stopped'] += 1 if stopped_tasks else 0
+        self.cancel_stats['saved_sentences'] += saved_sentences
+        self.cancel_stats['saved_chars'] += saved_chars
+        self.cancel_stats['dropped_queries'] += dropped_queries
+        
+        if state is not None:
+            self.log_with_time(f"🛑 [CANCEL] 轮次{turn_id}: 停止{stopped_tasks}个任务，耗时{stop_ms:.1f}ms；"
+                               f"已生成文本{state['llm_chars']}字/已合成{state['tts_sentences']}句/已发送音频{state['audio_bytes']}字节，"
+                               f"节省TTS {saved_sentences}句({saved_chars}字)，丢弃排队查询{dropped_queries}个")
+        else:
+            self.log_with_time(f"🛑 [CANCEL] 轮次{turn_id}: 没有进行中的生成任务，丢弃排队查询{dropped_queries}个")
+        self.log_with_time(f"📊 [CANCEL] 累计取消{self.cancel_stats['count']}次，实际停止生成{self.cancel_stats['stopped']}次，"
+                           f"节省TTS {self.cancel_stats['saved_sentences']}句({self.cancel_stats['saved_chars']}字)，"
+                           f"丢弃排队查询{self.cancel_stats['dropped_queries']}个")
+    
     async def handle_json_response(self, user_text: str):
         """处理JSON响应模式"""
         try:
@@ -575,6 +1105,10 @@ class AISocketClient:
                     if not self.pending_queries:
                         self.new_query_event.clear()
                 
+                if voice_id in self.cancelled_turns:
+                    self.log_with_time(f"🛑 [CANCEL] 轮次{voice_id}已被客户端取消，跳过生成")
+                    continue
+                
                 # 等待获取信号量
                 await self.max_concurrent_tasks.acquire()
                 
@@ -590,6 +1124,7 @@ class AISocketClient:
                 # 添加到活跃任务列表
                 async with self.tasks_lock:
                     self.active_tasks.append(new_task)
+                self.get_turn_state(voice_id)['tasks'].append(new_task)
                 
                 # 添加完成回调
                 new_task.add_done_callback(
@@ -603,10 +1138,11 @@ class AISocketClient:
     
     async def generate_text_response(self, text: str, voice_id: int, previous_tasks=None):
         """生成文本响应"""
+        spec = None
         try:
             # 发送AI开始信号
             await self.send_text_message(SocketProtocol.MSG_AI_START, "")
-            await self.send_text_message(SocketProtocol.MSG_AUDIO_START, "")
+            await self.send_audio_message(SocketProtocol.MSG_AUDIO_START, voice_id, self._begin_audio_turn(voice_id))
             
             # 创建TTS队列和任务
             tts_queue = asyncio.Queue()
@@ -617,6 +1153,9 @@ class AISocketClient:
             # 将TTS任务添加到活跃任务列表
             async with self.tasks_lock:
                 self.active_tasks.append(tts_task)
+            turn_state = self.get_turn_state(voice_id)
+            turn_state['tasks'].append(tts_task)
+            turn_state['tts_queue'] = tts_queue
             
             # 生成文本响应
             full_response = ""
@@ -626,7 +1165,16 @@ class AISocketClient:
             first_tts_timer = time.time()
             first_text_time = None  # 第一个文本chunk生成时间
             first_tts_text_time = None  # 新增：第一个TTS文本送入TTS队列时间
-            async for chunk in self.conversation_manager.generate_stream(text):
+            # 推测生成已确认时直接接着使用它的输出
+            spec = self.committed_speculations.pop(voice_id, None)
+            if spec is not None:
+                llm_stream = self._speculation_stream(spec)
+                saved_ms = (time.time() - spec['start_time']) * 1000
+                self.speculation_stats['saved_ms'] += saved_ms
+                self.log_with_time(f"🔮 [SPECULATE] 对话{voice_id}使用推测生成，已缓存{len(spec['chunks'])}块，LLM提前{saved_ms:.0f}ms")
+            else:
+                llm_stream = self.conversation_manager.generate_stream(text)
+            async for chunk in llm_stream:
                 # 记录第一个文本chunk生成完毕的时间点
                 if first_text_time is None:
                     first_text_time = time.time()
@@ -634,8 +1182,9 @@ class AISocketClient:
                     if start_time:
                         interval = first_text_time - start_time
                         self.log_with_time(f"【对话{voice_id}计时：第一个文本chunk生成完毕，耗时: {interval:.3f}s】")
-                if self.cancel_tasks.is_set():
+                if self.is_turn_cancelled(voice_id):
                     break
+                turn_state['llm_chars'] += len(chunk)
                 
                 # 检查是否需要取消之前的任务（参考AIServer.py的实现）
                 if not first_chunk_generated and previous_tasks:
@@ -677,11 +1226,6 @@ class AISocketClient:
                 
                 # 发送文本chunk
                 await self.send_text_message(SocketProtocol.MSG_TEXT_DATA, chunk)
-                # 确保立即发送
-                try:
-                    await self.writer.drain()
-                except Exception as e:
-                    self.log_with_time(f"刷新写入缓冲区失败: {e}")
                 
                 # 关键修复：让出执行权给TTS任务
                 await asyncio.sleep(0.001)  # 1ms，让TTS任务有机会处理队列
@@ -763,6 +1307,11 @@ class AISocketClient:
         except Exception as e:
             self.log_with_time(f"❌ [TXT_GEN] 生成文本响应时出错: {e} - voice_id={voice_id}")
             await self.send_text_message(SocketProtocol.MSG_ERROR, f"生成响应时出错: {str(e)}")
+        finally:
+            if spec is not None and not spec['task'].done():
+                spec['task'].cancel()
+            self.turn_state.pop(voice_id, None)
+            self.cancelled_turns.discard(voice_id)
     
     async def process_tts(self, text_queue: asyncio.Queue, voice_id: int):
         """处理TTS - 根据配置选择不同的音频处理方式"""
@@ -795,89 +1344,314 @@ class AISocketClient:
         except Exception as e:
             self.log_with_time(f"⚠️ [TTS] 清理TTS队列时出错: {e}")
     
+    def _tts_voice_name(self) -> str:
+        return str(getattr(self.tts_service, 'voice', None) or type(self.tts_service).__name__)
+    
+    def _begin_audio_turn(self, voice_id: int) -> bytes:
+        """确定本轮PCM下行格式（整轮不变），返回AUDIO_START的负载"""
+        pcm_format = SocketProtocol.PCM_DEFAULT_FORMAT
+        if self.audio_start_format and self.audio_format == SocketProtocol.AUDIO_FORMAT_PCM:
+            # 按TTS原始格式下发，省去服务器重采样，由客户端转换为播放格式；还不知道原始格式时用默认格式
+            pcm_format = TTS_NATIVE_FORMATS.get(self._tts_voice_name(), pcm_format)
+        self.get_turn_state(voice_id)['pcm_format'] = pcm_format
+        if self.audio_start_format and self.audio_format == SocketProtocol.AUDIO_FORMAT_PCM:
+            self.log_with_time(f"🎵 [AUDIO_START] PCM格式 {pcm_format[0]}Hz/{pcm_format[1]}ch - voice_id={voice_id}")
+            return SocketProtocol.pack_pcm_format(*pcm_format)
+        return b''
+    
+    def _turn_pcm_format(self, voice_id: int):
+        return self.get_turn_state(voice_id).get('pcm_format', SocketProtocol.PCM_DEFAULT_FORMAT)
+    
+    def _start_tts_pipeline(self, text_queue: asyncio.Queue, pcm_format):
+        """启动TTS预合成流水线：按顺序从text_queue取句子并立即开始合成，
+        最多tts_lookahead个句子在等待发送，发送端按句子顺序取出"""
+        pipeline = {
+            'sentences': asyncio.Queue(maxsize=self.tts_lookahead),
+            'tasks': set(),
+            'pcm_format': pcm_format,
+        }
+        pipeline['feeder'] = asyncio.create_task(self._tts_pipeline_feeder(text_queue, pipeline))
+        return pipeline
+    
+    async def _tts_pipeline_feeder(self, text_queue: asyncio.Queue, pipeline):
+        while True:
+            text = await text_queue.get()
+            if text == "__END__":
+                break
+            if not text or not text.strip():
+                continue
+            cleaned_text = text.strip()
+            chunks = asyncio.Queue()
+            cache_key = self._tts_cache_key(cleaned_text, pipeline['pcm_format'])
+            cached = await self.tts_cache.get(cache_key) if cache_key else None
+            if cached is not None:
+                # 命中：直接按客户端格式分块发送，不再合成和转码
+                for offset in range(0, len(cached), self.TTS_CACHE_SEND_BYTES):
+                    chunks.put_nowait(cached[offset:offset + self.TTS_CACHE_SEND_BYTES])
+                chunks.put_nowait(None)
+                self.log_with_time(f"💾 [TTS_CACHE] 命中: '{cleaned_text}' {len(cached)}字节；{self.tts_cache.summary()}")
+            else:
+                task = asyncio.create_task(self._tts_synthesize(cleaned_text, chunks))
+                pipeline['tasks'].add(task)
+                task.add_done_callback(pipeline['tasks'].discard)
+            await pipeline['sentences'].put((cleaned_text, chunks, cache_key, cached is not None))
+        await pipeline['sentences'].put(None)
+    
+    def _tts_cache_key(self, text: str, pcm_format):
+        """可以缓存的句子返回缓存键，否则返回None（PCM按采样率和声道数区分）"""
+        if self.tts_cache is None or not self.tts_cache.cacheable(text):
+            return None
+        audio_format = self.audio_format
+        if audio_format == SocketProtocol.AUDIO_FORMAT_PCM:
+            audio_format = f"{audio_format}/{pcm_format[0]}/{pcm_format[1]}"
+        return TTSCache.make_key(text, self._tts_voice_name(), audio_format)
+    
+    async def _tts_synthesize(self, text: str, chunks: asyncio.Queue):
+        """合成一个句子，数据包依次放入chunks，None表示结束，异常对象表示合成失败"""
+        try:
+            voice = self._tts_voice_name()
+            async for audio_chunk in self.tts_service.text_to_speech_stream(text):
+                if voice not in TTS_NATIVE_FORMATS:
+                    native = probe_mp3_format(audio_chunk)
+                    if native is not None:
+                        TTS_NATIVE_FORMATS[voice] = native
+                        self.log_with_time(f"🎵 [TTS] 音色{voice}原始格式: {native[0]}Hz/{native[1]}ch")
+                await chunks.put(audio_chunk)
+        except asyncio.CancelledError:
+            raise
+        except Exception as e:
+            await chunks.put(e)
+            return
+        await chunks.put(None)
+    
+    async def _tts_sentence_chunks(self, chunks: asyncio.Queue):
+        while True:
+            item = await chunks.get()
+            if item is None:
+                return
+            if isinstance(item, Exception):
+                raise item
+            yield item
+    
+    async def _stop_tts_pipeline(self, pipeline):
+        """停止流水线，取消还没发送的句子的合成"""
+        tasks = [pipeline['feeder']] + list(pipeline['tasks'])
+        for task in tasks:
+            if not task.done():
+                task.cancel()
+        await asyncio.gather(*tasks, return_exceptions=True)
+    
+    @staticmethod
+    def _pcm_duration_ms(data: bytes, pcm_format) -> float:
+        return len(data) * 1000.0 / (pcm_format[0] * pcm_format[1] * 2)
+    
+    def _measure_tts_audio(self, meter: PlaybackStallMeter, mp3_counter: MP3DurationCounter, data: bytes, pcm_format):
+        """按发送给客户端的音频时长更新停顿估计（pcm_format为None表示MP3）"""
+        duration_ms = self._pcm_duration_ms(data, pcm_format) if pcm_format else mp3_counter.feed(data)
+        meter.on_audio(duration_ms)
+    
+    def _report_tts_stalls(self, meter: PlaybackStallMeter, voice_id: int, tag: str):
+        stats = self.tts_stall_stats
+        stats['responses'] += 1
+        stats['stalls'] += meter.stalls
+        stats['stall_ms'] += meter.stall_ms
+        if meter.stalls:
+            stats['stalled_responses'] += 1
+        self.log_with_time(f"📊 [{tag}] 播放停顿估计: {meter.stalls}次/{meter.stall_ms:.0f}ms，音频{meter.audio_ms:.0f}ms - voice_id={voice_id}；"
+                           f"累计{stats['responses']}次响应中{stats['stalled_responses']}次有停顿，"
+                           f"共{stats['stalls']}次/{stats['stall_ms']:.0f}ms")
+    
     async def _process_tts_streaming(self, text_queue: asyncio.Queue, voice_id: int):
         """流式TTS处理 - 每个TTS数据包立即发送（原来的方式）"""
+        pcm_format = self._turn_pcm_format(voice_id)
+        pipeline = self._start_tts_pipeline(text_queue, pcm_format)
+        # 流式MP3解码器按需启动（见_process_tts_streaming_loop），统计累计所有解码器
+        pipeline['stream_decode'] = self.audio_format == SocketProtocol.AUDIO_FORMAT_PCM and MP3StreamDecoder.available()
+        pipeline['decoder'] = None
+        pipeline['decoded'] = [0, 0]
+        meter = PlaybackStallMeter()
+        try:
+            await self._process_tts_streaming_loop(pipeline, voice_id, meter)
+            if not self.is_turn_cancelled(voice_id):
+                tail = await self._close_mp3_stream_decoder(pipeline)
+                if tail:
+                    await self.send_audio_message(SocketProtocol.MSG_AUDIO_DATA, voice_id, tail)
+                    meter.on_audio(self._pcm_duration_ms(tail, pcm_format))
+                if pipeline['decoded'][0]:
+                    self.log_with_time(f"📊 [TTS_STREAM] 流式MP3解码: MP3 {pipeline['decoded'][0]} 字节 -> PCM {pipeline['decoded'][1]} 字节 - voice_id={voice_id}")
+            self._report_tts_stalls(meter, voice_id, "TTS_STREAM")
+        finally:
+            await self._stop_tts_pipeline(pipeline)
+            if pipeline['decoder'] is not None:
+                await pipeline['decoder'].abort()
+        # 发送音频结束信号
+        await self.send_audio_message(SocketProtocol.MSG_AUDIO_END, voice_id)
+    
+    async def _open_mp3_stream_decoder(self, voice_id: int, pcm_format):
+        """PCM下行时为本段TTS启动一个流式MP3解码器，ffmpeg不可用时返回None（退回逐包转换）"""
+        if self.audio_format != SocketProtocol.AUDIO_FORMAT_PCM or not MP3StreamDecoder.available():
+            return None
+        decoder = MP3StreamDecoder(sample_rate=pcm_format[0], channels=pcm_format[1])
+        try:
+            await decoder.start()
+        except Exception as e:
+            self.log_with_time(f"⚠️ [TTS_STREAM] 启动流式MP3解码失败，使用逐包转换: {e} - voice_id={voice_id}")
+            return None
+        return decoder
+    
+    async def _close_mp3_stream_decoder(self, pipeline) -> bytes:
+        """结束当前的流式解码器，返回还没输出的全部PCM（包括上一句的最后一帧）"""
+        decoder = pipeline['decoder']
+        if decoder is None:
+            return b''
+        pipeline['decoder'] = None
+        tail = await decoder.close()
+        pipeline['decoded'][0] += decoder.in_bytes
+        pipeline['decoded'][1] += decoder.out_bytes
+        return tail
+    
+    async def _process_tts_streaming_loop(self, pipeline, voice_id: int, meter: PlaybackStallMeter):
         last_session_id = None
         first_tts_time = None
+        mp3_counter = MP3DurationCounter()
+        pcm_format = pipeline['pcm_format'] if self.audio_format == SocketProtocol.AUDIO_FORMAT_PCM else None
         while True:
-            if self.cancel_tasks.is_set():
+            if self.is_turn_cancelled(voice_id):
                 self.log_with_time(f"🚫 [TTS_STREAM] 检测到取消信号，退出TTS处理 - voice_id={voice_id}")
                 # 发送取消信号给客户端
                 try:
-                    await self.send_text_message(SocketProtocol.MSG_AUDIO_END, "")
+                    await self.send_audio_message(SocketProtocol.MSG_AUDIO_END, voice_id)
                 except Exception as e:
                     self.log_with_time(f"⚠️ [TTS_STREAM] 发送取消信号失败: {e}")
                 break
             try:
-                text = await asyncio.wait_for(text_queue.get(), timeout=5.0)
-                if text == "__END__":
+                item = await asyncio.wait_for(pipeline['sentences'].get(), timeout=5.0)
+                if item is None:
                     break
-                if not text or not text.strip():
-                    continue
-                cleaned_text = text.strip()
+                cleaned_text, sentence_chunks, cache_key, cached = item
+                store = cache_key is not None and not cached
+                if store and pipeline.get('stream_decode'):
+                    # 要缓存的句子需要单独的解码器（多启动一个ffmpeg），第一次出现的句子仍共用解码器，
+                    # 再次出现（此前未命中过）才单独解码并写入缓存
+                    store = self.tts_cache.admit(cache_key)
+                sentence_audio = bytearray() if store else None
                 # 检查会话ID变化
                 if last_session_id is not None and voice_id != last_session_id:
                     await self.send_text_message(SocketProtocol.MSG_AI_NEWCHAT, "")
                 last_session_id = voice_id
-                # 生成音频并立即发送每个数据包
-                async for audio_chunk in self.tts_service.text_to_speech_stream(cleaned_text):
+                # 共用的流式解码器要到下一句数据到达时才输出上一句的最后一帧。
+                # 缓存命中或要写入缓存的句子先结束解码器，把上一句的尾部发完，保证播放顺序，
+                # 且缓存内容正好是本句的音频；其余句子共用一个解码器
+                mp3_decoder = None
+                if pipeline.get('stream_decode'):
+                    if cached or sentence_audio is not None:
+                        tail = await self._close_mp3_stream_decoder(pipeline)
+                        if tail:
+                            await self.send_audio_message(SocketProtocol.MSG_AUDIO_DATA, voice_id, tail)
+                            meter.on_audio(self._pcm_duration_ms(tail, pcm_format))
+                    if not cached:
+                        if pipeline['decoder'] is None:
+                            pipeline['decoder'] = await self._open_mp3_stream_decoder(voice_id, pcm_format)
+                            # 启动失败时本段剩余句子都退回逐包转换
+                            pipeline['stream_decode'] = pipeline['decoder'] is not None
+                        mp3_decoder = pipeline['decoder']
+                # 取出该句子（可能已经预先合成好）的数据包并立即发送
+                async for audio_chunk in self._tts_sentence_chunks(sentence_chunks):
                     if first_tts_time is None:
                         first_tts_time = time.time()
                         start_time = self.session_timers.get(voice_id, None)
                         if start_time:
                             interval = first_tts_time - start_time
                             self.log_with_time(f"【对话{voice_id}计时：第一个TTS包输出，端到端延迟: {interval:.3f}s】")
-                    if self.cancel_tasks.is_set():
+                    if self.is_turn_cancelled(voice_id):
                         self.log_with_time(f"🚫 [TTS_STREAM] 音频生成过程中检测到取消信号 - voice_id={voice_id}")
                         break
                     # 根据音频格式处理每个chunk
-                    if self.audio_format == SocketProtocol.AUDIO_FORMAT_PCM:
+                    if cached:
+                        # 缓存中已经是客户端格式
+                        final_chunk = audio_chunk
+                    elif mp3_decoder is not None:
+                        # 写入流式解码器，发送已经解码出的PCM
+                        final_chunk = await mp3_decoder.decode(audio_chunk)
+                        if not final_chunk:
+                            continue
+                    elif self.audio_format == SocketProtocol.AUDIO_FORMAT_PCM:
                         # 转换为PCM
-                        converted_chunk = await self.convert_mp3_to_pcm(audio_chunk)
+                        converted_chunk = await self.convert_mp3_to_pcm(audio_chunk, pcm_format)
                         final_chunk = converted_chunk
                     else:
                         # 保持MP3格式
                         final_chunk = audio_chunk
                     # 立即发送音频数据包（通常每个720字节）
-                    await self.send_message(SocketProtocol.MSG_AUDIO_DATA, final_chunk)
+                    await self.send_audio_message(SocketProtocol.MSG_AUDIO_DATA, voice_id, final_chunk)
+                    self._measure_tts_audio(meter, mp3_counter, final_chunk, pcm_format)
+                    if sentence_audio is not None:
+                        sentence_audio += final_chunk
                     self.log_with_time(f"🎵 发送音频包: {len(final_chunk)} 字节 ({self.audio_format.upper()})", verbose_only=True)
+                # 句子结束：要缓存的句子结束解码器取出最后一帧，其余的发送解码器中已输出的PCM
+                if mp3_decoder is not None:
+                    if sentence_audio is not None:
+                        tail = await self._close_mp3_stream_decoder(pipeline)
+                    else:
+                        tail = await mp3_decoder.read_idle()
+                    if tail:
+                        await self.send_audio_message(SocketProtocol.MSG_AUDIO_DATA, voice_id, tail)
+                        meter.on_audio(self._pcm_duration_ms(tail, pcm_format))
+                        if sentence_audio is not None:
+                            sentence_audio += tail
+                # 完整发送的句子写入缓存（与发送给客户端的数据相同）
+                if sentence_audio and not self.is_turn_cancelled(voice_id):
+                    await self.tts_cache.put(cache_key, bytes(sentence_audio))
                 # 发送音频包尾标记（表示当前句子结束）
                 end_marker = bytes([0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF])
-                await self.send_message(SocketProtocol.MSG_AUDIO_DATA, end_marker)
+                await self.send_audio_message(SocketProtocol.MSG_AUDIO_DATA, voice_id, end_marker)
+                self.get_turn_state(voice_id)['tts_sentences'] += 1
                 self.log_with_time(f"🎵 句子音频发送完成: '{cleaned_text}'")
             except asyncio.TimeoutError:
                 continue
             except Exception as e:
                 self.log_with_time(f"流式TTS处理出错: {e}")
                 continue
-        # 发送音频结束信号
-        await self.send_text_message(SocketProtocol.MSG_AUDIO_END, "")
     
     async def _process_tts_merged(self, text_queue: asyncio.Queue, voice_id: int):
         """合并TTS处理 - 将每个句子的多个数据包合并成一个包发送"""
+        pipeline = self._start_tts_pipeline(text_queue, self._turn_pcm_format(voice_id))
+        meter = PlaybackStallMeter()
+        try:
+            await self._process_tts_merged_loop(pipeline, voice_id, meter)
+            self._report_tts_stalls(meter, voice_id, "TTS_MERGE")
+        finally:
+            await self._stop_tts_pipeline(pipeline)
+        
+        # 发送音频结束信号
+        self.log_with_time(f"📤 [TTS_MERGE] 发送MSG_AUDIO_END信号 - voice_id={voice_id}")
+        await self.send_audio_message(SocketProtocol.MSG_AUDIO_END, voice_id)
+        self.log_with_time(f"🏁 [TTS_MERGE] TTS合并处理完成 - voice_id={voice_id}")
+    
+    async def _process_tts_merged_loop(self, pipeline, voice_id: int, meter: PlaybackStallMeter):
         last_session_id = None
         sentence_count = 0
         self.log_with_time(f"🚀 [TTS_MERGE] TTS合并处理开始 - voice_id={voice_id}")
         first_tts_time = None
+        mp3_counter = MP3DurationCounter()
+        pcm_format = pipeline['pcm_format'] if self.audio_format == SocketProtocol.AUDIO_FORMAT_PCM else None
         while True:
-            if self.cancel_tasks.is_set():
+            if self.is_turn_cancelled(voice_id):
                 self.log_with_time(f"🚫 [TTS_MERGE] 检测到取消信号，退出TTS处理 - voice_id={voice_id}")
                 # 发送取消信号给客户端
                 try:
-                    await self.send_text_message(SocketProtocol.MSG_AUDIO_END, "")
+                    await self.send_audio_message(SocketProtocol.MSG_AUDIO_END, voice_id)
                 except Exception as e:
                     self.log_with_time(f"⚠️ [TTS_MERGE] 发送取消信号失败: {e}")
                 break
             try:
                 self.log_with_time(f"⏳ [TTS_MERGE] 等待队列中的文本... - voice_id={voice_id}")
-                text = await asyncio.wait_for(text_queue.get(), timeout=5.0)
-                self.log_with_time(f"📥 [TTS_MERGE] 从队列获取文本: '{text[:20]}...' - voice_id={voice_id}")
-                if text == "__END__":
+                item = await asyncio.wait_for(pipeline['sentences'].get(), timeout=5.0)
+                if item is None:
                     self.log_with_time(f"🔚 [TTS_MERGE] 收到结束信号，准备退出 - voice_id={voice_id}")
                     break
-                if not text or not text.strip():
-                    continue
-                cleaned_text = text.strip()
+                cleaned_text, pending_chunks, cache_key, cached = item
+                self.log_with_time(f"📥 [TTS_MERGE] 从队列获取文本: '{cleaned_text[:20]}...' - voice_id={voice_id}")
                 sentence_count += 1
                 self.log_with_time(f"🎵 [TTS_MERGE] 开始生成第{sentence_count}个句子的音频 - voice_id={voice_id}")
                 # 检查会话ID变化
@@ -887,14 +1661,14 @@ class AISocketClient:
                 # 收集当前句子的所有TTS数据包
                 sentence_chunks = []
                 print(f"🎵 [TTS_MERGE] 句子内容 - cleaned_text={cleaned_text}")
-                async for audio_chunk in self.tts_service.text_to_speech_stream(cleaned_text):
+                async for audio_chunk in self._tts_sentence_chunks(pending_chunks):
                     if first_tts_time is None:
                         first_tts_time = time.time()
                         start_time = self.session_timers.get(voice_id, None)
                         if start_time:
                             interval = first_tts_time - start_time
                             self.log_with_time(f"【对话{voice_id}计时：第一个TTS包输出，端到端延迟: {interval:.3f}s】")
-                    if self.cancel_tasks.is_set():
+                    if self.is_turn_cancelled(voice_id):
                         self.log_with_time(f"🚫 [TTS_MERGE] 音频收集过程中检测到取消信号 - voice_id={voice_id}")
                         break
                     sentence_chunks.append(audio_chunk)
@@ -905,10 +1679,13 @@ class AISocketClient:
                     
                                     # 根据音频格式处理合并后的数据
                 self.log_with_time(f"🔄 [TTS_MERGE] 合并数据大小: {len(merged_sentence_data)} 字节 - voice_id={voice_id}")
-                if self.audio_format == SocketProtocol.AUDIO_FORMAT_PCM:
+                if cached:
+                    # 缓存中已经是客户端格式
+                    final_data = merged_sentence_data
+                elif self.audio_format == SocketProtocol.AUDIO_FORMAT_PCM:
                     # 转换为PCM
                     self.log_with_time(f"🔄 [TTS_MERGE] 开始MP3转PCM - voice_id={voice_id}")
-                    converted_data = await self.convert_mp3_to_pcm(merged_sentence_data)
+                    converted_data = await self.convert_mp3_to_pcm(merged_sentence_data, pcm_format)
                     final_data = converted_data
                     self.log_with_time(f"✅ [TTS_MERGE] MP3转PCM完成，PCM大小: {len(final_data)} 字节 - voice_id={voice_id}")
                 else:
@@ -918,12 +1695,16 @@ class AISocketClient:
                 
                 # 发送合并后的句子音频数据
                 self.log_with_time(f"📤 [TTS_MERGE] 发送句子音频数据 - voice_id={voice_id}")
-                await self.send_message(SocketProtocol.MSG_AUDIO_DATA, final_data)
+                await self.send_audio_message(SocketProtocol.MSG_AUDIO_DATA, voice_id, final_data)
+                self._measure_tts_audio(meter, mp3_counter, final_data, pcm_format)
+                if cache_key and not cached and not self.is_turn_cancelled(voice_id):
+                    await self.tts_cache.put(cache_key, final_data)
                 
                 # 发送音频包尾标记（表示当前句子结束）
                 end_marker = bytes([0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF])
                 self.log_with_time(f"📤 [TTS_MERGE] 发送句子结束标记 - voice_id={voice_id}")
-                await self.send_message(SocketProtocol.MSG_AUDIO_DATA, end_marker)
+                await self.send_audio_message(SocketProtocol.MSG_AUDIO_DATA, voice_id, end_marker)
+                self.get_turn_state(voice_id)['tts_sentences'] += 1
                 
                 self.log_with_time(f"🎵 发送合并句子: '{cleaned_text}' -> {len(sentence_chunks)}个包合并为{len(final_data)}字节 ({self.audio_format.upper()})")
                 
@@ -933,11 +1714,6 @@ class AISocketClient:
             except Exception as e:
                 self.log_with_time(f"❌ [TTS_MERGE] 合并TTS处理出错: {e} - voice_id={voice_id}")
                 continue
-        
-        # 发送音频结束信号
-        self.log_with_time(f"📤 [TTS_MERGE] 发送MSG_AUDIO_END信号 - voice_id={voice_id}")
-        await self.send_text_message(SocketProtocol.MSG_AUDIO_END, "")
-        self.log_with_time(f"🏁 [TTS_MERGE] TTS合并处理完成 - voice_id={voice_id}")
     
     async def task_completed_callback(self, future):
         """任务完成回调"""
@@ -955,7 +1731,7 @@ class AISocketServer:
     
     def __init__(self, host='192.168.14.129', port=7860, 
                  default_audio_format='mp3', default_audio_merge='disabled',
-                 verbose=False):
+                 verbose=False, tts_cache: Optional[TTSCache] = None):
         self.host = host
         self.port = port
         self.clients = {}
@@ -965,6 +1741,7 @@ class AISocketServer:
         self.default_audio_format = default_audio_format
         self.default_audio_merge = default_audio_merge
         self.verbose = verbose
+        self.tts_cache = tts_cache
     
     def log_with_time(self, message: str):
         """输出带时间戳的日志"""
@@ -993,7 +1770,8 @@ class AISocketServer:
             client = AISocketClient(reader, writer, client_addr, 
                                    default_audio_format=self.default_audio_format,
                                    default_audio_merge=self.default_audio_merge,
-                                   verbose=self.verbose)
+                                   verbose=self.verbose,
+                                   tts_cache=self.tts_cache)
             self.clients[client_id] = client
             self.log_with_time(f"✅ 客户端 {client_id} 处理器创建成功")
             
@@ -1073,6 +1851,9 @@ async def main():
                         choices=['enabled', 'disabled'],
                         default='disabled',
                         help='句子内TTS包合并模式: enabled=合并成一个包发送, disabled=立即发送每个包 (默认: disabled)')
+    parser.add_argument('--tts-cache-mb', type=int, default=32, help='TTS音频内存缓存大小MB，0表示关闭 (默认: 32)')
+    parser.add_argument('--tts-cache-dir', default=None, help='TTS音频磁盘缓存目录 (默认: 不使用磁盘缓存)')
+    parser.add_argument('--tts-cache-disk-mb', type=int, default=256, help='TTS音频磁盘缓存大小MB (默认: 256)')
     parser.add_argument('--verbose', '-v', action='store_true', help='详细日志输出')
     
     args = parser.parse_args()
@@ -1081,6 +1862,12 @@ async def main():
     log_main(f"📡 监听地址: {args.host}:{args.port}")
     log_main(f"🎵 默认音频格式: {args.audio_format.upper()}")
     log_main(f"📦 TTS包处理: {'句子内合并' if args.audio_merge == 'enabled' else '立即发送'}")
+    tts_cache = None
+    if args.tts_cache_mb > 0:
+        tts_cache = TTSCache(max_memory_bytes=args.tts_cache_mb << 20, disk_dir=args.tts_cache_dir,
+                             max_disk_bytes=args.tts_cache_disk_mb << 20)
+        log_main(f"💾 TTS缓存: 内存{args.tts_cache_mb}MB" +
+                 (f"，磁盘{args.tts_cache_dir} ({args.tts_cache_disk_mb}MB，已有{len(tts_cache.disk)}条)" if args.tts_cache_dir else ""))
     
     # 初始化服务
     log_main("🔄 会话初始化...")
@@ -1090,7 +1877,8 @@ async def main():
     server = AISocketServer(host=args.host, port=args.port, 
                            default_audio_format=args.audio_format,
                            default_audio_merge=args.audio_merge,
-                           verbose=args.verbose)
+                           verbose=args.verbose,
+                           tts_cache=tts_cache)
     log_main("✅ 服务器实例创建成功")
     
     try:
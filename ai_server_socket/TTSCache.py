@@ -0,0 +1,157 @@
+# TTS音频缓存
+# 助手经常重复简短的句子（问候、确认等），按 (文本, 音色, 下行音频格式) 缓存发送给客户端的最终音频
+# （PCM或MP3），命中时直接发送，不再调用TTS也不再转码。
+# 内存层为LRU；可选的磁盘层在内存淘汰后仍能命中，服务器重启后也保留。
+# 写入缓存有额外代价的调用者可以用admit()只缓存第二次出现的句子。
+
+import asyncio
+import hashlib
+import os
+from collections import OrderedDict
+from typing import Optional
+
+
+class TTSCache:
+    """进程内共享的TTS音频LRU缓存（内存 + 可选磁盘）"""
+
+    def __init__(self, max_memory_bytes: int = 32 << 20, disk_dir: Optional[str] = None,
+                 max_disk_bytes: int = 256 << 20, max_text_len: int = 40, max_missed: int = 4096):
+        self.max_memory_bytes = max_memory_bytes
+        self.max_disk_bytes = max_disk_bytes
+        self.max_text_len = max_text_len
+        self.disk_dir = disk_dir
+        self.memory = OrderedDict()     # key -> bytes
+        self.memory_bytes = 0
+        self.disk = OrderedDict()       # key -> 文件大小，按最近使用排序
+        self.disk_bytes = 0
+        self.missed = OrderedDict()     # 未命中过、还没缓存的键，按最近出现排序
+        self.max_missed = max_missed
+        self.stats = {'hits': 0, 'memory_hits': 0, 'disk_hits': 0, 'misses': 0,
+                      'stores': 0, 'evictions': 0, 'served_bytes': 0}
+        if disk_dir:
+            os.makedirs(disk_dir, exist_ok=True)
+            self._load_disk_index()
+
+    @staticmethod
+    def make_key(text: str, voice: str, audio_format: str) -> str:
+        return hashlib.sha1(f"{voice}\n{audio_format}\n{text}".encode('utf-8')).hexdigest()
+
+    def cacheable(self, text: str) -> bool:
+        """只缓存短句，长句很少重复"""
+        return 0 < len(text) <= self.max_text_len
+
+    def _disk_path(self, key: str) -> str:
+        return os.path.join(self.disk_dir, f"{key}.bin")
+
+    def _load_disk_index(self):
+        entries = []
+        for name in os.listdir(self.disk_dir):
+            if not name.endswith('.bin'):
+                continue
+            path = os.path.join(self.disk_dir, name)
+            try:
+                st = os.stat(path)
+            except OSError:
+                continue
+            entries.append((st.st_mtime, name[:-4], st.st_size))
+        for _, key, size in sorted(entries):
+            self.disk[key] = size
+            self.disk_bytes += size
+        self._trim_disk()
+
+    async def get(self, key: str) -> Optional[bytes]:
+        data = self.memory.get(key)
+        if data is not None:
+            self.memory.move_to_end(key)
+            self.stats['memory_hits'] += 1
+        elif self.disk_dir and key in self.disk:
+            try:
+                data = await asyncio.to_thread(self._read_disk, key)
+            except OSError:
+                self._drop_disk(key)
+                data = None
+            if data is not None:
+                self.disk.move_to_end(key)
+                self.stats['disk_hits'] += 1
+                self._put_memory(key, data)
+        if data is None:
+            self.stats['misses'] += 1
+            return None
+        self.stats['hits'] += 1
+        self.stats['served_bytes'] += len(data)
+        return data
+
+    def admit(self, key: str) -> bool:
+        """未命中后调用：第一次出现只记下并返回False，之前已经未命中过（再次出现）时返回True"""
+        if key in self.missed:
+            self.missed.move_to_end(key)
+            return True
+        self.missed[key] = None
+        while len(self.missed) > self.max_missed:
+            self.missed.popitem(last=False)
+        return False
+
+    async def put(self, key: str, data: bytes):
+        if not data or len(data) > self.max_memory_bytes // 4:
+            return
+        self.missed.pop(key, None)
+        self.stats['stores'] += 1
+        self._put_memory(key, data)
+        if self.disk_dir and key not in self.disk:
+            try:
+                await asyncio.to_thread(self._write_disk, key, data)
+            except OSError:
+                return
+            self.disk[key] = len(data)
+            self.disk_bytes += len(data)
+            self._trim_disk()
+
+    def _put_memory(self, key: str, data: bytes):
+        old = self.memory.pop(key, None)
+        if old is not None:
+            self.memory_bytes -= len(old)
+        self.memory[key] = data
+        self.memory_bytes += len(data)
+        while self.memory_bytes > self.max_memory_bytes and self.memory:
+            _, evicted = self.memory.popitem(last=False)
+            self.memory_bytes -= len(evicted)
+            self.stats['evictions'] += 1
+
+    def _read_disk(self, key: str) -> bytes:
+        path = self._disk_path(key)
+        with open(path, 'rb') as f:
+            data = f.read()
+        os.utime(path)
+        return data
+
+    def _write_disk(self, key: str, data: bytes):
+        path = self._disk_path(key)
+        tmp_path = path + '.tmp'
+        with open(tmp_path, 'wb') as f:
+            f.write(data)
+        os.replace(tmp_path, path)
+
+    def _drop_disk(self, key: str):
+        size = self.disk.pop(key, None)
+        if size is not None:
+            self.disk_bytes -= size
+        try:
+            os.remove(self._disk_path(key))
+        except OSError:
+            pass
+
+    def _trim_disk(self):
+        while self.disk_bytes > self.max_disk_bytes and self.disk:
+            key = next(iter(self.disk))
+            self._drop_disk(key)
+
+    def summary(self) -> str:
+        s = self.stats
+        lookups = s['hits'] + s['misses']
+        hit_rate = s['hits'] * 100.0 / lookups if lookups else 0.0
+        text = (f"命中率 {hit_rate:.1f}% ({s['hits']}/{lookups}，内存{s['memory_hits']}/磁盘{s['disk_hits']})，"
+                f"内存 {len(self.memory)}条/{self.memory_bytes // 1024}KB，淘汰{s['evictions']}条，"
+                f"命中发送 {s['served_bytes'] // 1024}KB")
+        if self.disk_dir:
+            text += f"，磁盘 {len(self.disk)}条/{self.disk_bytes // 1024}KB"
+        return text
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+MP3→PCM下行转换对比：逐包 AudioSegment.from_file vs 每段一个 MP3StreamDecoder
+
+把一个MP3文件切成TTS流式接口的包大小（默认720字节），分别按两种方式转换为16kHz单声道PCM，
+统计总耗时、子进程(ffmpeg) CPU时间、第一个PCM输出的延迟和输出字节数。
+
+用法: python3 bench_mp3_decode.py [mp3文件] [--chunk 720] [--rounds 3]
+"""
+
+import argparse
+import asyncio
+import io
+import os
+import resource
+import time
+
+from AudioCodec import MP3StreamDecoder
+
+DEFAULT_MP3 = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "mp3s", "1753268900849.mp3")
+
+
+def split_chunks(data: bytes, size: int):
+    return [data[i:i + size] for i in range(0, len(data), size)]
+
+
+def children_cpu() -> float:
+    usage = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return usage.ru_utime + usage.ru_stime
+
+
+def bench_pydub(chunks):
+    """SocketServer.convert_mp3_to_pcm 的做法：每个包单独解码并重采样"""
+    from pydub import AudioSegment
+    out_bytes = 0
+    failed = 0
+    first_pcm = None
+    start = time.perf_counter()
+    for chunk in chunks:
+        try:
+            audio = AudioSegment.from_file(io.BytesIO(chunk), format="mp3")
+            pcm = audio.set_frame_rate(16000).set_channels(1).set_sample_width(2).raw_data
+        except Exception:
+            failed += 1
+            continue
+        if pcm and first_pcm is None:
+            first_pcm = time.perf_counter() - start
+        out_bytes += len(pcm)
+    return time.perf_counter() - start, first_pcm, out_bytes, failed
+
+
+async def bench_stream(chunks):
+    decoder = MP3StreamDecoder(sample_rate=16000, channels=1)
+    first_pcm = None
+    out_bytes = 0
+    start = time.perf_counter()
+    await decoder.start()
+    for chunk in chunks:
+        pcm = await decoder.decode(chunk)
+        if pcm and first_pcm is None:
+            first_pcm = time.perf_counter() - start
+        out_bytes += len(pcm)
+    out_bytes += len(await decoder.close())
+    return time.perf_counter() - start, first_pcm, out_bytes, 0
+
+
+def report(name, results):
+    wall = sum(r[0] for r in results) / len(results)
+    cpu = sum(r[4] for r in results) / len(results)
+    firsts = [r[1] for r in results if r[1] is not None]
+    first = sum(firsts) / len(firsts) * 1000 if firsts else float("nan")
+    print(f"{name:<10} 耗时 {wall * 1000:8.1f} ms  ffmpeg CPU {cpu * 1000:8.1f} ms  "
+          f"首包PCM {first:7.1f} ms  输出 {results[0][2]} 字节  失败包 {results[0][3]}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="MP3→PCM下行转换对比")
+    parser.add_argument("mp3", nargs="?", default=DEFAULT_MP3)
+    parser.add_argument("--chunk", type=int, default=720, help="每包字节数")
+    parser.add_argument("--rounds", type=int, default=3)
+    args = parser.parse_args()
+
+    if not MP3StreamDecoder.available():
+        print("❌ 未找到ffmpeg，无法运行对比")
+        return
+
+    with open(args.mp3, "rb") as f:
+        chunks = split_chunks(f.read(), args.chunk)
+    print(f"📁 {args.mp3}: {len(chunks)} 个包 x {args.chunk} 字节, {args.rounds} 轮")
+
+    for name, run in (("pydub", lambda: bench_pydub(chunks)),
+                      ("stream", lambda: asyncio.run(bench_stream(chunks)))):
+        results = []
+        for _ in range(args.rounds):
+            cpu_before = children_cpu()
+            try:
+                result = run()
+            except ImportError as e:
+                print(f"⚠️ {name} 跳过: {e}")
+                break
+            results.append(result + (children_cpu() - cpu_before,))
+        if results:
+            report(name, results)
+
+
+if __name__ == "__main__":
+    main()
@@ -152,7 +152,7 @@ compile_ai_client() {
     
     # 编译
     print_info "正在编译..."
-    "$CC" ai_client_start_stop2.c test_comm_argparse.c -o ai_client_start_stop $CFLAGS $LDFLAGS
+    "$CC" ai_client_start_stop2.c test_comm_argparse.c socket_protocol.c socket_io_loop.c audio_codec.c audio_ring.c audio_jitter.c audio_mp3.c audio_preroll.c audio_dsp.c audio_vad.c audio_kws.c audio_resample.c -o ai_client_start_stop $CFLAGS $LDFLAGS
     
     if [ $? -eq 0 ] && [ -f "ai_client_start_stop" ]; then
         print_success "编译成功"